@@ -311,6 +311,14 @@ public class CAPI {
                                   Pointer log_ctx);
 
 
+    /**
+     * Indicates whether libmongocrypt was built with a native crypto backend. If so, crypto hooks do not need to be set.
+     *
+     * @return true if libmongocrypt can encrypt and decrypt without crypto hooks
+     */
+    public static native boolean
+    mongocrypt_is_crypto_available();
+
     public static native boolean
     mongocrypt_setopt_crypto_hooks(mongocrypt_t crypt,
                                    mongocrypt_crypto_fn aes_256_cbc_encrypt,
@@ -52,6 +52,7 @@ import static com.mongodb.crypt.capi.CAPI.mongocrypt_ctx_setopt_masterkey_aws_en
 import static com.mongodb.crypt.capi.CAPI.mongocrypt_ctx_setopt_masterkey_local;
 import static com.mongodb.crypt.capi.CAPI.mongocrypt_destroy;
 import static com.mongodb.crypt.capi.CAPI.mongocrypt_init;
+import static com.mongodb.crypt.capi.CAPI.mongocrypt_is_crypto_available;
 import static com.mongodb.crypt.capi.CAPI.mongocrypt_new;
 import static com.mongodb.crypt.capi.CAPI.mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5;
 import static com.mongodb.crypt.capi.CAPI.mongocrypt_setopt_crypto_hooks;
@@ -94,6 +95,30 @@ class MongoCryptImpl implements MongoCrypt {
     private final AtomicBoolean closed;
 
     MongoCryptImpl(final MongoCryptOptions options) {
+        this(options, !isNativeCryptoAvailable());
+    }
+
+    /**
+     * Returns whether libmongocrypt was built with native crypto.
+     *
+     * @return false if it was not, or if libmongocrypt is older than mongocrypt_is_crypto_available
+     */
+    static boolean isNativeCryptoAvailable() {
+        try {
+            return mongocrypt_is_crypto_available();
+        } catch (UnsatisfiedLinkError e) {
+            return false;
+        }
+    }
+
+    /**
+     * Create an instance, optionally without the Java crypto hooks.
+     *
+     * @param options the options
+     * @param useCryptoHooks whether to set the Java crypto hooks. They are only needed if libmongocrypt was built without native
+     *                       crypto, since each call crosses the JNA boundary.
+     */
+    MongoCryptImpl(final MongoCryptOptions options, final boolean useCryptoHooks) {
         closed = new AtomicBoolean();
         wrapped = mongocrypt_new();
         if (wrapped == null) {
@@ -121,16 +146,19 @@ class MongoCryptImpl implements MongoCrypt {
         sha256Callback = new MessageDigestCallback("SHA-256");
         secureRandomCallback = new SecureRandomCallback(new SecureRandom());
 
-        success = mongocrypt_setopt_crypto_hooks(wrapped, aesCBC256EncryptCallback, aesCBC256DecryptCallback, secureRandomCallback,
-                hmacSha512Callback, hmacSha256Callback, sha256Callback, null);
-        if (!success) {
-            throwExceptionFromStatus();
-        }
-
         signingRSAESPKCSCallback = new SigningRSAESPKCSCallback();
-        success = mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5(wrapped, signingRSAESPKCSCallback, null);
-        if (!success) {
-            throwExceptionFromStatus();
+
+        if (useCryptoHooks) {
+            success = mongocrypt_setopt_crypto_hooks(wrapped, aesCBC256EncryptCallback, aesCBC256DecryptCallback, secureRandomCallback,
+                    hmacSha512Callback, hmacSha256Callback, sha256Callback, null);
+            if (!success) {
+                throwExceptionFromStatus();
+            }
+
+            success = mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5(wrapped, signingRSAESPKCSCallback, null);
+            if (!success) {
+                throwExceptionFromStatus();
+            }
         }
 
         if (options.getLocalKmsProviderOptions() != null) {
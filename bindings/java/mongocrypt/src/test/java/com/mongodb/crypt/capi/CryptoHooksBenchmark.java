@@ -0,0 +1,95 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+package com.mongodb.crypt.capi;
+
+import com.mongodb.crypt.capi.MongoCryptContext.State;
+import org.bson.BsonDocument;
+import org.bson.BsonString;
+import org.bson.RawBsonDocument;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Measures the cost per field of explicit encryption and decryption with the Java crypto hooks, and with libmongocrypt's
+ * native crypto if it is available. Run the main method with the number of iterations as an optional argument.
+ */
+public final class CryptoHooksBenchmark {
+    private static final String ALGORITHM = "AEAD_AES_256_CBC_HMAC_SHA_512-Random";
+
+    public static void main(final String[] args) {
+        int iterations = args.length > 0 ? Integer.parseInt(args[0]) : 10000;
+        measure("crypto hooks", true, iterations);
+        if (MongoCryptImpl.isNativeCryptoAvailable()) {
+            measure("native crypto", false, iterations);
+        } else {
+            System.out.println("native crypto: unavailable, libmongocrypt was built without a crypto backend");
+        }
+    }
+
+    private static void measure(final String name, final boolean useCryptoHooks, final int iterations) {
+        MongoCrypt mongoCrypt = new MongoCryptImpl(MongoCryptOptions.builder()
+                .localKmsProviderOptions(MongoLocalKmsProviderOptions.builder()
+                        .localMasterKey(ByteBuffer.wrap(new byte[96]))
+                        .build())
+                .build(), useCryptoHooks);
+
+        MongoCryptContext dataKeyContext = mongoCrypt.createDataKeyContext("local",
+                MongoDataKeyOptions.builder().masterKey(new BsonDocument()).build());
+        RawBsonDocument keyDocument = dataKeyContext.finish();
+        dataKeyContext.close();
+
+        BsonDocument value = new BsonDocument("v", new BsonString("a short string value"));
+        MongoExplicitEncryptOptions options = MongoExplicitEncryptOptions.builder()
+                .keyId(keyDocument.getBinary("_id"))
+                .algorithm(ALGORITHM)
+                .build();
+
+        // warm up, and put the data key in the key cache.
+        RawBsonDocument encrypted = run(mongoCrypt.createExplicitEncryptionContext(value, options), keyDocument);
+
+        long start = System.nanoTime();
+        for (int i = 0; i < iterations; i++) {
+            run(mongoCrypt.createExplicitEncryptionContext(value, options), keyDocument);
+        }
+        double encryptMicros = (System.nanoTime() - start) / 1000.0 / iterations;
+
+        start = System.nanoTime();
+        for (int i = 0; i < iterations; i++) {
+            run(mongoCrypt.createExplicitDecryptionContext(encrypted), keyDocument);
+        }
+        double decryptMicros = (System.nanoTime() - start) / 1000.0 / iterations;
+
+        mongoCrypt.close();
+        System.out.printf("%s: encrypt %.2f us/field, decrypt %.2f us/field%n", name, encryptMicros, decryptMicros);
+    }
+
+    private static RawBsonDocument run(final MongoCryptContext context, final RawBsonDocument keyDocument) {
+        try {
+            if (context.getState() == State.NEED_MONGO_KEYS) {
+                context.addMongoOperationResult(keyDocument);
+                context.completeMongoOperation();
+            }
+            return context.finish();
+        } finally {
+            context.close();
+        }
+    }
+
+    private CryptoHooksBenchmark() {
+    }
+}
@@ -50,6 +50,9 @@ else
     LIBMONGOCRYPT_CFLAGS="-fPIC -Werror"
 fi
 
+# The addon uses the crypto callbacks in lib/cryptoCallbacks.js instead of
+# linking a crypto library. JavaScript callbacks must run on the main thread,
+# so `finalizeAsync` does not use the thread pool with this build.
 CMAKE_FLAGS="-DDISABLE_NATIVE_CRYPTO=1 -DCMAKE_INSTALL_LIBDIR=lib"
 if [ "$OS" == "Windows_NT" ]; then
   WINDOWS_CMAKE_FLAGS="-Thost=x64 -A x64 -DCMAKE_C_FLAGS_RELWITHDEBINFO=\"/MT\""
@@ -125,7 +125,10 @@ module.exports = function (modules) {
         mongoCryptOptions.logger = options.logger;
       }
 
-      Object.assign(mongoCryptOptions, { cryptoCallbacks });
+      // libmongocrypt's native crypto avoids a call into JavaScript per field
+      if (!mc.MongoCrypt.cryptoAvailable) {
+        Object.assign(mongoCryptOptions, { cryptoCallbacks });
+      }
       this._mongocrypt = new mc.MongoCrypt(mongoCryptOptions);
       this._contextCounter = 0;
     }
@@ -73,7 +73,10 @@ module.exports = function (modules) {
         throw new TypeError('Missing required option `keyVaultNamespace`');
       }
 
-      Object.assign(options, { cryptoCallbacks });
+      // libmongocrypt's native crypto avoids a call into JavaScript per field
+      if (!mc.MongoCrypt.cryptoAvailable) {
+        Object.assign(options, { cryptoCallbacks });
+      }
 
       // kmsProviders will be parsed by libmongocrypt, must be provided as BSON binary data
       if (options.kmsProviders && !Buffer.isBuffer(options.kmsProviders)) {
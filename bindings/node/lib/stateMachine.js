@@ -197,16 +197,27 @@ module.exports = function (modules) {
 
         // terminal states
         case MONGOCRYPT_CTX_READY: {
-          const finalizedContext = context.finalize();
-          // TODO: Maybe rework the logic here so that instead of doing
-          // the callback here, finalize stores the result, and then
-          // we wait to MONGOCRYPT_CTX_DONE to do the callback
-          if (context.state === MONGOCRYPT_CTX_ERROR) {
-            const message = context.status.message || 'Finalization error';
-            callback(new MongoCryptError(message));
-            return;
-          }
-          callback(null, bson.deserialize(finalizedContext, this.options));
+          // finalize off the main thread, so that encrypting or decrypting
+          // large documents does not block the event loop
+          // the callback is called outside of the promise chain, so that an
+          // exception it throws is not turned into an unhandled rejection,
+          // and it is called exactly once
+          context.finalizeAsync().then(
+            finalizedContext => {
+              let error = null;
+              let result = null;
+              try {
+                result = bson.deserialize(finalizedContext, this.options);
+              } catch (err) {
+                error = err;
+              }
+              process.nextTick(() => callback(error, result));
+            },
+            err => {
+              const error = new MongoCryptError(err.message || 'Finalization error');
+              process.nextTick(() => callback(error));
+            }
+          );
           return;
         }
         case MONGOCRYPT_CTX_ERROR: {
@@ -93,7 +93,8 @@ Function MongoCrypt::Init(Napi::Env env) {
                     InstanceMethod("makeDecryptionContext", &MongoCrypt::MakeDecryptionContext),
                     InstanceMethod("makeExplicitDecryptionContext", &MongoCrypt::MakeExplicitDecryptionContext),
                     InstanceMethod("makeDataKeyContext", &MongoCrypt::MakeDataKeyContext),
-                    InstanceAccessor("status", &MongoCrypt::Status, nullptr)
+                    InstanceAccessor("status", &MongoCrypt::Status, nullptr),
+                    StaticValue("cryptoAvailable", Boolean::New(env, mongocrypt_is_crypto_available()))
                   });
 }
 
@@ -396,6 +397,7 @@ MongoCrypt::MongoCrypt(const CallbackInfo& info)
 
     if (options.Has("logger")) {
         SetCallback("logger", options["logger"]);
+        _has_javascript_callbacks = true;
         if (!mongocrypt_setopt_log_handler(
                 _mongo_crypt.get(), MongoCrypt::logHandler, this)) {
             throw TypeError::New(Env(), errorStringFromStatus(_mongo_crypt.get()));
@@ -416,6 +418,7 @@ MongoCrypt::MongoCrypt(const CallbackInfo& info)
         if (!setupCryptoHooks()) {
             throw Error::New(Env(), "unable to configure crypto hooks");
         }
+        _has_javascript_callbacks = true;
     }
 
     // initialize afer all options are set, but after `MongoCrypt` instance is created so we can
@@ -447,7 +450,7 @@ Value MongoCrypt::MakeEncryptionContext(const CallbackInfo& info) {
         throw TypeError::New(Env(), errorStringFromStatus(context.get()));
     }
 
-    return MongoCryptContext::NewInstance(Env(), std::move(context));
+    return MongoCryptContext::NewInstance(Env(), this, std::move(context));
 }
 
 Value MongoCrypt::MakeExplicitEncryptionContext(const CallbackInfo& info) {
@@ -504,7 +507,7 @@ Value MongoCrypt::MakeExplicitEncryptionContext(const CallbackInfo& info) {
         throw TypeError::New(Env(), errorStringFromStatus(context.get()));
     }
 
-    return MongoCryptContext::NewInstance(Env(), std::move(context));
+    return MongoCryptContext::NewInstance(Env(), this, std::move(context));
 }
 
 Value MongoCrypt::MakeDecryptionContext(const CallbackInfo& info) {
@@ -521,7 +524,7 @@ Value MongoCrypt::MakeDecryptionContext(const CallbackInfo& info) {
         throw TypeError::New(Env(), errorStringFromStatus(context.get()));
     }
 
-    return MongoCryptContext::NewInstance(Env(), std::move(context));
+    return MongoCryptContext::NewInstance(Env(), this, std::move(context));
 }
 
 Value MongoCrypt::MakeExplicitDecryptionContext(const CallbackInfo& info) {
@@ -538,7 +541,7 @@ Value MongoCrypt::MakeExplicitDecryptionContext(const CallbackInfo& info) {
         throw TypeError::New(Env(), errorStringFromStatus(context.get()));
     }
 
-    return MongoCryptContext::NewInstance(Env(), std::move(context));
+    return MongoCryptContext::NewInstance(Env(), this, std::move(context));
 }
 
 Value MongoCrypt::MakeDataKeyContext(const CallbackInfo& info) {
@@ -585,7 +588,7 @@ Value MongoCrypt::MakeDataKeyContext(const CallbackInfo& info) {
         throw TypeError::New(Env(), errorStringFromStatus(context.get()));
     }
 
-    return MongoCryptContext::NewInstance(Env(), std::move(context));
+    return MongoCryptContext::NewInstance(Env(), this, std::move(context));
 }
 
 // Store callbacks as nested properties on the MongoCrypt binding object
@@ -627,39 +630,58 @@ Function MongoCryptContext::Init(Napi::Env env) {
                     InstanceMethod("nextKMSRequest", &MongoCryptContext::NextKMSRequest),
                     InstanceMethod("finishKMSRequests", &MongoCryptContext::FinishKMSRequests),
                     InstanceMethod("finalize", &MongoCryptContext::FinalizeContext),
+                    InstanceMethod("finalizeAsync", &MongoCryptContext::FinalizeContextAsync),
                     InstanceAccessor("status", &MongoCryptContext::Status, nullptr),
                     InstanceAccessor("state", &MongoCryptContext::State, nullptr)
                   });
 }
 
-Object MongoCryptContext::NewInstance(Napi::Env env, std::unique_ptr<mongocrypt_ctx_t, MongoCryptContextDeleter> context) {
+Object MongoCryptContext::NewInstance(Napi::Env env,
+                                      MongoCrypt* mongo_crypt,
+                                      std::unique_ptr<mongocrypt_ctx_t, MongoCryptContextDeleter> context) {
     InstanceData* instance_data = env.GetInstanceData<InstanceData>();
     Object obj = instance_data->MongoCryptContextCtor.Value().New({});
     MongoCryptContext* instance = MongoCryptContext::Unwrap(obj);
     instance->_context = std::move(context);
+    instance->_finalize_on_main_thread = mongo_crypt->_has_javascript_callbacks;
+    // `finalizeAsync` may outlive every other reference to the `MongoCrypt`
+    // that owns the underlying `mongocrypt_t`, so tie their lifetimes.
+    obj.Set("__mongoCrypt", mongo_crypt->Value());
     return obj;
 }
 
 MongoCryptContext::MongoCryptContext(const CallbackInfo& info)
     : ObjectWrap(info) {}
 
+// While `finalizeAsync` runs on the thread pool, the worker owns `_context`, so
+// every other use of it from JavaScript must wait for the promise to settle.
+void MongoCryptContext::ThrowIfFinalizing() {
+    if (_finalizing) {
+        throw Error::New(Env(), "Context is being finalized");
+    }
+}
+
 Value MongoCryptContext::Status(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     std::unique_ptr<mongocrypt_status_t, MongoCryptStatusDeleter> status(mongocrypt_status_new());
     mongocrypt_ctx_status(_context.get(), status.get());
     return ExtractStatus(Env(), status.get());
 }
 
 Value MongoCryptContext::State(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     return Number::New(Env(), mongocrypt_ctx_state(_context.get()));
 }
 
 Value MongoCryptContext::NextMongoOperation(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     std::unique_ptr<mongocrypt_binary_t, MongoCryptBinaryDeleter> op_bson(mongocrypt_binary_new());
     mongocrypt_ctx_mongo_op(_context.get(), op_bson.get());
     return BufferFromBinary(Env(), op_bson.get());
 }
 
 void MongoCryptContext::AddMongoOperationResponse(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     if (info.Length() != 1 || !info[0].IsObject()) {
         throw TypeError::New(Env(), "Missing required parameter `buffer`");
     }
@@ -675,10 +697,12 @@ void MongoCryptContext::AddMongoOperationResponse(const CallbackInfo& info) {
 }
 
 void MongoCryptContext::FinishMongoOperation(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     mongocrypt_ctx_mongo_done(_context.get());
 }
 
 Value MongoCryptContext::NextKMSRequest(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     mongocrypt_kms_ctx_t* kms_context = mongocrypt_ctx_next_kms_ctx(_context.get());
     if (kms_context == nullptr) {
         return Env().Null();
@@ -694,15 +718,80 @@ Value MongoCryptContext::NextKMSRequest(const CallbackInfo& info) {
 }
 
 void MongoCryptContext::FinishKMSRequests(const CallbackInfo& info) {
+    ThrowIfFinalizing();
     mongocrypt_ctx_kms_done(_context.get());
 }
 
 Value MongoCryptContext::FinalizeContext(const CallbackInfo& info) {
+    ThrowIfFinalizing();
+
     std::unique_ptr<mongocrypt_binary_t, MongoCryptBinaryDeleter> output(mongocrypt_binary_new());
     mongocrypt_ctx_finalize(_context.get(), output.get());
     return BufferFromBinary(Env(), output.get());
 }
 
+// Runs `mongocrypt_ctx_finalize` on the libuv thread pool, so that the
+// traversal and encryption or decryption of large documents does not block
+// the event loop.
+class MongoCryptContext::FinalizeWorker : public AsyncWorker {
+   public:
+    explicit FinalizeWorker(MongoCryptContext* context)
+        : AsyncWorker(context->Env(), "MongoCryptContextFinalize"),
+          _context(context),
+          _context_ref(Persistent(context->Value())),
+          _deferred(Promise::Deferred::New(context->Env())),
+          _output(mongocrypt_binary_new()) {}
+
+    Promise GetPromise() {
+        return _deferred.Promise();
+    }
+
+   protected:
+    void Execute() override {
+        if (!mongocrypt_ctx_finalize(_context->_context.get(), _output.get())) {
+            SetError(errorStringFromStatus(_context->_context.get()));
+        }
+    }
+
+    void OnOK() override {
+        _context->_finalizing = false;
+        _deferred.Resolve(BufferFromBinary(Env(), _output.get()));
+    }
+
+    void OnError(const Error& error) override {
+        _context->_finalizing = false;
+        _deferred.Reject(error.Value());
+    }
+
+   private:
+    MongoCryptContext* _context;
+    ObjectReference _context_ref;
+    Promise::Deferred _deferred;
+    std::unique_ptr<mongocrypt_binary_t, MongoCryptBinaryDeleter> _output;
+};
+
+Value MongoCryptContext::FinalizeContextAsync(const CallbackInfo& info) {
+    ThrowIfFinalizing();
+
+    if (_finalize_on_main_thread) {
+        // The crypto hooks and the logger are JavaScript functions, which
+        // cannot be called from the thread pool.
+        Promise::Deferred deferred = Promise::Deferred::New(Env());
+        std::unique_ptr<mongocrypt_binary_t, MongoCryptBinaryDeleter> output(mongocrypt_binary_new());
+        if (mongocrypt_ctx_finalize(_context.get(), output.get())) {
+            deferred.Resolve(BufferFromBinary(Env(), output.get()));
+        } else {
+            deferred.Reject(Error::New(Env(), errorStringFromStatus(_context.get())).Value());
+        }
+        return deferred.Promise();
+    }
+
+    FinalizeWorker* worker = new FinalizeWorker(this);
+    _finalizing = true;
+    worker->Queue();
+    return worker->GetPromise();
+}
+
 Function MongoCryptKMSRequest::Init(Napi::Env env) {
   return
       DefineClass(env,
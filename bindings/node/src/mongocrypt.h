@@ -50,6 +50,7 @@ class MongoCrypt : public Napi::ObjectWrap<MongoCrypt> {
 
    private:
     friend class Napi::ObjectWrap<MongoCrypt>;
+    friend class MongoCryptContext;
     Napi::Function GetCallback(const char* name);
     void SetCallback(const char* name, Napi::Value fn);
 
@@ -62,12 +63,17 @@ class MongoCrypt : public Napi::ObjectWrap<MongoCrypt> {
                            void* ctx);
 
     std::unique_ptr<mongocrypt_t, MongoCryptDeleter> _mongo_crypt;
+    // Whether libmongocrypt calls into JavaScript, through the crypto hooks
+    // or the log handler. This is only possible on the main thread.
+    bool _has_javascript_callbacks = false;
 };
 
 class MongoCryptContext : public Napi::ObjectWrap<MongoCryptContext> {
    public:
     static Napi::Function Init(Napi::Env env);
-    static Napi::Object NewInstance(Napi::Env env, std::unique_ptr<mongocrypt_ctx_t, MongoCryptContextDeleter> context);
+    static Napi::Object NewInstance(Napi::Env env,
+                                    MongoCrypt* mongo_crypt,
+                                    std::unique_ptr<mongocrypt_ctx_t, MongoCryptContextDeleter> context);
 
    private:
     Napi::Value NextMongoOperation(const Napi::CallbackInfo& info);
@@ -76,14 +82,19 @@ class MongoCryptContext : public Napi::ObjectWrap<MongoCryptContext> {
     Napi::Value NextKMSRequest(const Napi::CallbackInfo& info);
     void FinishKMSRequests(const Napi::CallbackInfo& info);
     Napi::Value FinalizeContext(const Napi::CallbackInfo& info);
+    Napi::Value FinalizeContextAsync(const Napi::CallbackInfo& info);
 
     Napi::Value Status(const Napi::CallbackInfo& info);
     Napi::Value State(const Napi::CallbackInfo& info);
 
    private:
    friend class Napi::ObjectWrap<MongoCryptContext>;
+    class FinalizeWorker;
     explicit MongoCryptContext(const Napi::CallbackInfo& info);
+    void ThrowIfFinalizing();
     std::unique_ptr<mongocrypt_ctx_t, MongoCryptContextDeleter> _context;
+    bool _finalize_on_main_thread = false;
+    bool _finalizing = false;
 };
 
 class MongoCryptKMSRequest : public Napi::ObjectWrap<MongoCryptKMSRequest> {
@@ -0,0 +1,79 @@
+'use strict';
+
+// Measures the cost per field of explicit encryption and decryption when
+// libmongocrypt calls the JavaScript crypto callbacks, and when it uses its
+// own native crypto. The native case only runs if libmongocrypt was built
+// with a crypto backend (`MongoCrypt.cryptoAvailable`).
+//
+// Usage: node test/benchmarks/cryptoHooks.js [iterations]
+
+const BSON = require('bson');
+const mc = require('bindings')('mongocrypt');
+const cryptoCallbacks = require('../../lib/cryptoCallbacks');
+
+const MONGOCRYPT_CTX_NEED_MONGO_KEYS = 3;
+const MONGOCRYPT_CTX_READY = 5;
+
+const ITERATIONS = Number(process.argv[2]) || 10000;
+const ALGORITHM = 'AEAD_AES_256_CBC_HMAC_SHA_512-Random';
+const kmsProviders = BSON.serialize({ local: { key: Buffer.alloc(96) } });
+
+function run(context, keyDocument) {
+  for (;;) {
+    switch (context.state) {
+      case MONGOCRYPT_CTX_NEED_MONGO_KEYS:
+        context.addMongoOperationResponse(keyDocument);
+        context.finishMongoOperation();
+        break;
+      case MONGOCRYPT_CTX_READY:
+        return context.finalize();
+      default:
+        throw new Error(`unexpected state ${context.state}: ${context.status.message}`);
+    }
+  }
+}
+
+function measure(name, useCallbacks) {
+  const options = { kmsProviders };
+  if (useCallbacks) {
+    options.cryptoCallbacks = cryptoCallbacks;
+  }
+  const mongoCrypt = new mc.MongoCrypt(options);
+
+  const keyDocument = run(mongoCrypt.makeDataKeyContext(BSON.serialize({ provider: 'local' }), {}));
+  const keyId = BSON.deserialize(keyDocument)._id.buffer;
+  const value = BSON.serialize({ v: 'a short string value' });
+
+  // warm up, and put the data key in the key cache.
+  let encrypted = run(
+    mongoCrypt.makeExplicitEncryptionContext(value, { keyId, algorithm: ALGORITHM }),
+    keyDocument
+  );
+
+  let start = process.hrtime.bigint();
+  for (let i = 0; i < ITERATIONS; i++) {
+    encrypted = run(
+      mongoCrypt.makeExplicitEncryptionContext(value, { keyId, algorithm: ALGORITHM }),
+      keyDocument
+    );
+  }
+  const encryptNs = Number(process.hrtime.bigint() - start) / ITERATIONS;
+
+  start = process.hrtime.bigint();
+  for (let i = 0; i < ITERATIONS; i++) {
+    run(mongoCrypt.makeExplicitDecryptionContext(encrypted), keyDocument);
+  }
+  const decryptNs = Number(process.hrtime.bigint() - start) / ITERATIONS;
+
+  console.log(
+    `${name}: encrypt ${(encryptNs / 1000).toFixed(2)} us/field, ` +
+      `decrypt ${(decryptNs / 1000).toFixed(2)} us/field`
+  );
+}
+
+measure('crypto callbacks', true);
+if (mc.MongoCrypt.cryptoAvailable) {
+  measure('native crypto', false);
+} else {
+  console.log('native crypto: unavailable, libmongocrypt was built without a crypto backend');
+}
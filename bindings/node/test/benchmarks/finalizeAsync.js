@@ -0,0 +1,108 @@
+'use strict';
+
+// Measures event loop lag while decrypting large documents, with the
+// synchronous `finalize` and with `finalizeAsync`, which runs on the libuv
+// thread pool. `finalizeAsync` only leaves the main thread if libmongocrypt
+// was built with a crypto backend (`MongoCrypt.cryptoAvailable`) and no
+// logger or crypto callbacks are set.
+//
+// Usage: node test/benchmarks/finalizeAsync.js [fields] [seconds]
+
+const BSON = require('bson');
+const { monitorEventLoopDelay } = require('perf_hooks');
+const mc = require('bindings')('mongocrypt');
+const cryptoCallbacks = require('../../lib/cryptoCallbacks');
+
+const MONGOCRYPT_CTX_NEED_MONGO_KEYS = 3;
+const MONGOCRYPT_CTX_READY = 5;
+
+const FIELDS = Number(process.argv[2]) || 1000;
+const SECONDS = Number(process.argv[3]) || 5;
+const CONCURRENCY = 4;
+const ALGORITHM = 'AEAD_AES_256_CBC_HMAC_SHA_512-Random';
+const kmsProviders = BSON.serialize({ local: { key: Buffer.alloc(96) } });
+
+// Drives `context` to MONGOCRYPT_CTX_READY.
+function prepare(context, keyDocument) {
+  for (;;) {
+    switch (context.state) {
+      case MONGOCRYPT_CTX_NEED_MONGO_KEYS:
+        context.addMongoOperationResponse(keyDocument);
+        context.finishMongoOperation();
+        break;
+      case MONGOCRYPT_CTX_READY:
+        return context;
+      default:
+        throw new Error(`unexpected state ${context.state}: ${context.status.message}`);
+    }
+  }
+}
+
+function makeMongoCrypt() {
+  const options = { kmsProviders };
+  if (!mc.MongoCrypt.cryptoAvailable) {
+    options.cryptoCallbacks = cryptoCallbacks;
+  }
+  return new mc.MongoCrypt(options);
+}
+
+function makeDocument(mongoCrypt) {
+  const dataKeyContext = mongoCrypt.makeDataKeyContext(BSON.serialize({ provider: 'local' }), {});
+  const keyDocument = prepare(dataKeyContext).finalize();
+  const keyId = BSON.deserialize(keyDocument)._id.buffer;
+
+  const value = BSON.serialize({ v: 'x'.repeat(64) });
+  const document = {};
+  for (let i = 0; i < FIELDS; i++) {
+    const context = mongoCrypt.makeExplicitEncryptionContext(value, {
+      keyId,
+      algorithm: ALGORITHM
+    });
+    document[`field${i}`] = BSON.deserialize(prepare(context, keyDocument).finalize()).v;
+  }
+  return { keyDocument, command: BSON.serialize(document) };
+}
+
+async function measure(name, finalize) {
+  const mongoCrypt = makeMongoCrypt();
+  const { keyDocument, command } = makeDocument(mongoCrypt);
+
+  const histogram = monitorEventLoopDelay({ resolution: 1 });
+  const deadline = Date.now() + SECONDS * 1000;
+  let documents = 0;
+
+  async function worker() {
+    while (Date.now() < deadline) {
+      await finalize(prepare(mongoCrypt.makeDecryptionContext(command), keyDocument));
+      documents++;
+      // let timers run between documents, as a server handling requests would
+      await new Promise(resolve => setImmediate(resolve));
+    }
+  }
+
+  histogram.enable();
+  await Promise.all(Array.from({ length: CONCURRENCY }, worker));
+  histogram.disable();
+
+  const ms = ns => (ns / 1e6).toFixed(2);
+  console.log(
+    `${name}: ${(documents / SECONDS).toFixed(1)} documents/s, event loop delay ` +
+      `mean ${ms(histogram.mean)} ms, p99 ${ms(histogram.percentile(99))} ms, ` +
+      `max ${ms(histogram.max)} ms`
+  );
+}
+
+async function main() {
+  console.log(`decrypting documents of ${FIELDS} fields, ${CONCURRENCY} at a time`);
+  if (!mc.MongoCrypt.cryptoAvailable) {
+    console.log('no native crypto, so finalizeAsync runs on the main thread');
+  }
+
+  await measure('finalize', context => context.finalize());
+  await measure('finalizeAsync', context => context.finalizeAsync());
+}
+
+main().catch(err => {
+  console.error(err);
+  process.exitCode = 1;
+});
@@ -8,6 +8,7 @@ const mongodb = require('mongodb');
 const MongoClient = mongodb.MongoClient;
 const stateMachine = require('../lib/stateMachine')({ mongodb });
 const cryptoCallbacks = require('../lib/cryptoCallbacks');
+const mc = require('bindings')('mongocrypt');
 const ClientEncryption = require('../lib/clientEncryption')({
   mongodb,
   stateMachine
@@ -34,6 +35,11 @@ describe('cryptoCallbacks', function () {
       this.test.skip();
       return;
     }
+    if (mc.MongoCrypt.cryptoAvailable) {
+      this.currentTest.skipReason = 'libmongocrypt uses native crypto, not the crypto callbacks';
+      this.test.skip();
+      return;
+    }
     this.sinon.restore();
     this.client = new MongoClient('mongodb://localhost:27017/', {
       useUnifiedTopology: true,
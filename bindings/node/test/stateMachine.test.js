@@ -8,6 +8,7 @@ const fs = require('fs');
 const expect = require('chai').expect;
 const sinon = require('sinon');
 const mongodb = require('mongodb');
+const mc = require('bindings')('mongocrypt');
 const StateMachine = require('../lib/stateMachine')({ mongodb }).StateMachine;
 
 describe('StateMachine', function () {
@@ -36,6 +37,87 @@ describe('StateMachine', function () {
     }
   }
 
+  describe('MONGOCRYPT_CTX_READY', function () {
+    const kmsProviders = BSON.serialize({ local: { key: Buffer.alloc(96) } });
+
+    it('should finalize the context asynchronously', function (done) {
+      const mongoCrypt = new mc.MongoCrypt({ kmsProviders });
+      const context = mongoCrypt.makeDataKeyContext(BSON.serialize({ provider: 'local' }), {});
+      const stateMachine = new StateMachine({ bson: BSON });
+
+      stateMachine.execute({}, context, (err, keyDocument) => {
+        expect(err).to.not.exist;
+        expect(keyDocument).to.have.property('_id');
+        expect(keyDocument).to.have.property('keyMaterial');
+        done();
+      });
+    });
+
+    it('throws while the context is finalized asynchronously', async function () {
+      if (!mc.MongoCrypt.cryptoAvailable) {
+        // without native crypto, finalizeAsync settles on the main thread
+        this.skip();
+      }
+
+      const mongoCrypt = new mc.MongoCrypt({ kmsProviders });
+      const context = mongoCrypt.makeDataKeyContext(BSON.serialize({ provider: 'local' }), {});
+      expect(context.state).to.equal(5); // MONGOCRYPT_CTX_READY
+
+      const promise = context.finalizeAsync();
+      expect(() => context.state).to.throw(/being finalized/);
+      expect(() => context.status).to.throw(/being finalized/);
+      expect(() => context.nextMongoOperation()).to.throw(/being finalized/);
+      expect(() => context.finalize()).to.throw(/being finalized/);
+      expect(() => context.finalizeAsync()).to.throw(/being finalized/);
+
+      const keyDocument = BSON.deserialize(await promise);
+      expect(keyDocument).to.have.property('keyMaterial');
+      expect(context.state).to.equal(6); // MONGOCRYPT_CTX_DONE
+    });
+
+    it('finalizeAsync rejects if the context is not ready', async function () {
+      const mongoCrypt = new mc.MongoCrypt({ kmsProviders });
+      const context = mongoCrypt.makeExplicitEncryptionContext(BSON.serialize({ v: 'value' }), {
+        keyId: Buffer.alloc(16),
+        algorithm: 'AEAD_AES_256_CBC_HMAC_SHA_512-Random'
+      });
+
+      try {
+        await context.finalizeAsync();
+      } catch (err) {
+        expect(err.message).to.match(/wrong state/);
+        return;
+      }
+      expect.fail('missed exception');
+    });
+
+    it('calls back once, outside of the finalize promise chain', async function () {
+      const stateMachine = new StateMachine({ bson: BSON });
+      const context = {
+        state: 5, // MONGOCRYPT_CTX_READY
+        finalizeAsync: () => Promise.resolve(BSON.serialize({ v: 'value' }))
+      };
+      const callback = sinon.stub().throws(new Error('thrown by callback'));
+      const nextTick = sinon.stub(process, 'nextTick');
+
+      try {
+        stateMachine.execute({}, context, callback);
+        await new Promise(resolve => setImmediate(resolve));
+      } finally {
+        nextTick.restore();
+      }
+
+      // an exception from the callback is thrown from the deferred call, not
+      // caught by the promise, so the callback cannot be called again
+      expect(callback.callCount).to.equal(0);
+      expect(nextTick.callCount).to.equal(1);
+      expect(() => nextTick.firstCall.args[0]()).to.throw(/thrown by callback/);
+      expect(callback.callCount).to.equal(1);
+      expect(callback.firstCall.args[0]).to.equal(null);
+      expect(callback.firstCall.args[1]).to.deep.equal({ v: 'value' });
+    });
+  });
+
   describe('kmsRequest', function () {
     class MockSocket extends EventEmitter {
       constructor(callback) {
@@ -1066,6 +1066,20 @@ typedef bool (*mongocrypt_random_fn) (void *ctx,
                                       uint32_t count,
                                       mongocrypt_status_t *status);
 
+/**
+ * Indicates whether libmongocrypt was built with a native crypto backend.
+ *
+ * If true, crypto hooks do not need to be set with @ref
+ * mongocrypt_setopt_crypto_hooks and @ref
+ * mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5. Bindings can skip
+ * registering their hooks to avoid a call into the host language for each
+ * encrypted or decrypted field. If hooks are set, they are used.
+ *
+ * @returns True if libmongocrypt can encrypt and decrypt without hooks.
+ */
+bool
+mongocrypt_is_crypto_available (void);
+
 bool
 mongocrypt_setopt_crypto_hooks (mongocrypt_t *crypt,
                                 mongocrypt_crypto_fn aes_256_cbc_encrypt,
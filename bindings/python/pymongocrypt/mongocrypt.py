@@ -137,6 +137,15 @@ class MongoCryptOptions(object):
         self.schema_map = schema_map
 
 
+def _native_crypto_available():
+    """Return True if libmongocrypt was built with native crypto."""
+    try:
+        return bool(lib.mongocrypt_is_crypto_available())
+    except AttributeError:
+        # libmongocrypt is older than mongocrypt_is_crypto_available.
+        return False
+
+
 class MongoCrypt(object):
     def __init__(self, options, callback):
         """Abstracts libmongocrypt's mongocrypt_t type.
@@ -193,14 +202,18 @@ class MongoCrypt(object):
                         self.__crypt, binary_schema_map.bin):
                     self.__raise_from_status()
 
-        if not lib.mongocrypt_setopt_crypto_hooks(
-                self.__crypt, aes_256_cbc_encrypt, aes_256_cbc_decrypt,
-                secure_random, hmac_sha_512, hmac_sha_256, sha_256, ffi.NULL):
-            self.__raise_from_status()
+        # Python crypto callbacks are only needed when libmongocrypt lacks
+        # native crypto. Calling them costs several FFI crossings per field.
+        if not _native_crypto_available():
+            if not lib.mongocrypt_setopt_crypto_hooks(
+                    self.__crypt, aes_256_cbc_encrypt, aes_256_cbc_decrypt,
+                    secure_random, hmac_sha_512, hmac_sha_256, sha_256,
+                    ffi.NULL):
+                self.__raise_from_status()
 
-        if not lib.mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5(
-                self.__crypt, sign_rsaes_pkcs1_v1_5, ffi.NULL):
-            self.__raise_from_status()
+            if not lib.mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5(
+                    self.__crypt, sign_rsaes_pkcs1_v1_5, ffi.NULL):
+                self.__raise_from_status()
 
         if not lib.mongocrypt_init(self.__crypt):
             self.__raise_from_status()
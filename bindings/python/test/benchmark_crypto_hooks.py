@@ -0,0 +1,113 @@
+# Copyright 2019-present MongoDB, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Benchmark explicit encryption with Python crypto callbacks and with
+libmongocrypt's native crypto.
+
+Usage: python test/benchmark_crypto_hooks.py [iterations]
+"""
+
+import sys
+import timeit
+
+import bson
+from bson.binary import UuidRepresentation
+from bson.codec_options import CodecOptions
+
+sys.path[0:0] = [""]
+
+import pymongocrypt.mongocrypt
+from pymongocrypt.explicit_encrypter import ExplicitEncrypter
+from pymongocrypt.mongocrypt import MongoCryptOptions
+from pymongocrypt.state_machine import MongoCryptCallback
+
+OPTS = CodecOptions(uuid_representation=UuidRepresentation.UNSPECIFIED)
+ALGORITHM = "AEAD_AES_256_CBC_HMAC_SHA_512-Random"
+
+
+class KeyVaultCallback(MongoCryptCallback):
+    """A key vault holding one data key in memory."""
+
+    def __init__(self):
+        self.data_key = None
+
+    def kms_request(self, kms_context):
+        raise NotImplementedError
+
+    def collection_info(self, database, filter):
+        raise NotImplementedError
+
+    def mark_command(self, database, cmd):
+        raise NotImplementedError
+
+    def fetch_keys(self, filter):
+        yield self.data_key
+
+    def insert_data_key(self, data_key):
+        self.data_key = data_key
+        return bson.decode(data_key, OPTS)['_id']
+
+    def bson_encode(self, doc):
+        return bson.encode(doc)
+
+    def close(self):
+        pass
+
+
+def measure(name, use_callbacks, iterations):
+    native_crypto_available = pymongocrypt.mongocrypt._native_crypto_available
+    if use_callbacks:
+        pymongocrypt.mongocrypt._native_crypto_available = lambda: False
+    try:
+        encrypter = ExplicitEncrypter(
+            KeyVaultCallback(),
+            MongoCryptOptions({'local': {'key': b'\x00' * 96}}))
+    finally:
+        pymongocrypt.mongocrypt._native_crypto_available = (
+            native_crypto_available)
+
+    try:
+        key_id = encrypter.create_data_key('local')
+        value = bson.encode({'v': 'a short string value'})
+        # Warm up, and put the data key in the key cache.
+        encrypted = encrypter.encrypt(value, ALGORITHM, key_id=key_id)
+
+        start = timeit.default_timer()
+        for _ in range(iterations):
+            encrypter.encrypt(value, ALGORITHM, key_id=key_id)
+        encrypt_us = (timeit.default_timer() - start) * 1e6 / iterations
+
+        start = timeit.default_timer()
+        for _ in range(iterations):
+            encrypter.decrypt(encrypted)
+        decrypt_us = (timeit.default_timer() - start) * 1e6 / iterations
+    finally:
+        encrypter.close()
+
+    print("%s: encrypt %.2f us/field, decrypt %.2f us/field" % (
+        name, encrypt_us, decrypt_us))
+
+
+def main():
+    iterations = int(sys.argv[1]) if len(sys.argv) > 1 else 10000
+    measure("crypto callbacks", True, iterations)
+    if pymongocrypt.mongocrypt._native_crypto_available():
+        measure("native crypto", False, iterations)
+    else:
+        print("native crypto: unavailable, libmongocrypt was built without "
+              "a crypto backend")
+
+
+if __name__ == "__main__":
+    main()
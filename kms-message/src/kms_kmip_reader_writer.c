@@ -409,6 +409,17 @@ kmip_reader_find (kmip_reader_t *reader,
                   kmip_item_type_t type,
                   size_t *pos,
                   size_t *length)
+{
+   return kmip_reader_find_nth (reader, search_tag, type, 0, pos, length);
+}
+
+bool
+kmip_reader_find_nth (kmip_reader_t *reader,
+                      kmip_tag_type_t search_tag,
+                      kmip_item_type_t type,
+                      size_t n,
+                      size_t *pos,
+                      size_t *length)
 {
    reader->pos = 0;
 
@@ -424,9 +435,12 @@ kmip_reader_find (kmip_reader_t *reader,
 
 
       if (read_tag == search_tag && read_type == type) {
-         *pos = reader->pos;
-         *length = read_length;
-         return true;
+         if (n == 0) {
+            *pos = reader->pos;
+            *length = read_length;
+            return true;
+         }
+         n--;
       }
 
       size_t advance_length = read_length;
@@ -443,11 +457,18 @@ kmip_reader_find (kmip_reader_t *reader,
 
 bool
 kmip_reader_find_and_recurse (kmip_reader_t *reader, size_t tag)
+{
+   return kmip_reader_find_nth_and_recurse (reader, tag, 0);
+}
+
+bool
+kmip_reader_find_nth_and_recurse (kmip_reader_t *reader, size_t tag, size_t n)
 {
    size_t pos;
    size_t length;
 
-   if (!kmip_reader_find (reader, tag, KMIP_ITEM_TYPE_Structure, &pos, &length)) {
+   if (!kmip_reader_find_nth (
+          reader, tag, KMIP_ITEM_TYPE_Structure, n, &pos, &length)) {
       return false;
    }
 
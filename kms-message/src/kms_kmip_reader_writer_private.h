@@ -133,9 +133,22 @@ kmip_reader_find (kmip_reader_t *reader,
                   size_t *pos,
                   size_t *length);
 
+/* Like kmip_reader_find, but skip the first @n matching items. */
+bool
+kmip_reader_find_nth (kmip_reader_t *reader,
+                      kmip_tag_type_t search_tag,
+                      kmip_item_type_t type,
+                      size_t n,
+                      size_t *pos,
+                      size_t *length);
+
 bool
 kmip_reader_find_and_recurse (kmip_reader_t *reader, size_t tag);
 
+/* Like kmip_reader_find_and_recurse, but skip the first @n matching items. */
+bool
+kmip_reader_find_nth_and_recurse (kmip_reader_t *reader, size_t tag, size_t n);
+
 bool
 kmip_reader_find_and_read_enum (kmip_reader_t *reader,
                                 size_t tag,
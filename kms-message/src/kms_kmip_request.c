@@ -180,6 +180,14 @@ kms_kmip_request_activate_new (void *reserved, const char *unique_identifer)
 
 kms_request_t *
 kms_kmip_request_get_new (void *reserved, const char *unique_identifer)
+{
+   return kms_kmip_request_get_batch_new (reserved, &unique_identifer, 1);
+}
+
+kms_request_t *
+kms_kmip_request_get_batch_new (void *reserved,
+                                const char *const *unique_identifiers,
+                                size_t count)
 {
    /*
    Create a KMIP Get request of this form:
@@ -198,14 +206,28 @@ kms_kmip_request_get_new (void *reserved, const char *unique_identifer)
      </RequestPayload>
     </BatchItem>
    </RequestMessage>
+
+   With more than one identifier, there is one BatchItem for each, and each
+   BatchItem begins with its index as a 4 byte big endian UniqueBatchItemID:
+    <BatchItem tag="0x42000f" type="Structure">
+     <Operation tag="0x42005c" type="Enumeration" value="10"/>
+     <UniqueBatchItemID tag="0x420093" type="ByteString" value="00000001"/>
+     <RequestPayload tag="0x420079" type="Structure">
+      ...
    */
 
    kmip_writer_t *writer;
    kms_request_t *req;
+   size_t i;
 
    req = calloc (1, sizeof (kms_request_t));
    req->provider = KMS_REQUEST_PROVIDER_KMIP;
 
+   if (count == 0 || count > INT32_MAX) {
+      KMS_ERROR (req, "expected between 1 and %d identifiers", INT32_MAX);
+      return req;
+   }
+
    writer = kmip_writer_new ();
    kmip_writer_begin_struct (writer, KMIP_TAG_RequestMessage);
 
@@ -214,20 +236,31 @@ kms_kmip_request_get_new (void *reserved, const char *unique_identifer)
    kmip_writer_write_integer (writer, KMIP_TAG_ProtocolVersionMajor, 1);
    kmip_writer_write_integer (writer, KMIP_TAG_ProtocolVersionMinor, 0);
    kmip_writer_close_struct (writer); /* KMIP_TAG_ProtocolVersion */
-   kmip_writer_write_integer (writer, KMIP_TAG_BatchCount, 1);
+   kmip_writer_write_integer (writer, KMIP_TAG_BatchCount, (int32_t) count);
    kmip_writer_close_struct (writer); /* KMIP_TAG_RequestHeader */
 
-   kmip_writer_begin_struct (writer, KMIP_TAG_BatchItem);
-   /* 0x0A == Get */
-   kmip_writer_write_enumeration (writer, KMIP_TAG_Operation, 0x0A);
-   kmip_writer_begin_struct (writer, KMIP_TAG_RequestPayload);
-   kmip_writer_write_string (writer,
-                             KMIP_TAG_UniqueIdentifier,
-                             unique_identifer,
-                             strlen (unique_identifer));
-   /* 0x01 = Raw */
-   kmip_writer_close_struct (writer); /* KMIP_TAG_RequestPayload */
-   kmip_writer_close_struct (writer); /* KMIP_TAG_BatchItem */
+   for (i = 0; i < count; i++) {
+      kmip_writer_begin_struct (writer, KMIP_TAG_BatchItem);
+      /* 0x0A == Get */
+      kmip_writer_write_enumeration (writer, KMIP_TAG_Operation, 0x0A);
+      if (count > 1) {
+         char id[4];
+
+         id[0] = (char) ((i >> 24) & 0xFF);
+         id[1] = (char) ((i >> 16) & 0xFF);
+         id[2] = (char) ((i >> 8) & 0xFF);
+         id[3] = (char) (i & 0xFF);
+         kmip_writer_write_bytes (
+            writer, KMIP_TAG_UniqueBatchItemID, id, sizeof id);
+      }
+      kmip_writer_begin_struct (writer, KMIP_TAG_RequestPayload);
+      kmip_writer_write_string (writer,
+                                KMIP_TAG_UniqueIdentifier,
+                                unique_identifiers[i],
+                                strlen (unique_identifiers[i]));
+      kmip_writer_close_struct (writer); /* KMIP_TAG_RequestPayload */
+      kmip_writer_close_struct (writer); /* KMIP_TAG_BatchItem */
+   }
    kmip_writer_close_struct (writer); /* KMIP_TAG_RequestMessage */
 
    /* Copy the KMIP writer buffer to a KMIP request. */
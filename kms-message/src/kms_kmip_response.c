@@ -18,6 +18,56 @@ check_and_require_kmip (kms_response_t *res)
    return true;
 }
 
+/* Return a reader positioned in the BatchItem answering batch item @index of
+ * the request. A BatchItem with a UniqueBatchItemID matches if the ID is
+ * @index, as written by kms_kmip_request_get_batch_new. A BatchItem without
+ * one matches by position. Returns NULL and sets an error if none matches. */
+static kmip_reader_t *
+recurse_batch_item (kms_response_t *res, size_t index)
+{
+   kmip_reader_t *reader;
+   size_t n;
+
+   for (n = 0;; n++) {
+      uint8_t *id;
+      size_t id_len;
+      bool matches;
+
+      reader = kmip_reader_new (res->kmip.data, res->kmip.len);
+      if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_ResponseMessage)) {
+         KMS_ERROR (res,
+                    "unable to find tag: %s",
+                    kmip_tag_to_string (KMIP_TAG_ResponseMessage));
+         break;
+      }
+
+      if (!kmip_reader_find_nth_and_recurse (reader, KMIP_TAG_BatchItem, n)) {
+         KMS_ERROR (res,
+                    "unable to find tag: %s",
+                    kmip_tag_to_string (KMIP_TAG_BatchItem));
+         break;
+      }
+
+      if (kmip_reader_find_and_read_bytes (
+             reader, KMIP_TAG_UniqueBatchItemID, &id, &id_len)) {
+         matches = id_len == 4 && (size_t) (((uint32_t) id[0] << 24) |
+                                            ((uint32_t) id[1] << 16) |
+                                            ((uint32_t) id[2] << 8) |
+                                            (uint32_t) id[3]) == index;
+      } else {
+         matches = n == index;
+      }
+
+      if (matches) {
+         return reader;
+      }
+      kmip_reader_destroy (reader);
+   }
+
+   kmip_reader_destroy (reader);
+   return NULL;
+}
+
 /*
 Example of an error message:
 <ResponseMessage tag="0x42007b" type="Structure">
@@ -39,7 +89,7 @@ value="ResultReasonItemNotFound"/>
 </ResponseMessage>
 */
 static bool
-kms_kmip_response_ok (kms_response_t *res)
+kms_kmip_response_ok (kms_response_t *res, size_t index)
 {
    kmip_reader_t *reader = NULL;
    size_t pos;
@@ -50,19 +100,8 @@ kms_kmip_response_ok (kms_response_t *res)
    uint32_t result_message_len = 0;
    bool ok = false;
 
-   reader = kmip_reader_new (res->kmip.data, res->kmip.len);
-
-   if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_ResponseMessage)) {
-      KMS_ERROR (res,
-                 "unable to find tag: %s",
-                 kmip_tag_to_string (KMIP_TAG_ResponseMessage));
-      goto fail;
-   }
-
-   if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_BatchItem)) {
-      KMS_ERROR (res,
-                 "unable to find tag: %s",
-                 kmip_tag_to_string (KMIP_TAG_BatchItem));
+   reader = recurse_batch_item (res, index);
+   if (!reader) {
       goto fail;
    }
 
@@ -161,21 +200,12 @@ kms_kmip_response_get_unique_identifier (kms_response_t *res)
       goto fail;
    }
 
-   if (!kms_kmip_response_ok (res)) {
+   if (!kms_kmip_response_ok (res, 0)) {
       goto fail;
    }
 
-   reader = kmip_reader_new (res->kmip.data, res->kmip.len);
-   if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_ResponseMessage)) {
-      KMS_ERROR (res,
-                 "unable to find tag: %s",
-                 kmip_tag_to_string (KMIP_TAG_ResponseMessage));
-      goto fail;
-   }
-   if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_BatchItem)) {
-      KMS_ERROR (res,
-                 "unable to find tag: %s",
-                 kmip_tag_to_string (KMIP_TAG_BatchItem));
+   reader = recurse_batch_item (res, 0);
+   if (!reader) {
       goto fail;
    }
    if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_ResponsePayload)) {
@@ -239,6 +269,14 @@ Example of a successful response to a Get request:
 */
 uint8_t *
 kms_kmip_response_get_secretdata (kms_response_t *res, size_t *secretdatalen)
+{
+   return kms_kmip_response_get_secretdata_at (res, 0, secretdatalen);
+}
+
+uint8_t *
+kms_kmip_response_get_secretdata_at (kms_response_t *res,
+                                     size_t index,
+                                     size_t *secretdatalen)
 {
    kmip_reader_t *reader = NULL;
    size_t pos;
@@ -250,23 +288,12 @@ kms_kmip_response_get_secretdata (kms_response_t *res, size_t *secretdatalen)
       goto fail;
    }
 
-   if (!kms_kmip_response_ok (res)) {
+   if (!kms_kmip_response_ok (res, index)) {
       goto fail;
    }
 
-   reader = kmip_reader_new (res->kmip.data, res->kmip.len);
-
-   if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_ResponseMessage)) {
-      KMS_ERROR (res,
-                 "unable to find tag: %s",
-                 kmip_tag_to_string (KMIP_TAG_ResponseMessage));
-      goto fail;
-   }
-
-   if (!kmip_reader_find_and_recurse (reader, KMIP_TAG_BatchItem)) {
-      KMS_ERROR (res,
-                 "unable to find tag: %s",
-                 kmip_tag_to_string (KMIP_TAG_BatchItem));
+   reader = recurse_batch_item (res, index);
+   if (!reader) {
       goto fail;
    }
 
@@ -51,6 +51,16 @@ kms_kmip_request_activate_new (void *reserved, const char *unique_identifier);
 KMS_MSG_EXPORT (kms_request_t *)
 kms_kmip_request_get_new (void *reserved, const char *unique_identifier);
 
+/* kms_kmip_request_get_batch_new creates one KMIP RequestMessage with a Get
+ * BatchItem for each of the provided unique identifiers.
+ * - unique_identifiers must be count NULL terminated strings.
+ * - Use kms_kmip_response_get_secretdata_at to read the result of each.
+ * - Callers must check for an error by calling kms_request_get_error. */
+KMS_MSG_EXPORT (kms_request_t *)
+kms_kmip_request_get_batch_new (void *reserved,
+                                const char *const *unique_identifiers,
+                                size_t count);
+
 #ifdef __cplusplus
 }
 #endif
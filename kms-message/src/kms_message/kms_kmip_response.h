@@ -37,4 +37,14 @@ kms_kmip_response_get_unique_identifier (kms_response_t *res);
 KMS_MSG_EXPORT (uint8_t *)
 kms_kmip_response_get_secretdata (kms_response_t *res, size_t *secretdatalen);
 
+/* kms_kmip_response_get_secretdata_at returns the KeyMaterial in the
+ * BatchItem answering batch item @index of a request created with
+ * kms_kmip_request_get_batch_new.
+ * - Caller must free returned data.
+ * - Returns NULL on error and sets an error on kms_response_t. */
+KMS_MSG_EXPORT (uint8_t *)
+kms_kmip_response_get_secretdata_at (kms_response_t *res,
+                                     size_t index,
+                                     size_t *secretdatalen);
+
 #endif /* KMS_KMIP_RESPONSE_H */
@@ -79,6 +79,11 @@ KMS_MSG_EXPORT (char *)
 kms_request_get_string_to_sign (kms_request_t *request);
 KMS_MSG_EXPORT (bool)
 kms_request_get_signing_key (kms_request_t *request, unsigned char *key);
+/* Use the 32 byte @key, previously derived with kms_request_get_signing_key
+ * from the same secret key, date, region and service, to sign @request. It is
+ * discarded if any of those are set afterward. */
+KMS_MSG_EXPORT (bool)
+kms_request_set_signing_key (kms_request_t *request, const unsigned char *key);
 KMS_MSG_EXPORT (char *)
 kms_request_get_signature (kms_request_t *request);
 KMS_MSG_EXPORT (char *)
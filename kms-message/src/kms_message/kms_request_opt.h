@@ -48,6 +48,11 @@ kms_request_opt_destroy (kms_request_opt_t *request);
 KMS_MSG_EXPORT (void)
 kms_request_opt_set_connection_close (kms_request_opt_t *opt,
                                       bool connection_close);
+/* Add a "Connection: keep-alive" header, so the connection can be reused for
+ * further requests to the same host. Ignored if connection_close is set. */
+KMS_MSG_EXPORT (void)
+kms_request_opt_set_connection_keep_alive (kms_request_opt_t *opt,
+                                           bool connection_keep_alive);
 
 KMS_MSG_EXPORT (void)
 kms_request_opt_set_crypto_hooks (kms_request_opt_t *opt,
@@ -35,6 +35,10 @@ kms_response_get_body (kms_response_t *response, size_t *len);
 KMS_MSG_EXPORT (void) kms_response_destroy (kms_response_t *response);
 KMS_MSG_EXPORT (const char *)
 kms_response_get_error (const kms_response_t *response);
+/* Returns the value of the first header named @name, compared without regard
+ * to case, or NULL if there is none. */
+KMS_MSG_EXPORT (const char *)
+kms_response_get_header (const kms_response_t *response, const char *name);
 
 #ifdef __cplusplus
 } /* extern "C" */
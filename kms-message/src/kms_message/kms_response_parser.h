@@ -33,6 +33,14 @@ typedef struct _kms_response_parser_t kms_response_parser_t;
 KMS_MSG_EXPORT (kms_response_parser_t *)
 kms_response_parser_new (void);
 
+/* By default, bytes fed past the end of a response are an error. If
+ * multiple_responses is set, they are kept, and parsed as the start of the next
+ * response after kms_response_parser_get_response. This permits parsing the
+ * responses of several requests sent on one keep-alive connection. */
+KMS_MSG_EXPORT (void)
+kms_response_parser_set_multiple_responses (kms_response_parser_t *parser,
+                                            bool multiple_responses);
+
 KMS_MSG_EXPORT (int)
 kms_response_parser_wants_bytes (kms_response_parser_t *parser, int32_t max);
 
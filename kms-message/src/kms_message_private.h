@@ -36,6 +36,9 @@ struct _kms_request_t {
    kms_request_str_t *secret_key;
    kms_request_str_t *datetime;
    kms_request_str_t *date;
+   /* set by kms_request_set_signing_key, reset when an input changes */
+   unsigned char signing_key[32];
+   bool has_signing_key;
    /* End: AWS specific */
    kms_request_str_t *method;
    kms_request_str_t *path;
@@ -95,6 +98,10 @@ struct _kms_response_parser_t {
    kms_request_str_t *raw_response;
    int content_length;
    int start; /* start of the current thing getting parsed. */
+   int end;   /* end of the response once parsed, or -1. */
+   /* If set, bytes past the end of a response are kept as the start of the
+    * next response on the same connection. */
+   bool multiple_responses;
 
    /* Support two types of HTTP 1.1 responses.
     * - "Content-Length: x" header is present, indicating the body length.
@@ -122,6 +122,11 @@ kms_request_new (const char *method,
       if (!kms_request_add_header_field (request, "Connection", "close")) {
          return request;
       }
+   } else if (opt && opt->connection_keep_alive) {
+      if (!kms_request_add_header_field (
+             request, "Connection", "keep-alive")) {
+         return request;
+      }
    }
 
    if (opt && opt->crypto.sha256) {
@@ -194,6 +199,7 @@ kms_request_set_date (kms_request_t *request, const struct tm *tm)
    }
 
    kms_request_str_set_chars (request->date, buf, sizeof "YYYYmmDD" - 1);
+   request->has_signing_key = false;
    kms_request_str_set_chars (request->datetime, buf, sizeof AMZ_DT_FORMAT - 1);
    kms_kv_list_del (request->header_fields, "X-Amz-Date");
    if (!kms_request_add_header_field (request, "X-Amz-Date", buf)) {
@@ -212,6 +218,7 @@ kms_request_set_region (kms_request_t *request, const char *region)
       return false;
    }
    kms_request_str_set_chars (request->region, region, -1);
+   request->has_signing_key = false;
    return true;
 }
 
@@ -222,6 +229,7 @@ kms_request_set_service (kms_request_t *request, const char *service)
       return false;
    }
    kms_request_str_set_chars (request->service, service, -1);
+   request->has_signing_key = false;
    return true;
 }
 
@@ -242,6 +250,7 @@ kms_request_set_secret_key (kms_request_t *request, const char *key)
       return false;
    }
    kms_request_str_set_chars (request->secret_key, key, -1);
+   request->has_signing_key = false;
    return true;
 }
 
@@ -650,6 +659,11 @@ kms_request_get_signing_key (kms_request_t *request, unsigned char *key)
       return false;
    }
 
+   if (request->has_signing_key) {
+      memcpy (key, request->signing_key, sizeof request->signing_key);
+      return true;
+   }
+
    /* docs.aws.amazon.com/general/latest/gr/sigv4-calculate-signature.html
     * Pseudocode for deriving a signing key
     *
@@ -683,6 +697,22 @@ done:
    return success;
 }
 
+bool
+kms_request_set_signing_key (kms_request_t *request, const unsigned char *key)
+{
+   if (request->failed) {
+      return false;
+   }
+
+   if (!check_and_prohibit_kmip (request)) {
+      return false;
+   }
+
+   memcpy (request->signing_key, key, sizeof request->signing_key);
+   request->has_signing_key = true;
+   return true;
+}
+
 char *
 kms_request_get_signature (kms_request_t *request)
 {
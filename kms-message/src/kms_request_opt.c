@@ -38,6 +38,13 @@ kms_request_opt_set_connection_close (kms_request_opt_t *opt,
    opt->connection_close = connection_close;
 }
 
+void
+kms_request_opt_set_connection_keep_alive (kms_request_opt_t *opt,
+                                           bool connection_keep_alive)
+{
+   opt->connection_keep_alive = connection_keep_alive;
+}
+
 
 void
 kms_request_opt_set_crypto_hooks (kms_request_opt_t *opt,
@@ -25,6 +25,7 @@
 
 struct _kms_request_opt_t {
    bool connection_close;
+   bool connection_keep_alive;
    _kms_crypto_t crypto;
    kms_request_provider_t provider;
 };
@@ -52,3 +52,16 @@ kms_response_get_error (const kms_response_t *response)
 {
    return response->failed ? response->error : NULL;
 }
+
+const char *
+kms_response_get_header (const kms_response_t *response, const char *name)
+{
+   const kms_kv_t *kv;
+
+   /* KMIP responses have no headers. */
+   if (!response->headers) {
+      return NULL;
+   }
+   kv = kms_kv_list_find (response->headers, name);
+   return kv ? kv->value->str : NULL;
+}
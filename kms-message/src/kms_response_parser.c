@@ -32,6 +32,7 @@ _parser_init (kms_response_parser_t *parser)
    parser->response->headers = kms_kv_list_new ();
    parser->state = PARSING_STATUS_LINE;
    parser->start = 0;
+   parser->end = -1;
    parser->failed = false;
    parser->chunk_size = 0;
    parser->transfer_encoding_chunked = false;
@@ -45,9 +46,17 @@ kms_response_parser_new (void)
    KMS_ASSERT (parser);
 
    _parser_init (parser);
+   parser->multiple_responses = false;
    return parser;
 }
 
+void
+kms_response_parser_set_multiple_responses (kms_response_parser_t *parser,
+                                            bool multiple_responses)
+{
+   parser->multiple_responses = multiple_responses;
+}
+
 int
 kms_response_parser_wants_bytes (kms_response_parser_t *parser, int32_t max)
 {
@@ -272,7 +281,7 @@ kms_response_parser_feed (kms_response_parser_t *parser,
    curr = (int) raw->len;
    kms_request_str_append_chars (raw, (char *) buf, len);
    /* process the new data appended. */
-   while (curr < (int) raw->len) {
+   while (curr < (int) raw->len && parser->state != PARSING_DONE) {
       switch (parser->state) {
       case PARSING_STATUS_LINE:
       case PARSING_HEADER:
@@ -294,19 +303,21 @@ kms_response_parser_feed (kms_response_parser_t *parser,
          body_read = (int) raw->len - parser->start;
 
          if (parser->content_length == -1 ||
-             body_read > parser->content_length) {
+             (body_read > parser->content_length &&
+              !parser->multiple_responses)) {
             KMS_ERROR (parser, "Unexpected: exceeded content length");
             return false;
          }
 
          /* check if we have the entire body. */
-         if (body_read == parser->content_length) {
+         if (body_read >= parser->content_length) {
             parser->response->body = kms_request_str_new_from_chars (
                raw->str + parser->start, parser->content_length);
             parser->state = PARSING_DONE;
+            curr = parser->start + parser->content_length;
+         } else {
+            curr = (int) raw->len;
          }
-
-         curr = (int) raw->len;
          break;
       case PARSING_CHUNK:
          chunk_read = (int) raw->len - parser->start;
@@ -331,14 +342,22 @@ kms_response_parser_feed (kms_response_parser_t *parser,
          }
          break;
       case PARSING_DONE:
-         KMS_ERROR (parser, "Unexpected extra HTTP content");
-         return false;
+         break;
       }
    }
 
    if (parser->failed) {
       return false;
    }
+
+   if (parser->state == PARSING_DONE && parser->end == -1) {
+      parser->end = curr;
+   }
+
+   if (curr < (int) raw->len && !parser->multiple_responses) {
+      KMS_ERROR (parser, "Unexpected extra HTTP content");
+      return false;
+   }
    return true;
 }
 
@@ -347,17 +366,33 @@ kms_response_t *
 kms_response_parser_get_response (kms_response_parser_t *parser)
 {
    kms_response_t *response;
+   kms_request_str_t *raw;
+   kms_request_str_t *next = NULL;
 
    if (parser->kmip) {
       return kms_kmip_response_parser_get_response (parser->kmip);
    }
    
    response = parser->response;
+   raw = parser->raw_response;
+
+   if (parser->end != -1 && parser->end < (int) raw->len) {
+      /* the bytes past the end begin the next response. */
+      next = kms_request_str_new_from_chars (raw->str + parser->end,
+                                             (int) raw->len - parser->end);
+   }
 
    parser->response = NULL;
    /* reset the parser. */
    _parser_destroy (parser);
    _parser_init (parser);
+
+   if (next) {
+      /* a parse error is reported by the next kms_response_parser_feed. */
+      (void) kms_response_parser_feed (
+         parser, (uint8_t *) next->str, (uint32_t) next->len);
+      kms_request_str_destroy (next);
+   }
    return response;
 }
 
@@ -1,6 +1,7 @@
 #include "test_kms_assert.h"
 
 #include "kms_message/kms_kmip_request.h"
+#include "kms_kmip_reader_writer_private.h"
 
 /*
 <RequestMessage tag="0x420078" type="Structure">
@@ -161,6 +162,54 @@ kms_kmip_request_get_test (void)
 }
 
 
+void
+kms_kmip_request_get_batch_test (void)
+{
+   kms_request_t *req;
+   const uint8_t *actual_bytes;
+   size_t actual_len;
+   uint8_t expected_bytes[] = {GET_REQUEST};
+   const char *ids[] = {"7FJYvnV6XkaUCWuY96bCSc6AuhvkPpqI", "42"};
+   const uint8_t expected_batch_id[] = {0x00, 0x00, 0x00, 0x01};
+   kmip_reader_t *reader;
+   uint8_t *ptr;
+   size_t pos;
+   size_t len;
+
+   /* A batch of one is the same as kms_kmip_request_get_new. */
+   req = kms_kmip_request_get_batch_new (NULL, ids, 1);
+   ASSERT_REQUEST_OK (req);
+   actual_bytes = kms_request_to_bytes (req, &actual_len);
+   ASSERT_CMPBYTES (
+      actual_bytes, actual_len, expected_bytes, sizeof (expected_bytes));
+   kms_request_destroy (req);
+
+   /* Each identifier gets a BatchItem with its index as UniqueBatchItemID. */
+   req = kms_kmip_request_get_batch_new (NULL, ids, 2);
+   ASSERT_REQUEST_OK (req);
+   actual_bytes = kms_request_to_bytes (req, &actual_len);
+   reader = kmip_reader_new ((uint8_t *) actual_bytes, actual_len);
+   ASSERT (kmip_reader_find_and_recurse (reader, KMIP_TAG_RequestMessage));
+   ASSERT (kmip_reader_find_nth_and_recurse (reader, KMIP_TAG_BatchItem, 1));
+   ASSERT (kmip_reader_find_and_read_bytes (
+      reader, KMIP_TAG_UniqueBatchItemID, &ptr, &len));
+   ASSERT_CMPBYTES (ptr, len, expected_batch_id, sizeof (expected_batch_id));
+   ASSERT (kmip_reader_find_and_recurse (reader, KMIP_TAG_RequestPayload));
+   ASSERT (kmip_reader_find (reader,
+                             KMIP_TAG_UniqueIdentifier,
+                             KMIP_ITEM_TYPE_TextString,
+                             &pos,
+                             &len));
+   ASSERT (kmip_reader_read_string (reader, &ptr, len));
+   ASSERT_CMPBYTES (ptr, len, (const uint8_t *) ids[1], strlen (ids[1]));
+   kmip_reader_destroy (reader);
+   kms_request_destroy (req);
+
+   req = kms_kmip_request_get_batch_new (NULL, ids, 0);
+   ASSERT_REQUEST_ERROR (req, "expected between 1 and");
+   kms_request_destroy (req);
+}
+
 /*
 <RequestMessage tag="0x420078" type="Structure">
  <RequestHeader tag="0x420077" type="Structure">
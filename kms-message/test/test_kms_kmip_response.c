@@ -19,6 +19,7 @@
 
 #include "kms_message/kms_kmip_response.h"
 #include "kms_message_private.h"
+#include "kms_kmip_reader_writer_private.h"
 
 
 /*
@@ -212,3 +213,70 @@ kms_kmip_response_get_secretdata_notfound_test (void)
    ASSERT_RESPONSE_ERROR (&res, "ResultReasonItemNotFound");
    ASSERT (NULL == secretdata);
 }
+
+static void
+write_get_batch_item (kmip_writer_t *writer, uint8_t index, uint8_t fill)
+{
+   char id[4] = {0, 0, 0, 0};
+   char secretdata[KMS_KMIP_REQUEST_SECRETDATA_LENGTH];
+
+   id[3] = (char) index;
+   memset (secretdata, fill, sizeof (secretdata));
+   kmip_writer_begin_struct (writer, KMIP_TAG_BatchItem);
+   kmip_writer_write_enumeration (writer, KMIP_TAG_Operation, 0x0A);
+   kmip_writer_write_bytes (writer, KMIP_TAG_UniqueBatchItemID, id, sizeof id);
+   kmip_writer_write_enumeration (writer, KMIP_TAG_ResultStatus, 0);
+   kmip_writer_begin_struct (writer, KMIP_TAG_ResponsePayload);
+   kmip_writer_begin_struct (writer, KMIP_TAG_SecretData);
+   kmip_writer_begin_struct (writer, KMIP_TAG_KeyBlock);
+   kmip_writer_begin_struct (writer, KMIP_TAG_KeyValue);
+   kmip_writer_write_bytes (
+      writer, KMIP_TAG_KeyMaterial, secretdata, sizeof (secretdata));
+   kmip_writer_close_struct (writer); /* KMIP_TAG_KeyValue */
+   kmip_writer_close_struct (writer); /* KMIP_TAG_KeyBlock */
+   kmip_writer_close_struct (writer); /* KMIP_TAG_SecretData */
+   kmip_writer_close_struct (writer); /* KMIP_TAG_ResponsePayload */
+   kmip_writer_close_struct (writer); /* KMIP_TAG_BatchItem */
+}
+
+/* BatchItems are matched by UniqueBatchItemID, not by position. */
+void
+kms_kmip_response_get_secretdata_batch_test (void)
+{
+   kms_response_t res = {0};
+   kmip_writer_t *writer;
+   uint8_t expected[KMS_KMIP_REQUEST_SECRETDATA_LENGTH];
+   uint8_t *secretdata;
+   size_t secretdata_len;
+   size_t i;
+
+   writer = kmip_writer_new ();
+   kmip_writer_begin_struct (writer, KMIP_TAG_ResponseMessage);
+   kmip_writer_begin_struct (writer, KMIP_TAG_ResponseHeader);
+   kmip_writer_write_integer (writer, KMIP_TAG_BatchCount, 2);
+   kmip_writer_close_struct (writer); /* KMIP_TAG_ResponseHeader */
+   write_get_batch_item (writer, 1, 0x11);
+   write_get_batch_item (writer, 0, 0x00);
+   kmip_writer_close_struct (writer); /* KMIP_TAG_ResponseMessage */
+
+   res.provider = KMS_REQUEST_PROVIDER_KMIP;
+   res.kmip.data =
+      (uint8_t *) kmip_writer_get_buffer (writer, &secretdata_len);
+   res.kmip.len = (uint32_t) secretdata_len;
+
+   for (i = 0; i < 2; i++) {
+      memset (expected, (int) (0x11 * i), sizeof (expected));
+      secretdata =
+         kms_kmip_response_get_secretdata_at (&res, i, &secretdata_len);
+      ASSERT_RESPONSE_OK (&res);
+      ASSERT_CMPBYTES (
+         expected, sizeof (expected), secretdata, secretdata_len);
+      free (secretdata);
+   }
+
+   secretdata = kms_kmip_response_get_secretdata_at (&res, 2, &secretdata_len);
+   ASSERT_RESPONSE_ERROR (&res, "unable to find tag: BatchItem");
+   ASSERT (NULL == secretdata);
+
+   kmip_writer_destroy (writer);
+}
@@ -435,6 +435,56 @@ example_signature_test (void)
    kms_request_destroy (request);
 }
 
+static kms_request_t *
+make_signing_key_test_request (void)
+{
+   kms_request_t *request;
+
+   request = kms_request_new ("GET", "uri", NULL);
+   set_test_date (request);
+   kms_request_set_region (request, "us-east-1");
+   kms_request_set_service (request, "iam");
+   kms_request_set_access_key_id (request, "AKIDEXAMPLE");
+   kms_request_set_secret_key (request,
+                               "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+   return request;
+}
+
+/* a signing key set by the caller is used in place of the derived key */
+void
+set_signing_key_test (void)
+{
+   kms_request_t *request;
+   unsigned char signing[32];
+   unsigned char bogus[32];
+   char *expect;
+   char *sig;
+
+   request = make_signing_key_test_request ();
+   KMS_ASSERT (kms_request_get_signing_key (request, signing));
+   expect = kms_request_get_signed (request);
+   kms_request_destroy (request);
+
+   request = make_signing_key_test_request ();
+   KMS_ASSERT (kms_request_set_signing_key (request, signing));
+   sig = kms_request_get_signed (request);
+   ASSERT_CMPSTR (expect, sig);
+   free (sig);
+   kms_request_destroy (request);
+
+   /* the key is discarded when the region changes */
+   memset (bogus, 0, sizeof bogus);
+   request = make_signing_key_test_request ();
+   KMS_ASSERT (kms_request_set_signing_key (request, bogus));
+   kms_request_set_region (request, "us-east-1");
+   sig = kms_request_get_signed (request);
+   ASSERT_CMPSTR (expect, sig);
+   free (sig);
+   kms_request_destroy (request);
+
+   free (expect);
+}
+
 void
 path_normalization_test (void)
 {
@@ -607,6 +657,44 @@ connection_close_test (void)
    kms_request_destroy (request);
 }
 
+void
+connection_keep_alive_test (void)
+{
+   kms_request_opt_t *opt;
+   kms_request_t *request;
+   char *str;
+
+   opt = kms_request_opt_new ();
+   kms_request_opt_set_connection_keep_alive (opt, true);
+
+   request = kms_request_new ("POST", "/", opt);
+   kms_request_set_region (request, "foo-region");
+   kms_request_set_service (request, "foo-service");
+   kms_request_set_access_key_id (request, "foo-akid");
+   kms_request_set_secret_key (request, "foo-key");
+   set_test_date (request);
+
+   str = kms_request_to_string (request);
+   ASSERT (strstr (str, "Connection:keep-alive\n"));
+   kms_request_free_string (str);
+   /* the Connection header is not signed. */
+   str = kms_request_get_signed (request);
+   ASSERT (strstr (str, "Connection:keep-alive\n"));
+   ASSERT (strstr (str, "SignedHeaders=host;x-amz-date,"));
+   kms_request_free_string (str);
+   kms_request_destroy (request);
+
+   /* connection_close takes precedence. */
+   kms_request_opt_set_connection_close (opt, true);
+   request = kms_request_new ("POST", "/", opt);
+   str = kms_request_to_string (request);
+   ASSERT (strstr (str, "Connection:close\n"));
+   ASSERT (!strstr (str, "keep-alive"));
+   kms_request_free_string (str);
+   kms_request_opt_destroy (opt);
+   kms_request_destroy (request);
+}
+
 /* the ciphertext blob from a response to an "Encrypt" API call */
 const char ciphertext_blob[] =
    "\x01\x02\x02\x00\x78\xf3\x8e\xd8\xd4\xc6\xba\xfb\xa1\xcf\xc1\x1e\x68\xf2"
@@ -744,6 +832,8 @@ kms_response_parser_test (void)
       kms_response_parser_feed (parser, (uint8_t *) "HTTP/1.1 200 OK\r\n", 17));
    ASSERT (kms_response_parser_feed (
       parser, (uint8_t *) "Content-Length: 15\r\n", 20));
+   ASSERT (kms_response_parser_feed (
+      parser, (uint8_t *) "Connection: close\r\n", 19));
    ASSERT (kms_response_parser_feed (parser, (uint8_t *) "\r\n", 2));
    ASSERT (
       kms_response_parser_feed (parser, (uint8_t *) "This is a test.", 15));
@@ -751,6 +841,9 @@ kms_response_parser_test (void)
    response = kms_response_parser_get_response (parser);
    ASSERT (response->status == 200)
    ASSERT_CMPSTR (response->body->str, "This is a test.");
+   /* headers are looked up without regard to case. */
+   ASSERT_CMPSTR (kms_response_get_header (response, "connection"), "close");
+   ASSERT (!kms_response_get_header (response, "Keep-Alive"));
 
    kms_response_destroy (response);
    kms_response_parser_destroy (parser);
@@ -864,6 +957,71 @@ kms_response_parser_test (void)
    kms_response_parser_destroy (parser);
 }
 
+void
+kms_response_parser_multiple_responses_test (void)
+{
+   kms_response_parser_t *parser;
+   kms_response_t *response;
+   const char *stream = "HTTP/1.1 200 OK\r\n"
+                        "Content-Length: 5\r\n"
+                        "\r\n"
+                        "abcde"
+                        "HTTP/1.1 404 Not Found\r\n"
+                        "Transfer-Encoding: chunked\r\n"
+                        "\r\n"
+                        "2\r\nfg\r\n"
+                        "0\r\n\r\n"
+                        "HTTP/1.1 204 No Content\r\n"
+                        "\r\n"
+                        "HTTP/1.1 200 OK\r\n"
+                        "Content-Length: 3\r\n";
+
+   parser = kms_response_parser_new ();
+   kms_response_parser_set_multiple_responses (parser, true);
+
+   /* feed everything at once. */
+   ASSERT (kms_response_parser_feed (
+      parser, (uint8_t *) stream, (uint32_t) strlen (stream)));
+   ASSERT (kms_response_parser_wants_bytes (parser, 1024) == 0);
+   response = kms_response_parser_get_response (parser);
+   ASSERT (response->status == 200);
+   ASSERT_CMPSTR (response->body->str, "abcde");
+   kms_response_destroy (response);
+
+   ASSERT (kms_response_parser_wants_bytes (parser, 1024) == 0);
+   response = kms_response_parser_get_response (parser);
+   ASSERT (response->status == 404);
+   ASSERT_CMPSTR (response->body->str, "fg");
+   kms_response_destroy (response);
+
+   ASSERT (kms_response_parser_wants_bytes (parser, 1024) == 0);
+   response = kms_response_parser_get_response (parser);
+   ASSERT (response->status == 204);
+   ASSERT_CMPSTR (response->body->str, "");
+   kms_response_destroy (response);
+
+   /* the last response is not complete. */
+   ASSERT (kms_response_parser_status (parser) == 200);
+   ASSERT (kms_response_parser_wants_bytes (parser, 1024) == 1024);
+   ASSERT (kms_response_parser_feed (parser, (uint8_t *) "\r\nxy", 4));
+   ASSERT (kms_response_parser_wants_bytes (parser, 1024) == 1);
+   ASSERT (kms_response_parser_feed (parser, (uint8_t *) "z", 1));
+   ASSERT (kms_response_parser_wants_bytes (parser, 1024) == 0);
+   response = kms_response_parser_get_response (parser);
+   ASSERT (response->status == 200);
+   ASSERT_CMPSTR (response->body->str, "xyz");
+   kms_response_destroy (response);
+   kms_response_parser_destroy (parser);
+
+   /* without multiple_responses, the same stream is an error. */
+   parser = kms_response_parser_new ();
+   ASSERT (!kms_response_parser_feed (
+      parser, (uint8_t *) stream, (uint32_t) strlen (stream)));
+   ASSERT (strstr (kms_response_parser_error (parser),
+                   "Unexpected: exceeded content length"));
+   kms_response_parser_destroy (parser);
+}
+
 typedef struct {
    const char *filepath;
    const char *expected_body;
@@ -1121,11 +1279,13 @@ extern void kms_kmip_reader_find_and_read_bytes_test (void);
 extern void kms_kmip_request_register_secretdata_test (void);
 extern void kms_kmip_request_register_secretdata_invalid_test (void);
 extern void kms_kmip_request_get_test (void);
+extern void kms_kmip_request_get_batch_test (void);
 extern void kms_kmip_request_activate_test (void);
 extern void kms_kmip_response_parser_test (void);
 extern void kms_kmip_response_get_unique_identifier_test (void);
 extern void kms_kmip_response_get_secretdata_test (void);
 extern void kms_kmip_response_get_secretdata_notfound_test (void);
+extern void kms_kmip_response_get_secretdata_batch_test (void);
 extern void kms_kmip_response_parser_reuse_test (void);
 extern void kms_kmip_response_parser_excess_test (void);
 extern void kms_kmip_response_parser_notenough_test (void);
@@ -1153,6 +1313,7 @@ main (int argc, char *argv[])
    }
 
    RUN_TEST (example_signature_test);
+   RUN_TEST (set_signing_key_test);
    RUN_TEST (path_normalization_test);
    RUN_TEST (host_test);
    RUN_TEST (content_length_test);
@@ -1161,6 +1322,7 @@ main (int argc, char *argv[])
    RUN_TEST (set_date_test);
    RUN_TEST (multibyte_test);
    RUN_TEST (connection_close_test);
+   RUN_TEST (connection_keep_alive_test);
    RUN_TEST (decrypt_request_test);
    RUN_TEST (encrypt_request_test);
    RUN_TEST (kv_list_del_test);
@@ -1171,6 +1333,7 @@ main (int argc, char *argv[])
 
    RUN_TEST (kms_response_parser_test);
    RUN_TEST (kms_response_parser_files);
+   RUN_TEST (kms_response_parser_multiple_responses_test);
    RUN_TEST (kms_request_validate_test);
 
    RUN_TEST (kms_signature_test);
@@ -1185,12 +1348,14 @@ main (int argc, char *argv[])
    RUN_TEST (kms_kmip_request_register_secretdata_test);
    RUN_TEST (kms_kmip_request_register_secretdata_invalid_test);
    RUN_TEST (kms_kmip_request_get_test);
+   RUN_TEST (kms_kmip_request_get_batch_test);
    RUN_TEST (kms_kmip_request_activate_test);
    RUN_TEST (kms_request_kmip_prohibited_test);
    RUN_TEST (kms_kmip_response_parser_test);
    RUN_TEST (kms_kmip_response_get_unique_identifier_test);
    RUN_TEST (kms_kmip_response_get_secretdata_test);
    RUN_TEST (kms_kmip_response_get_secretdata_notfound_test);
+   RUN_TEST (kms_kmip_response_get_secretdata_batch_test);
    RUN_TEST (kms_kmip_response_parser_reuse_test);
    RUN_TEST (kms_kmip_response_parser_excess_test);
    RUN_TEST (kms_kmip_response_parser_notenough_test);
@@ -186,29 +186,39 @@ bool
 _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
                                     const _mongocrypt_buffer_t *iv,
                                     const _mongocrypt_buffer_t *in,
+                                    uint32_t in_count,
                                     _mongocrypt_buffer_t *out,
                                     uint32_t *bytes_written,
                                     mongocrypt_status_t *status)
 {
    bool ret = false;
    cng_encrypt_state *state = _crypto_state_init (key, iv, status);
+   ULONG intermediate_bytes_written;
+   uint32_t i;
 
    NTSTATUS nt_status;
 
-   nt_status = BCryptEncrypt (state->key_handle,
-                              (PUCHAR) (in->data),
-                              in->len,
-                              NULL,
-                              state->iv,
-                              state->iv_len,
-                              out->data,
-                              out->len,
-                              bytes_written,
-                              0);
+   *bytes_written = 0;
 
-   if (nt_status != STATUS_SUCCESS) {
-      CLIENT_ERR ("error initializing cipher: 0x%x", (int) nt_status);
-      goto done;
+   /* BCryptEncrypt updates state->iv with the last ciphertext block, so each
+    * call continues the CBC chain of the previous one. */
+   for (i = 0; i < in_count; i++) {
+      nt_status = BCryptEncrypt (state->key_handle,
+                                 (PUCHAR) (in[i].data),
+                                 in[i].len,
+                                 NULL,
+                                 state->iv,
+                                 state->iv_len,
+                                 out->data + *bytes_written,
+                                 out->len - *bytes_written,
+                                 &intermediate_bytes_written,
+                                 0);
+
+      if (nt_status != STATUS_SUCCESS) {
+         CLIENT_ERR ("error initializing cipher: 0x%x", (int) nt_status);
+         goto done;
+      }
+      *bytes_written += intermediate_bytes_written;
    }
 
    ret = true;
@@ -258,12 +268,14 @@ done:
 bool
 _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              const _mongocrypt_buffer_t *in,
+                             uint32_t in_count,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
 {
    bool ret = false;
    BCRYPT_HASH_HANDLE hHash;
    NTSTATUS nt_status;
+   uint32_t i;
 
    if (out->len != 64) {
       CLIENT_ERR ("out does not contain 64 bytes");
@@ -282,10 +294,13 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
       goto done;
    }
 
-   nt_status = BCryptHashData (hHash, (PUCHAR) in->data, (ULONG) in->len, 0);
-   if (nt_status != STATUS_SUCCESS) {
-      CLIENT_ERR ("error hashing data: 0x%x", (int) nt_status);
-      goto done;
+   for (i = 0; i < in_count; i++) {
+      nt_status =
+         BCryptHashData (hHash, (PUCHAR) in[i].data, (ULONG) in[i].len, 0);
+      if (nt_status != STATUS_SUCCESS) {
+         CLIENT_ERR ("error hashing data: 0x%x", (int) nt_status);
+         goto done;
+      }
    }
 
    nt_status = BCryptFinishHash (hHash, out->data, out->len, 0);
@@ -315,4 +330,62 @@ _native_crypto_random (_mongocrypt_buffer_t *out,
    return true;
 }
 
+
+_mongocrypt_prepared_key_t *
+_native_crypto_prepare_key (const _mongocrypt_buffer_t *key)
+{
+   /* Keys are not prepared. Each operation creates a key handle. */
+   return NULL;
+}
+
+
+void
+_native_crypto_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key)
+{
+   BSON_ASSERT (!prepared_key);
+}
+
+
+bool
+_native_crypto_aes_256_cbc_encrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
+
+bool
+_native_crypto_aes_256_cbc_decrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
+
+bool
+_native_crypto_hmac_sha_512_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   _mongocrypt_prepared_hmac_key_t which,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
 #endif /* MONGOCRYPT_ENABLE_CRYPTO_CNG */
\ No newline at end of file
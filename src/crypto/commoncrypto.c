@@ -36,6 +36,7 @@ bool
 _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
                                     const _mongocrypt_buffer_t *iv,
                                     const _mongocrypt_buffer_t *in,
+                                    uint32_t in_count,
                                     _mongocrypt_buffer_t *out,
                                     uint32_t *bytes_written,
                                     mongocrypt_status_t *status)
@@ -44,6 +45,7 @@ _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
    CCCryptorRef ctx = NULL;
    CCCryptorStatus cc_status;
    size_t intermediate_bytes_written;
+   uint32_t i;
 
    cc_status = CCCryptorCreate (kCCEncrypt,
                                 kCCAlgorithmAES,
@@ -60,13 +62,19 @@ _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
 
    *bytes_written = 0;
 
-   cc_status = CCCryptorUpdate (
-      ctx, in->data, in->len, out->data, out->len, &intermediate_bytes_written);
-   if (cc_status != kCCSuccess) {
-      CLIENT_ERR ("error encrypting: %d", (int) cc_status);
-      goto done;
+   for (i = 0; i < in_count; i++) {
+      cc_status = CCCryptorUpdate (ctx,
+                                   in[i].data,
+                                   in[i].len,
+                                   out->data + *bytes_written,
+                                   out->len - *bytes_written,
+                                   &intermediate_bytes_written);
+      if (cc_status != kCCSuccess) {
+         CLIENT_ERR ("error encrypting: %d", (int) cc_status);
+         goto done;
+      }
+      *bytes_written += intermediate_bytes_written;
    }
-   *bytes_written = intermediate_bytes_written;
 
 
    cc_status = CCCryptorFinal (ctx,
@@ -146,10 +154,12 @@ done:
 bool
 _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              const _mongocrypt_buffer_t *in,
+                             uint32_t in_count,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
 {
    CCHmacContext *ctx;
+   uint32_t i;
 
    if (out->len != MONGOCRYPT_HMAC_SHA512_LEN) {
       CLIENT_ERR ("out does not contain %d bytes", MONGOCRYPT_HMAC_SHA512_LEN);
@@ -161,7 +171,9 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
 
 
    CCHmacInit (ctx, kCCHmacAlgSHA512, key->data, key->len);
-   CCHmacUpdate (ctx, in->data, in->len);
+   for (i = 0; i < in_count; i++) {
+      CCHmacUpdate (ctx, in[i].data, in[i].len);
+   }
    CCHmacFinal (ctx, out->data);
    bson_free (ctx);
    return true;
@@ -181,4 +193,62 @@ _native_crypto_random (_mongocrypt_buffer_t *out,
    return true;
 }
 
+
+_mongocrypt_prepared_key_t *
+_native_crypto_prepare_key (const _mongocrypt_buffer_t *key)
+{
+   /* Keys are not prepared. Each operation creates a cryptor. */
+   return NULL;
+}
+
+
+void
+_native_crypto_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key)
+{
+   BSON_ASSERT (!prepared_key);
+}
+
+
+bool
+_native_crypto_aes_256_cbc_encrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
+
+bool
+_native_crypto_aes_256_cbc_decrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
+
+bool
+_native_crypto_hmac_sha_512_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   _mongocrypt_prepared_hmac_key_t which,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
 #endif /* MONGOCRYPT_ENABLE_CRYPTO_COMMON_CRYPTO */
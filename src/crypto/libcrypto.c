@@ -33,6 +33,12 @@
 #include <openssl/hmac.h>
 #include <openssl/rand.h>
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#define MONGOCRYPT_LIBCRYPTO_EVP_MAC
+#endif
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L || \
    (defined(LIBRESSL_VERSION_NUMBER) && LIBRESSL_VERSION_NUMBER < 0x20700000L)
 EVP_CIPHER_CTX *
@@ -60,60 +66,251 @@ HMAC_CTX_free (HMAC_CTX *ctx)
    HMAC_CTX_cleanup (ctx);
    bson_free (ctx);
 }
+
+int
+EVP_CIPHER_CTX_reset (EVP_CIPHER_CTX *ctx)
+{
+   int ret = EVP_CIPHER_CTX_cleanup (ctx);
+
+   EVP_CIPHER_CTX_init (ctx);
+   return ret;
+}
+
+int
+HMAC_CTX_reset (HMAC_CTX *ctx)
+{
+   HMAC_CTX_cleanup (ctx);
+   HMAC_CTX_init (ctx);
+   return 1;
+}
 #endif
 
+/* Contexts reused by the crypto operations on one thread. What is reused is
+ * the allocation of the cipher and HMAC contexts, and with OpenSSL 3, the
+ * fetched cipher and HMAC implementations, which otherwise cost a provider
+ * lookup per operation. The key schedule and HMAC pads are still set up for
+ * every operation, and contexts are reset after every operation, so no data
+ * key material outlives the call that used it. */
+typedef struct {
+   EVP_CIPHER_CTX *cipher_ctx;
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+   EVP_CIPHER *cipher;
+   /* EVP_MAC_CTX cannot be reset, so one is created per operation from the
+    * fetched implementation. */
+   EVP_MAC *mac;
+#else
+   HMAC_CTX *hmac_ctx;
+#endif
+   /* False if the context is destroyed after the operation. */
+   bool pooled;
+} _thread_ctx_t;
+
 bool _native_crypto_initialized = false;
+bool _native_crypto_reuse_contexts = true;
+
+static void
+_thread_ctx_destroy (void *arg)
+{
+   _thread_ctx_t *tctx = (_thread_ctx_t *) arg;
+
+   if (!tctx) {
+      return;
+   }
+   EVP_CIPHER_CTX_free (tctx->cipher_ctx);
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+   EVP_CIPHER_free (tctx->cipher);
+   EVP_MAC_free (tctx->mac);
+#else
+   HMAC_CTX_free (tctx->hmac_ctx);
+#endif
+   bson_free (tctx);
+}
+
+#ifndef _WIN32
+#include <pthread.h>
+
+static pthread_key_t _thread_ctx_key;
+/* False if contexts are not pooled per thread. This is always the case on
+ * Windows, and if the thread key cannot be created. A context is then created
+ * and destroyed for each operation. */
+static bool _thread_ctx_key_created = false;
+
+/* Delete the thread key at exit, or when the library is unloaded, so exiting
+ * threads never call a destructor that is no longer mapped. Contexts still
+ * held by other threads are leaked. */
+static void
+_native_crypto_cleanup (void)
+{
+   if (!_thread_ctx_key_created) {
+      return;
+   }
+   _thread_ctx_key_created = false;
+   _thread_ctx_destroy (pthread_getspecific (_thread_ctx_key));
+   (void) pthread_setspecific (_thread_ctx_key, NULL);
+   (void) pthread_key_delete (_thread_ctx_key);
+}
+#endif /* _WIN32 */
 
 void
 _native_crypto_init ()
 {
+#ifndef _WIN32
+   /* Pooled contexts are destroyed when their thread exits. On failure, fall
+    * back to a context per operation. */
+   if (0 == pthread_key_create (&_thread_ctx_key, _thread_ctx_destroy)) {
+      _thread_ctx_key_created = true;
+      if (0 != atexit (_native_crypto_cleanup)) {
+         _native_crypto_cleanup ();
+      }
+   }
+#endif
    _native_crypto_initialized = true;
 }
 
-bool
-_native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
-                                    const _mongocrypt_buffer_t *iv,
-                                    const _mongocrypt_buffer_t *in,
-                                    _mongocrypt_buffer_t *out,
-                                    uint32_t *bytes_written,
-                                    mongocrypt_status_t *status)
+static _thread_ctx_t *
+_thread_ctx_get (void)
+{
+   _thread_ctx_t *tctx;
+   bool pooled = false;
+
+#ifndef _WIN32
+   pooled = _thread_ctx_key_created && _native_crypto_reuse_contexts;
+   if (pooled) {
+      tctx = pthread_getspecific (_thread_ctx_key);
+      if (tctx) {
+         return tctx;
+      }
+   }
+#endif
+
+   tctx = bson_malloc0 (sizeof (*tctx));
+   BSON_ASSERT (tctx);
+#ifndef _WIN32
+   if (pooled && 0 != pthread_setspecific (_thread_ctx_key, tctx)) {
+      pooled = false;
+   }
+#endif
+   tctx->pooled = pooled;
+   return tctx;
+}
+
+static void
+_thread_ctx_release (_thread_ctx_t *tctx)
+{
+   /* A pooled context stays with the thread for the next operation. */
+   if (!tctx->pooled) {
+      _thread_ctx_destroy (tctx);
+   }
+}
+
+
+/* A data key with its AES key schedules and HMAC pads set up. Operations copy
+ * a context into the thread's context and never modify these, so threads may
+ * share a prepared key. Freeing the contexts cleanses them. */
+struct _mongocrypt_prepared_key_t {
+   EVP_CIPHER_CTX *encrypt_ctx;
+   EVP_CIPHER_CTX *decrypt_ctx;
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+   EVP_MAC_CTX *hmac_ctx[2];
+#else
+   HMAC_CTX *hmac_ctx[2];
+#endif
+};
+
+
+/* Encrypt or decrypt with @key, or with @prepared if it is not NULL. */
+static bool
+_aes_256_cbc_crypt (const _mongocrypt_buffer_t *key,
+                    const EVP_CIPHER_CTX *prepared,
+                    const _mongocrypt_buffer_t *iv,
+                    const _mongocrypt_buffer_t *in,
+                    uint32_t in_count,
+                    _mongocrypt_buffer_t *out,
+                    uint32_t *bytes_written,
+                    int enc,
+                    mongocrypt_status_t *status)
 {
    const EVP_CIPHER *cipher;
-   EVP_CIPHER_CTX *ctx;
+   _thread_ctx_t *tctx;
    bool ret = false;
    int intermediate_bytes_written;
-
-   ctx = EVP_CIPHER_CTX_new ();
+   uint32_t i;
+
+   tctx = _thread_ctx_get ();
+
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+   if (!tctx->cipher) {
+      tctx->cipher = EVP_CIPHER_fetch (NULL, "AES-256-CBC", NULL);
+      if (!tctx->cipher) {
+         CLIENT_ERR ("error fetching AES-256-CBC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         _thread_ctx_release (tctx);
+         return false;
+      }
+   }
+   cipher = tctx->cipher;
+#else
    cipher = EVP_aes_256_cbc ();
-
-   BSON_ASSERT (ctx);
+#endif
    BSON_ASSERT (cipher);
    BSON_ASSERT (EVP_CIPHER_iv_length (cipher) == iv->len);
-   BSON_ASSERT (EVP_CIPHER_key_length (cipher) == key->len);
-   BSON_ASSERT (EVP_CIPHER_block_size (cipher) == 16);
+   BSON_ASSERT (prepared ||
+                EVP_CIPHER_key_length (cipher) == (int) key->len);
+   BSON_ASSERT (EVP_CIPHER_block_size (cipher) == MONGOCRYPT_BLOCK_SIZE);
+
+   if (!tctx->cipher_ctx) {
+      tctx->cipher_ctx = EVP_CIPHER_CTX_new ();
+      BSON_ASSERT (tctx->cipher_ctx);
+   }
 
-   if (!EVP_EncryptInit_ex (
-          ctx, cipher, NULL /* engine */, key->data, iv->data)) {
+   if (prepared) {
+      /* Copy the expanded key, and only set the IV. */
+      if (!EVP_CIPHER_CTX_copy (tctx->cipher_ctx, prepared) ||
+          !EVP_CipherInit_ex (tctx->cipher_ctx,
+                              NULL /* cipher */,
+                              NULL /* engine */,
+                              NULL /* key */,
+                              iv->data,
+                              -1 /* keep direction */)) {
+         CLIENT_ERR ("error initializing cipher: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         goto done;
+      }
+   } else if (!EVP_CipherInit_ex (tctx->cipher_ctx,
+                                  cipher,
+                                  NULL /* engine */,
+                                  key->data,
+                                  iv->data,
+                                  enc)) {
       CLIENT_ERR ("error initializing cipher: %s",
                   ERR_error_string (ERR_get_error (), NULL));
       goto done;
    }
 
    /* Disable the default OpenSSL padding. */
-   EVP_CIPHER_CTX_set_padding (ctx, 0);
+   EVP_CIPHER_CTX_set_padding (tctx->cipher_ctx, 0);
 
    *bytes_written = 0;
-   if (!EVP_EncryptUpdate (
-          ctx, out->data, &intermediate_bytes_written, in->data, in->len)) {
-      CLIENT_ERR ("error encrypting: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+   for (i = 0; i < in_count; i++) {
+      if (!EVP_CipherUpdate (tctx->cipher_ctx,
+                             out->data + *bytes_written,
+                             &intermediate_bytes_written,
+                             in[i].data,
+                             in[i].len)) {
+         CLIENT_ERR ("%s: %s",
+                     enc ? "error encrypting" : "error decrypting",
+                     ERR_error_string (ERR_get_error (), NULL));
+         goto done;
+      }
+
+      *bytes_written += (uint32_t) intermediate_bytes_written;
    }
 
-   *bytes_written = (uint32_t) intermediate_bytes_written;
-
-   if (!EVP_EncryptFinal_ex (ctx, out->data, &intermediate_bytes_written)) {
-      CLIENT_ERR ("error finalizing: %s",
+   if (!EVP_CipherFinal_ex (tctx->cipher_ctx,
+                            out->data + *bytes_written,
+                            &intermediate_bytes_written)) {
+      CLIENT_ERR ("%s: %s",
+                  enc ? "error finalizing" : "error decrypting",
                   ERR_error_string (ERR_get_error (), NULL));
       goto done;
    }
@@ -122,11 +319,37 @@ _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
 
    ret = true;
 done:
-   EVP_CIPHER_CTX_free (ctx);
+   /* Cleanse the key schedule. Do not reuse a context that fails to reset. */
+   if (1 != EVP_CIPHER_CTX_reset (tctx->cipher_ctx)) {
+      EVP_CIPHER_CTX_free (tctx->cipher_ctx);
+      tctx->cipher_ctx = NULL;
+   }
+   _thread_ctx_release (tctx);
    return ret;
 }
 
 
+bool
+_native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
+                                    const _mongocrypt_buffer_t *iv,
+                                    const _mongocrypt_buffer_t *in,
+                                    uint32_t in_count,
+                                    _mongocrypt_buffer_t *out,
+                                    uint32_t *bytes_written,
+                                    mongocrypt_status_t *status)
+{
+   return _aes_256_cbc_crypt (key,
+                              NULL /* prepared */,
+                              iv,
+                              in,
+                              in_count,
+                              out,
+                              bytes_written,
+                              1 /* encrypt */,
+                              status);
+}
+
+
 bool
 _native_crypto_aes_256_cbc_decrypt (const _mongocrypt_buffer_t *key,
                                     const _mongocrypt_buffer_t *iv,
@@ -135,113 +358,352 @@ _native_crypto_aes_256_cbc_decrypt (const _mongocrypt_buffer_t *key,
                                     uint32_t *bytes_written,
                                     mongocrypt_status_t *status)
 {
-   const EVP_CIPHER *cipher;
-   EVP_CIPHER_CTX *ctx;
-   bool ret = false;
-   int intermediate_bytes_written;
+   return _aes_256_cbc_crypt (key,
+                              NULL /* prepared */,
+                              iv,
+                              in,
+                              1,
+                              out,
+                              bytes_written,
+                              0 /* decrypt */,
+                              status);
+}
 
-   ctx = EVP_CIPHER_CTX_new ();
-   cipher = EVP_aes_256_cbc ();
 
-   BSON_ASSERT (EVP_CIPHER_iv_length (cipher) == iv->len);
-   BSON_ASSERT (EVP_CIPHER_key_length (cipher) == key->len);
-   BSON_ASSERT (EVP_CIPHER_block_size (cipher) == MONGOCRYPT_BLOCK_SIZE);
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+/* Compute the HMAC with @key, or with @prepared if it is not NULL. */
+static bool
+_hmac_sha_512 (_thread_ctx_t *tctx,
+               const _mongocrypt_buffer_t *key,
+               const EVP_MAC_CTX *prepared,
+               const _mongocrypt_buffer_t *in,
+               uint32_t in_count,
+               _mongocrypt_buffer_t *out,
+               mongocrypt_status_t *status)
+{
+   EVP_MAC_CTX *ctx;
+   OSSL_PARAM params[2];
+   size_t len;
+   bool ret = false;
+   uint32_t i;
+
+   if (prepared) {
+      /* The copy starts with the prepared pads. */
+      ctx = EVP_MAC_CTX_dup (prepared);
+      if (!ctx) {
+         CLIENT_ERR ("error copying HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         return false;
+      }
+   } else {
+      if (!tctx->mac) {
+         tctx->mac = EVP_MAC_fetch (NULL, "HMAC", NULL);
+         if (!tctx->mac) {
+            CLIENT_ERR ("error fetching HMAC: %s",
+                        ERR_error_string (ERR_get_error (), NULL));
+            return false;
+         }
+      }
+
+      ctx = EVP_MAC_CTX_new (tctx->mac);
+      BSON_ASSERT (ctx);
+
+      params[0] = OSSL_PARAM_construct_utf8_string (
+         OSSL_MAC_PARAM_DIGEST, (char *) "SHA512", 0);
+      params[1] = OSSL_PARAM_construct_end ();
+      if (1 != EVP_MAC_init (ctx, key->data, key->len, params)) {
+         CLIENT_ERR ("error initializing HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         goto done;
+      }
+   }
 
-   if (!EVP_DecryptInit_ex (
-          ctx, cipher, NULL /* engine */, key->data, iv->data)) {
-      CLIENT_ERR ("error initializing cipher: %s",
+   for (i = 0; i < in_count; i++) {
+      if (1 != EVP_MAC_update (ctx, in[i].data, in[i].len)) {
+         CLIENT_ERR ("error updating HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         goto done;
+      }
+   }
+
+   if (1 != EVP_MAC_final (ctx, out->data, &len, out->len)) {
+      CLIENT_ERR ("error finalizing: %s",
                   ERR_error_string (ERR_get_error (), NULL));
       goto done;
    }
 
-   /* Disable padding. */
-   EVP_CIPHER_CTX_set_padding (ctx, 0);
+   ret = true;
+done:
+   /* Freeing the context cleanses the key. */
+   EVP_MAC_CTX_free (ctx);
+   return ret;
+}
+#else
+/* Compute the HMAC with @key, or with @prepared if it is not NULL. */
+static bool
+_hmac_sha_512 (_thread_ctx_t *tctx,
+               const _mongocrypt_buffer_t *key,
+               const HMAC_CTX *prepared,
+               const _mongocrypt_buffer_t *in,
+               uint32_t in_count,
+               _mongocrypt_buffer_t *out,
+               mongocrypt_status_t *status)
+{
+   bool ret = false;
+   uint32_t i;
 
-   *bytes_written = 0;
+   if (!tctx->hmac_ctx) {
+      tctx->hmac_ctx = HMAC_CTX_new ();
+      BSON_ASSERT (tctx->hmac_ctx);
+   }
 
-   if (!EVP_DecryptUpdate (
-          ctx, out->data, &intermediate_bytes_written, in->data, in->len)) {
-      CLIENT_ERR ("error decrypting: %s",
+   if (prepared) {
+      /* The copy starts with the prepared pads. */
+      if (1 != HMAC_CTX_copy (tctx->hmac_ctx, (HMAC_CTX *) prepared)) {
+         CLIENT_ERR ("error copying HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         goto done;
+      }
+   } else if (1 != HMAC_Init_ex (tctx->hmac_ctx,
+                                 key->data,
+                                 (int) key->len,
+                                 EVP_sha512 (),
+                                 NULL /* engine */)) {
+      CLIENT_ERR ("error initializing HMAC: %s",
                   ERR_error_string (ERR_get_error (), NULL));
       goto done;
    }
 
-   *bytes_written = intermediate_bytes_written;
+   for (i = 0; i < in_count; i++) {
+      if (1 != HMAC_Update (tctx->hmac_ctx, in[i].data, in[i].len)) {
+         CLIENT_ERR ("error updating HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         goto done;
+      }
+   }
 
-   if (!EVP_DecryptFinal_ex (ctx, out->data, &intermediate_bytes_written)) {
-      CLIENT_ERR ("error decrypting: %s",
+   if (1 != HMAC_Final (tctx->hmac_ctx, out->data, NULL /* unused len */)) {
+      CLIENT_ERR ("error finalizing: %s",
                   ERR_error_string (ERR_get_error (), NULL));
       goto done;
    }
 
-   *bytes_written += intermediate_bytes_written;
-
    ret = true;
 done:
-   EVP_CIPHER_CTX_free (ctx);
+   /* Cleanse the HMAC pads. Do not reuse a context that fails to reset. */
+   if (1 != HMAC_CTX_reset (tctx->hmac_ctx)) {
+      HMAC_CTX_free (tctx->hmac_ctx);
+      tctx->hmac_ctx = NULL;
+   }
    return ret;
 }
+#endif /* MONGOCRYPT_LIBCRYPTO_EVP_MAC */
 
 
 bool
 _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              const _mongocrypt_buffer_t *in,
+                             uint32_t in_count,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
 {
    const EVP_MD *algo;
+   _thread_ctx_t *tctx;
+   bool ret;
 
    algo = EVP_sha512 ();
    BSON_ASSERT (EVP_MD_block_size (algo) == 128);
    BSON_ASSERT (EVP_MD_size (algo) == MONGOCRYPT_HMAC_SHA512_LEN);
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-   if (!HMAC (algo,
-              key->data,
-              key->len,
-              in->data,
-              in->len,
-              out->data,
-              NULL /* unused out len */)) {
-      CLIENT_ERR ("error initializing HMAC: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
+   if (out->len != MONGOCRYPT_HMAC_SHA512_LEN) {
+      CLIENT_ERR ("out does not contain %d bytes", MONGOCRYPT_HMAC_SHA512_LEN);
+      return false;
+   }
+
+   tctx = _thread_ctx_get ();
+   ret = _hmac_sha_512 (
+      tctx, key, NULL /* prepared */, in, in_count, out, status);
+   _thread_ctx_release (tctx);
+   return ret;
+}
+
+
+static bool
+_prepare_cipher (EVP_CIPHER_CTX **out, const uint8_t *key, int enc)
+{
+   *out = EVP_CIPHER_CTX_new ();
+   BSON_ASSERT (*out);
+   if (!EVP_CipherInit_ex (*out,
+                           EVP_aes_256_cbc (),
+                           NULL /* engine */,
+                           key,
+                           NULL /* iv */,
+                           enc)) {
       return false;
    }
+   /* Disable the default OpenSSL padding. */
+   EVP_CIPHER_CTX_set_padding (*out, 0);
    return true;
-#else
-   HMAC_CTX *ctx;
-   bool ret = false;
+}
 
-   ctx = HMAC_CTX_new ();
 
-   if (out->len != MONGOCRYPT_HMAC_SHA512_LEN) {
-      CLIENT_ERR ("out does not contain %d bytes", MONGOCRYPT_HMAC_SHA512_LEN);
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+static bool
+_prepare_hmac (EVP_MAC_CTX **out, const uint8_t *key)
+{
+   EVP_MAC *mac;
+   OSSL_PARAM params[2];
+
+   mac = EVP_MAC_fetch (NULL, "HMAC", NULL);
+   if (!mac) {
       return false;
    }
+   *out = EVP_MAC_CTX_new (mac);
+   EVP_MAC_free (mac);
+   BSON_ASSERT (*out);
+
+   params[0] = OSSL_PARAM_construct_utf8_string (
+      OSSL_MAC_PARAM_DIGEST, (char *) "SHA512", 0);
+   params[1] = OSSL_PARAM_construct_end ();
+   return 1 == EVP_MAC_init (*out, key, MONGOCRYPT_MAC_KEY_LEN, params);
+}
+#else
+static bool
+_prepare_hmac (HMAC_CTX **out, const uint8_t *key)
+{
+   *out = HMAC_CTX_new ();
+   BSON_ASSERT (*out);
+   return 1 == HMAC_Init_ex (*out,
+                             key,
+                             MONGOCRYPT_MAC_KEY_LEN,
+                             EVP_sha512 (),
+                             NULL /* engine */);
+}
+#endif /* MONGOCRYPT_LIBCRYPTO_EVP_MAC */
 
-   if (!HMAC_Init_ex (ctx, key->data, key->len, algo, NULL /* engine */)) {
-      CLIENT_ERR ("error initializing HMAC: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+
+_mongocrypt_prepared_key_t *
+_native_crypto_prepare_key (const _mongocrypt_buffer_t *key)
+{
+   _mongocrypt_prepared_key_t *prepared_key;
+   const uint8_t *mac_key;
+   const uint8_t *enc_key;
+   const uint8_t *iv_key;
+
+   BSON_ASSERT (key->len == MONGOCRYPT_KEY_LEN);
+   /* [MCGREW]: MAC_KEY, then ENC_KEY. The IV key follows. */
+   mac_key = key->data;
+   enc_key = mac_key + MONGOCRYPT_MAC_KEY_LEN;
+   iv_key = enc_key + MONGOCRYPT_ENC_KEY_LEN;
+
+   prepared_key = bson_malloc0 (sizeof (*prepared_key));
+   BSON_ASSERT (prepared_key);
+   if (!_prepare_cipher (&prepared_key->encrypt_ctx, enc_key, 1) ||
+       !_prepare_cipher (&prepared_key->decrypt_ctx, enc_key, 0) ||
+       !_prepare_hmac (&prepared_key->hmac_ctx[MONGOCRYPT_PREPARED_MAC_KEY],
+                       mac_key) ||
+       !_prepare_hmac (&prepared_key->hmac_ctx[MONGOCRYPT_PREPARED_IV_KEY],
+                       iv_key)) {
+      /* Operations fall back to the raw key. */
+      ERR_clear_error ();
+      _native_crypto_prepared_key_destroy (prepared_key);
+      return NULL;
    }
+   return prepared_key;
+}
 
-   if (!HMAC_Update (ctx, in->data, in->len)) {
-      CLIENT_ERR ("error updating HMAC: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+
+void
+_native_crypto_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key)
+{
+   int i;
+
+   if (!prepared_key) {
+      return;
+   }
+   EVP_CIPHER_CTX_free (prepared_key->encrypt_ctx);
+   EVP_CIPHER_CTX_free (prepared_key->decrypt_ctx);
+   for (i = 0; i < 2; i++) {
+#ifdef MONGOCRYPT_LIBCRYPTO_EVP_MAC
+      EVP_MAC_CTX_free (prepared_key->hmac_ctx[i]);
+#else
+      HMAC_CTX_free (prepared_key->hmac_ctx[i]);
+#endif
    }
+   bson_free (prepared_key);
+}
 
-   if (!HMAC_Final (ctx, out->data, NULL /* unused out len */)) {
-      CLIENT_ERR ("error finalizing: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+
+bool
+_native_crypto_aes_256_cbc_encrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   return _aes_256_cbc_crypt (NULL /* key */,
+                              prepared_key->encrypt_ctx,
+                              iv,
+                              in,
+                              in_count,
+                              out,
+                              bytes_written,
+                              1 /* encrypt */,
+                              status);
+}
+
+
+bool
+_native_crypto_aes_256_cbc_decrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   return _aes_256_cbc_crypt (NULL /* key */,
+                              prepared_key->decrypt_ctx,
+                              iv,
+                              in,
+                              1,
+                              out,
+                              bytes_written,
+                              0 /* decrypt */,
+                              status);
+}
+
+
+bool
+_native_crypto_hmac_sha_512_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   _mongocrypt_prepared_hmac_key_t which,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status)
+{
+   _thread_ctx_t *tctx;
+   bool ret;
+
+   if (out->len != MONGOCRYPT_HMAC_SHA512_LEN) {
+      CLIENT_ERR ("out does not contain %d bytes", MONGOCRYPT_HMAC_SHA512_LEN);
+      return false;
    }
 
-   ret = true;
-done:
-   HMAC_CTX_free (ctx);
+   tctx = _thread_ctx_get ();
+   ret = _hmac_sha_512 (tctx,
+                        NULL /* key */,
+                        prepared_key->hmac_ctx[which],
+                        in,
+                        in_count,
+                        out,
+                        status);
+   _thread_ctx_release (tctx);
    return ret;
-#endif
 }
 
 
@@ -34,6 +34,7 @@ bool
 _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
                                     const _mongocrypt_buffer_t *iv,
                                     const _mongocrypt_buffer_t *in,
+                                    uint32_t in_count,
                                     _mongocrypt_buffer_t *out,
                                     uint32_t *bytes_written,
                                     mongocrypt_status_t *status)
@@ -59,6 +60,7 @@ _native_crypto_aes_256_cbc_decrypt (const _mongocrypt_buffer_t *key,
 bool
 _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              const _mongocrypt_buffer_t *in,
+                             uint32_t in_count,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
 {
@@ -76,4 +78,62 @@ _native_crypto_random (_mongocrypt_buffer_t *out,
    return false;
 }
 
+
+_mongocrypt_prepared_key_t *
+_native_crypto_prepare_key (const _mongocrypt_buffer_t *key)
+{
+   /* Hooks are given raw keys. */
+   return NULL;
+}
+
+
+void
+_native_crypto_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key)
+{
+   BSON_ASSERT (!prepared_key);
+}
+
+
+bool
+_native_crypto_aes_256_cbc_encrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
+
+bool
+_native_crypto_aes_256_cbc_decrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
+
+bool
+_native_crypto_hmac_sha_512_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   _mongocrypt_prepared_hmac_key_t which,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("prepared keys are not supported");
+   return false;
+}
+
 #endif /* MONGOCRYPT_ENABLE_CRYPTO */
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_ARENA_PRIVATE_H
+#define MONGOCRYPT_ARENA_PRIVATE_H
+
+#include <bson/bson.h>
+#include "mongocrypt-mutex-private.h"
+
+typedef struct __mongocrypt_arena_chunk_t _mongocrypt_arena_chunk_t;
+
+/* A bump allocator for the small temporary buffers used while encrypting or
+ * decrypting fields. Memory is never freed individually, only all at once by
+ * _mongocrypt_arena_cleanup. Allocation is thread safe, since fields may be
+ * transformed concurrently by a parallel executor. */
+typedef struct {
+   _mongocrypt_arena_chunk_t *chunks; /* most recently allocated first. */
+   size_t total;                      /* bytes in all chunks. */
+   mongocrypt_mutex_t mutex;
+} _mongocrypt_arena_t;
+
+
+void
+_mongocrypt_arena_init (_mongocrypt_arena_t *arena);
+
+
+/* Returns @len bytes from @arena, or NULL if @len is too large to be worth
+ * keeping until the arena is cleaned up. The caller falls back to the heap
+ * when NULL is returned. */
+void *
+_mongocrypt_arena_alloc (_mongocrypt_arena_t *arena, size_t len);
+
+
+/* Invalidate and zero all memory drawn from @arena, but keep one chunk to draw
+ * from again. Must not be called concurrently with _mongocrypt_arena_alloc. */
+void
+_mongocrypt_arena_reset (_mongocrypt_arena_t *arena);
+
+
+/* Zero and free all memory drawn from @arena. */
+void
+_mongocrypt_arena_cleanup (_mongocrypt_arena_t *arena);
+
+#endif /* MONGOCRYPT_ARENA_PRIVATE_H */
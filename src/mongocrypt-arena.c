@@ -0,0 +1,132 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-arena-private.h"
+#include "mongocrypt-util-private.h"
+
+/* Chunks are sized for the IVs, associated data, and short values of many
+ * fields. Larger allocations are left to the heap, and the arena stops growing
+ * at MAX_TOTAL, so a context with many fields does not hold on to an unbounded
+ * amount of temporary memory until it is destroyed. */
+#define ARENA_CHUNK_SIZE 4096
+#define ARENA_MAX_ALLOC 1024
+#define ARENA_MAX_TOTAL (1024 * 1024)
+#define ARENA_ALIGN 8
+
+struct __mongocrypt_arena_chunk_t {
+   _mongocrypt_arena_chunk_t *next;
+   size_t used;
+   /* followed by ARENA_CHUNK_SIZE bytes. */
+};
+
+
+void
+_mongocrypt_arena_init (_mongocrypt_arena_t *arena)
+{
+   BSON_ASSERT (arena);
+
+   memset (arena, 0, sizeof (*arena));
+   _mongocrypt_mutex_init (&arena->mutex);
+}
+
+
+void *
+_mongocrypt_arena_alloc (_mongocrypt_arena_t *arena, size_t len)
+{
+   _mongocrypt_arena_chunk_t *chunk;
+   void *ret = NULL;
+
+   BSON_ASSERT (arena);
+
+   if (len == 0 || len > ARENA_MAX_ALLOC) {
+      return NULL;
+   }
+
+   _mongocrypt_mutex_lock (&arena->mutex);
+   chunk = arena->chunks;
+   if (!chunk || chunk->used + len > ARENA_CHUNK_SIZE) {
+      if (arena->total + ARENA_CHUNK_SIZE > ARENA_MAX_TOTAL) {
+         goto done;
+      }
+      chunk = bson_malloc (sizeof (*chunk) + ARENA_CHUNK_SIZE);
+      BSON_ASSERT (chunk);
+      chunk->used = 0;
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      arena->total += ARENA_CHUNK_SIZE;
+   }
+
+   ret = (uint8_t *) (chunk + 1) + chunk->used;
+   /* Keep the next allocation aligned. */
+   chunk->used += (len + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+
+done:
+   _mongocrypt_mutex_unlock (&arena->mutex);
+   return ret;
+}
+
+
+/* Zero the memory drawn from @chunk, which may hold decrypted plaintext or
+ * key material. */
+static void
+_cleanse_chunk (_mongocrypt_arena_chunk_t *chunk)
+{
+   _mongocrypt_memzero (chunk + 1, chunk->used);
+   chunk->used = 0;
+}
+
+
+static void
+_free_chunks (_mongocrypt_arena_chunk_t *chunk)
+{
+   _mongocrypt_arena_chunk_t *next;
+
+   for (; chunk; chunk = next) {
+      next = chunk->next;
+      _cleanse_chunk (chunk);
+      bson_free (chunk);
+   }
+}
+
+
+void
+_mongocrypt_arena_reset (_mongocrypt_arena_t *arena)
+{
+   BSON_ASSERT (arena);
+
+   if (!arena->chunks) {
+      return;
+   }
+
+   _free_chunks (arena->chunks->next);
+   arena->chunks->next = NULL;
+   _cleanse_chunk (arena->chunks);
+   arena->total = ARENA_CHUNK_SIZE;
+}
+
+
+void
+_mongocrypt_arena_cleanup (_mongocrypt_arena_t *arena)
+{
+   if (!arena) {
+      return;
+   }
+
+   _free_chunks (arena->chunks);
+   arena->chunks = NULL;
+   arena->total = 0;
+   _mongocrypt_mutex_cleanup (&arena->mutex);
+}
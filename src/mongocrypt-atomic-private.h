@@ -0,0 +1,71 @@
+/*
+ * Copyright 2021-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_ATOMIC_PRIVATE_H
+#define MONGOCRYPT_ATOMIC_PRIVATE_H
+
+#include <bson/bson.h>
+
+/* Atomically add @n to @*p. Returns the new value. */
+static BSON_INLINE int32_t
+_mongocrypt_atomic_int32_add (volatile int32_t *p, int32_t n)
+{
+#if defined(_MSC_VER)
+   return (int32_t) InterlockedExchangeAdd ((volatile LONG *) p, (LONG) n) + n;
+#else
+   return __atomic_add_fetch (p, n, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Atomically add @n to @*p. Returns the new value. */
+static BSON_INLINE int64_t
+_mongocrypt_atomic_int64_add (volatile int64_t *p, int64_t n)
+{
+#if defined(_MSC_VER)
+   return (int64_t) InterlockedExchangeAdd64 ((volatile LONGLONG *) p,
+                                              (LONGLONG) n) +
+          n;
+#else
+   return __atomic_add_fetch (p, n, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Atomically load @*p. */
+static BSON_INLINE void *
+_mongocrypt_atomic_ptr_load (void *volatile *p)
+{
+#if defined(_MSC_VER)
+   return InterlockedCompareExchangePointer (p, NULL, NULL);
+#else
+   return __atomic_load_n (p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Atomically set @*p to @desired if it equals @expected.
+ * Returns true if @*p was set. */
+static BSON_INLINE bool
+_mongocrypt_atomic_ptr_cas (void *volatile *p, void *expected, void *desired)
+{
+#if defined(_MSC_VER)
+   return InterlockedCompareExchangePointer (p, desired, expected) ==
+          expected;
+#else
+   return __atomic_compare_exchange_n (
+      p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#endif /* MONGOCRYPT_ATOMIC_PRIVATE_H */
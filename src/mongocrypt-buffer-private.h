@@ -18,6 +18,7 @@
 #define MONGOCRYPT_BUFFER_H
 
 #include <bson/bson.h>
+#include "mongocrypt-arena-private.h"
 #include "mongocrypt-binary-private.h"
 #include "mongocrypt-compat.h"
 
@@ -43,6 +44,14 @@ _mongocrypt_buffer_init (_mongocrypt_buffer_t *buf);
 void
 _mongocrypt_buffer_resize (_mongocrypt_buffer_t *buf, uint32_t len);
 
+/* Like _mongocrypt_buffer_resize, but draws the memory from @arena when
+ * possible. A buffer drawn from @arena is not owned, and remains valid until
+ * @arena is cleaned up. @arena may be NULL to always use the heap. */
+void
+_mongocrypt_buffer_resize_in_arena (_mongocrypt_buffer_t *buf,
+                                    _mongocrypt_arena_t *arena,
+                                    uint32_t len);
+
 
 void
 _mongocrypt_buffer_steal (_mongocrypt_buffer_t *buf, _mongocrypt_buffer_t *src);
@@ -123,6 +132,12 @@ void
 _mongocrypt_buffer_cleanup (_mongocrypt_buffer_t *buf);
 
 
+/* Like _mongocrypt_buffer_cleanup, but zero the data first if @buf owns it.
+ * For buffers holding plaintext or key material. */
+void
+_mongocrypt_buffer_cleanse (_mongocrypt_buffer_t *buf);
+
+
 bool
 _mongocrypt_buffer_empty (const _mongocrypt_buffer_t *buf);
 
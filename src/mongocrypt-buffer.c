@@ -73,6 +73,30 @@ _mongocrypt_buffer_resize (_mongocrypt_buffer_t *buf, uint32_t len)
 }
 
 
+void
+_mongocrypt_buffer_resize_in_arena (_mongocrypt_buffer_t *buf,
+                                    _mongocrypt_arena_t *arena,
+                                    uint32_t len)
+{
+   uint8_t *data = NULL;
+
+   BSON_ASSERT (buf);
+
+   if (arena) {
+      data = _mongocrypt_arena_alloc (arena, len);
+   }
+   if (!data) {
+      _mongocrypt_buffer_resize (buf, len);
+      return;
+   }
+
+   _mongocrypt_buffer_cleanup (buf);
+   buf->data = data;
+   buf->len = len;
+   buf->owned = false;
+}
+
+
 void
 _mongocrypt_buffer_steal (_mongocrypt_buffer_t *buf, _mongocrypt_buffer_t *src)
 {
@@ -278,6 +302,16 @@ _mongocrypt_buffer_cleanup (_mongocrypt_buffer_t *buf)
 }
 
 
+void
+_mongocrypt_buffer_cleanse (_mongocrypt_buffer_t *buf)
+{
+   if (buf && buf->owned && buf->data) {
+      _mongocrypt_memzero (buf->data, buf->len);
+   }
+   _mongocrypt_buffer_cleanup (buf);
+}
+
+
 bool
 _mongocrypt_buffer_empty (const _mongocrypt_buffer_t *buf)
 {
@@ -336,6 +370,8 @@ _mongocrypt_buffer_to_bson_value (_mongocrypt_buffer_t *plaintext,
 
    ret = true;
 fail:
+   /* The copy of the plaintext is no longer needed. */
+   _mongocrypt_memzero (data, data_len);
    bson_free (data);
    return ret;
 }
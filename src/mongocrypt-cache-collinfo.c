@@ -30,6 +30,15 @@ _cmp_attr (void *a, void *b, int *out)
 }
 
 
+static bool
+_hash_attr (void *ns, uint32_t *out)
+{
+   *out = _mongocrypt_cache_hash_bytes ((const uint8_t *) ns,
+                                        (uint32_t) strlen ((char *) ns));
+   return true;
+}
+
+
 static void *
 _copy_attr (void *ns)
 {
@@ -58,15 +67,22 @@ _destroy_value (void *bson)
 }
 
 
+static uint32_t
+_size_value (void *bson)
+{
+   return ((bson_t *) bson)->len;
+}
+
+
 void
 _mongocrypt_cache_collinfo_init (_mongocrypt_cache_t *cache)
 {
    cache->cmp_attr = _cmp_attr;
+   cache->hash_attr = _hash_attr;
    cache->copy_attr = _copy_attr;
    cache->destroy_attr = _destroy_attr;
    cache->copy_value = _copy_value;
    cache->destroy_value = _destroy_value;
-   _mongocrypt_mutex_init (&cache->mutex);
-   cache->pair = NULL;
-   cache->expiration = CACHE_EXPIRATION_MS;
+   cache->size_value = _size_value;
+   _mongocrypt_cache_init (cache);
 }
\ No newline at end of file
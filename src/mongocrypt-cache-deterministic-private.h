@@ -0,0 +1,40 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_CACHE_DETERMINISTIC_PRIVATE_H
+#define MONGOCRYPT_CACHE_DETERMINISTIC_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-private.h"
+#include "mongocrypt-crypto-private.h"
+
+/* The associated data (subtype, UUID key id, BSON type), then the IV. */
+#define MONGOCRYPT_CACHE_DETERMINISTIC_ATTR_LEN (1 + 16 + 1 + MONGOCRYPT_IV_LEN)
+
+void
+_mongocrypt_cache_deterministic_init (_mongocrypt_cache_t *cache);
+
+/* Set @out to the attribute for a deterministic encryption with
+ * @associated_data, which identifies the key and BSON type, and the
+ * deterministic @iv computed from it and the plaintext. Returns false if the
+ * attribute does not have the expected length. */
+bool
+_mongocrypt_cache_deterministic_attr (
+   const _mongocrypt_buffer_t *associated_data,
+   const _mongocrypt_buffer_t *iv,
+   _mongocrypt_buffer_t *out);
+
+#endif /* MONGOCRYPT_CACHE_DETERMINISTIC_PRIVATE_H */
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-cache-deterministic-private.h"
+/* The deterministic encryption cache.
+ *
+ * Attribute is a _mongocrypt_buffer_t of the associated data followed by the
+ * deterministic IV. The associated data holds the key id and the original BSON
+ * type. The IV is an HMAC of the associated data and plaintext under the data
+ * key, so the attribute determines the result of deterministic encryption
+ * without holding the plaintext, and can only be computed with the data key.
+ * Value is a _mongocrypt_buffer_t of the encrypted data.
+ */
+
+
+static void
+_destroy_attr (void *attr)
+{
+   _mongocrypt_buffer_cleanse ((_mongocrypt_buffer_t *) attr);
+   bson_free (attr);
+}
+
+
+/* Attributes have a fixed length, so count them with each value. */
+static uint32_t
+_size_value (void *value)
+{
+   return ((_mongocrypt_buffer_t *) value)->len +
+          MONGOCRYPT_CACHE_DETERMINISTIC_ATTR_LEN;
+}
+
+
+bool
+_mongocrypt_cache_deterministic_attr (
+   const _mongocrypt_buffer_t *associated_data,
+   const _mongocrypt_buffer_t *iv,
+   _mongocrypt_buffer_t *out)
+{
+   _mongocrypt_buffer_t parts[2];
+
+   _mongocrypt_buffer_init (out);
+   if (associated_data->len + iv->len !=
+       MONGOCRYPT_CACHE_DETERMINISTIC_ATTR_LEN) {
+      return false;
+   }
+   parts[0] = *associated_data;
+   parts[1] = *iv;
+   return _mongocrypt_buffer_concat (out, parts, 2);
+}
+
+
+void
+_mongocrypt_cache_deterministic_init (_mongocrypt_cache_t *cache)
+{
+   _mongocrypt_cache_use_buffer_attr (cache);
+   _mongocrypt_cache_use_buffer_value (cache);
+   cache->destroy_attr = _destroy_attr;
+   cache->size_value = _size_value;
+   _mongocrypt_cache_init (cache);
+   /* Deterministic results never become stale. Entries are only evicted to
+    * respect the cache limits. */
+   _mongocrypt_cache_set_expiration (cache, (uint64_t) INT64_MAX);
+}
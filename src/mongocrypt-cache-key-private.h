@@ -19,14 +19,20 @@
 
 #include "mongocrypt-buffer-private.h"
 #include "mongocrypt-cache-private.h"
+#include "mongocrypt-crypto-private.h"
 #include "mongocrypt-key-private.h"
 #include "mongocrypt-mutex-private.h"
 #include "mongocrypt-opts-private.h"
 #include "mongocrypt-status-private.h"
 
+/* Key cache values are immutable once created. Getting a value from the cache
+ * returns a new reference instead of a copy. The prepared key is built on
+ * first use and shared by every reference. */
 typedef struct {
    _mongocrypt_key_doc_t *key_doc;
    _mongocrypt_buffer_t decrypted_key_material;
+   _mongocrypt_prepared_key_t *volatile prepared_key; /* may be NULL */
+   volatile int32_t refcount;
 } _mongocrypt_cache_key_value_t;
 
 typedef struct {
@@ -45,6 +51,18 @@ _mongocrypt_cache_key_value_t *
 _mongocrypt_cache_key_value_new (_mongocrypt_key_doc_t *key_doc,
                                  _mongocrypt_buffer_t *decrypted_key_material);
 
+/* Returns a new reference to @value. */
+_mongocrypt_cache_key_value_t *
+_mongocrypt_cache_key_value_ref (_mongocrypt_cache_key_value_t *value);
+
+/* Returns the prepared form of @value's key material, building it on the
+ * first call. Safe to call from multiple threads. Returns NULL if @crypto
+ * does not prepare keys, in which case callers use the key material. */
+const _mongocrypt_prepared_key_t *
+_mongocrypt_cache_key_value_prepared_key (_mongocrypt_cache_key_value_t *value,
+                                          _mongocrypt_crypto_t *crypto);
+
+/* Releases a reference to @value. @value is freed with the last reference. */
 void
 _mongocrypt_cache_key_value_destroy (void *value);
 
@@ -14,11 +14,13 @@
  * limitations under the License.
  */
 
+#include "mongocrypt-atomic-private.h"
 #include "mongocrypt-cache-key-private.h"
 /* The key cache.
  *
  * Attribute is a UUID in the form of a _mongocrypt_buffer_t.
- * Value contains a key document and decrypted key material.
+ * Value contains a key document and decrypted key material. Values are
+ * reference counted, so "copying" a value only adds a reference.
  */
 
 
@@ -49,6 +51,19 @@ _cmp_attr (void *a, void *b, int *out)
 }
 
 
+/* Key attributes are hashed by _id. An attribute with keyAltNames may match
+ * entries with any _id, so it is not hashable. */
+static bool
+_hash_attr (void *a, uint32_t *out)
+{
+   _mongocrypt_cache_key_attr_t *attr;
+
+   attr = (_mongocrypt_cache_key_attr_t *) a;
+   *out = _mongocrypt_cache_hash_bytes (attr->id.data, attr->id.len);
+   return !_mongocrypt_buffer_empty (&attr->id) && NULL == attr->alt_names;
+}
+
+
 static void *
 _copy_attr (void *attr)
 {
@@ -69,14 +84,22 @@ _destroy_attr (void *attr)
 
 static void *
 _copy_contents (void *value)
+{
+   return _mongocrypt_cache_key_value_ref (
+      (_mongocrypt_cache_key_value_t *) value);
+}
+
+static uint32_t
+_size_value (void *value)
 {
    _mongocrypt_cache_key_value_t *key_value;
 
    key_value = (_mongocrypt_cache_key_value_t *) value;
-   return _mongocrypt_cache_key_value_new (key_value->key_doc,
-                                           &key_value->decrypted_key_material);
+   return (uint32_t) sizeof (*key_value) +
+          key_value->decrypted_key_material.len + key_value->key_doc->bson.len;
 }
 
+
 static void
 _dump_attr (void *attr_in)
 {
@@ -111,11 +134,52 @@ _mongocrypt_cache_key_value_new (_mongocrypt_key_doc_t *key_doc,
 
    key_value->key_doc = _mongocrypt_key_new ();
    _mongocrypt_key_doc_copy_to (key_doc, key_value->key_doc);
+   key_value->refcount = 1;
 
    return key_value;
 }
 
 
+_mongocrypt_cache_key_value_t *
+_mongocrypt_cache_key_value_ref (_mongocrypt_cache_key_value_t *value)
+{
+   BSON_ASSERT (value);
+   _mongocrypt_atomic_int32_add (&value->refcount, 1);
+   return value;
+}
+
+
+const _mongocrypt_prepared_key_t *
+_mongocrypt_cache_key_value_prepared_key (_mongocrypt_cache_key_value_t *value,
+                                          _mongocrypt_crypto_t *crypto)
+{
+   _mongocrypt_prepared_key_t *prepared_key;
+
+   BSON_ASSERT (value);
+   prepared_key =
+      _mongocrypt_atomic_ptr_load ((void *volatile *) &value->prepared_key);
+   if (prepared_key) {
+      return prepared_key;
+   }
+
+   prepared_key =
+      _mongocrypt_prepare_key (crypto, &value->decrypted_key_material);
+   if (!prepared_key) {
+      return NULL;
+   }
+
+   /* Another thread may have prepared the key first. Keep theirs. */
+   if (!_mongocrypt_atomic_ptr_cas ((void *volatile *) &value->prepared_key,
+                                    NULL,
+                                    prepared_key)) {
+      _mongocrypt_prepared_key_destroy (prepared_key);
+      prepared_key =
+         _mongocrypt_atomic_ptr_load ((void *volatile *) &value->prepared_key);
+   }
+   return prepared_key;
+}
+
+
 void
 _mongocrypt_cache_key_value_destroy (void *value)
 {
@@ -125,8 +189,12 @@ _mongocrypt_cache_key_value_destroy (void *value)
       return;
    }
    key_value = (_mongocrypt_cache_key_value_t *) value;
+   if (_mongocrypt_atomic_int32_add (&key_value->refcount, -1) > 0) {
+      return;
+   }
    _mongocrypt_key_destroy (key_value->key_doc);
-   _mongocrypt_buffer_cleanup (&key_value->decrypted_key_material);
+   _mongocrypt_prepared_key_destroy (key_value->prepared_key);
+   _mongocrypt_buffer_cleanse (&key_value->decrypted_key_material);
    bson_free (key_value);
 }
 
@@ -134,14 +202,14 @@ void
 _mongocrypt_cache_key_init (_mongocrypt_cache_t *cache)
 {
    cache->cmp_attr = _cmp_attr;
+   cache->hash_attr = _hash_attr;
    cache->copy_attr = _copy_attr;
    cache->destroy_attr = _destroy_attr;
    cache->copy_value = _copy_contents;
    cache->destroy_value = _mongocrypt_cache_key_value_destroy;
    cache->dump_attr = _dump_attr;
-   _mongocrypt_mutex_init (&cache->mutex);
-   cache->pair = NULL;
-   cache->expiration = CACHE_EXPIRATION_MS;
+   cache->size_value = _size_value;
+   _mongocrypt_cache_init (cache);
 }
 
 /* Since key cache may be looked up by either _id or keyAltName,
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_CACHE_MARKING_PRIVATE_H
+#define MONGOCRYPT_CACHE_MARKING_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-private.h"
+
+typedef struct {
+   _mongocrypt_buffer_t cmd;   /* the command sent to mongocryptd. */
+   _mongocrypt_buffer_t reply; /* the reply of mongocryptd. */
+} _mongocrypt_cache_marking_value_t;
+
+
+void
+_mongocrypt_cache_marking_value_destroy (void *value);
+
+
+void
+_mongocrypt_cache_marking_init (_mongocrypt_cache_t *cache);
+
+
+/* Set @out to the attribute of @cmd. It identifies the namespace, the schema,
+ * and the shape of the command: its keys, types and nesting, but not its
+ * values. Returns false if @cmd or @schema is not valid BSON. */
+bool
+_mongocrypt_cache_marking_attr (const char *ns,
+                                bool is_remote_schema,
+                                const _mongocrypt_buffer_t *schema,
+                                const _mongocrypt_buffer_t *cmd,
+                                _mongocrypt_buffer_t *out)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+
+/* Produce in @out the reply mongocryptd would give for @cmd, from @value, a
+ * reply for a command with the same attribute. Marked values are replaced with
+ * the values of @cmd. Returns false if @value cannot be reused for @cmd: the
+ * values of @cmd that were not marked must be equal to those of @value->cmd,
+ * except for data that mongocryptd does not analyze. */
+bool
+_mongocrypt_cache_marking_reply (const _mongocrypt_cache_marking_value_t *value,
+                                 const _mongocrypt_buffer_t *cmd,
+                                 _mongocrypt_buffer_t *out)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+
+/* Returns true if replies for @value->cmd can be produced from @value. This is
+ * only the case if every element of the reply's result is copied from, or is
+ * a marking for, the element with the same key in the command, and no marking
+ * has a keyAltName. */
+bool
+_mongocrypt_cache_marking_reusable (
+   const _mongocrypt_cache_marking_value_t *value);
+
+#endif /* MONGOCRYPT_CACHE_MARKING_PRIVATE_H */
@@ -0,0 +1,486 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-cache-marking-private.h"
+#include "mongocrypt-private.h"
+/* The marking cache.
+ *
+ * Attribute is a _mongocrypt_buffer_t of the namespace, whether the schema is
+ * remote, the schema, and the shape of the command sent to mongocryptd.
+ * Value is a _mongocrypt_cache_marking_value_t of a command with that
+ * attribute and the reply of mongocryptd.
+ */
+
+
+static void *
+_copy_value (void *value)
+{
+   _mongocrypt_cache_marking_value_t *src, *copy;
+
+   src = (_mongocrypt_cache_marking_value_t *) value;
+   copy = bson_malloc0 (sizeof (_mongocrypt_cache_marking_value_t));
+   BSON_ASSERT (copy);
+   _mongocrypt_buffer_copy_to (&src->cmd, &copy->cmd);
+   _mongocrypt_buffer_copy_to (&src->reply, &copy->reply);
+   return copy;
+}
+
+
+void
+_mongocrypt_cache_marking_value_destroy (void *value)
+{
+   _mongocrypt_cache_marking_value_t *marking_value;
+
+   marking_value = (_mongocrypt_cache_marking_value_t *) value;
+   _mongocrypt_buffer_cleanup (&marking_value->cmd);
+   _mongocrypt_buffer_cleanup (&marking_value->reply);
+   bson_free (marking_value);
+}
+
+
+static uint32_t
+_size_value (void *value)
+{
+   _mongocrypt_cache_marking_value_t *marking_value;
+
+   marking_value = (_mongocrypt_cache_marking_value_t *) value;
+   return marking_value->cmd.len + marking_value->reply.len;
+}
+
+
+void
+_mongocrypt_cache_marking_init (_mongocrypt_cache_t *cache)
+{
+   _mongocrypt_cache_use_buffer_attr (cache);
+   cache->copy_value = _copy_value;
+   cache->destroy_value = _mongocrypt_cache_marking_value_destroy;
+   cache->size_value = _size_value;
+   _mongocrypt_cache_init (cache);
+   /* Markings only depend on the attribute, which includes the schema.
+    * Entries are only evicted to respect the cache limits. */
+   _mongocrypt_cache_set_expiration (cache, (uint64_t) INT64_MAX);
+}
+
+
+/* Append the keys, types, and nesting of the elements after @iter to @out.
+ * Values are left out, except the subtype of binary values. */
+static bool
+_append_shape (bson_iter_t *iter, bson_t *out)
+{
+   while (bson_iter_next (iter)) {
+      const char *key = bson_iter_key (iter);
+      bson_type_t type = bson_iter_type (iter);
+
+      if (type == BSON_TYPE_DOCUMENT || type == BSON_TYPE_ARRAY) {
+         bson_iter_t child_iter;
+         bson_t child;
+         bool ok;
+
+         if (!bson_iter_recurse (iter, &child_iter)) {
+            return false;
+         }
+         if (type == BSON_TYPE_DOCUMENT) {
+            bson_append_document_begin (out, key, -1, &child);
+         } else {
+            bson_append_array_begin (out, key, -1, &child);
+         }
+         ok = _append_shape (&child_iter, &child);
+         if (type == BSON_TYPE_DOCUMENT) {
+            bson_append_document_end (out, &child);
+         } else {
+            bson_append_array_end (out, &child);
+         }
+         if (!ok) {
+            return false;
+         }
+      } else if (type == BSON_TYPE_BINARY) {
+         bson_subtype_t subtype;
+         uint32_t len;
+         const uint8_t *data;
+
+         bson_iter_binary (iter, &subtype, &len, &data);
+         bson_append_int32 (out, key, -1, (int32_t) (type | subtype << 8));
+      } else {
+         bson_append_int32 (out, key, -1, (int32_t) type);
+      }
+   }
+   return true;
+}
+
+
+bool
+_mongocrypt_cache_marking_attr (const char *ns,
+                                bool is_remote_schema,
+                                const _mongocrypt_buffer_t *schema,
+                                const _mongocrypt_buffer_t *cmd,
+                                _mongocrypt_buffer_t *out)
+{
+   _mongocrypt_buffer_t parts[4];
+   bson_t cmd_bson, shape = BSON_INITIALIZER, empty = BSON_INITIALIZER;
+   bson_iter_t iter;
+   uint8_t remote = is_remote_schema ? 1 : 0;
+   bool ret = false;
+
+   if (!_mongocrypt_buffer_to_bson (cmd, &cmd_bson) ||
+       !bson_iter_init (&iter, &cmd_bson) || !_append_shape (&iter, &shape)) {
+      goto done;
+   }
+
+   /* Each part is NULL terminated or a BSON document, so the concatenation
+    * cannot be ambiguous. */
+   _mongocrypt_buffer_init (&parts[0]);
+   parts[0].data = (uint8_t *) ns;
+   parts[0].len = (uint32_t) strlen (ns) + 1;
+   _mongocrypt_buffer_init (&parts[1]);
+   parts[1].data = &remote;
+   parts[1].len = 1;
+   if (_mongocrypt_buffer_empty (schema)) {
+      _mongocrypt_buffer_from_bson (&parts[2], &empty);
+   } else {
+      parts[2] = *schema;
+   }
+   _mongocrypt_buffer_from_bson (&parts[3], &shape);
+   ret = _mongocrypt_buffer_concat (out, parts, 4);
+
+done:
+   bson_destroy (&shape);
+   bson_destroy (&empty);
+   return ret;
+}
+
+
+/* Returns true if the values at @a and @b have the same type and bytes. Each
+ * is appended under an empty key, so only the values are compared. */
+static bool
+_value_equal (const bson_iter_t *a, const bson_iter_t *b)
+{
+   bson_t a_bson, b_bson;
+   bool ret;
+
+   if (bson_iter_type (a) != bson_iter_type (b)) {
+      return false;
+   }
+   bson_init (&a_bson);
+   bson_init (&b_bson);
+   ret = bson_append_iter (&a_bson, "", 0, a) &&
+         bson_append_iter (&b_bson, "", 0, b) && bson_equal (&a_bson, &b_bson);
+   bson_destroy (&a_bson);
+   bson_destroy (&b_bson);
+   return ret;
+}
+
+
+/* Returns true if @iter is at an intent-to-encrypt marking. */
+static bool
+_is_marking (const bson_iter_t *iter, bson_t *marking)
+{
+   bson_subtype_t subtype;
+   uint32_t len;
+   const uint8_t *data;
+
+   if (!BSON_ITER_HOLDS_BINARY (iter)) {
+      return false;
+   }
+   bson_iter_binary (iter, &subtype, &len, &data);
+   if (subtype != BSON_SUBTYPE_ENCRYPTED || len == 0 || data[0] != 0) {
+      return false;
+   }
+   return bson_init_static (marking, data + 1, len - 1);
+}
+
+
+/* Append a copy of @marking to @out as @key, with "v" set to the value at
+ * @value. The other elements of the marking keep their order. */
+static bool
+_append_marking (bson_t *out,
+                 const char *key,
+                 const bson_t *marking,
+                 const bson_iter_t *value)
+{
+   bson_t copy = BSON_INITIALIZER;
+   bson_iter_t iter;
+   uint8_t *data;
+   bool ret;
+
+   if (!bson_iter_init (&iter, marking)) {
+      bson_destroy (&copy);
+      return false;
+   }
+   while (bson_iter_next (&iter)) {
+      if (0 == strcmp (bson_iter_key (&iter), "v")) {
+         bson_append_iter (&copy, "v", 1, value);
+      } else {
+         bson_append_iter (&copy, NULL, 0, &iter);
+      }
+   }
+
+   data = bson_malloc (copy.len + 1);
+   BSON_ASSERT (data);
+   data[0] = 0; /* the intent-to-encrypt marking type. */
+   memcpy (data + 1, bson_get_data (&copy), copy.len);
+   ret = bson_append_binary (
+      out, key, -1, BSON_SUBTYPE_ENCRYPTED, data, copy.len + 1);
+   bson_free (data);
+   bson_destroy (&copy);
+   return ret;
+}
+
+
+/* Position @out at @key, trying the element after @pos first. @start is the
+ * iterator at the start of the document. */
+static bool
+_find_key (const bson_iter_t *start,
+           bson_iter_t *pos,
+           const char *key,
+           bson_iter_t *out)
+{
+   if (bson_iter_next (pos) && 0 == strcmp (bson_iter_key (pos), key)) {
+      memcpy (out, pos, sizeof (bson_iter_t));
+      return true;
+   }
+   memcpy (out, start, sizeof (bson_iter_t));
+   return bson_iter_find (out, key);
+}
+
+
+/* Values of insert documents and of these generic command arguments are not
+ * analyzed by mongocryptd, so they may differ from the cached command. */
+static bool
+_is_unanalyzed (const char *cmd_name, const char *key)
+{
+   const char *generic_args[] = {"lsid",
+                                 "txnNumber",
+                                 "$clusterTime",
+                                 "$db",
+                                 "maxTimeMS",
+                                 "writeConcern",
+                                 "readConcern",
+                                 "autocommit",
+                                 "startTransaction",
+                                 "comment"};
+   size_t i;
+
+   if (0 == strcmp (cmd_name, "insert") && 0 == strcmp (key, "documents")) {
+      return true;
+   }
+   for (i = 0; i < sizeof (generic_args) / sizeof (generic_args[0]); i++) {
+      if (0 == strcmp (key, generic_args[i])) {
+         return true;
+      }
+   }
+   return false;
+}
+
+
+/* Walk the document at @tmpl, a mongocryptd result or the cached command
+ * itself, matching each element by key to the cached command at @orig and the
+ * new command at @cmd. If @out is not NULL, append the result for @cmd. */
+static bool
+_synthesize (bson_iter_t *tmpl,
+             bson_iter_t *orig,
+             bson_iter_t *cmd,
+             const char *cmd_name,
+             bool unanalyzed,
+             bson_t *out)
+{
+   bson_iter_t orig_start, orig_pos, cmd_start, cmd_pos;
+   uint32_t tmpl_count = 0, orig_count = 0;
+
+   memcpy (&orig_start, orig, sizeof (bson_iter_t));
+   memcpy (&orig_pos, orig, sizeof (bson_iter_t));
+   memcpy (&cmd_start, cmd, sizeof (bson_iter_t));
+   memcpy (&cmd_pos, cmd, sizeof (bson_iter_t));
+
+   while (bson_iter_next (tmpl)) {
+      const char *key = bson_iter_key (tmpl);
+      bson_type_t type = bson_iter_type (tmpl);
+      bson_iter_t orig_iter, cmd_iter;
+      bool child_unanalyzed = unanalyzed;
+      bson_t marking;
+
+      tmpl_count++;
+      if (!_find_key (&orig_start, &orig_pos, key, &orig_iter) ||
+          !_find_key (&cmd_start, &cmd_pos, key, &cmd_iter) ||
+          bson_iter_type (&orig_iter) != bson_iter_type (&cmd_iter)) {
+         return false;
+      }
+
+      if (cmd_name && _is_unanalyzed (cmd_name, key)) {
+         child_unanalyzed = true;
+      }
+
+      if (_is_marking (tmpl, &marking)) {
+         bson_iter_t v_iter, ka_iter;
+
+         /* The marked value must be the value of the cached command. */
+         if (!bson_iter_init_find (&v_iter, &marking, "v") ||
+             !_value_equal (&v_iter, &orig_iter)) {
+            return false;
+         }
+         /* A keyAltName may be read from another value of the command, by a
+          * JSON pointer keyId in the schema, so the marking cannot be reused
+          * for a command with other values. */
+         if (bson_iter_init_find (&ka_iter, &marking, "ka")) {
+            return false;
+         }
+         if (out && !_append_marking (out, key, &marking, &cmd_iter)) {
+            return false;
+         }
+      } else if (type != bson_iter_type (&orig_iter)) {
+         return false;
+      } else if (type == BSON_TYPE_DOCUMENT || type == BSON_TYPE_ARRAY) {
+         bson_iter_t tmpl_child, orig_child, cmd_child;
+         bson_t out_child;
+         bool ok;
+
+         if (!bson_iter_recurse (tmpl, &tmpl_child) ||
+             !bson_iter_recurse (&orig_iter, &orig_child) ||
+             !bson_iter_recurse (&cmd_iter, &cmd_child)) {
+            return false;
+         }
+         if (!out) {
+            ok = _synthesize (&tmpl_child,
+                              &orig_child,
+                              &cmd_child,
+                              NULL,
+                              child_unanalyzed,
+                              NULL);
+         } else if (type == BSON_TYPE_DOCUMENT) {
+            bson_append_document_begin (out, key, -1, &out_child);
+            ok = _synthesize (&tmpl_child,
+                              &orig_child,
+                              &cmd_child,
+                              NULL,
+                              child_unanalyzed,
+                              &out_child);
+            bson_append_document_end (out, &out_child);
+         } else {
+            bson_append_array_begin (out, key, -1, &out_child);
+            ok = _synthesize (&tmpl_child,
+                              &orig_child,
+                              &cmd_child,
+                              NULL,
+                              child_unanalyzed,
+                              &out_child);
+            bson_append_array_end (out, &out_child);
+         }
+         if (!ok) {
+            return false;
+         }
+      } else {
+         /* A value mongocryptd copied must be the value of the cached
+          * command. It may only change if mongocryptd does not analyze it. */
+         if (!_value_equal (tmpl, &orig_iter)) {
+            return false;
+         }
+         if (!child_unanalyzed && !_value_equal (&orig_iter, &cmd_iter)) {
+            return false;
+         }
+         if (out) {
+            bson_append_iter (out, key, -1, &cmd_iter);
+         }
+      }
+   }
+
+   /* Every value of the cached command must have been checked. */
+   while (bson_iter_next (&orig_start)) {
+      orig_count++;
+   }
+   return tmpl_count == orig_count;
+}
+
+
+bool
+_mongocrypt_cache_marking_reply (const _mongocrypt_cache_marking_value_t *value,
+                                 const _mongocrypt_buffer_t *cmd,
+                                 _mongocrypt_buffer_t *out)
+{
+   bson_t reply_bson, orig_bson, cmd_bson, reply_out, result_out;
+   bson_iter_t iter, result_iter, orig_iter, cmd_iter;
+   const char *cmd_name;
+
+   if (!_mongocrypt_buffer_to_bson (&value->reply, &reply_bson) ||
+       !_mongocrypt_buffer_to_bson (&value->cmd, &orig_bson) ||
+       !_mongocrypt_buffer_to_bson (cmd, &cmd_bson) ||
+       !bson_iter_init (&orig_iter, &orig_bson) ||
+       !bson_iter_init (&cmd_iter, &cmd_bson)) {
+      return false;
+   }
+
+   memcpy (&iter, &orig_iter, sizeof (bson_iter_t));
+   if (!bson_iter_next (&iter)) {
+      return false;
+   }
+   cmd_name = bson_iter_key (&iter);
+
+   if (!bson_iter_init_find (&result_iter, &reply_bson, "result") ||
+       !BSON_ITER_HOLDS_DOCUMENT (&result_iter)) {
+      /* Nothing was marked. The reply holds for any command whose values
+       * equal those of the cached command. */
+      memcpy (&iter, &orig_iter, sizeof (bson_iter_t));
+      if (!_synthesize (&iter, &orig_iter, &cmd_iter, cmd_name, false, NULL)) {
+         return false;
+      }
+      _mongocrypt_buffer_copy_to (&value->reply, out);
+      return true;
+   }
+
+   if (!bson_iter_recurse (&result_iter, &result_iter)) {
+      return false;
+   }
+   bson_init (&result_out);
+   if (!_synthesize (
+          &result_iter, &orig_iter, &cmd_iter, cmd_name, false, &result_out)) {
+      bson_destroy (&result_out);
+      return false;
+   }
+
+   /* Copy the reply, replacing the result. */
+   bson_init (&reply_out);
+   if (!bson_iter_init (&iter, &reply_bson)) {
+      bson_destroy (&result_out);
+      bson_destroy (&reply_out);
+      return false;
+   }
+   while (bson_iter_next (&iter)) {
+      if (0 == strcmp (bson_iter_key (&iter), "result")) {
+         bson_append_document (&reply_out, "result", 6, &result_out);
+      } else {
+         bson_append_iter (&reply_out, NULL, 0, &iter);
+      }
+   }
+   bson_destroy (&result_out);
+   _mongocrypt_buffer_steal_from_bson (out, &reply_out);
+   return true;
+}
+
+
+bool
+_mongocrypt_cache_marking_reusable (
+   const _mongocrypt_cache_marking_value_t *value)
+{
+   _mongocrypt_buffer_t reply;
+   bool ret;
+
+   /* Producing the reply for the cached command itself must give back the
+    * reply of mongocryptd. Otherwise mongocryptd restructured the command, and
+    * the reply cannot be derived for other values. */
+   _mongocrypt_buffer_init (&reply);
+   ret = _mongocrypt_cache_marking_reply (value, &value->cmd, &reply) &&
+         0 == _mongocrypt_buffer_cmp (&reply, &value->reply);
+   _mongocrypt_buffer_cleanup (&reply);
+   return ret;
+}
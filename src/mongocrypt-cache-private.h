@@ -21,37 +21,113 @@
 #include "mongocrypt-status-private.h"
 
 #define CACHE_EXPIRATION_MS 60000
+/* The longest expiration that can be configured for the key cache: a year. */
+#define CACHE_MAX_EXPIRATION_MS ((uint64_t) 365 * 24 * 60 * 60 * 1000)
+
+/* Number of independently locked shards in a cache. Must be a power of two. */
+#define CACHE_NUM_SHARDS 16
+/* Initial number of hash buckets in each shard. Must be a power of two. */
+#define CACHE_INITIAL_BUCKETS 8
 
 /* A generic simple cache.
  * To avoid overusing the names "key" or "id", the cache contains
  * "attribute-value" pairs.
  * https://en.wikipedia.org/wiki/Attribute%E2%80%93value_pair
+ *
+ * Pairs are stored in a hash table indexed by the hash of the attribute. The
+ * table is split into CACHE_NUM_SHARDS shards, each with its own lock, so
+ * threads only contend when they access attributes in the same shard.
  */
 typedef bool (*cache_compare_fn) (void *thing_a, void *thing_b, int *out);
 typedef void (*cache_destroy_fn) (void *thing);
 typedef void *(*cache_copy_fn) (void *thing);
 typedef void (*cache_dump_fn) (void *thing);
+/* Returns the approximate number of bytes held by @thing. */
+typedef uint32_t (*cache_size_fn) (void *thing);
+/* Sets @out to the hash of @thing. Attributes that compare equal must have
+ * equal hashes. Returns false if @thing may also compare equal to attributes
+ * with a different hash (e.g. a key looked up by keyAltName). Lookups with such
+ * an attribute compare against every entry in the cache. */
+typedef bool (*cache_hash_fn) (void *thing, uint32_t *out);
 
 typedef struct __mongocrypt_cache_pair_t {
    void *attr;
    void *value;
-   struct __mongocrypt_cache_pair_t *next;
+   struct __mongocrypt_cache_pair_t *next; /* next pair in the same bucket. */
+   /* neighbors in the shard's expiration list. */
+   struct __mongocrypt_cache_pair_t *older;
+   struct __mongocrypt_cache_pair_t *newer;
+   /* neighbors in the shard's least-recently-used list. */
+   struct __mongocrypt_cache_pair_t *less_recent;
+   struct __mongocrypt_cache_pair_t *more_recent;
    int64_t last_updated;
+   int64_t last_used; /* value of the cache's use_count at the last access. */
+   uint32_t hash;
+   uint32_t size; /* bytes counted against the cache's byte limit. */
+   bool refresh_claimed; /* a caller has been asked to refresh this pair. */
 } _mongocrypt_cache_pair_t;
 
+typedef struct {
+   mongocrypt_mutex_t mutex; /* lock of this shard. */
+   _mongocrypt_cache_pair_t **buckets;
+   uint32_t num_buckets;
+   uint32_t num_entries;
+   /* All pairs of the shard ordered by last_updated, oldest first. */
+   _mongocrypt_cache_pair_t *oldest;
+   _mongocrypt_cache_pair_t *newest;
+   /* All pairs of the shard ordered by last access, least recent first. */
+   _mongocrypt_cache_pair_t *least_recent;
+   _mongocrypt_cache_pair_t *most_recent;
+} _mongocrypt_cache_shard_t;
+
 typedef struct {
    cache_dump_fn dump_attr;
    cache_compare_fn cmp_attr;
+   cache_hash_fn hash_attr;
    cache_copy_fn copy_attr;
    cache_destroy_fn destroy_attr;
    cache_copy_fn copy_value;
    cache_destroy_fn destroy_value;
-   _mongocrypt_cache_pair_t *pair;
-   mongocrypt_mutex_t mutex; /* global lock of cache. */
+   cache_size_fn size_value; /* may be NULL if no byte limit applies. */
+   _mongocrypt_cache_shard_t shards[CACHE_NUM_SHARDS];
    uint64_t expiration;
+   /* Window before expiration in which a pair is handed out for refresh. 0
+    * disables refresh-ahead. */
+   uint64_t refresh_ahead;
+   /* Limits of the cache. 0 means unlimited. */
+   uint32_t max_entries;
+   uint64_t max_bytes;
+   /* Totals over every shard, compared against the limits. Guarded by
+    * @count_mutex, which is only ever taken while holding a shard lock. */
+   mongocrypt_mutex_t count_mutex;
+   uint32_t num_entries;
+   uint64_t num_bytes;
+   /* Incremented atomically on every access, to order pairs across shards by
+    * recency. */
+   volatile int64_t use_count;
 } _mongocrypt_cache_t;
 
 
+/* Initialize the shared state of a cache. Called by the specific cache
+ * initializers after setting the attribute and value functions. */
+void
+_mongocrypt_cache_init (_mongocrypt_cache_t *cache);
+
+/* Hash a byte sequence. A helper for implementing cache_hash_fn. */
+uint32_t
+_mongocrypt_cache_hash_bytes (const uint8_t *data, uint32_t len);
+
+
+/* Use _mongocrypt_buffer_t attributes, compared and hashed by their bytes.
+ * Called by the specific cache initializers before _mongocrypt_cache_init. */
+void
+_mongocrypt_cache_use_buffer_attr (_mongocrypt_cache_t *cache);
+
+/* Use _mongocrypt_buffer_t values, sized by their length. */
+void
+_mongocrypt_cache_use_buffer_value (_mongocrypt_cache_t *cache);
+
+
 /* Attempt to get an entry.
  * Returns boolean indicating success.
  */
@@ -85,10 +161,46 @@ _mongocrypt_cache_cleanup (_mongocrypt_cache_t *cache);
 void
 _mongocrypt_cache_dump (_mongocrypt_cache_t *cache);
 
-/* Tests may override the default expiration */
+/* Limit the number of entries and the total size of values in the cache.
+ * When a limit is exceeded, the least recently used entries of the whole cache
+ * are evicted, whichever shard they are in. Pass 0 for no limit. */
+void
+_mongocrypt_cache_set_limits (_mongocrypt_cache_t *cache,
+                              uint32_t max_entries,
+                              uint64_t max_bytes);
+
+/* Like _mongocrypt_cache_get, but also sets @refresh to true if the matched
+ * pair is within the refresh-ahead window of its expiration. Only the first
+ * caller to see a pair in that window is asked to refresh it. Others keep
+ * getting the still valid value until it is replaced or expires. */
+bool
+_mongocrypt_cache_get_refresh_ahead (_mongocrypt_cache_t *cache,
+                                     void *attr,
+                                     void **value,
+                                     bool *refresh)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Release the refresh claim on the pair matching @attr, so that the next
+ * caller in the refresh-ahead window is asked to refresh it. Called when the
+ * caller asked to refresh it will not. */
+bool
+_mongocrypt_cache_release_refresh (_mongocrypt_cache_t *cache, void *attr)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Set the time in milliseconds after which pairs expire. Defaults to
+ * CACHE_EXPIRATION_MS. Values above INT64_MAX are treated as INT64_MAX. */
 void
 _mongocrypt_cache_set_expiration (_mongocrypt_cache_t *cache, uint64_t milli);
 
+/* Set the refresh-ahead window in milliseconds. 0 disables refresh-ahead. */
+void
+_mongocrypt_cache_set_refresh_ahead (_mongocrypt_cache_t *cache,
+                                     uint64_t milli);
+
+/* Remove every pair. */
+void
+_mongocrypt_cache_clear (_mongocrypt_cache_t *cache);
+
 uint32_t
 _mongocrypt_cache_num_entries (_mongocrypt_cache_t *cache);
 
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_CACHE_SIGNING_KEY_PRIVATE_H
+#define MONGOCRYPT_CACHE_SIGNING_KEY_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-private.h"
+
+#define MONGOCRYPT_SIGNING_KEY_LEN 32
+
+void
+_mongocrypt_cache_signing_key_init (_mongocrypt_cache_t *cache);
+
+/* Set @out to the attribute of an AWS SigV4 signing key. The key is derived
+ * from the secret key, the UTC @date formatted as YYYYmmDD, the region and the
+ * service. The access key id and @secret_digest, a digest of the secret key
+ * from _mongocrypt_hash_secret, are included so that each credential has its
+ * own entries without the cache holding the secret. Returns false if the
+ * attribute is too large. */
+bool
+_mongocrypt_cache_signing_key_attr (const char *access_key_id,
+                                    const _mongocrypt_buffer_t *secret_digest,
+                                    const char *date,
+                                    const char *region,
+                                    const char *service,
+                                    _mongocrypt_buffer_t *out)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+#endif /* MONGOCRYPT_CACHE_SIGNING_KEY_PRIVATE_H */
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-cache-signing-key-private.h"
+
+/* The AWS SigV4 signing key cache.
+ *
+ * Attribute is a _mongocrypt_buffer_t of the NULL terminated access key id,
+ * date, region and service, followed by a digest of the secret key. Value is a
+ * _mongocrypt_buffer_t of the MONGOCRYPT_SIGNING_KEY_LEN byte signing key.
+ * Both are zeroed when they are destroyed.
+ */
+
+/* A few regions and credentials per day are expected. Keys of past days are
+ * never requested again and are evicted as the least recently used. */
+#define SIGNING_KEY_CACHE_MAX_ENTRIES 64
+#define SIGNING_KEY_CACHE_EXPIRATION_MS (24 * 60 * 60 * 1000)
+
+
+static void
+_destroy_secret_buffer (void *buf)
+{
+   _mongocrypt_buffer_cleanse ((_mongocrypt_buffer_t *) buf);
+   bson_free (buf);
+}
+
+
+static void
+_set_part (_mongocrypt_buffer_t *part, const char *str)
+{
+   _mongocrypt_buffer_init (part);
+   part->data = (uint8_t *) str;
+   part->len = (uint32_t) strlen (str) + 1;
+}
+
+
+bool
+_mongocrypt_cache_signing_key_attr (const char *access_key_id,
+                                    const _mongocrypt_buffer_t *secret_digest,
+                                    const char *date,
+                                    const char *region,
+                                    const char *service,
+                                    _mongocrypt_buffer_t *out)
+{
+   _mongocrypt_buffer_t parts[5];
+
+   _set_part (&parts[0], access_key_id);
+   _set_part (&parts[1], date);
+   _set_part (&parts[2], region);
+   _set_part (&parts[3], service);
+   parts[4] = *secret_digest;
+   return _mongocrypt_buffer_concat (out, parts, 5);
+}
+
+
+void
+_mongocrypt_cache_signing_key_init (_mongocrypt_cache_t *cache)
+{
+   _mongocrypt_cache_use_buffer_attr (cache);
+   _mongocrypt_cache_use_buffer_value (cache);
+   cache->destroy_attr = _destroy_secret_buffer;
+   cache->destroy_value = _destroy_secret_buffer;
+   _mongocrypt_cache_init (cache);
+   _mongocrypt_cache_set_limits (cache, SIGNING_KEY_CACHE_MAX_ENTRIES, 0);
+   _mongocrypt_cache_set_expiration (cache, SIGNING_KEY_CACHE_EXPIRATION_MS);
+}
@@ -16,111 +16,456 @@
 
 #include "mongocrypt-cache-private.h"
 
+#include "mongocrypt-atomic-private.h"
 #include "mongocrypt-private.h"
 
 
-/* Did the cache pair expire? Caller must hold lock. */
+/* Finalization mix of MurmurHash3, spreads entropy to all bits. */
+static uint32_t
+_mix32 (uint32_t h)
+{
+   h ^= h >> 16;
+   h *= 0x85ebca6b;
+   h ^= h >> 13;
+   h *= 0xc2b2ae35;
+   h ^= h >> 16;
+   return h;
+}
+
+
+/* FNV-1a over the bytes followed by a final mix. */
+uint32_t
+_mongocrypt_cache_hash_bytes (const uint8_t *data, uint32_t len)
+{
+   uint32_t h = 2166136261u;
+   uint32_t i;
+
+   for (i = 0; i < len; i++) {
+      h ^= data[i];
+      h *= 16777619u;
+   }
+   return _mix32 (h);
+}
+
+
 static bool
-_pair_expired (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+_buffer_cmp (void *a, void *b, int *out)
 {
-   int64_t current;
+   *out = _mongocrypt_buffer_cmp ((_mongocrypt_buffer_t *) a,
+                                  (_mongocrypt_buffer_t *) b);
+   return true;
+}
 
-   current = bson_get_monotonic_time () / 1000;
-   return (current - pair->last_updated) > (int64_t) cache->expiration;
+
+static bool
+_buffer_hash (void *attr, uint32_t *out)
+{
+   _mongocrypt_buffer_t *buf = (_mongocrypt_buffer_t *) attr;
+
+   *out = _mongocrypt_cache_hash_bytes (buf->data, buf->len);
+   return true;
 }
 
 
-/* Return the pair after the one being destroyed. */
-static _mongocrypt_cache_pair_t *
-_destroy_pair (_mongocrypt_cache_t *cache,
-               _mongocrypt_cache_pair_t *prev,
-               _mongocrypt_cache_pair_t *pair)
+static void *
+_buffer_copy (void *buf)
 {
-   _mongocrypt_cache_pair_t *tmp;
-   tmp = pair->next;
+   _mongocrypt_buffer_t *copy;
 
-   /* Unlink */
-   if (!prev) {
-      cache->pair = cache->pair->next;
-   } else {
-      prev->next = pair->next;
+   copy = bson_malloc0 (sizeof (_mongocrypt_buffer_t));
+   BSON_ASSERT (copy);
+   _mongocrypt_buffer_copy_to ((_mongocrypt_buffer_t *) buf, copy);
+   return copy;
+}
+
+
+static void
+_buffer_destroy (void *buf)
+{
+   _mongocrypt_buffer_cleanup ((_mongocrypt_buffer_t *) buf);
+   bson_free (buf);
+}
+
+
+static uint32_t
+_buffer_size (void *buf)
+{
+   return ((_mongocrypt_buffer_t *) buf)->len;
+}
+
+
+void
+_mongocrypt_cache_use_buffer_attr (_mongocrypt_cache_t *cache)
+{
+   cache->cmp_attr = _buffer_cmp;
+   cache->hash_attr = _buffer_hash;
+   cache->copy_attr = _buffer_copy;
+   cache->destroy_attr = _buffer_destroy;
+}
+
+
+void
+_mongocrypt_cache_use_buffer_value (_mongocrypt_cache_t *cache)
+{
+   cache->copy_value = _buffer_copy;
+   cache->destroy_value = _buffer_destroy;
+   cache->size_value = _buffer_size;
+}
+
+
+static _mongocrypt_cache_shard_t *
+_shard_for (_mongocrypt_cache_t *cache, uint32_t hash)
+{
+   return &cache->shards[hash & (CACHE_NUM_SHARDS - 1)];
+}
+
+
+/* The low bits select the shard, so use the remaining bits for the bucket. */
+static _mongocrypt_cache_pair_t **
+_bucket_for (_mongocrypt_cache_shard_t *shard, uint32_t hash)
+{
+   return &shard->buckets[(hash / CACHE_NUM_SHARDS) &
+                          (shard->num_buckets - 1)];
+}
+
+
+/* Lock every shard. Shards are always locked in index order. */
+static void
+_lock_all (_mongocrypt_cache_t *cache)
+{
+   int i;
+
+   for (i = 0; i < CACHE_NUM_SHARDS; i++) {
+      _mongocrypt_mutex_lock (&cache->shards[i].mutex);
    }
+}
+
+
+static void
+_unlock_all (_mongocrypt_cache_t *cache)
+{
+   int i;
+
+   for (i = CACHE_NUM_SHARDS - 1; i >= 0; i--) {
+      _mongocrypt_mutex_unlock (&cache->shards[i].mutex);
+   }
+}
+
 
-   /* Destroy pair */
+void
+_mongocrypt_cache_init (_mongocrypt_cache_t *cache)
+{
+   int i;
+
+   BSON_ASSERT (cache->hash_attr);
+   for (i = 0; i < CACHE_NUM_SHARDS; i++) {
+      _mongocrypt_cache_shard_t *shard = &cache->shards[i];
+
+      _mongocrypt_mutex_init (&shard->mutex);
+      shard->num_buckets = CACHE_INITIAL_BUCKETS;
+      shard->buckets =
+         bson_malloc0 (shard->num_buckets * sizeof (*shard->buckets));
+      BSON_ASSERT (shard->buckets);
+      shard->num_entries = 0;
+      shard->oldest = NULL;
+      shard->newest = NULL;
+      shard->least_recent = NULL;
+      shard->most_recent = NULL;
+   }
+   cache->expiration = CACHE_EXPIRATION_MS;
+   cache->refresh_ahead = 0;
+   cache->max_entries = 0;
+   cache->max_bytes = 0;
+   _mongocrypt_mutex_init (&cache->count_mutex);
+   cache->num_entries = 0;
+   cache->num_bytes = 0;
+   cache->use_count = 0;
+}
+
+
+/* Add to the totals of the cache. Caller must hold a shard lock. */
+static void
+_count_add (_mongocrypt_cache_t *cache, int32_t entries, int64_t bytes)
+{
+   _mongocrypt_mutex_lock (&cache->count_mutex);
+   cache->num_entries += (uint32_t) entries;
+   cache->num_bytes += (uint64_t) bytes;
+   _mongocrypt_mutex_unlock (&cache->count_mutex);
+}
+
+
+/* Does the cache exceed one of its limits? Caller must hold a shard lock. */
+static bool
+_over_limits (_mongocrypt_cache_t *cache)
+{
+   bool over = false;
+
+   _mongocrypt_mutex_lock (&cache->count_mutex);
+   if (cache->max_entries && cache->num_entries > cache->max_entries) {
+      over = true;
+   }
+   if (cache->max_bytes && cache->num_bytes > cache->max_bytes) {
+      over = true;
+   }
+   _mongocrypt_mutex_unlock (&cache->count_mutex);
+   return over;
+}
+
+
+/* Did the cache pair expire as of @current (in milliseconds)? Caller must hold
+ * lock. */
+static bool
+_pair_expired (_mongocrypt_cache_t *cache,
+               _mongocrypt_cache_pair_t *pair,
+               int64_t current)
+{
+   return (current - pair->last_updated) > (int64_t) cache->expiration;
+}
+
+
+/* Caller must hold lock. */
+static void
+_cache_pair_destroy (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+{
    cache->destroy_attr (pair->attr);
    cache->destroy_value (pair->value);
    bson_free (pair);
+}
+
 
-   return tmp;
+/* Append a pair to the newest end of the expiration list. Pairs are appended
+ * when added, so the list is ordered by last_updated. Caller must hold the
+ * shard lock. */
+static void
+_expiry_append (_mongocrypt_cache_shard_t *shard,
+                _mongocrypt_cache_pair_t *pair)
+{
+   pair->newer = NULL;
+   pair->older = shard->newest;
+   if (shard->newest) {
+      shard->newest->newer = pair;
+   } else {
+      shard->oldest = pair;
+   }
+   shard->newest = pair;
 }
 
-/* Caller must hold mutex. */
-void
-_mongocrypt_cache_evict (_mongocrypt_cache_t *cache)
+
+/* Caller must hold the shard lock. */
+static void
+_expiry_unlink (_mongocrypt_cache_shard_t *shard,
+                _mongocrypt_cache_pair_t *pair)
 {
-   _mongocrypt_cache_pair_t *pair, *prev;
+   if (pair->older) {
+      pair->older->newer = pair->newer;
+   } else {
+      shard->oldest = pair->newer;
+   }
+   if (pair->newer) {
+      pair->newer->older = pair->older;
+   } else {
+      shard->newest = pair->older;
+   }
+   pair->older = NULL;
+   pair->newer = NULL;
+}
 
-   prev = NULL;
-   pair = cache->pair;
-   while (pair) {
-      if (_pair_expired (cache, pair)) {
-         pair = _destroy_pair (cache, prev, pair);
-         continue;
+
+/* Append a pair to the most recent end of the LRU list. Caller must hold the
+ * shard lock. */
+static void
+_lru_append (_mongocrypt_cache_shard_t *shard, _mongocrypt_cache_pair_t *pair)
+{
+   pair->more_recent = NULL;
+   pair->less_recent = shard->most_recent;
+   if (shard->most_recent) {
+      shard->most_recent->more_recent = pair;
+   } else {
+      shard->least_recent = pair;
+   }
+   shard->most_recent = pair;
+}
+
+
+/* Caller must hold the shard lock. */
+static void
+_lru_unlink (_mongocrypt_cache_shard_t *shard, _mongocrypt_cache_pair_t *pair)
+{
+   if (pair->less_recent) {
+      pair->less_recent->more_recent = pair->more_recent;
+   } else {
+      shard->least_recent = pair->more_recent;
+   }
+   if (pair->more_recent) {
+      pair->more_recent->less_recent = pair->less_recent;
+   } else {
+      shard->most_recent = pair->less_recent;
+   }
+   pair->less_recent = NULL;
+   pair->more_recent = NULL;
+}
+
+
+/* Mark a pair as most recently used. Caller must hold the shard lock. */
+static void
+_lru_touch (_mongocrypt_cache_shard_t *shard, _mongocrypt_cache_pair_t *pair)
+{
+   if (shard->most_recent == pair) {
+      return;
+   }
+   _lru_unlink (shard, pair);
+   _lru_append (shard, pair);
+}
+
+
+/* Unlink the pair pointed to by @link and destroy it. Caller must hold the
+ * shard lock. */
+static void
+_unlink_and_destroy (_mongocrypt_cache_t *cache,
+                     _mongocrypt_cache_shard_t *shard,
+                     _mongocrypt_cache_pair_t **link)
+{
+   _mongocrypt_cache_pair_t *pair;
+
+   pair = *link;
+   *link = pair->next;
+   _expiry_unlink (shard, pair);
+   _lru_unlink (shard, pair);
+   shard->num_entries--;
+   _count_add (cache, -1, -(int64_t) pair->size);
+   _cache_pair_destroy (cache, pair);
+}
+
+
+/* Remove a pair from its bucket and destroy it. Caller must hold the shard
+ * lock. */
+static void
+_remove_pair (_mongocrypt_cache_t *cache,
+              _mongocrypt_cache_shard_t *shard,
+              _mongocrypt_cache_pair_t *pair)
+{
+   _mongocrypt_cache_pair_t **link;
+
+   /* Find the link to the pair in its bucket. */
+   link = _bucket_for (shard, pair->hash);
+   while (*link != pair) {
+      link = &(*link)->next;
+   }
+   _unlink_and_destroy (cache, shard, link);
+}
+
+
+/* Evict expired pairs. Since every pair shares the same expiration, the
+ * expired pairs are at the oldest end of the expiration list, and eviction
+ * stops at the first unexpired pair. Caller must hold shard lock. */
+static void
+_evict_shard (_mongocrypt_cache_t *cache, _mongocrypt_cache_shard_t *shard)
+{
+   int64_t current;
+
+   current = bson_get_monotonic_time () / 1000;
+   while (shard->oldest && _pair_expired (cache, shard->oldest, current)) {
+      _remove_pair (cache, shard, shard->oldest);
+   }
+}
+
+
+/* Evict the least recently used pairs of the whole cache until it is within
+ * its limits. Expired pairs of every shard are evicted first, since shards are
+ * otherwise only swept when accessed. The most recently added pair @keep is
+ * never evicted. @keep is only compared, never dereferenced, since another
+ * thread may have evicted it. Caller must hold every shard lock. */
+static void
+_enforce_limits (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *keep)
+{
+   int i;
+
+   if (!_over_limits (cache)) {
+      return;
+   }
+   for (i = 0; i < CACHE_NUM_SHARDS; i++) {
+      _evict_shard (cache, &cache->shards[i]);
+   }
+
+   while (_over_limits (cache)) {
+      _mongocrypt_cache_shard_t *victim_shard = NULL;
+      _mongocrypt_cache_pair_t *victim = NULL;
+
+      /* Each shard's least recently used pair is a candidate. */
+      for (i = 0; i < CACHE_NUM_SHARDS; i++) {
+         _mongocrypt_cache_shard_t *shard = &cache->shards[i];
+         _mongocrypt_cache_pair_t *candidate = shard->least_recent;
+
+         if (candidate == keep) {
+            candidate = candidate->more_recent;
+         }
+         if (candidate &&
+             (!victim || candidate->last_used < victim->last_used)) {
+            victim = candidate;
+            victim_shard = shard;
+         }
       }
-      prev = pair;
-      pair = pair->next;
+
+      if (!victim) {
+         break;
+      }
+      _remove_pair (cache, victim_shard, victim);
    }
 }
 
-/* Caller must hold mutex. */
+
+/* Remove all pairs in a bucket matching @attr. If @hashed is true, only pairs
+ * with an equal hash can match. Caller must hold shard lock. */
 static bool
-_mongocrypt_remove_matches (_mongocrypt_cache_t *cache, void *attr)
+_remove_matches_in_bucket (_mongocrypt_cache_t *cache,
+                           _mongocrypt_cache_shard_t *shard,
+                           _mongocrypt_cache_pair_t **link,
+                           void *attr,
+                           bool hashed,
+                           uint32_t hash)
 {
-   _mongocrypt_cache_pair_t *pair, *prev;
-
-   prev = NULL;
-   pair = cache->pair;
-   while (pair) {
+   while (*link) {
       int res;
 
-      if (!cache->cmp_attr (pair->attr, attr, &res)) {
+      if (hashed && (*link)->hash != hash) {
+         link = &(*link)->next;
+         continue;
+      }
+
+      if (!cache->cmp_attr ((*link)->attr, attr, &res)) {
          return false;
       }
 
       if (0 == res) {
-         pair = _destroy_pair (cache, prev, pair);
+         _unlink_and_destroy (cache, shard, link);
          continue;
       }
-      prev = pair;
-      pair = pair->next;
+      link = &(*link)->next;
    }
 
    return true;
 }
 
 
-void
-_mongocrypt_cache_set_expiration (_mongocrypt_cache_t *cache, uint64_t milli)
-{
-   cache->expiration = milli;
-}
-
-
-/* caller must hold lock. */
+/* Find the first pair in a bucket matching @attr. If @hashed is true, only
+ * pairs with an equal hash can match. Caller must hold shard lock. */
 static bool
-_find_pair (_mongocrypt_cache_t *cache,
-            void *attr,
-            _mongocrypt_cache_pair_t **out)
+_find_in_bucket (_mongocrypt_cache_t *cache,
+                 _mongocrypt_cache_pair_t *pair,
+                 void *attr,
+                 bool hashed,
+                 uint32_t hash,
+                 _mongocrypt_cache_pair_t **out)
 {
-   _mongocrypt_cache_pair_t *pair;
-
    *out = NULL;
 
-   pair = cache->pair;
-   while (pair) {
+   for (; pair != NULL; pair = pair->next) {
       int res;
-      /* TODO: this is a naive O(n) lookup. Consider optimizing
-         with a hash map (possibly vendor one). */
+
+      if (hashed && pair->hash != hash) {
+         continue;
+      }
+
       if (!cache->cmp_attr (pair->attr, attr, &res)) {
          return false;
       }
@@ -129,66 +474,249 @@ _find_pair (_mongocrypt_cache_t *cache,
          *out = pair;
          return true;
       }
-      pair = pair->next;
    }
    return true;
 }
 
 
-/* Create a new pair on linked list. Caller must hold lock. */
+/* Find the first pair in a shard matching @attr. Caller must hold shard
+ * lock. */
+static bool
+_find_in_shard (_mongocrypt_cache_t *cache,
+                _mongocrypt_cache_shard_t *shard,
+                void *attr,
+                _mongocrypt_cache_pair_t **out)
+{
+   uint32_t i;
+
+   *out = NULL;
+   for (i = 0; i < shard->num_buckets; i++) {
+      if (!_find_in_bucket (
+             cache, shard->buckets[i], attr, false /* hashed */, 0, out)) {
+         return false;
+      }
+      if (*out) {
+         return true;
+      }
+   }
+   return true;
+}
+
+
+/* Double the number of buckets of a shard. Caller must hold shard lock. */
+static void
+_grow_shard (_mongocrypt_cache_shard_t *shard)
+{
+   _mongocrypt_cache_pair_t **old_buckets;
+   uint32_t old_num_buckets;
+   uint32_t i;
+
+   old_buckets = shard->buckets;
+   old_num_buckets = shard->num_buckets;
+
+   shard->num_buckets = old_num_buckets * 2;
+   shard->buckets =
+      bson_malloc0 (shard->num_buckets * sizeof (*shard->buckets));
+   BSON_ASSERT (shard->buckets);
+
+   for (i = 0; i < old_num_buckets; i++) {
+      _mongocrypt_cache_pair_t *pair, *next;
+
+      for (pair = old_buckets[i]; pair != NULL; pair = next) {
+         _mongocrypt_cache_pair_t **bucket;
+
+         next = pair->next;
+         bucket = _bucket_for (shard, pair->hash);
+         pair->next = *bucket;
+         *bucket = pair;
+      }
+   }
+   bson_free (old_buckets);
+}
+
+
+/* Create a new pair in the shard. Caller must hold shard lock. */
 static _mongocrypt_cache_pair_t *
-_pair_new (_mongocrypt_cache_t *cache, void *attr)
+_pair_new (_mongocrypt_cache_t *cache,
+           _mongocrypt_cache_shard_t *shard,
+           void *attr,
+           uint32_t hash)
 {
    _mongocrypt_cache_pair_t *pair;
+   _mongocrypt_cache_pair_t **bucket;
+
+   if (shard->num_entries >= shard->num_buckets &&
+       shard->num_buckets < UINT32_MAX / 2) {
+      _grow_shard (shard);
+   }
 
    pair = bson_malloc0 (sizeof (_mongocrypt_cache_pair_t));
    BSON_ASSERT (pair);
 
    pair->attr = cache->copy_attr (attr);
+   pair->hash = hash;
    /* add rest of values. */
-   pair->next = cache->pair;
    pair->last_updated = bson_get_monotonic_time () / 1000;
-   cache->pair = pair;
+   bucket = _bucket_for (shard, hash);
+   pair->next = *bucket;
+   *bucket = pair;
+   _expiry_append (shard, pair);
+   _lru_append (shard, pair);
+   pair->last_used = _mongocrypt_atomic_int64_add (&cache->use_count, 1);
+   shard->num_entries++;
+   _count_add (cache, 1, 0);
    return pair;
 }
 
 
-/* Caller must hold lock. */
+void
+_mongocrypt_cache_set_expiration (_mongocrypt_cache_t *cache, uint64_t milli)
+{
+   /* Ages are signed, so larger values would compare as negative. */
+   cache->expiration = BSON_MIN (milli, (uint64_t) INT64_MAX);
+}
+
+
+void
+_mongocrypt_cache_set_refresh_ahead (_mongocrypt_cache_t *cache,
+                                     uint64_t milli)
+{
+   cache->refresh_ahead = BSON_MIN (milli, (uint64_t) INT64_MAX);
+}
+
+
+void
+_mongocrypt_cache_set_limits (_mongocrypt_cache_t *cache,
+                              uint32_t max_entries,
+                              uint64_t max_bytes)
+{
+   cache->max_entries = max_entries;
+   cache->max_bytes = max_bytes;
+}
+
+
+/* Mark a matched pair as most recently used and copy its value out. If
+ * @refresh is non-NULL, claim the pair for refresh if it is within the
+ * refresh-ahead window and nobody has claimed it yet. If @value is NULL,
+ * release the refresh claim on the pair instead. Caller must hold the shard
+ * lock. */
 static void
-_cache_pair_destroy (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+_use_match (_mongocrypt_cache_t *cache,
+            _mongocrypt_cache_shard_t *shard,
+            _mongocrypt_cache_pair_t *match,
+            void **value,
+            bool *refresh)
 {
-   cache->destroy_attr (pair->attr);
-   cache->destroy_value (pair->value);
-   bson_free (pair);
+   if (!value) {
+      match->refresh_claimed = false;
+      return;
+   }
+   _lru_touch (shard, match);
+   match->last_used = _mongocrypt_atomic_int64_add (&cache->use_count, 1);
+   *value = cache->copy_value (match->value);
+   if (refresh && cache->refresh_ahead && !match->refresh_claimed) {
+      int64_t age;
+
+      /* Compare the age rather than adding to last_updated, which could
+       * overflow. Both settings are at most INT64_MAX. */
+      age = bson_get_monotonic_time () / 1000 - match->last_updated;
+      if (age >=
+          (int64_t) cache->expiration - (int64_t) cache->refresh_ahead) {
+         match->refresh_claimed = true;
+         *refresh = true;
+      }
+   }
 }
 
 
-bool
-_mongocrypt_cache_get (_mongocrypt_cache_t *cache,
-                       void *attr, /* attr of cache item */
-                       void **value /* copied to. */)
+static bool
+_cache_get (_mongocrypt_cache_t *cache,
+            void *attr,
+            void **value,
+            bool *refresh)
 {
+   _mongocrypt_cache_shard_t *shard;
    _mongocrypt_cache_pair_t *match;
+   uint32_t hash;
+   int i;
 
-   *value = NULL;
+   if (value) {
+      *value = NULL;
+   }
+   if (refresh) {
+      *refresh = false;
+   }
 
-   _mongocrypt_mutex_lock (&cache->mutex);
-   /* TODO CDRIVER-3120: optimize the eviction algorithm to avoid unnecessary
-    * O(n) traversal */
-   _mongocrypt_cache_evict (cache);
-   if (!_find_pair (cache, attr, &match)) {
-      _mongocrypt_mutex_unlock (&cache->mutex);
-      return false;
+   if (cache->hash_attr (attr, &hash)) {
+      /* Only pairs in the bucket for this hash can match. */
+      shard = _shard_for (cache, hash);
+      _mongocrypt_mutex_lock (&shard->mutex);
+      _evict_shard (cache, shard);
+      if (!_find_in_bucket (cache,
+                            *_bucket_for (shard, hash),
+                            attr,
+                            true /* hashed */,
+                            hash,
+                            &match)) {
+         _mongocrypt_mutex_unlock (&shard->mutex);
+         return false;
+      }
+
+      if (match) {
+         _use_match (cache, shard, match, value, refresh);
+      }
+      _mongocrypt_mutex_unlock (&shard->mutex);
+      return true;
    }
 
-   if (match) {
-      *value = cache->copy_value (match->value);
+   /* The attribute may match a pair in any shard. */
+   for (i = 0; i < CACHE_NUM_SHARDS; i++) {
+      shard = &cache->shards[i];
+      _mongocrypt_mutex_lock (&shard->mutex);
+      _evict_shard (cache, shard);
+      if (!_find_in_shard (cache, shard, attr, &match)) {
+         _mongocrypt_mutex_unlock (&shard->mutex);
+         return false;
+      }
+
+      if (match) {
+         _use_match (cache, shard, match, value, refresh);
+         _mongocrypt_mutex_unlock (&shard->mutex);
+         return true;
+      }
+      _mongocrypt_mutex_unlock (&shard->mutex);
    }
-   _mongocrypt_mutex_unlock (&cache->mutex);
    return true;
 }
 
 
+bool
+_mongocrypt_cache_get (_mongocrypt_cache_t *cache,
+                       void *attr, /* attr of cache item */
+                       void **value /* copied to. */)
+{
+   return _cache_get (cache, attr, value, NULL);
+}
+
+
+bool
+_mongocrypt_cache_get_refresh_ahead (_mongocrypt_cache_t *cache,
+                                     void *attr,
+                                     void **value,
+                                     bool *refresh)
+{
+   BSON_ASSERT (refresh);
+   return _cache_get (cache, attr, value, refresh);
+}
+
+
+bool
+_mongocrypt_cache_release_refresh (_mongocrypt_cache_t *cache, void *attr)
+{
+   return _cache_get (cache, attr, NULL, NULL);
+}
+
+
 static bool
 _cache_add (_mongocrypt_cache_t *cache,
             void *attr,
@@ -196,24 +724,81 @@ _cache_add (_mongocrypt_cache_t *cache,
             mongocrypt_status_t *status,
             bool steal_value)
 {
+   _mongocrypt_cache_shard_t *shard;
    _mongocrypt_cache_pair_t *pair;
-
-   _mongocrypt_mutex_lock (&cache->mutex);
-   _mongocrypt_cache_evict (cache);
-   if (!_mongocrypt_remove_matches (cache, attr)) {
-      CLIENT_ERR ("error removing from cache");
-      _mongocrypt_mutex_unlock (&cache->mutex);
-      return false;
+   uint32_t hash;
+   uint32_t i;
+   bool hashed;
+   int j;
+
+   hashed = cache->hash_attr (attr, &hash);
+   if (hashed) {
+      /* Only pairs in the bucket for this hash can match. */
+      shard = _shard_for (cache, hash);
+      _mongocrypt_mutex_lock (&shard->mutex);
+      _evict_shard (cache, shard);
+      if (!_remove_matches_in_bucket (cache,
+                                      shard,
+                                      _bucket_for (shard, hash),
+                                      attr,
+                                      true /* hashed */,
+                                      hash)) {
+         CLIENT_ERR ("error removing from cache");
+         _mongocrypt_mutex_unlock (&shard->mutex);
+         return false;
+      }
+   } else {
+      /* The attribute may match pairs in any shard. Hold every lock so the
+       * removal and insertion are atomic. */
+      _lock_all (cache);
+      for (j = 0; j < CACHE_NUM_SHARDS; j++) {
+         _mongocrypt_cache_shard_t *other = &cache->shards[j];
+
+         _evict_shard (cache, other);
+         for (i = 0; i < other->num_buckets; i++) {
+            if (!_remove_matches_in_bucket (cache,
+                                            other,
+                                            &other->buckets[i],
+                                            attr,
+                                            false /* hashed */,
+                                            0)) {
+               CLIENT_ERR ("error removing from cache");
+               _unlock_all (cache);
+               return false;
+            }
+         }
+      }
+      shard = _shard_for (cache, hash);
    }
 
-   pair = _pair_new (cache, attr);
+   pair = _pair_new (cache, shard, attr, hash);
 
    if (steal_value) {
       pair->value = value;
    } else {
       pair->value = cache->copy_value (value);
    }
-   _mongocrypt_mutex_unlock (&cache->mutex);
+
+   if (cache->size_value) {
+      pair->size = cache->size_value (pair->value);
+      _count_add (cache, 0, (int64_t) pair->size);
+   }
+
+   if (hashed) {
+      bool over;
+
+      over = _over_limits (cache);
+      _mongocrypt_mutex_unlock (&shard->mutex);
+      if (over) {
+         /* The least recently used pairs may be in any shard. */
+         _lock_all (cache);
+         _enforce_limits (cache, pair);
+         _unlock_all (cache);
+      }
+   } else {
+      _enforce_limits (cache, pair);
+      _unlock_all (cache);
+   }
    return true;
 }
 
@@ -241,13 +826,33 @@ void
 _mongocrypt_cache_cleanup (_mongocrypt_cache_t *cache)
 {
    _mongocrypt_cache_pair_t *pair, *tmp;
-
-   pair = cache->pair;
-   while (pair) {
-      tmp = pair->next;
-      _cache_pair_destroy (cache, pair);
-      pair = tmp;
+   uint32_t i;
+   int j;
+
+   for (j = 0; j < CACHE_NUM_SHARDS; j++) {
+      _mongocrypt_cache_shard_t *shard = &cache->shards[j];
+
+      for (i = 0; i < shard->num_buckets; i++) {
+         pair = shard->buckets[i];
+         while (pair) {
+            tmp = pair->next;
+            _cache_pair_destroy (cache, pair);
+            pair = tmp;
+         }
+      }
+      bson_free (shard->buckets);
+      shard->buckets = NULL;
+      shard->num_buckets = 0;
+      shard->num_entries = 0;
+      shard->oldest = NULL;
+      shard->newest = NULL;
+      shard->least_recent = NULL;
+      shard->most_recent = NULL;
+      _mongocrypt_mutex_cleanup (&shard->mutex);
    }
+   cache->num_entries = 0;
+   cache->num_bytes = 0;
+   _mongocrypt_mutex_cleanup (&cache->count_mutex);
 }
 
 /* Print the contents of the cache (for debugging purposes) */
@@ -256,34 +861,61 @@ _mongocrypt_cache_dump (_mongocrypt_cache_t *cache)
 {
    _mongocrypt_cache_pair_t *pair;
    int count;
+   uint32_t i;
+   int j;
 
-   _mongocrypt_mutex_lock (&cache->mutex);
+   _lock_all (cache);
    count = 0;
-   for (pair = cache->pair; pair != NULL; pair = pair->next) {
-      printf ("entry:%d last_updated:%d\n", count, (int) pair->last_updated);
-      if (cache->dump_attr) {
-         printf ("- attr:");
-         cache->dump_attr (pair->attr);
+   for (j = 0; j < CACHE_NUM_SHARDS; j++) {
+      _mongocrypt_cache_shard_t *shard = &cache->shards[j];
+
+      for (i = 0; i < shard->num_buckets; i++) {
+         for (pair = shard->buckets[i]; pair != NULL; pair = pair->next) {
+            printf ("entry:%d shard:%d last_updated:%d\n",
+                    count,
+                    j,
+                    (int) pair->last_updated);
+            if (cache->dump_attr) {
+               printf ("- attr:");
+               cache->dump_attr (pair->attr);
+            }
+            count++;
+         }
       }
-      count++;
    }
 
-   _mongocrypt_mutex_unlock (&cache->mutex);
+   _unlock_all (cache);
+}
+
+
+void
+_mongocrypt_cache_clear (_mongocrypt_cache_t *cache)
+{
+   int j;
+
+   for (j = 0; j < CACHE_NUM_SHARDS; j++) {
+      _mongocrypt_cache_shard_t *shard = &cache->shards[j];
+
+      _mongocrypt_mutex_lock (&shard->mutex);
+      while (shard->least_recent) {
+         _remove_pair (cache, shard, shard->least_recent);
+      }
+      _mongocrypt_mutex_unlock (&shard->mutex);
+   }
 }
 
 
 uint32_t
 _mongocrypt_cache_num_entries (_mongocrypt_cache_t *cache)
 {
-   _mongocrypt_cache_pair_t *pair;
    uint32_t count;
+   int j;
 
-   _mongocrypt_mutex_lock (&cache->mutex);
    count = 0;
-   for (pair = cache->pair; pair != NULL; pair = pair->next) {
-      count++;
+   for (j = 0; j < CACHE_NUM_SHARDS; j++) {
+      _mongocrypt_mutex_lock (&cache->shards[j].mutex);
+      count += cache->shards[j].num_entries;
+      _mongocrypt_mutex_unlock (&cache->shards[j].mutex);
    }
-
-   _mongocrypt_mutex_unlock (&cache->mutex);
    return count;
-}
\ No newline at end of file
+}
@@ -47,9 +47,11 @@ _mongocrypt_serialize_ciphertext (_mongocrypt_ciphertext_t *ciphertext,
                                   _mongocrypt_buffer_t *out)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* @arena may be NULL to allocate @out on the heap. */
 bool
 _mongocrypt_ciphertext_serialize_associated_data (
    _mongocrypt_ciphertext_t *ciphertext,
+   _mongocrypt_arena_t *arena,
    _mongocrypt_buffer_t *out) MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
@@ -155,7 +155,9 @@ A = Associated Data = fle_blob_subtype + key_uuid[16] + original_bson_type
 
 bool
 _mongocrypt_ciphertext_serialize_associated_data (
-   _mongocrypt_ciphertext_t *ciphertext, _mongocrypt_buffer_t *out)
+   _mongocrypt_ciphertext_t *ciphertext,
+   _mongocrypt_arena_t *arena,
+   _mongocrypt_buffer_t *out)
 {
    int32_t bytes_written;
 
@@ -179,11 +181,8 @@ _mongocrypt_ciphertext_serialize_associated_data (
       return false;
    }
 
-   out->len = 1 + ciphertext->key_id.len + 1;
-   out->data = bson_malloc (out->len);
-   BSON_ASSERT (out->data);
-
-   out->owned = true;
+   _mongocrypt_buffer_resize_in_arena (
+      out, arena, 1 + ciphertext->key_id.len + 1);
    memcpy (out->data, &ciphertext->blob_subtype, 1);
    bytes_written = 1;
    memcpy (out->data + bytes_written,
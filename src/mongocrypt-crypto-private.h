@@ -40,27 +40,53 @@ typedef struct {
    void *ctx;
 } _mongocrypt_crypto_t;
 
+/* A 96 byte data key whose AES key schedules and HMAC pads are set up once by
+ * the native crypto backend, rather than for every field. Defined by the
+ * backend. It is only read once prepared, so threads may share it. */
+typedef struct _mongocrypt_prepared_key_t _mongocrypt_prepared_key_t;
+
+/* The HMAC keys of a prepared key. */
+typedef enum {
+   MONGOCRYPT_PREPARED_MAC_KEY = 0,
+   MONGOCRYPT_PREPARED_IV_KEY = 1
+} _mongocrypt_prepared_hmac_key_t;
+
+/* Prepare the 96 byte data key @key. Returns NULL if crypto hooks are
+ * enabled, the native backend does not prepare keys, or on error. Operations
+ * then use @key directly. */
+_mongocrypt_prepared_key_t *
+_mongocrypt_prepare_key (_mongocrypt_crypto_t *crypto,
+                         const _mongocrypt_buffer_t *key);
+
+/* Cleanses and frees @prepared_key. @prepared_key may be NULL. */
+void
+_mongocrypt_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key);
+
 uint32_t
 _mongocrypt_calculate_ciphertext_len (uint32_t plaintext_len);
 
 uint32_t
 _mongocrypt_calculate_plaintext_len (uint32_t ciphertext_len);
 
+/* @prepared_key may be NULL. If set, it must be prepared from @key. */
 bool
 _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
                            const _mongocrypt_buffer_t *iv,
                            const _mongocrypt_buffer_t *associated_data,
                            const _mongocrypt_buffer_t *key,
+                           const _mongocrypt_prepared_key_t *prepared_key,
                            const _mongocrypt_buffer_t *plaintext,
                            _mongocrypt_buffer_t *ciphertext,
                            uint32_t *bytes_written,
                            mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* @prepared_key may be NULL. If set, it must be prepared from @key. */
 bool
 _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
                            const _mongocrypt_buffer_t *associated_data,
                            const _mongocrypt_buffer_t *key,
+                           const _mongocrypt_prepared_key_t *prepared_key,
                            const _mongocrypt_buffer_t *ciphertext,
                            _mongocrypt_buffer_t *plaintext,
                            uint32_t *bytes_written,
@@ -114,15 +140,26 @@ _mongocrypt_unwrap_key (_mongocrypt_crypto_t *crypto,
                         mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* @prepared_key may be NULL. If set, it must be prepared from @key. */
 bool
 _mongocrypt_calculate_deterministic_iv (
    _mongocrypt_crypto_t *crypto,
    const _mongocrypt_buffer_t *key,
+   const _mongocrypt_prepared_key_t *prepared_key,
    const _mongocrypt_buffer_t *plaintext,
    const _mongocrypt_buffer_t *associated_data,
    _mongocrypt_buffer_t *out,
    mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Set @out to a one-way digest of the NULL terminated @secret, to identify a
+ * secret without keeping a copy of it. */
+bool
+_mongocrypt_hash_secret (_mongocrypt_crypto_t *crypto,
+                         const char *secret,
+                         _mongocrypt_buffer_t *out,
+                         mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 /* Crypto implementations must implement these functions. */
 
 /* This variable must be defined in implementation
@@ -130,14 +167,23 @@ _mongocrypt_calculate_deterministic_iv (
    is successful. */
 extern bool _native_crypto_initialized;
 
+#ifdef MONGOCRYPT_ENABLE_CRYPTO_LIBCRYPTO
+/* True by default. Set to false to create crypto contexts per operation
+ * rather than reusing them on each thread. Only for benchmarks. */
+extern bool _native_crypto_reuse_contexts;
+#endif
+
 void
 _native_crypto_init ();
 
 
+/* Encrypt the concatenation of the @in_count buffers in @in without copying
+ * them together. Each buffer's length must be a multiple of the block size. */
 bool
 _native_crypto_aes_256_cbc_encrypt (const _mongocrypt_buffer_t *key,
                                     const _mongocrypt_buffer_t *iv,
                                     const _mongocrypt_buffer_t *in,
+                                    uint32_t in_count,
                                     _mongocrypt_buffer_t *out,
                                     uint32_t *bytes_written,
                                     mongocrypt_status_t *status)
@@ -152,9 +198,11 @@ _native_crypto_aes_256_cbc_decrypt (const _mongocrypt_buffer_t *key,
                                     mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Compute the HMAC of the concatenation of the @in_count buffers in @in. */
 bool
 _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              const _mongocrypt_buffer_t *in,
+                             uint32_t in_count,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
@@ -165,4 +213,40 @@ _native_crypto_random (_mongocrypt_buffer_t *out,
                        mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Returns NULL if the backend does not prepare keys, or on error. */
+_mongocrypt_prepared_key_t *
+_native_crypto_prepare_key (const _mongocrypt_buffer_t *key);
+
+void
+_native_crypto_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key);
+
+/* Like the functions above, with the keys of @prepared_key. */
+bool
+_native_crypto_aes_256_cbc_encrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
+bool
+_native_crypto_aes_256_cbc_decrypt_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *in,
+   _mongocrypt_buffer_t *out,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
+bool
+_native_crypto_hmac_sha_512_prepared (
+   const _mongocrypt_prepared_key_t *prepared_key,
+   _mongocrypt_prepared_hmac_key_t which,
+   const _mongocrypt_buffer_t *in,
+   uint32_t in_count,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
 #endif /* MONGOCRYPT_CRYPTO_PRIVATE_H */
@@ -27,16 +27,20 @@
 #include "mongocrypt-log-private.h"
 #include "mongocrypt-private.h"
 #include "mongocrypt-status-private.h"
+#include "mongocrypt-util-private.h"
 
 #include <inttypes.h>
 
 /* Crypto primitives. These either call the native built in crypto primitives or
- * user supplied hooks. */
+ * user supplied hooks. Encryption and HMAC take their input as @in_count
+ * buffers, which the native primitives process in place. User supplied hooks
+ * take a single input, so the buffers are concatenated for them. */
 static bool
 _crypto_aes_256_cbc_encrypt (_mongocrypt_crypto_t *crypto,
                              const _mongocrypt_buffer_t *enc_key,
                              const _mongocrypt_buffer_t *iv,
                              const _mongocrypt_buffer_t *in,
+                             uint32_t in_count,
                              _mongocrypt_buffer_t *out,
                              uint32_t *bytes_written,
                              mongocrypt_status_t *status)
@@ -53,8 +57,18 @@ _crypto_aes_256_cbc_encrypt (_mongocrypt_crypto_t *crypto,
 
    if (crypto->hooks_enabled) {
       mongocrypt_binary_t enc_key_bin, iv_bin, out_bin, in_bin;
+      _mongocrypt_buffer_t concatenated;
       bool ret;
 
+      _mongocrypt_buffer_init (&concatenated);
+      if (in_count > 1) {
+         if (!_mongocrypt_buffer_concat (&concatenated, in, in_count)) {
+            CLIENT_ERR ("failed to allocate buffer");
+            return false;
+         }
+         in = &concatenated;
+      }
+
       _mongocrypt_buffer_to_binary (enc_key, &enc_key_bin);
       _mongocrypt_buffer_to_binary (iv, &iv_bin);
       _mongocrypt_buffer_to_binary (out, &out_bin);
@@ -67,10 +81,11 @@ _crypto_aes_256_cbc_encrypt (_mongocrypt_crypto_t *crypto,
                                          &out_bin,
                                          bytes_written,
                                          status);
+      _mongocrypt_buffer_cleanup (&concatenated);
       return ret;
    }
    return _native_crypto_aes_256_cbc_encrypt (
-      enc_key, iv, in, out, bytes_written, status);
+      enc_key, iv, in, in_count, out, bytes_written, status);
 }
 
 
@@ -115,6 +130,7 @@ static bool
 _crypto_hmac_sha_512 (_mongocrypt_crypto_t *crypto,
                       const _mongocrypt_buffer_t *hmac_key,
                       const _mongocrypt_buffer_t *in,
+                      uint32_t in_count,
                       _mongocrypt_buffer_t *out,
                       mongocrypt_status_t *status)
 {
@@ -130,17 +146,53 @@ _crypto_hmac_sha_512 (_mongocrypt_crypto_t *crypto,
 
    if (crypto->hooks_enabled) {
       mongocrypt_binary_t hmac_key_bin, out_bin, in_bin;
+      _mongocrypt_buffer_t concatenated;
       bool ret;
 
+      _mongocrypt_buffer_init (&concatenated);
+      if (in_count > 1) {
+         if (!_mongocrypt_buffer_concat (&concatenated, in, in_count)) {
+            CLIENT_ERR ("failed to allocate buffer");
+            return false;
+         }
+         in = &concatenated;
+      }
+
       _mongocrypt_buffer_to_binary (hmac_key, &hmac_key_bin);
       _mongocrypt_buffer_to_binary (out, &out_bin);
       _mongocrypt_buffer_to_binary (in, &in_bin);
 
       ret = crypto->hmac_sha_512 (
          crypto->ctx, &hmac_key_bin, &in_bin, &out_bin, status);
+      _mongocrypt_buffer_cleanup (&concatenated);
       return ret;
    }
-   return _native_crypto_hmac_sha_512 (hmac_key, in, out, status);
+   return _native_crypto_hmac_sha_512 (hmac_key, in, in_count, out, status);
+}
+
+
+_mongocrypt_prepared_key_t *
+_mongocrypt_prepare_key (_mongocrypt_crypto_t *crypto,
+                         const _mongocrypt_buffer_t *key)
+{
+   BSON_ASSERT (crypto);
+   BSON_ASSERT (key);
+
+   /* Hooks are given raw keys. */
+   if (crypto->hooks_enabled || key->len != MONGOCRYPT_KEY_LEN) {
+      return NULL;
+   }
+   return _native_crypto_prepare_key (key);
+}
+
+
+void
+_mongocrypt_prepared_key_destroy (_mongocrypt_prepared_key_t *prepared_key)
+{
+   if (!prepared_key) {
+      return;
+   }
+   _native_crypto_prepared_key_destroy (prepared_key);
 }
 
 
@@ -264,6 +316,7 @@ static bool
 _encrypt_step (_mongocrypt_crypto_t *crypto,
                const _mongocrypt_buffer_t *iv,
                const _mongocrypt_buffer_t *enc_key,
+               const _mongocrypt_prepared_key_t *prepared_key,
                const _mongocrypt_buffer_t *plaintext,
                _mongocrypt_buffer_t *ciphertext,
                uint32_t *bytes_written,
@@ -272,12 +325,9 @@ _encrypt_step (_mongocrypt_crypto_t *crypto,
    uint32_t unaligned;
    uint32_t padding_byte;
    _mongocrypt_buffer_t intermediates[2];
-   _mongocrypt_buffer_t to_encrypt;
    uint8_t final_block_storage[MONGOCRYPT_BLOCK_SIZE];
    bool ret = false;
 
-   _mongocrypt_buffer_init (&to_encrypt);
-
    BSON_ASSERT (bytes_written);
    *bytes_written = 0;
 
@@ -326,18 +376,24 @@ _encrypt_step (_mongocrypt_crypto_t *crypto,
       memset (intermediates[1].data, padding_byte, padding_byte);
    }
 
-   if (!_mongocrypt_buffer_concat (&to_encrypt, intermediates, 2)) {
-      CLIENT_ERR ("failed to allocate buffer");
-      goto done;
-   }
-
-   if (!_crypto_aes_256_cbc_encrypt (crypto,
-                                     enc_key,
-                                     iv,
-                                     &to_encrypt,
-                                     ciphertext,
-                                     bytes_written,
-                                     status)) {
+   if (prepared_key) {
+      if (!_native_crypto_aes_256_cbc_encrypt_prepared (prepared_key,
+                                                        iv,
+                                                        intermediates,
+                                                        2,
+                                                        ciphertext,
+                                                        bytes_written,
+                                                        status)) {
+         goto done;
+      }
+   } else if (!_crypto_aes_256_cbc_encrypt (crypto,
+                                            enc_key,
+                                            iv,
+                                            intermediates,
+                                            2,
+                                            ciphertext,
+                                            bytes_written,
+                                            status)) {
       goto done;
    }
 
@@ -351,7 +407,6 @@ _encrypt_step (_mongocrypt_crypto_t *crypto,
 
    ret = true;
 done:
-   _mongocrypt_buffer_cleanup (&to_encrypt);
    return ret;
 }
 
@@ -384,20 +439,18 @@ done:
 static bool
 _hmac_step (_mongocrypt_crypto_t *crypto,
             const _mongocrypt_buffer_t *mac_key,
+            const _mongocrypt_prepared_key_t *prepared_key,
             const _mongocrypt_buffer_t *associated_data,
             const _mongocrypt_buffer_t *ciphertext,
             _mongocrypt_buffer_t *out,
             mongocrypt_status_t *status)
 {
    _mongocrypt_buffer_t intermediates[3];
-   _mongocrypt_buffer_t to_hmac;
    uint64_t associated_data_len_be;
    uint8_t tag_storage[64];
    _mongocrypt_buffer_t tag;
    bool ret = false;
 
-   _mongocrypt_buffer_init (&to_hmac);
-
    if (MONGOCRYPT_MAC_KEY_LEN != mac_key->len) {
       CLIENT_ERR ("HMAC key wrong length: %d", mac_key->len);
       goto done;
@@ -437,12 +490,17 @@ _hmac_step (_mongocrypt_crypto_t *crypto,
    tag.data = tag_storage;
    tag.len = sizeof (tag_storage);
 
-
-   if (!_mongocrypt_buffer_concat (&to_hmac, intermediates, 3)) {
-      CLIENT_ERR ("failed to allocate buffer");
-      goto done;
-   }
-   if (!_crypto_hmac_sha_512 (crypto, mac_key, &to_hmac, &tag, status)) {
+   if (prepared_key) {
+      if (!_native_crypto_hmac_sha_512_prepared (prepared_key,
+                                                 MONGOCRYPT_PREPARED_MAC_KEY,
+                                                 intermediates,
+                                                 3,
+                                                 &tag,
+                                                 status)) {
+         goto done;
+      }
+   } else if (!_crypto_hmac_sha_512 (
+                 crypto, mac_key, intermediates, 3, &tag, status)) {
       goto done;
    }
 
@@ -450,7 +508,6 @@ _hmac_step (_mongocrypt_crypto_t *crypto,
    memcpy (out->data, tag.data, MONGOCRYPT_HMAC_LEN);
    ret = true;
 done:
-   _mongocrypt_buffer_cleanup (&to_hmac);
    return ret;
 }
 
@@ -464,6 +521,7 @@ done:
  *    @iv a 16 byte IV.
  *    @associated_data associated data for the HMAC. May be NULL.
  *    @key a 96 byte key.
+ *    @prepared_key @key prepared by _mongocrypt_prepare_key. May be NULL.
  *    @plaintext the plaintext to encrypt.
  *    @ciphertext a location for the resulting ciphertext and HMAC tag.
  *    @bytes_written a location for the resulting bytes written.
@@ -487,6 +545,7 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
                            const _mongocrypt_buffer_t *iv,
                            const _mongocrypt_buffer_t *associated_data,
                            const _mongocrypt_buffer_t *key,
+                           const _mongocrypt_prepared_key_t *prepared_key,
                            const _mongocrypt_buffer_t *plaintext,
                            _mongocrypt_buffer_t *ciphertext,
                            uint32_t *bytes_written,
@@ -545,6 +604,7 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
    if (!_encrypt_step (crypto,
                        iv,
                        &enc_key,
+                       prepared_key,
                        plaintext,
                        &intermediate,
                        &intermediate_bytes_written,
@@ -564,6 +624,7 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
    /* [MCGREW]: Steps 4 & 5, compute the HMAC. */
    if (!_hmac_step (crypto,
                     &mac_key,
+                    prepared_key,
                     associated_data ? associated_data : &empty_buffer,
                     &intermediate,
                     &intermediate_hmac,
@@ -608,6 +669,7 @@ static bool
 _decrypt_step (_mongocrypt_crypto_t *crypto,
                const _mongocrypt_buffer_t *iv,
                const _mongocrypt_buffer_t *enc_key,
+               const _mongocrypt_prepared_key_t *prepared_key,
                const _mongocrypt_buffer_t *ciphertext,
                _mongocrypt_buffer_t *plaintext,
                uint32_t *bytes_written,
@@ -637,8 +699,18 @@ _decrypt_step (_mongocrypt_crypto_t *crypto,
       return false;
    }
 
-   if (!_crypto_aes_256_cbc_decrypt (
-          crypto, iv, enc_key, ciphertext, plaintext, bytes_written, status)) {
+   if (prepared_key) {
+      if (!_native_crypto_aes_256_cbc_decrypt_prepared (
+             prepared_key, iv, ciphertext, plaintext, bytes_written, status)) {
+         return false;
+      }
+   } else if (!_crypto_aes_256_cbc_decrypt (crypto,
+                                            iv,
+                                            enc_key,
+                                            ciphertext,
+                                            plaintext,
+                                            bytes_written,
+                                            status)) {
       return false;
    }
 
@@ -661,6 +733,7 @@ _decrypt_step (_mongocrypt_crypto_t *crypto,
  * Parameters:
  *    @associated_data associated data for the HMAC. May be NULL.
  *    @key a 96 byte key.
+ *    @prepared_key @key prepared by _mongocrypt_prepare_key. May be NULL.
  *    @ciphertext the ciphertext to decrypt. This contains the IV prepended.
  *    @plaintext a location for the resulting plaintext.
  *    @bytes_written a location for the resulting bytes written.
@@ -684,6 +757,7 @@ bool
 _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
                            const _mongocrypt_buffer_t *associated_data,
                            const _mongocrypt_buffer_t *key,
+                           const _mongocrypt_prepared_key_t *prepared_key,
                            const _mongocrypt_buffer_t *ciphertext,
                            _mongocrypt_buffer_t *plaintext,
                            uint32_t *bytes_written,
@@ -741,6 +815,7 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
    /* [MCGREW 2.2]: Step 3: HMAC check. */
    if (!_hmac_step (crypto,
                     &mac_key,
+                    prepared_key,
                     associated_data ? associated_data : &empty_buffer,
                     &intermediate,
                     &hmac_tag,
@@ -765,6 +840,7 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
    if (!_decrypt_step (crypto,
                        &iv,
                        &enc_key,
+                       prepared_key,
                        &intermediate,
                        plaintext,
                        bytes_written,
@@ -824,6 +900,7 @@ _mongocrypt_random (_mongocrypt_crypto_t *crypto,
  *
  * Parameters:
  *    @key the 96 byte key. The last 32 represent the IV key.
+ *    @prepared_key @key prepared by _mongocrypt_prepare_key. May be NULL.
  *    @plaintext the plaintext to be encrypted.
  *    @associated_data associated data to include in the HMAC.
  *    @out an output buffer that has been pre-allocated.
@@ -841,21 +918,19 @@ bool
 _mongocrypt_calculate_deterministic_iv (
    _mongocrypt_crypto_t *crypto,
    const _mongocrypt_buffer_t *key,
+   const _mongocrypt_prepared_key_t *prepared_key,
    const _mongocrypt_buffer_t *plaintext,
    const _mongocrypt_buffer_t *associated_data,
    _mongocrypt_buffer_t *out,
    mongocrypt_status_t *status)
 {
    _mongocrypt_buffer_t intermediates[3];
-   _mongocrypt_buffer_t to_hmac;
    _mongocrypt_buffer_t iv_key;
    uint64_t associated_data_len_be;
    uint8_t tag_storage[64];
    _mongocrypt_buffer_t tag;
    bool ret = false;
 
-   _mongocrypt_buffer_init (&to_hmac);
-
    BSON_ASSERT (key);
    BSON_ASSERT (plaintext);
    BSON_ASSERT (associated_data);
@@ -897,12 +972,17 @@ _mongocrypt_calculate_deterministic_iv (
    tag.data = tag_storage;
    tag.len = sizeof (tag_storage);
 
-   if (!_mongocrypt_buffer_concat (&to_hmac, intermediates, 3)) {
-      CLIENT_ERR ("failed to allocate buffer");
-      goto done;
-   }
-
-   if (!_crypto_hmac_sha_512 (crypto, &iv_key, &to_hmac, &tag, status)) {
+   if (prepared_key) {
+      if (!_native_crypto_hmac_sha_512_prepared (prepared_key,
+                                                 MONGOCRYPT_PREPARED_IV_KEY,
+                                                 intermediates,
+                                                 3,
+                                                 &tag,
+                                                 status)) {
+         goto done;
+      }
+   } else if (!_crypto_hmac_sha_512 (
+                 crypto, &iv_key, intermediates, 3, &tag, status)) {
       goto done;
    }
 
@@ -911,10 +991,37 @@ _mongocrypt_calculate_deterministic_iv (
 
    ret = true;
 done:
-   _mongocrypt_buffer_cleanup (&to_hmac);
    return ret;
 }
 
+bool
+_mongocrypt_hash_secret (_mongocrypt_crypto_t *crypto,
+                         const char *secret,
+                         _mongocrypt_buffer_t *out,
+                         mongocrypt_status_t *status)
+{
+   /* A fixed key, since the digest only needs to be one-way. */
+   uint8_t zero_key[MONGOCRYPT_MAC_KEY_LEN] = {0};
+   _mongocrypt_buffer_t hmac_key;
+   _mongocrypt_buffer_t in;
+
+   BSON_ASSERT (secret);
+   BSON_ASSERT (out);
+
+   _mongocrypt_buffer_init (&hmac_key);
+   hmac_key.data = zero_key;
+   hmac_key.len = sizeof (zero_key);
+   _mongocrypt_buffer_init (&in);
+   in.data = (uint8_t *) secret;
+   if (!size_to_uint32 (strlen (secret), &in.len)) {
+      CLIENT_ERR ("secret is too long");
+      return false;
+   }
+
+   _mongocrypt_buffer_resize (out, MONGOCRYPT_HMAC_SHA512_LEN);
+   return _crypto_hmac_sha_512 (crypto, &hmac_key, &in, 1, out, status);
+}
+
 bool
 _mongocrypt_wrap_key (_mongocrypt_crypto_t *crypto,
                       _mongocrypt_buffer_t *kek,
@@ -948,6 +1055,7 @@ _mongocrypt_wrap_key (_mongocrypt_crypto_t *crypto,
                                    &iv,
                                    NULL /* associated data. */,
                                    kek,
+                                   NULL /* prepared key */,
                                    dek,
                                    encrypted_dek,
                                    &bytes_written,
@@ -977,6 +1085,7 @@ _mongocrypt_unwrap_key (_mongocrypt_crypto_t *crypto,
    if (!_mongocrypt_do_decryption (crypto,
                                    NULL /* associated data. */,
                                    kek,
+                                   NULL /* prepared key */,
                                    encrypted_dek,
                                    dek,
                                    &bytes_written,
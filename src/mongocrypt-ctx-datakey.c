@@ -203,12 +203,14 @@ _kms_start (mongocrypt_ctx_t *ctx)
       /* For AWS provider, AWS credentials are supplied in
        * mongocrypt_setopt_kms_provider_aws. Data keys are encrypted with an
        * "encrypt" HTTP message to KMS. */
-      if (!_mongocrypt_kms_ctx_init_aws_encrypt (&dkctx->kms,
-                                                 &ctx->crypt->opts,
-                                                 &ctx->opts,
-                                                 &dkctx->plaintext_key_material,
-                                                 &ctx->crypt->log,
-                                                 ctx->crypt->crypto)) {
+      if (!_mongocrypt_kms_ctx_init_aws_encrypt (
+             &dkctx->kms,
+             &ctx->crypt->opts,
+             &ctx->opts,
+             &dkctx->plaintext_key_material,
+             &ctx->crypt->log,
+             ctx->crypt->crypto,
+             &ctx->crypt->cache_signing_key)) {
          mongocrypt_kms_ctx_status (&dkctx->kms, ctx->status);
          _mongocrypt_ctx_fail (ctx);
          goto done;
@@ -29,6 +29,7 @@ _replace_ciphertext_with_plaintext (void *ctx,
    _mongocrypt_ciphertext_t ciphertext;
    _mongocrypt_buffer_t plaintext;
    _mongocrypt_buffer_t key_material;
+   const _mongocrypt_prepared_key_t *prepared_key;
    _mongocrypt_buffer_t associated_data;
    uint32_t bytes_written;
    bool ret = false;
@@ -48,19 +49,17 @@ _replace_ciphertext_with_plaintext (void *ctx,
 
    /* look up the key */
    if (!_mongocrypt_key_broker_decrypted_key_by_id (
-          kb, &ciphertext.key_id, &key_material)) {
-      CLIENT_ERR ("key not found");
+          kb, &ciphertext.key_id, &key_material, &prepared_key, status)) {
       goto fail;
    }
 
-   plaintext.len = _mongocrypt_calculate_plaintext_len (ciphertext.data.len);
-   plaintext.data = bson_malloc0 (plaintext.len);
-   BSON_ASSERT (plaintext.data);
+   _mongocrypt_buffer_resize_in_arena (
+      &plaintext,
+      kb->arena,
+      _mongocrypt_calculate_plaintext_len (ciphertext.data.len));
 
-   plaintext.owned = true;
-
-   if (!_mongocrypt_ciphertext_serialize_associated_data (&ciphertext,
-                                                          &associated_data)) {
+   if (!_mongocrypt_ciphertext_serialize_associated_data (
+          &ciphertext, kb->arena, &associated_data)) {
       CLIENT_ERR ("could not serialize associated data");
       goto fail;
    }
@@ -68,6 +67,7 @@ _replace_ciphertext_with_plaintext (void *ctx,
    if (!_mongocrypt_do_decryption (kb->crypt->crypto,
                                    &associated_data,
                                    &key_material,
+                                   prepared_key,
                                    &ciphertext.data,
                                    &plaintext,
                                    &bytes_written,
@@ -85,7 +85,8 @@ _replace_ciphertext_with_plaintext (void *ctx,
    ret = true;
 
 fail:
-   _mongocrypt_buffer_cleanup (&plaintext);
+   /* Plaintext too large for the arena is on the heap. */
+   _mongocrypt_buffer_cleanse (&plaintext);
    _mongocrypt_buffer_cleanup (&associated_data);
    _mongocrypt_buffer_cleanup (&key_material);
    return ret;
@@ -95,10 +96,8 @@ fail:
 static bool
 _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 {
-   bson_t as_bson, final_bson;
-   bson_iter_t iter;
+   bson_t final_bson;
    _mongocrypt_ctx_decrypt_t *dctx;
-   bool res;
 
    if (!ctx) {
       return false;
@@ -117,20 +116,17 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
          return true;
       }
 
-      if (!_mongocrypt_buffer_to_bson (&dctx->original_doc, &as_bson)) {
-         return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
-      }
-
-      bson_iter_init (&iter, &as_bson);
-      bson_init (&final_bson);
-      res = _mongocrypt_transform_binary_in_bson (
-         _replace_ciphertext_with_plaintext,
-         &ctx->kb,
-         TRAVERSE_MATCH_CIPHERTEXT,
-         &iter,
-         &final_bson,
-         ctx->status);
-      if (!res) {
+      /* Splice plaintext in at the ciphertext locations recorded in init. */
+      _mongocrypt_key_broker_prepare_lookups (&ctx->kb);
+      if (!_mongocrypt_splice_binary_in_bson (
+             _replace_ciphertext_with_plaintext,
+             &ctx->kb,
+             &dctx->original_doc,
+             &dctx->ciphertext_locs,
+             ctx->crypt->opts.parallel_for,
+             ctx->crypt->opts.executor_ctx,
+             &dctx->decrypted_doc,
+             ctx->status)) {
          return _mongocrypt_ctx_fail (ctx);
       }
    } else {
@@ -145,9 +141,9 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
       bson_init (&final_bson);
       bson_append_value (&final_bson, MONGOCRYPT_STR_AND_LEN ("v"), &value);
       bson_value_destroy (&value);
+      _mongocrypt_buffer_steal_from_bson (&dctx->decrypted_doc, &final_bson);
    }
 
-   _mongocrypt_buffer_steal_from_bson (&dctx->decrypted_doc, &final_bson);
    out->data = dctx->decrypted_doc.data;
    out->len = dctx->decrypted_doc.len;
    ctx->state = MONGOCRYPT_CTX_DONE;
@@ -188,6 +184,7 @@ _cleanup (mongocrypt_ctx_t *ctx)
    dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
    _mongocrypt_buffer_cleanup (&dctx->original_doc);
    _mongocrypt_buffer_cleanup (&dctx->decrypted_doc);
+   _mongocrypt_traverse_locs_cleanup (&dctx->ciphertext_locs);
 }
 
 
@@ -303,14 +300,53 @@ mongocrypt_ctx_decrypt_init (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *doc)
    }
 
    bson_iter_init (&iter, &as_bson);
-   if (!_mongocrypt_traverse_binary_in_bson (_collect_key_from_ciphertext,
-                                             &ctx->kb,
-                                             TRAVERSE_MATCH_CIPHERTEXT,
-                                             &iter,
-                                             ctx->status)) {
+   if (!_mongocrypt_locate_binary_in_bson (_collect_key_from_ciphertext,
+                                           &ctx->kb,
+                                           TRAVERSE_MATCH_CIPHERTEXT,
+                                           &iter,
+                                           &dctx->ciphertext_locs,
+                                           ctx->status)) {
       return _mongocrypt_ctx_fail (ctx);
    }
 
    (void) _mongocrypt_key_broker_requests_done (&ctx->kb);
    return _mongocrypt_ctx_state_from_key_broker (ctx);
 }
+
+
+bool
+mongocrypt_ctx_decrypt_batch_init (mongocrypt_ctx_t *ctx,
+                                   mongocrypt_binary_t *docs)
+{
+   _mongocrypt_ctx_decrypt_t *dctx;
+   bson_t as_bson;
+   bson_iter_t iter, array_iter;
+
+   /* The batch wrapper is decrypted as one document: ciphertexts from every
+    * item are located in a single pass, share one key broker, and are spliced
+    * back in one pass by finalize. Only the shape needs checking. */
+   if (!mongocrypt_ctx_decrypt_init (ctx, docs)) {
+      return false;
+   }
+
+   dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+   if (!_mongocrypt_buffer_to_bson (&dctx->original_doc, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "v") ||
+       !BSON_ITER_HOLDS_ARRAY (&iter) ||
+       !bson_iter_recurse (&iter, &array_iter)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid docs, must contain array 'v'");
+   }
+
+   while (bson_iter_next (&array_iter)) {
+      if (!BSON_ITER_HOLDS_DOCUMENT (&array_iter)) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "invalid docs, 'v' must contain only documents");
+      }
+   }
+
+   return true;
+}
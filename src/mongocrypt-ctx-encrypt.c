@@ -14,10 +14,12 @@
  * limitations under the License.
  */
 
+#include "mongocrypt-cache-marking-private.h"
 #include "mongocrypt-ciphertext-private.h"
 #include "mongocrypt-crypto-private.h"
 #include "mongocrypt-ctx-private.h"
 #include "mongocrypt-key-broker-private.h"
+#include "mongocrypt-local-marking-private.h"
 #include "mongocrypt-marking-private.h"
 #include "mongocrypt-traverse-util-private.h"
 
@@ -120,6 +122,10 @@ _mongo_feed_collinfo (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
 }
 
 
+static bool
+_try_markings_in_process (mongocrypt_ctx_t *ctx);
+
+
 static bool
 _mongo_done_collinfo (mongocrypt_ctx_t *ctx)
 {
@@ -139,7 +145,7 @@ _mongo_done_collinfo (mongocrypt_ctx_t *ctx)
    }
 
    ectx->parent.state = MONGOCRYPT_CTX_NEED_MONGO_MARKINGS;
-   return true;
+   return _try_markings_in_process (ctx);
 }
 
 
@@ -227,6 +233,12 @@ _mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
       return _mongocrypt_ctx_fail_w_msg (ctx, "malformed BSON");
    }
 
+   if (!_mongocrypt_buffer_empty (&ectx->marking_cache_attr) &&
+       !ectx->markings_from_cache &&
+       ectx->num_mongocryptd_replies++ == 0) {
+      _mongocrypt_buffer_copy_from_binary (&ectx->mongocryptd_reply, in);
+   }
+
    if (bson_iter_init_find (&iter, &as_bson, "schemaRequiresEncryption") &&
        !bson_iter_as_bool (&iter)) {
       /* TODO: update cache: this schema does not require encryption. */
@@ -280,14 +292,180 @@ _mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
 }
 
 
+/* Cache the reply of mongocryptd for original_cmd, if replies for commands of
+ * the same shape can be derived from it. */
+static bool
+_add_markings_to_cache (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_cache_marking_value_t value;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   if (ectx->batch || ectx->markings_from_cache ||
+       _mongocrypt_buffer_empty (&ectx->marking_cache_attr) ||
+       ectx->num_mongocryptd_replies != 1) {
+      return true;
+   }
+
+   _mongocrypt_buffer_set_to (&ectx->original_cmd, &value.cmd);
+   _mongocrypt_buffer_set_to (&ectx->mongocryptd_reply, &value.reply);
+   if (!_mongocrypt_cache_marking_reusable (&value)) {
+      return true;
+   }
+   return _mongocrypt_cache_add_copy (&ctx->crypt->cache_marking,
+                                      &ectx->marking_cache_attr,
+                                      &value,
+                                      ctx->status);
+}
+
+
+/* Point original_cmd at the next batch item that needs markings, starting at
+ * batch_index. Returns false if no items remain. */
+static bool
+_batch_next_item (_mongocrypt_ctx_encrypt_t *ectx)
+{
+   _mongocrypt_buffer_cleanup (&ectx->original_cmd);
+   _mongocrypt_buffer_cleanup (&ectx->mongocryptd_cmd);
+   _mongocrypt_buffer_init (&ectx->mongocryptd_cmd);
+
+   for (; ectx->batch_index < ectx->batch_len; ectx->batch_index++) {
+      _mongocrypt_ctx_encrypt_batch_item_t *item;
+
+      item = &ectx->batch_items[ectx->batch_index];
+      if (!item->bypass) {
+         _mongocrypt_buffer_set_to (&item->cmd, &ectx->original_cmd);
+         return true;
+      }
+   }
+   _mongocrypt_buffer_init (&ectx->original_cmd);
+   return false;
+}
+
+
+static bool
+_try_local_markings (mongocrypt_ctx_t *ctx);
+
+
 static bool
 _mongo_done_markings (mongocrypt_ctx_t *ctx)
 {
+   _mongocrypt_ctx_encrypt_t *ectx;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   if (ectx->batch) {
+      /* Keep this item's markings and move on. Keys are only requested from
+       * the key broker once every command in the batch has been marked. */
+      _mongocrypt_buffer_steal (
+         &ectx->batch_items[ectx->batch_index].marked_cmd, &ectx->marked_cmd);
+      ectx->batch_index++;
+      if (_batch_next_item (ectx)) {
+         return _try_local_markings (ctx);
+      }
+   }
+
+   if (!_add_markings_to_cache (ctx)) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+
    (void) _mongocrypt_key_broker_requests_done (&ctx->kb);
    return _mongocrypt_ctx_state_from_key_broker (ctx);
 }
 
 
+/* If the markings can be derived from the cache, feed them in place of a
+ * reply from mongocryptd and skip MONGOCRYPT_CTX_NEED_MONGO_MARKINGS. */
+static bool
+_try_markings_from_cache (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_cache_marking_value_t *value = NULL;
+   _mongocrypt_buffer_t reply;
+   mongocrypt_binary_t reply_bin;
+   bool ret;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   /* Batches are sent to mongocryptd as one command per item. */
+   if (ectx->batch || ctx->crypt->opts.marking_cache_max_entries == 0 ||
+       ctx->state != MONGOCRYPT_CTX_NEED_MONGO_MARKINGS) {
+      return true;
+   }
+
+   if (!_mongocrypt_cache_marking_attr (ectx->ns,
+                                        !ectx->used_local_schema,
+                                        &ectx->schema,
+                                        &ectx->original_cmd,
+                                        &ectx->marking_cache_attr)) {
+      /* Leave the command to mongocryptd. */
+      return true;
+   }
+
+   if (!_mongocrypt_cache_get (&ctx->crypt->cache_marking,
+                               &ectx->marking_cache_attr,
+                               (void **) &value)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "failed to retrieve from cache");
+   }
+   if (!value) {
+      return true;
+   }
+
+   _mongocrypt_buffer_init (&reply);
+   if (!_mongocrypt_cache_marking_reply (value, &ectx->original_cmd, &reply)) {
+      /* The cached command differs in values mongocryptd analyzes. */
+      _mongocrypt_cache_marking_value_destroy (value);
+      return true;
+   }
+   _mongocrypt_cache_marking_value_destroy (value);
+
+   ectx->markings_from_cache = true;
+   _mongocrypt_buffer_to_binary (&reply, &reply_bin);
+   ret = _mongo_feed_markings (ctx, &reply_bin) && _mongo_done_markings (ctx);
+   _mongocrypt_buffer_cleanup (&reply);
+   return ret;
+}
+
+
+/* Mark supported commands with the local marking engine, in place of a reply
+ * from mongocryptd. Each item of a batch is tried in turn, until one needs
+ * mongocryptd. */
+static bool
+_try_local_markings (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_buffer_t reply;
+   mongocrypt_binary_t reply_bin;
+   bool ret = true;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   if (!ctx->crypt->opts.local_markings || ectx->marking_locally) {
+      return true;
+   }
+
+   ectx->marking_locally = true;
+   while (ret && ctx->state == MONGOCRYPT_CTX_NEED_MONGO_MARKINGS &&
+          _mongocrypt_local_marking (
+             &ectx->schema, &ectx->original_cmd, &reply)) {
+      _mongocrypt_buffer_to_binary (&reply, &reply_bin);
+      ret =
+         _mongo_feed_markings (ctx, &reply_bin) && _mongo_done_markings (ctx);
+      _mongocrypt_buffer_cleanup (&reply);
+   }
+   ectx->marking_locally = false;
+   return ret;
+}
+
+
+/* Skip MONGOCRYPT_CTX_NEED_MONGO_MARKINGS if the command can be marked without
+ * mongocryptd. */
+static bool
+_try_markings_in_process (mongocrypt_ctx_t *ctx)
+{
+   if (!_try_local_markings (ctx)) {
+      return false;
+   }
+   return _try_markings_from_cache (ctx);
+}
+
+
 static bool
 _marking_to_bson_value (void *ctx,
                         _mongocrypt_marking_t *marking,
@@ -349,6 +527,160 @@ _replace_marking_with_ciphertext (void *ctx,
    return ret;
 }
 
+static bool
+_skip_marking (void *ctx, _mongocrypt_buffer_t *in, mongocrypt_status_t *status)
+{
+   return true;
+}
+
+
+static bool
+_transform_marked_cmd (mongocrypt_ctx_t *ctx,
+                       _mongocrypt_buffer_t *marked_cmd,
+                       bson_t *out)
+{
+   bson_t as_bson;
+   bson_iter_t iter;
+   _mongocrypt_traverse_locs_t locs;
+   _mongocrypt_buffer_t spliced;
+   bool ret;
+
+   if (!_mongocrypt_buffer_to_bson (marked_cmd, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   bson_iter_init (&iter, &as_bson);
+   if (!ctx->crypt->opts.parallel_for) {
+      if (!_mongocrypt_transform_binary_in_bson (
+             _replace_marking_with_ciphertext,
+             &ctx->kb,
+             TRAVERSE_MATCH_MARKING,
+             &iter,
+             out,
+             ctx->status)) {
+         return _mongocrypt_ctx_fail (ctx);
+      }
+      return true;
+   }
+
+   /* Locate the markings first so the executor can encrypt them in any
+    * order, then splice the ciphertexts in. */
+   _mongocrypt_traverse_locs_init (&locs);
+   _mongocrypt_buffer_init (&spliced);
+   _mongocrypt_key_broker_prepare_lookups (&ctx->kb);
+   ret = _mongocrypt_locate_binary_in_bson (_skip_marking,
+                                            NULL,
+                                            TRAVERSE_MATCH_MARKING,
+                                            &iter,
+                                            &locs,
+                                            ctx->status) &&
+         _mongocrypt_splice_binary_in_bson (_replace_marking_with_ciphertext,
+                                            &ctx->kb,
+                                            marked_cmd,
+                                            &locs,
+                                            ctx->crypt->opts.parallel_for,
+                                            ctx->crypt->opts.executor_ctx,
+                                            &spliced,
+                                            ctx->status);
+   if (ret) {
+      bson_t spliced_bson;
+
+      ret = _mongocrypt_buffer_to_bson (&spliced, &spliced_bson) &&
+            bson_concat (out, &spliced_bson);
+      if (!ret) {
+         _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+      }
+   } else {
+      _mongocrypt_ctx_fail (ctx);
+   }
+   _mongocrypt_buffer_cleanup (&spliced);
+   _mongocrypt_traverse_locs_cleanup (&locs);
+   return ret;
+}
+
+
+/* Encrypt each element of the 'v' array at iter with the key and algorithm of
+ * marking, appending {v: [<ciphertext>, ...]} to out in order. */
+static bool
+_explicit_encrypt_bulk (mongocrypt_ctx_t *ctx,
+                        _mongocrypt_marking_t *marking,
+                        bson_iter_t *iter,
+                        bson_t *out)
+{
+   bson_iter_t array_iter;
+   bson_t array;
+   bool ret = true;
+
+   if (!BSON_ITER_HOLDS_ARRAY (iter) ||
+       !bson_iter_recurse (iter, &array_iter)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx,
+                                         "invalid msg, 'v' must be an array");
+   }
+
+   bson_append_array_begin (out, MONGOCRYPT_STR_AND_LEN ("v"), &array);
+   while (ret && bson_iter_next (&array_iter)) {
+      bson_value_t value;
+
+      memset (&value, 0, sizeof (value));
+      memcpy (&marking->v_iter, &array_iter, sizeof (bson_iter_t));
+      ret = _marking_to_bson_value (&ctx->kb, marking, &value, ctx->status);
+      if (ret) {
+         bson_append_value (&array,
+                            bson_iter_key (&array_iter),
+                            (int) bson_iter_key_len (&array_iter),
+                            &value);
+      }
+      bson_value_destroy (&value);
+   }
+   bson_append_array_end (out, &array);
+   return ret;
+}
+
+
+/* Produce {v: [<encrypted cmd>, ...]}, in the order the commands were given.
+ * Bypassed commands and commands without markings are copied unchanged. */
+static bool
+_finalize_batch (mongocrypt_ctx_t *ctx, bson_t *converted)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   bson_t array, child;
+   uint32_t i;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   bson_init (converted);
+   bson_append_array_begin (converted, MONGOCRYPT_STR_AND_LEN ("v"), &array);
+   for (i = 0; i < ectx->batch_len; i++) {
+      _mongocrypt_ctx_encrypt_batch_item_t *item;
+      char *key;
+      bool ret = true;
+
+      item = &ectx->batch_items[i];
+      key = bson_strdup_printf ("%u", i);
+      if (_mongocrypt_buffer_empty (&item->marked_cmd)) {
+         bson_t cmd_bson;
+
+         ret = _mongocrypt_buffer_to_bson (&item->cmd, &cmd_bson) &&
+               bson_append_document (&array, key, -1, &cmd_bson);
+         if (!ret) {
+            _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+         }
+      } else {
+         bson_append_document_begin (&array, key, -1, &child);
+         ret = _transform_marked_cmd (ctx, &item->marked_cmd, &child);
+         bson_append_document_end (&array, &child);
+      }
+      bson_free (key);
+      if (!ret) {
+         bson_append_array_end (converted, &array);
+         bson_destroy (converted);
+         return false;
+      }
+   }
+   bson_append_array_end (converted, &array);
+   return true;
+}
+
+
 static bool
 _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 {
@@ -359,33 +691,29 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
 
-   if (!ectx->explicit) {
+   if (ectx->batch) {
       if (ctx->nothing_to_do) {
-         _mongocrypt_buffer_to_binary (&ectx->original_cmd, out);
+         _mongocrypt_buffer_to_binary (&ectx->batch_cmds, out);
          ctx->state = MONGOCRYPT_CTX_DONE;
          return true;
       }
-      if (!_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &as_bson)) {
-         return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+      if (!_finalize_batch (ctx, &converted)) {
+         return false;
+      }
+   } else if (!ectx->explicit) {
+      if (ctx->nothing_to_do) {
+         _mongocrypt_buffer_to_binary (&ectx->original_cmd, out);
+         ctx->state = MONGOCRYPT_CTX_DONE;
+         return true;
       }
-
-      bson_iter_init (&iter, &as_bson);
       bson_init (&converted);
-      if (!_mongocrypt_transform_binary_in_bson (
-             _replace_marking_with_ciphertext,
-             &ctx->kb,
-             TRAVERSE_MATCH_MARKING,
-             &iter,
-             &converted,
-             ctx->status)) {
-         return _mongocrypt_ctx_fail (ctx);
+      if (!_transform_marked_cmd (ctx, &ectx->marked_cmd, &converted)) {
+         bson_destroy (&converted);
+         return false;
       }
    } else {
       /* For explicit encryption, we have no marking, but we can fake one */
       _mongocrypt_marking_t marking;
-      bson_value_t value;
-
-      memset (&value, 0, sizeof (value));
 
       _mongocrypt_marking_init (&marking);
 
@@ -399,7 +727,6 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
       }
 
 
-      memcpy (&marking.v_iter, &iter, sizeof (bson_iter_t));
       marking.algorithm = ctx->opts.algorithm;
       _mongocrypt_buffer_set_to (&ctx->opts.key_id, &marking.key_id);
       if (ctx->opts.key_alt_names) {
@@ -409,12 +736,22 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
       }
 
       bson_init (&converted);
-      res = _marking_to_bson_value (&ctx->kb, &marking, &value, ctx->status);
-      if (res) {
-         bson_append_value (&converted, MONGOCRYPT_STR_AND_LEN ("v"), &value);
+      if (ectx->bulk) {
+         res = _explicit_encrypt_bulk (ctx, &marking, &iter, &converted);
+      } else {
+         bson_value_t value;
+
+         memset (&value, 0, sizeof (value));
+         memcpy (&marking.v_iter, &iter, sizeof (bson_iter_t));
+         res =
+            _marking_to_bson_value (&ctx->kb, &marking, &value, ctx->status);
+         if (res) {
+            bson_append_value (
+               &converted, MONGOCRYPT_STR_AND_LEN ("v"), &value);
+         }
+         bson_value_destroy (&value);
       }
 
-      bson_value_destroy (&value);
       _mongocrypt_marking_cleanup (&marking);
 
       if (!res) {
@@ -446,33 +783,37 @@ _cleanup (mongocrypt_ctx_t *ctx)
    _mongocrypt_buffer_cleanup (&ectx->mongocryptd_cmd);
    _mongocrypt_buffer_cleanup (&ectx->marked_cmd);
    _mongocrypt_buffer_cleanup (&ectx->encrypted_cmd);
+   if (ectx->batch_items) {
+      uint32_t i;
+
+      for (i = 0; i < ectx->batch_len; i++) {
+         _mongocrypt_buffer_cleanup (&ectx->batch_items[i].marked_cmd);
+      }
+      bson_free (ectx->batch_items);
+   }
+   _mongocrypt_buffer_cleanup (&ectx->batch_cmds);
+   _mongocrypt_buffer_cleanup (&ectx->marking_cache_attr);
+   _mongocrypt_buffer_cleanup (&ectx->mongocryptd_reply);
 }
 
 
 static bool
 _try_schema_from_schema_map (mongocrypt_ctx_t *ctx)
 {
-   mongocrypt_t *crypt;
    _mongocrypt_ctx_encrypt_t *ectx;
-   bson_t schema_map;
-   bson_iter_t iter;
+   const _mongocrypt_schema_map_entry_t *entry;
 
-   crypt = ctx->crypt;
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
 
-   if (_mongocrypt_buffer_empty (&crypt->opts.schema_map)) {
-      /* No schema map set. */
-      return true;
-   }
-
-   if (!_mongocrypt_buffer_to_bson (&crypt->opts.schema_map, &schema_map)) {
-      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed schema map");
-   }
-
-   if (bson_iter_init_find (&iter, &schema_map, ectx->ns)) {
-      if (!_mongocrypt_buffer_copy_from_document_iter (&ectx->schema, &iter)) {
+   /* The schema map is indexed by mongocrypt_init. The schema is viewed, not
+    * copied, since the schema map outlives the context. */
+   entry =
+      _mongocrypt_schema_map_find (&ctx->crypt->schema_map_index, ectx->ns);
+   if (entry) {
+      if (_mongocrypt_buffer_empty (&entry->schema)) {
          return _mongocrypt_ctx_fail_w_msg (ctx, "malformed schema map");
       }
+      _mongocrypt_buffer_set_to (&entry->schema, &ectx->schema);
       ectx->used_local_schema = true;
       ctx->state = MONGOCRYPT_CTX_NEED_MONGO_MARKINGS;
    }
@@ -574,9 +915,10 @@ fail:
    return ret;
 }
 
-bool
-mongocrypt_ctx_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
-                                      mongocrypt_binary_t *msg)
+static bool
+_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
+                        mongocrypt_binary_t *msg,
+                        bool bulk)
 {
    _mongocrypt_ctx_encrypt_t *ectx;
    bson_t as_bson;
@@ -597,6 +939,7 @@ mongocrypt_ctx_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
    ctx->type = _MONGOCRYPT_TYPE_ENCRYPT;
    ectx->explicit = true;
+   ectx->bulk = bulk;
    ctx->vtable.finalize = _finalize;
    ctx->vtable.cleanup = _cleanup;
 
@@ -639,7 +982,22 @@ mongocrypt_ctx_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
       return _mongocrypt_ctx_fail_w_msg (ctx, "invalid msg, must contain 'v'");
    }
 
-   if (!_permitted_for_encryption (&iter, ctx->opts.algorithm, ctx->status)) {
+   if (bulk) {
+      bson_iter_t array_iter;
+
+      if (!BSON_ITER_HOLDS_ARRAY (&iter) ||
+          !bson_iter_recurse (&iter, &array_iter)) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "invalid msg, 'v' must be an array");
+      }
+      while (bson_iter_next (&array_iter)) {
+         if (!_permitted_for_encryption (
+                &array_iter, ctx->opts.algorithm, ctx->status)) {
+            return _mongocrypt_ctx_fail (ctx);
+         }
+      }
+   } else if (!_permitted_for_encryption (
+                 &iter, ctx->opts.algorithm, ctx->status)) {
       return _mongocrypt_ctx_fail (ctx);
    }
 
@@ -647,6 +1005,20 @@ mongocrypt_ctx_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
    return _mongocrypt_ctx_state_from_key_broker (ctx);
 }
 
+bool
+mongocrypt_ctx_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
+                                      mongocrypt_binary_t *msg)
+{
+   return _explicit_encrypt_init (ctx, msg, false);
+}
+
+bool
+mongocrypt_ctx_explicit_encrypt_bulk_init (mongocrypt_ctx_t *ctx,
+                                           mongocrypt_binary_t *msg)
+{
+   return _explicit_encrypt_init (ctx, msg, true);
+}
+
 static bool
 _check_cmd_for_auto_encrypt (mongocrypt_binary_t *cmd,
                              bool *bypass,
@@ -798,58 +1170,28 @@ _check_cmd_for_auto_encrypt (mongocrypt_binary_t *cmd,
    return false;
 }
 
-bool
-mongocrypt_ctx_encrypt_init (mongocrypt_ctx_t *ctx,
-                             const char *db,
-                             int32_t db_len,
-                             mongocrypt_binary_t *cmd)
+static void
+_init_auto_encrypt_vtable (mongocrypt_ctx_t *ctx)
 {
-   _mongocrypt_ctx_encrypt_t *ectx;
-   _mongocrypt_ctx_opts_spec_t opts_spec;
-   bool bypass;
-
-   if (!ctx) {
-      return false;
-   }
-   memset (&opts_spec, 0, sizeof (opts_spec));
-   opts_spec.schema = OPT_OPTIONAL;
-   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
-      return false;
-   }
-
-   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
    ctx->type = _MONGOCRYPT_TYPE_ENCRYPT;
-   ectx->explicit = false;
    ctx->vtable.mongo_op_collinfo = _mongo_op_collinfo;
    ctx->vtable.mongo_feed_collinfo = _mongo_feed_collinfo;
    ctx->vtable.mongo_done_collinfo = _mongo_done_collinfo;
-   ctx->vtable.mongo_op_collinfo = _mongo_op_collinfo;
    ctx->vtable.mongo_op_markings = _mongo_op_markings;
    ctx->vtable.mongo_feed_markings = _mongo_feed_markings;
    ctx->vtable.mongo_done_markings = _mongo_done_markings;
    ctx->vtable.finalize = _finalize;
    ctx->vtable.cleanup = _cleanup;
-   ctx->vtable.mongo_op_collinfo = _mongo_op_collinfo;
-   ctx->vtable.mongo_feed_collinfo = _mongo_feed_collinfo;
-   ctx->vtable.mongo_done_collinfo = _mongo_done_collinfo;
-
-
-   if (!cmd || !cmd->data) {
-      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid command");
-   }
+}
 
-   _mongocrypt_buffer_copy_from_binary (&ectx->original_cmd, cmd);
 
-   if (!_check_cmd_for_auto_encrypt (
-          cmd, &bypass, &ectx->coll_name, ctx->status)) {
-      return _mongocrypt_ctx_fail (ctx);
-   }
+/* Validate db and the context options for auto encryption, and set ns. */
+static bool
+_init_auto_encrypt_ns (mongocrypt_ctx_t *ctx, const char *db, int32_t db_len)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
 
-   if (bypass) {
-      ctx->nothing_to_do = true;
-      ctx->state = MONGOCRYPT_CTX_READY;
-      return true;
-   }
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
 
    /* if _check_cmd_for_auto_encrypt did not bypass or error, a collection name
     * must have been set. */
@@ -881,6 +1223,82 @@ mongocrypt_ctx_encrypt_init (mongocrypt_ctx_t *ctx,
          ctx, "algorithm must not be set for auto encryption");
    }
 
+   return true;
+}
+
+
+static bool
+_init_auto_encrypt_schema (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+
+   /* Check if we have a local schema from schema_map */
+   if (!_try_schema_from_schema_map (ctx)) {
+      return false;
+   }
+
+   /* If we didn't have a local schema, try the cache. */
+   if (_mongocrypt_buffer_empty (&ectx->schema)) {
+      if (!_try_schema_from_cache (ctx)) {
+         return false;
+      }
+   }
+
+   /* Otherwise, we need the the driver to fetch the schema. */
+   if (_mongocrypt_buffer_empty (&ectx->schema)) {
+      ctx->state = MONGOCRYPT_CTX_NEED_MONGO_COLLINFO;
+      return true;
+   }
+   return _try_markings_in_process (ctx);
+}
+
+
+bool
+mongocrypt_ctx_encrypt_init (mongocrypt_ctx_t *ctx,
+                             const char *db,
+                             int32_t db_len,
+                             mongocrypt_binary_t *cmd)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+   bool bypass;
+
+   if (!ctx) {
+      return false;
+   }
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   opts_spec.schema = OPT_OPTIONAL;
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
+      return false;
+   }
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   ectx->explicit = false;
+   _init_auto_encrypt_vtable (ctx);
+
+   if (!cmd || !cmd->data) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid command");
+   }
+
+   _mongocrypt_buffer_copy_from_binary (&ectx->original_cmd, cmd);
+
+   if (!_check_cmd_for_auto_encrypt (
+          cmd, &bypass, &ectx->coll_name, ctx->status)) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+
+   if (bypass) {
+      ctx->nothing_to_do = true;
+      ctx->state = MONGOCRYPT_CTX_READY;
+      return true;
+   }
+
+   if (!_init_auto_encrypt_ns (ctx, db, db_len)) {
+      return false;
+   }
+
    if (ctx->crypt->log.trace_enabled) {
       char *cmd_val;
       cmd_val = _mongocrypt_new_json_string_from_binary (cmd);
@@ -897,21 +1315,127 @@ mongocrypt_ctx_encrypt_init (mongocrypt_ctx_t *ctx,
       bson_free (cmd_val);
    }
 
-   /* Check if we have a local schema from schema_map */
-   if (!_try_schema_from_schema_map (ctx)) {
+   return _init_auto_encrypt_schema (ctx);
+}
+
+
+bool
+mongocrypt_ctx_encrypt_batch_init (mongocrypt_ctx_t *ctx,
+                                   const char *db,
+                                   int32_t db_len,
+                                   mongocrypt_binary_t *cmds)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+   bson_t as_bson;
+   bson_iter_t iter, array_iter;
+   uint32_t i;
+
+   if (!ctx) {
+      return false;
+   }
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   opts_spec.schema = OPT_OPTIONAL;
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
       return false;
    }
 
-   /* If we didn't have a local schema, try the cache. */
-   if (_mongocrypt_buffer_empty (&ectx->schema)) {
-      if (!_try_schema_from_cache (ctx)) {
-         return false;
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   ectx->explicit = false;
+   ectx->batch = true;
+   _init_auto_encrypt_vtable (ctx);
+
+   if (!cmds || !cmds->data) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid commands");
+   }
+
+   _mongocrypt_buffer_copy_from_binary (&ectx->batch_cmds, cmds);
+   if (!_mongocrypt_buffer_to_bson (&ectx->batch_cmds, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid BSON commands");
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "v") ||
+       !BSON_ITER_HOLDS_ARRAY (&iter) ||
+       !bson_iter_recurse (&iter, &array_iter)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid commands, must contain array 'v'");
+   }
+
+   memcpy (&iter, &array_iter, sizeof (bson_iter_t));
+   while (bson_iter_next (&iter)) {
+      ectx->batch_len++;
+   }
+   if (ectx->batch_len == 0) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid commands, 'v' is empty");
+   }
+   ectx->batch_items = bson_malloc0 (
+      ectx->batch_len * sizeof (_mongocrypt_ctx_encrypt_batch_item_t));
+   BSON_ASSERT (ectx->batch_items);
+
+   /* All eligible commands must target the same collection, so the batch
+    * resolves one schema and shares one key broker. */
+   for (i = 0; bson_iter_next (&array_iter); i++) {
+      _mongocrypt_ctx_encrypt_batch_item_t *item;
+      mongocrypt_binary_t cmd;
+      char *coll_name = NULL;
+
+      item = &ectx->batch_items[i];
+      if (!_mongocrypt_buffer_from_document_iter (&item->cmd, &array_iter)) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "invalid commands, 'v' must contain only documents");
+      }
+
+      _mongocrypt_buffer_to_binary (&item->cmd, &cmd);
+      if (!_check_cmd_for_auto_encrypt (
+             &cmd, &item->bypass, &coll_name, ctx->status)) {
+         bson_free (coll_name);
+         return _mongocrypt_ctx_fail (ctx);
+      }
+
+      if (item->bypass) {
+         bson_free (coll_name);
+         continue;
+      }
+
+      if (!ectx->coll_name) {
+         ectx->coll_name = coll_name;
+      } else {
+         bool same = 0 == strcmp (ectx->coll_name, coll_name);
+
+         bson_free (coll_name);
+         if (!same) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "all commands in a batch must target the same collection");
+         }
       }
    }
 
-   /* Otherwise, we need the the driver to fetch the schema. */
-   if (_mongocrypt_buffer_empty (&ectx->schema)) {
-      ctx->state = MONGOCRYPT_CTX_NEED_MONGO_COLLINFO;
+   if (!_batch_next_item (ectx)) {
+      /* Every command was bypassed. */
+      ctx->nothing_to_do = true;
+      ctx->state = MONGOCRYPT_CTX_READY;
+      return true;
    }
-   return true;
+
+   if (!_init_auto_encrypt_ns (ctx, db, db_len)) {
+      return false;
+   }
+
+   if (ctx->crypt->log.trace_enabled) {
+      char *cmds_val;
+      cmds_val = _mongocrypt_new_json_string_from_binary (cmds);
+      _mongocrypt_log (&ctx->crypt->log,
+                       MONGOCRYPT_LOG_LEVEL_TRACE,
+                       "%s (%s=\"%s\", %s=%d, %s=\"%s\")",
+                       BSON_FUNC,
+                       "db",
+                       ectx->db_name,
+                       "db_len",
+                       db_len,
+                       "cmds",
+                       cmds_val);
+      bson_free (cmds_val);
+   }
+
+   return _init_auto_encrypt_schema (ctx);
 }
@@ -23,6 +23,7 @@
 #include "mongocrypt-key-broker-private.h"
 #include "mongocrypt-key-private.h"
 #include "mongocrypt-endpoint-private.h"
+#include "mongocrypt-traverse-util-private.h"
 
 typedef enum {
    _MONGOCRYPT_TYPE_NONE,
@@ -67,6 +68,8 @@ struct _mongocrypt_ctx_t {
    _mongocrypt_ctx_type_t type;
    mongocrypt_status_t *status;
    _mongocrypt_key_broker_t kb;
+   /* Temporary buffers for transformed fields. Released when destroyed. */
+   _mongocrypt_arena_t arena;
    _mongocrypt_vtable_t vtable;
    _mongocrypt_ctx_opts_t opts;
    bool initialized;
@@ -85,9 +88,19 @@ bool
 _mongocrypt_ctx_fail_w_msg (mongocrypt_ctx_t *ctx, const char *msg);
 
 
+typedef struct {
+   _mongocrypt_buffer_t cmd;        /* views into batch_cmds. */
+   _mongocrypt_buffer_t marked_cmd; /* empty if nothing was marked. */
+   bool bypass;
+} _mongocrypt_ctx_encrypt_batch_item_t;
+
+
 typedef struct {
    mongocrypt_ctx_t parent;
    bool explicit;
+   /* bulk is only set for explicit encryption, where original_cmd is
+    * {v: [<BSON value>, ...]} and each value is encrypted in order. */
+   bool bulk;
    char *coll_name;
    char *db_name;
    char *ns;
@@ -114,6 +127,25 @@ typedef struct {
    /* collinfo_has_siblings is true if the schema came from a remote JSON
     * schema, and there were siblings. */
    bool collinfo_has_siblings;
+   /* Batch auto encryption. batch_cmds is the {v: [<cmd>, ...]} document
+    * passed to mongocrypt_ctx_encrypt_batch_init. Each item views one command
+    * inside batch_cmds and owns the marked command returned for it.
+    * batch_index is the item currently being sent to mongocryptd. */
+   bool batch;
+   _mongocrypt_buffer_t batch_cmds;
+   _mongocrypt_ctx_encrypt_batch_item_t *batch_items;
+   uint32_t batch_len;
+   uint32_t batch_index;
+   /* The marking cache attribute of original_cmd, empty if the marking cache
+    * is not used. mongocryptd_reply is the first reply fed, which is cached
+    * when markings are done if exactly one reply was fed. */
+   _mongocrypt_buffer_t marking_cache_attr;
+   _mongocrypt_buffer_t mongocryptd_reply;
+   uint32_t num_mongocryptd_replies;
+   bool markings_from_cache;
+   /* Set while _try_local_markings feeds markings, so batch items are marked
+    * in a loop rather than recursively. */
+   bool marking_locally;
 } _mongocrypt_ctx_encrypt_t;
 
 
@@ -127,6 +159,10 @@ typedef struct {
    _mongocrypt_buffer_t original_doc;
    _mongocrypt_buffer_t unwrapped_doc; /* explicit only */
    _mongocrypt_buffer_t decrypted_doc;
+   /* Locations of the ciphertexts in original_doc, recorded while collecting
+    * key ids so finalize can splice in plaintext without another traversal.
+    */
+   _mongocrypt_traverse_locs_t ciphertext_locs;
 } _mongocrypt_ctx_decrypt_t;
 
 
@@ -44,6 +44,8 @@ _mongocrypt_ctx_fail (mongocrypt_ctx_t *ctx)
          ctx, "unexpected, failing but no error status set");
    }
    ctx->state = MONGOCRYPT_CTX_ERROR;
+   /* Let another context refresh the keys this one was to refresh. */
+   _mongocrypt_key_broker_release_refresh (&ctx->kb);
    return false;
 }
 
@@ -232,11 +234,27 @@ mongocrypt_ctx_setopt_algorithm (mongocrypt_ctx_t *ctx,
 }
 
 
+/* Size of the largest context type, which every context is allocated with. */
+static size_t
+_ctx_size (void)
+{
+   size_t ctx_size;
+
+   ctx_size = sizeof (_mongocrypt_ctx_encrypt_t);
+   if (sizeof (_mongocrypt_ctx_decrypt_t) > ctx_size) {
+      ctx_size = sizeof (_mongocrypt_ctx_decrypt_t);
+   }
+   if (sizeof (_mongocrypt_ctx_datakey_t) > ctx_size) {
+      ctx_size = sizeof (_mongocrypt_ctx_datakey_t);
+   }
+   return ctx_size;
+}
+
+
 mongocrypt_ctx_t *
 mongocrypt_ctx_new (mongocrypt_t *crypt)
 {
    mongocrypt_ctx_t *ctx;
-   size_t ctx_size;
 
    if (!crypt) {
       return NULL;
@@ -248,18 +266,12 @@ mongocrypt_ctx_new (mongocrypt_t *crypt)
       CLIENT_ERR ("cannot create context from uninitialized crypt");
       return NULL;
    }
-   ctx_size = sizeof (_mongocrypt_ctx_encrypt_t);
-   if (sizeof (_mongocrypt_ctx_decrypt_t) > ctx_size) {
-      ctx_size = sizeof (_mongocrypt_ctx_decrypt_t);
-   }
-   if (sizeof (_mongocrypt_ctx_datakey_t) > ctx_size) {
-      ctx_size = sizeof (_mongocrypt_ctx_datakey_t);
-   }
-   ctx = bson_malloc0 (ctx_size);
+   ctx = bson_malloc0 (_ctx_size ());
    BSON_ASSERT (ctx);
 
    ctx->crypt = crypt;
    ctx->status = mongocrypt_status_new ();
+   _mongocrypt_arena_init (&ctx->arena);
    ctx->opts.algorithm = MONGOCRYPT_ENCRYPTION_ALGORITHM_NONE;
    ctx->state = MONGOCRYPT_CTX_DONE;
    return ctx;
@@ -421,6 +433,17 @@ mongocrypt_ctx_mongo_done (mongocrypt_ctx_t *ctx)
 }
 
 
+uint32_t
+mongocrypt_ctx_mongo_wait_ms (mongocrypt_ctx_t *ctx)
+{
+   if (!ctx || !ctx->initialized ||
+       ctx->state != MONGOCRYPT_CTX_NEED_MONGO_KEYS) {
+      return 0;
+   }
+   return _mongocrypt_key_broker_wait_ms (&ctx->kb);
+}
+
+
 mongocrypt_ctx_state_t
 mongocrypt_ctx_state (mongocrypt_ctx_t *ctx)
 {
@@ -533,22 +556,62 @@ mongocrypt_ctx_status (mongocrypt_ctx_t *ctx, mongocrypt_status_t *out)
 }
 
 
-void
-mongocrypt_ctx_destroy (mongocrypt_ctx_t *ctx)
+/* Release everything set by options or initialization. The status and arena
+ * are kept, so the context may be reset. */
+static void
+_ctx_cleanup (mongocrypt_ctx_t *ctx)
 {
-   if (!ctx) {
-      return;
-   }
-
    if (ctx->vtable.cleanup) {
       ctx->vtable.cleanup (ctx);
    }
 
    _mongocrypt_kek_cleanup (&ctx->opts.kek);
-   mongocrypt_status_destroy (ctx->status);
    _mongocrypt_key_broker_cleanup (&ctx->kb);
    _mongocrypt_key_alt_name_destroy_all (ctx->opts.key_alt_names);
    _mongocrypt_buffer_cleanup (&ctx->opts.key_id);
+}
+
+
+void
+mongocrypt_ctx_reset (mongocrypt_ctx_t *ctx)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_status_t *status;
+   size_t arena_end;
+
+   if (!ctx) {
+      return;
+   }
+
+   _ctx_cleanup (ctx);
+
+   crypt = ctx->crypt;
+   status = ctx->status;
+   _mongocrypt_status_reset (status);
+   /* Keep a chunk of the arena to draw from in the next operation. */
+   _mongocrypt_arena_reset (&ctx->arena);
+
+   /* Zero everything but the arena, whose mutex must not be moved. */
+   arena_end = offsetof (mongocrypt_ctx_t, arena) + sizeof (ctx->arena);
+   memset (ctx, 0, offsetof (mongocrypt_ctx_t, arena));
+   memset ((uint8_t *) ctx + arena_end, 0, _ctx_size () - arena_end);
+   ctx->crypt = crypt;
+   ctx->status = status;
+   ctx->opts.algorithm = MONGOCRYPT_ENCRYPTION_ALGORITHM_NONE;
+   ctx->state = MONGOCRYPT_CTX_DONE;
+}
+
+
+void
+mongocrypt_ctx_destroy (mongocrypt_ctx_t *ctx)
+{
+   if (!ctx) {
+      return;
+   }
+
+   _ctx_cleanup (ctx);
+   mongocrypt_status_destroy (ctx->status);
+   _mongocrypt_arena_cleanup (&ctx->arena);
    bson_free (ctx);
    return;
 }
@@ -744,6 +807,7 @@ _mongocrypt_ctx_init (mongocrypt_ctx_t *ctx,
    }
 
    _mongocrypt_key_broker_init (&ctx->kb, ctx->crypt);
+   ctx->kb.arena = &ctx->arena;
    return true;
 }
 
@@ -28,12 +28,18 @@
 #include "mongocrypt-opts-private.h"
 #include "mongocrypt-cache-private.h"
 
+/* Bounds in milliseconds of the time a key broker asks the driver to wait
+ * while only waiting on other key brokers' fetches. The wait doubles each
+ * round. */
+#define KEY_FETCH_WAIT_MIN_MS 5
+#define KEY_FETCH_WAIT_MAX_MS 100
+
 /* The key broker acts as a middle-man between an encrypt/decrypt request and
  * the key cache.
  * Each encrypt/decrypt request has one key broker. Key brokers are not shared.
  * It is responsible for:
  * - keeping track of requested keys (either by id or keyAltName)
- * - copying keys from the cache to satisfy those requests
+ * - borrowing keys from the cache to satisfy those requests
  * - generating find cmd filters to fetch keys that aren't cached or are expired
  * - generating KMS decrypt requests on newly fetched keys
  * - adding newly fetched keys back to the cache
@@ -70,6 +76,12 @@ typedef struct _key_request_t {
    _mongocrypt_buffer_t id;
    _mongocrypt_key_alt_name_t *alt_name;
    bool satisfied; /* true if satisfied by a cache entry or a key returned. */
+   /* true if this broker was asked to refresh the cache entry of the key. */
+   bool refresh_claimed;
+   /* true while another key broker is fetching the key. A deferred request
+    * is left out of the filter, and looked up in the cache again after each
+    * round of key documents. */
+   bool deferred;
    struct _key_request_t *next;
 } key_request_t;
 
@@ -77,15 +89,49 @@ typedef struct _key_request_t {
 typedef struct _key_returned_t {
    _mongocrypt_key_doc_t *doc;
    _mongocrypt_buffer_t decrypted_key_material;
+   /* Set if the key came from the cache. Holds a reference to the cache value,
+    * and @doc and @decrypted_key_material are borrowed from it. */
+   _mongocrypt_cache_key_value_t *cache_value;
+   /* Set once a decrypted key is stored to the cache. Holds a reference to the
+    * stored value, so its prepared key is shared with later key brokers. */
+   _mongocrypt_cache_key_value_t *stored_value;
 
    mongocrypt_kms_ctx_t kms;
    bool decrypted;
 
    bool needs_auth;
 
+   /* For a KMIP key, the key returned whose kms context gets this key's KEK,
+    * batched with the KEKs of other KMIP keys on the same endpoint. It may be
+    * this key returned. kmip_batch_index is the index of the KEK in the batch.
+    */
+   struct _key_returned_t *kmip_batch;
+   uint32_t kmip_batch_index;
+
    struct _key_returned_t *next;
 } key_returned_t;
 
+/* A key id being fetched from the key vault by one key broker. Other key
+ * brokers requesting the same key id defer their request until that fetch
+ * completes rather than starting their own. Entries live in mongocrypt_t's
+ * key_fetches list. */
+typedef struct _key_fetch_t {
+   _mongocrypt_buffer_t id;
+   const void *owner; /* the key broker fetching the key. */
+   struct _key_fetch_t *next;
+} key_fetch_t;
+
+/* An entry in the key broker's index of keys returned, by _id or by one
+ * keyAltName. The index is an open addressing hash table built once the key
+ * broker is done, so each lookup while encrypting or decrypting fields does
+ * not walk the lists of keys. */
+typedef struct {
+   uint32_t hash;
+   const _mongocrypt_buffer_t *id; /* set for an entry by _id. */
+   const char *alt_name;           /* set for an entry by keyAltName. */
+   key_returned_t *key_returned;   /* NULL for an unused entry. */
+} key_index_entry_t;
+
 typedef struct _auth_request_t {
    mongocrypt_kms_ctx_t kms;
    bool returned;
@@ -110,6 +156,20 @@ typedef struct {
    key_returned_t *decryptor_iter;
    auth_request_t auth_request_azure;
    auth_request_t auth_request_gcp;
+   /* True if this broker has entries in crypt->key_fetches. */
+   bool owns_fetches;
+   /* Monotonic time in milliseconds after which deferred requests are
+    * fetched by this broker. */
+   int64_t fetch_deadline;
+   /* The next wait in milliseconds while only waiting on deferred requests. */
+   int64_t fetch_wait_ms;
+   /* Built on the first lookup in KB_DONE. key_index_size is a power of two,
+    * or zero if the index is not built. */
+   key_index_entry_t *key_index;
+   uint32_t key_index_size;
+   /* Not owned. Temporary buffers for fields transformed with this key broker
+    * are drawn from arena, or from the heap if it is NULL. */
+   _mongocrypt_arena_t *arena;
 } _mongocrypt_key_broker_t;
 
 void
@@ -148,6 +208,12 @@ _mongocrypt_key_broker_add_doc (_mongocrypt_key_broker_t *kb,
 bool
 _mongocrypt_key_broker_docs_done (_mongocrypt_key_broker_t *kb);
 
+/* In KB_ADDING_DOCS, returns the time in milliseconds to wait before
+ * _mongocrypt_key_broker_docs_done if every unsatisfied request is deferred,
+ * in which case there is no filter. Returns 0 otherwise. */
+uint32_t
+_mongocrypt_key_broker_wait_ms (_mongocrypt_key_broker_t *kb);
+
 /* Iterate the keys needing KMS decryption. */
 mongocrypt_kms_ctx_t *
 _mongocrypt_key_broker_next_kms (_mongocrypt_key_broker_t *kb)
@@ -159,22 +225,43 @@ bool
 _mongocrypt_key_broker_kms_done (_mongocrypt_key_broker_t *kb);
 
 
+/* Build the index used by the decrypted key lookups below, which is otherwise
+ * built on the first lookup. Afterward, lookups only read kb and may be made
+ * concurrently. */
+void
+_mongocrypt_key_broker_prepare_lookups (_mongocrypt_key_broker_t *kb);
+
+
 /* Get the final decrypted key material from a key by looking up with a key_id.
- * @out is always initialized, even on error. */
+ * @out is always initialized, even on error. @out borrows from the key broker,
+ * and is valid until the key broker is cleaned up. Errors are set on @status,
+ * and do not fail the key broker.
+ * @prepared_key_out may be NULL. If not NULL, it is set to the prepared form
+ * of @out, or to NULL if the key is not prepared. It also borrows from the key
+ * broker. */
 bool
-_mongocrypt_key_broker_decrypted_key_by_id (_mongocrypt_key_broker_t *kb,
-                                            const _mongocrypt_buffer_t *key_id,
-                                            _mongocrypt_buffer_t *out)
+_mongocrypt_key_broker_decrypted_key_by_id (
+   _mongocrypt_key_broker_t *kb,
+   const _mongocrypt_buffer_t *key_id,
+   _mongocrypt_buffer_t *out,
+   const _mongocrypt_prepared_key_t **prepared_key_out,
+   mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 /* Get the final decrypted key material from a key, and optionally its key_id.
  * @key_id_out may be NULL. @out and @key_id_out (if not NULL) are always
- * initialized, even on error. */
+ * initialized, even on error. Both borrow from the key broker, and are valid
+ * until the key broker is cleaned up. Errors are set on @status, and do not
+ * fail the key broker. @prepared_key_out is as in
+ * _mongocrypt_key_broker_decrypted_key_by_id. */
 bool
-_mongocrypt_key_broker_decrypted_key_by_name (_mongocrypt_key_broker_t *kb,
-                                              const bson_value_t *key_alt_name,
-                                              _mongocrypt_buffer_t *out,
-                                              _mongocrypt_buffer_t *key_id_out)
+_mongocrypt_key_broker_decrypted_key_by_name (
+   _mongocrypt_key_broker_t *kb,
+   const bson_value_t *key_alt_name,
+   _mongocrypt_buffer_t *out,
+   const _mongocrypt_prepared_key_t **prepared_key_out,
+   _mongocrypt_buffer_t *key_id_out,
+   mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
@@ -183,6 +270,13 @@ _mongocrypt_key_broker_status (_mongocrypt_key_broker_t *kb,
                                mongocrypt_status_t *out);
 
 
+/* Release the cache entries this key broker was asked to refresh, so another
+ * key broker refreshes them. Called when the key broker will not fetch keys,
+ * e.g. when its context fails. Idempotent. */
+void
+_mongocrypt_key_broker_release_refresh (_mongocrypt_key_broker_t *kb);
+
+
 void
 _mongocrypt_key_broker_cleanup (_mongocrypt_key_broker_t *kb);
 
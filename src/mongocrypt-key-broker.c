@@ -17,6 +17,9 @@
 #include "mongocrypt-key-broker-private.h"
 #include "mongocrypt-private.h"
 
+/* The most KMIP objects requested in one KMIP Get. */
+#define KMIP_MAX_BATCH_COUNT 64
+
 void
 _mongocrypt_key_broker_init (_mongocrypt_key_broker_t *kb, mongocrypt_t *crypt)
 {
@@ -56,6 +59,32 @@ _key_returned_prepend (_mongocrypt_key_broker_t *kb,
    return key_returned;
 }
 
+/*
+ * Creates a new key_returned_t borrowing from a cache value and prepends it to
+ * kb->keys_cached. Takes ownership of the reference to @cache_value.
+ */
+static key_returned_t *
+_key_returned_prepend_cached (_mongocrypt_key_broker_t *kb,
+                              _mongocrypt_cache_key_value_t *cache_value)
+{
+   key_returned_t *key_returned;
+
+   BSON_ASSERT (cache_value);
+
+   key_returned = bson_malloc0 (sizeof (*key_returned));
+   BSON_ASSERT (key_returned);
+
+   key_returned->cache_value = cache_value;
+   key_returned->doc = cache_value->key_doc;
+   _mongocrypt_buffer_set_to (&cache_value->decrypted_key_material,
+                              &key_returned->decrypted_key_material);
+   key_returned->decrypted = true;
+
+   key_returned->next = kb->keys_cached;
+   kb->keys_cached = key_returned;
+   return key_returned;
+}
+
 /* Find the first (if any) key_returned_t matching either a key_id or a list of
  * key_alt_names (both are NULLable) */
 static key_returned_t *
@@ -124,6 +153,55 @@ _all_key_requests_satisfied (_mongocrypt_key_broker_t *kb)
    return true;
 }
 
+/* Like _all_key_requests_satisfied, but ignores deferred requests, which were
+ * not part of the filter. */
+static bool
+_filtered_key_requests_satisfied (_mongocrypt_key_broker_t *kb)
+{
+   key_request_t *key_request;
+
+   for (key_request = kb->key_requests; NULL != key_request;
+        key_request = key_request->next) {
+      if (!key_request->satisfied && !key_request->deferred) {
+         return false;
+      }
+   }
+   return true;
+}
+
+void
+_mongocrypt_key_broker_release_refresh (_mongocrypt_key_broker_t *kb)
+{
+   key_request_t *req;
+
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      _mongocrypt_cache_key_attr_t *attr;
+
+      if (!req->refresh_claimed) {
+         continue;
+      }
+      req->refresh_claimed = false;
+      attr = _mongocrypt_cache_key_attr_new (&req->id, req->alt_name);
+      if (attr) {
+         /* Failing to release only delays the refresh until expiration. */
+         (void) _mongocrypt_cache_release_refresh (&kb->crypt->cache_key,
+                                                   attr);
+      }
+      _mongocrypt_cache_key_attr_destroy (attr);
+   }
+}
+
+/* The keys were stored to the cache, replacing the entries being refreshed. */
+static void
+_refresh_done (_mongocrypt_key_broker_t *kb)
+{
+   key_request_t *req;
+
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      req->refresh_claimed = false;
+   }
+}
+
 static bool
 _key_broker_fail_w_msg (_mongocrypt_key_broker_t *kb, const char *msg)
 {
@@ -132,6 +210,7 @@ _key_broker_fail_w_msg (_mongocrypt_key_broker_t *kb, const char *msg)
    kb->state = KB_ERROR;
    status = kb->status;
    CLIENT_ERR (msg);
+   _mongocrypt_key_broker_release_refresh (kb);
    return false;
 }
 
@@ -143,6 +222,7 @@ _key_broker_fail (_mongocrypt_key_broker_t *kb)
          kb, "unexpected, failing but no error status set");
    }
    kb->state = KB_ERROR;
+   _mongocrypt_key_broker_release_refresh (kb);
    return false;
 }
 
@@ -151,23 +231,30 @@ _try_satisfying_from_cache (_mongocrypt_key_broker_t *kb, key_request_t *req)
 {
    _mongocrypt_cache_key_attr_t *attr = NULL;
    _mongocrypt_cache_key_value_t *value = NULL;
+   bool refresh = false;
    bool ret = false;
 
-   if (kb->state != KB_REQUESTING) {
+   /* Deferred requests are retried while adding docs. */
+   if (kb->state != KB_REQUESTING && kb->state != KB_ADDING_DOCS) {
       _key_broker_fail_w_msg (
          kb, "trying to retrieve key from cache in invalid state");
       goto cleanup;
    }
 
    attr = _mongocrypt_cache_key_attr_new (&req->id, req->alt_name);
-   if (!_mongocrypt_cache_get (&kb->crypt->cache_key, attr, (void **) &value)) {
+   if (!_mongocrypt_cache_get_refresh_ahead (
+          &kb->crypt->cache_key, attr, (void **) &value, &refresh)) {
       _key_broker_fail_w_msg (kb, "failed to retrieve from cache");
       goto cleanup;
    }
 
-   if (value) {
-      key_returned_t *key_returned;
-
+   /* The entry is close to expiring and this context was chosen to refresh
+    * it. Fetch the key as if it missed. Other contexts are still served the
+    * cached entry until _store_to_cache replaces it. */
+   if (refresh) {
+      req->refresh_claimed = true;
+   }
+   if (value && !refresh) {
       req->satisfied = true;
       if (_mongocrypt_buffer_empty (&value->decrypted_key_material)) {
          _key_broker_fail_w_msg (
@@ -175,17 +262,13 @@ _try_satisfying_from_cache (_mongocrypt_key_broker_t *kb, key_request_t *req)
          goto cleanup;
       }
 
-      /* Add the cached key to our locally copied list.
+      /* Add the cached key to our list of borrowed keys.
        * Note, we deduplicate requests, but *not* keys from the cache,
        * because the state of the cache may change between each call to
        * _mongocrypt_cache_get.
        */
-      key_returned =
-         _key_returned_prepend (kb, &kb->keys_cached, value->key_doc);
-      _mongocrypt_buffer_init (&key_returned->decrypted_key_material);
-      _mongocrypt_buffer_copy_to (&value->decrypted_key_material,
-                                  &key_returned->decrypted_key_material);
-      key_returned->decrypted = true;
+      _key_returned_prepend_cached (kb, value /* takes ownership */);
+      value = NULL;
    }
 
    ret = true;
@@ -214,6 +297,7 @@ _store_to_cache (_mongocrypt_key_broker_t *kb, key_returned_t *key_returned)
    }
    value = _mongocrypt_cache_key_value_new (
       key_returned->doc, &key_returned->decrypted_key_material);
+   key_returned->stored_value = _mongocrypt_cache_key_value_ref (value);
    ret = _mongocrypt_cache_add_stolen (
       &kb->crypt->cache_key, attr, value, kb->status);
    _mongocrypt_cache_key_attr_destroy (attr);
@@ -223,6 +307,167 @@ _store_to_cache (_mongocrypt_key_broker_t *kb, key_returned_t *key_returned)
    return true;
 }
 
+
+/* Find an in-flight fetch of @id. Caller must hold crypt->mutex. */
+static key_fetch_t *
+_key_fetch_find (mongocrypt_t *crypt, const _mongocrypt_buffer_t *id)
+{
+   key_fetch_t *fetch;
+
+   for (fetch = crypt->key_fetches; NULL != fetch; fetch = fetch->next) {
+      if (0 == _mongocrypt_buffer_cmp (&fetch->id, id)) {
+         return fetch;
+      }
+   }
+   return NULL;
+}
+
+
+/* Register @req as fetched by @kb. Caller must hold crypt->mutex. */
+static void
+_key_fetch_register (_mongocrypt_key_broker_t *kb, key_request_t *req)
+{
+   mongocrypt_t *crypt = kb->crypt;
+   key_fetch_t *fetch;
+
+   fetch = bson_malloc0 (sizeof (*fetch));
+   BSON_ASSERT (fetch);
+   _mongocrypt_buffer_copy_to (&req->id, &fetch->id);
+   fetch->owner = kb;
+   fetch->next = crypt->key_fetches;
+   crypt->key_fetches = fetch;
+   kb->owns_fetches = true;
+}
+
+
+/* Remove all fetches owned by @kb. */
+static void
+_key_fetch_release (_mongocrypt_key_broker_t *kb)
+{
+   mongocrypt_t *crypt = kb->crypt;
+   key_fetch_t **link;
+
+   if (!kb->owns_fetches) {
+      return;
+   }
+
+   _mongocrypt_mutex_lock (&crypt->mutex);
+   link = &crypt->key_fetches;
+   while (*link) {
+      key_fetch_t *fetch = *link;
+
+      if (fetch->owner == kb) {
+         *link = fetch->next;
+         _mongocrypt_buffer_cleanup (&fetch->id);
+         bson_free (fetch);
+      } else {
+         link = &fetch->next;
+      }
+   }
+   _mongocrypt_mutex_unlock (&crypt->mutex);
+   kb->owns_fetches = false;
+}
+
+
+/* Coalesce fetches of unsatisfied key ids with other key brokers.
+ *
+ * Requests for key ids another key broker is fetching are deferred. They are
+ * left out of the filter, and _key_fetch_poll checks the cache for them each
+ * time the driver is done adding key documents. Remaining unsatisfied key ids
+ * are registered as fetched by @kb. Keys requested by keyAltName are not
+ * coalesced. This never blocks. */
+static void
+_key_fetch_coalesce (_mongocrypt_key_broker_t *kb)
+{
+   mongocrypt_t *crypt = kb->crypt;
+   key_request_t *req;
+
+   kb->fetch_deadline = bson_get_monotonic_time () / 1000 +
+                        (int64_t) crypt->opts.key_fetch_max_wait_ms;
+   kb->fetch_wait_ms = KEY_FETCH_WAIT_MIN_MS;
+
+   _mongocrypt_mutex_lock (&crypt->mutex);
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      key_fetch_t *fetch;
+
+      if (req->satisfied || req->alt_name) {
+         continue;
+      }
+      fetch = _key_fetch_find (crypt, &req->id);
+      if (fetch) {
+         req->deferred = fetch->owner != kb;
+         continue;
+      }
+      _key_fetch_register (kb, req);
+   }
+   _mongocrypt_mutex_unlock (&crypt->mutex);
+}
+
+
+/* Returns true if every unsatisfied request of @kb is deferred, so there is
+ * nothing to fetch until other key brokers finish. */
+static bool
+_key_fetch_waiting (_mongocrypt_key_broker_t *kb)
+{
+   key_request_t *req;
+   bool waiting = false;
+
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      if (req->satisfied) {
+         continue;
+      }
+      if (!req->deferred) {
+         return false;
+      }
+      waiting = true;
+   }
+   return waiting;
+}
+
+
+/* Check the cache for the deferred requests of @kb. A deferred request still
+ * missing from the cache is no longer deferred once the other key broker
+ * stops fetching it, or once the wait expires, and @kb fetches it itself.
+ * Sets @again if the driver must fetch key documents again, either to poll
+ * the deferred requests or to fetch the ones no longer deferred. */
+static bool
+_key_fetch_poll (_mongocrypt_key_broker_t *kb, bool *again)
+{
+   mongocrypt_t *crypt = kb->crypt;
+   key_request_t *req;
+   bool expired;
+
+   *again = false;
+   expired = bson_get_monotonic_time () / 1000 >= kb->fetch_deadline;
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      key_fetch_t *fetch;
+
+      if (!req->deferred) {
+         continue;
+      }
+      if (!_try_satisfying_from_cache (kb, req)) {
+         return false;
+      }
+      if (req->satisfied) {
+         req->deferred = false;
+         continue;
+      }
+
+      *again = true;
+      _mongocrypt_mutex_lock (&crypt->mutex);
+      fetch = _key_fetch_find (crypt, &req->id);
+      if (!fetch) {
+         req->deferred = false;
+         _key_fetch_register (kb, req);
+      } else if (expired || req->refresh_claimed) {
+         /* Fetch the key anyway without registering. */
+         req->deferred = false;
+      }
+      _mongocrypt_mutex_unlock (&crypt->mutex);
+   }
+   return true;
+}
+
 bool
 _mongocrypt_key_broker_request_id (_mongocrypt_key_broker_t *kb,
                                    const _mongocrypt_buffer_t *key_id)
@@ -295,6 +540,11 @@ _mongocrypt_key_broker_requests_done (_mongocrypt_key_broker_t *kb)
          kb, "attempting to finish adding requests, but in wrong state");
    }
 
+   if (kb->key_requests && kb->crypt->opts.key_fetch_max_wait_ms &&
+       !_all_key_requests_satisfied (kb)) {
+      _key_fetch_coalesce (kb);
+   }
+
    if (kb->key_requests) {
       /* If all were satisfied from the cache, then we're done since those all
        * have decrypted material */
@@ -327,6 +577,11 @@ _mongocrypt_key_broker_filter (_mongocrypt_key_broker_t *kb,
          kb, "attempting to retrieve filter, but in wrong state");
    }
 
+   if (_key_fetch_waiting (kb)) {
+      return _key_broker_fail_w_msg (
+         kb, "attempting to retrieve filter, but waiting on other fetches");
+   }
+
    if (!_mongocrypt_buffer_empty (&kb->filter)) {
       _mongocrypt_buffer_to_binary (&kb->filter, out);
       return true;
@@ -336,7 +591,7 @@ _mongocrypt_key_broker_filter (_mongocrypt_key_broker_t *kb,
    bson_init (&ids);
 
    for (req = kb->key_requests; NULL != req; req = req->next) {
-      if (req->satisfied) {
+      if (req->satisfied || req->deferred) {
          continue;
       }
 
@@ -410,6 +665,16 @@ _mongocrypt_key_broker_filter (_mongocrypt_key_broker_t *kb,
    return true;
 }
 
+static const _mongocrypt_endpoint_t *
+_kmip_endpoint (_mongocrypt_key_broker_t *kb,
+                const _mongocrypt_key_doc_t *key_doc)
+{
+   if (key_doc->kek.provider.kmip.endpoint) {
+      return key_doc->kek.provider.kmip.endpoint;
+   }
+   return kb->crypt->opts.kms_provider_kmip.endpoint;
+}
+
 bool
 _mongocrypt_key_broker_add_doc (_mongocrypt_key_broker_t *kb,
                                 const _mongocrypt_buffer_t *doc)
@@ -486,11 +751,13 @@ _mongocrypt_key_broker_add_doc (_mongocrypt_key_broker_t *kb,
          goto done;
       }
    } else if (kek_provider == MONGOCRYPT_KMS_PROVIDER_AWS) {
-      if (!_mongocrypt_kms_ctx_init_aws_decrypt (&key_returned->kms,
-                                                 &kb->crypt->opts,
-                                                 key_doc,
-                                                 &kb->crypt->log,
-                                                 kb->crypt->crypto)) {
+      if (!_mongocrypt_kms_ctx_init_aws_decrypt (
+             &key_returned->kms,
+             &kb->crypt->opts,
+             key_doc,
+             &kb->crypt->log,
+             kb->crypt->crypto,
+             &kb->crypt->cache_signing_key)) {
          mongocrypt_kms_ctx_status (&key_returned->kms, kb->status);
          _key_broker_fail (kb);
          goto done;
@@ -555,33 +822,17 @@ _mongocrypt_key_broker_add_doc (_mongocrypt_key_broker_t *kb,
          }
       }
    } else if (kek_provider == MONGOCRYPT_KMS_PROVIDER_KMIP) {
-      char *unique_identifier;
-      _mongocrypt_endpoint_t *endpoint;
-
+      /* The KMS request is created once all documents are added, in
+       * _init_kmip_batches. */
       if (!key_returned->doc->kek.provider.kmip.key_id) {
          _key_broker_fail_w_msg (kb, "KMIP key malformed, no keyId present");
          goto done;
       }
 
-      unique_identifier = key_returned->doc->kek.provider.kmip.key_id;
-
-      if (key_returned->doc->kek.provider.kmip.endpoint) {
-         endpoint = key_returned->doc->kek.provider.kmip.endpoint;
-      } else if (kb->crypt->opts.kms_provider_kmip.endpoint) {
-         endpoint = kb->crypt->opts.kms_provider_kmip.endpoint;
-      } else {
+      if (!_kmip_endpoint (kb, key_returned->doc)) {
          _key_broker_fail_w_msg (kb, "endpoint not set for KMIP request");
          goto done;
       }
-
-      if (!_mongocrypt_kms_ctx_init_kmip_get (&key_returned->kms,
-                                              endpoint,
-                                              unique_identifier,
-                                              &kb->crypt->log)) {
-         mongocrypt_kms_ctx_status (&key_returned->kms, kb->status);
-         _key_broker_fail (kb);
-         goto done;
-      }
    } else {
       _key_broker_fail_w_msg (kb, "unrecognized kms provider");
       goto done;
@@ -606,12 +857,73 @@ done:
    return ret;
 }
 
+/* Create one KMIP Get request per endpoint for the KEKs of the KMIP keys
+ * returned, rather than one per key. Keys wrapped by the same KEK share a batch
+ * item. A batch holds at most KMIP_MAX_BATCH_COUNT KEKs. */
+static bool
+_init_kmip_batches (_mongocrypt_key_broker_t *kb)
+{
+   key_returned_t *leader;
+   key_returned_t *key_returned;
+   const char *key_ids[KMIP_MAX_BATCH_COUNT];
+
+   for (leader = kb->keys_returned; NULL != leader; leader = leader->next) {
+      const _mongocrypt_endpoint_t *endpoint;
+      uint32_t count = 0;
+
+      if (leader->doc->kek.kms_provider != MONGOCRYPT_KMS_PROVIDER_KMIP ||
+          leader->kmip_batch) {
+         continue;
+      }
+
+      endpoint = _kmip_endpoint (kb, leader->doc);
+      for (key_returned = leader; NULL != key_returned;
+           key_returned = key_returned->next) {
+         const char *key_id;
+         uint32_t i;
+
+         if (key_returned->doc->kek.kms_provider !=
+                MONGOCRYPT_KMS_PROVIDER_KMIP ||
+             key_returned->kmip_batch ||
+             0 != strcmp (_kmip_endpoint (kb, key_returned->doc)->host_and_port,
+                          endpoint->host_and_port)) {
+            continue;
+         }
+
+         key_id = key_returned->doc->kek.provider.kmip.key_id;
+         for (i = 0; i < count; i++) {
+            if (0 == strcmp (key_ids[i], key_id)) {
+               break;
+            }
+         }
+         if (i == count) {
+            if (count == KMIP_MAX_BATCH_COUNT) {
+               /* Left for a later batch. */
+               continue;
+            }
+            key_ids[count++] = key_id;
+         }
+         key_returned->kmip_batch = leader;
+         key_returned->kmip_batch_index = i;
+      }
+
+      if (!_mongocrypt_kms_ctx_init_kmip_get_batch (
+             &leader->kms, endpoint, key_ids, count, &kb->crypt->log)) {
+         mongocrypt_kms_ctx_status (&leader->kms, kb->status);
+         return _key_broker_fail (kb);
+      }
+   }
+   return true;
+}
+
 bool
 _mongocrypt_key_broker_docs_done (_mongocrypt_key_broker_t *kb)
 {
    key_returned_t *key_returned;
    bool needs_decryption;
    bool needs_auth;
+   bool waited;
+   bool again;
 
    if (kb->state != KB_ADDING_DOCS) {
       return _key_broker_fail_w_msg (
@@ -619,11 +931,30 @@ _mongocrypt_key_broker_docs_done (_mongocrypt_key_broker_t *kb)
    }
 
    /* If there are any requests left unsatisfied, error. */
-   if (!_all_key_requests_satisfied (kb)) {
+   if (!_filtered_key_requests_satisfied (kb)) {
       return _key_broker_fail_w_msg (kb,
                                      "not all keys requested were satisfied");
    }
 
+   waited = _key_fetch_waiting (kb);
+   if (!_key_fetch_poll (kb, &again)) {
+      return false;
+   }
+   if (again) {
+      /* Stay in KB_ADDING_DOCS, and build a new filter for the next round. */
+      _mongocrypt_buffer_cleanup (&kb->filter);
+      _mongocrypt_buffer_init (&kb->filter);
+      if (waited) {
+         kb->fetch_wait_ms =
+            BSON_MIN (kb->fetch_wait_ms * 2, KEY_FETCH_WAIT_MAX_MS);
+      }
+      return true;
+   }
+
+   if (!_init_kmip_batches (kb)) {
+      return false;
+   }
+
    /* Transition to the next state.
     *  - If there are any Azure or GCP backed keys, and no oauth token is
     * cached, transition to KB_AUTHENTICATING.
@@ -651,10 +982,26 @@ _mongocrypt_key_broker_docs_done (_mongocrypt_key_broker_t *kb)
       kb->state = KB_DECRYPTING_KEY_MATERIAL;
    } else {
       kb->state = KB_DONE;
+      _key_fetch_release (kb);
+      _refresh_done (kb);
    }
    return true;
 }
 
+uint32_t
+_mongocrypt_key_broker_wait_ms (_mongocrypt_key_broker_t *kb)
+{
+   int64_t remaining;
+
+   if (kb->state != KB_ADDING_DOCS || !_key_fetch_waiting (kb)) {
+      return 0;
+   }
+   /* Wait at least a millisecond, since there is nothing to fetch until the
+    * deferred requests are polled again. */
+   remaining = kb->fetch_deadline - bson_get_monotonic_time () / 1000;
+   return (uint32_t) BSON_MAX (1, BSON_MIN (kb->fetch_wait_ms, remaining));
+}
+
 mongocrypt_kms_ctx_t *
 _mongocrypt_key_broker_next_kms (_mongocrypt_key_broker_t *kb)
 {
@@ -691,7 +1038,10 @@ _mongocrypt_key_broker_next_kms (_mongocrypt_key_broker_t *kb)
    }
 
    while (kb->decryptor_iter) {
-      if (!kb->decryptor_iter->decrypted) {
+      /* A KMIP key is decrypted with the kms context of its batch. */
+      if (!kb->decryptor_iter->decrypted &&
+          (!kb->decryptor_iter->kmip_batch ||
+           kb->decryptor_iter->kmip_batch == kb->decryptor_iter)) {
          key_returned_t *key_returned;
 
          key_returned = kb->decryptor_iter;
@@ -845,8 +1195,11 @@ _mongocrypt_key_broker_kms_done (_mongocrypt_key_broker_t *kb)
       } else if (key_returned->doc->kek.kms_provider ==
                  MONGOCRYPT_KMS_PROVIDER_KMIP) {
          _mongocrypt_buffer_t kek;
-         if (!_mongocrypt_kms_ctx_result (&key_returned->kms, &kek)) {
-            mongocrypt_kms_ctx_status (&key_returned->kms, kb->status);
+         mongocrypt_kms_ctx_t *kms = &key_returned->kmip_batch->kms;
+
+         if (!_mongocrypt_kms_ctx_batch_result (
+                kms, key_returned->kmip_batch_index, &kek)) {
+            mongocrypt_kms_ctx_status (kms, kb->status);
             return _key_broker_fail (kb);
          }
 
@@ -877,62 +1230,248 @@ _mongocrypt_key_broker_kms_done (_mongocrypt_key_broker_t *kb)
    }
 
    kb->state = KB_DONE;
+   _key_fetch_release (kb);
+   _refresh_done (kb);
    return true;
 }
 
 
-bool
-_get_decrypted_key_material (_mongocrypt_key_broker_t *kb,
-                             _mongocrypt_buffer_t *key_id,
-                             _mongocrypt_key_alt_name_t *key_alt_name,
-                             _mongocrypt_buffer_t *out,
-                             _mongocrypt_buffer_t *key_id_out)
+static uint32_t
+_key_index_hash_alt_name (const char *alt_name)
 {
+   return _mongocrypt_cache_hash_bytes ((const uint8_t *) alt_name,
+                                        (uint32_t) strlen (alt_name));
+}
+
+
+static bool
+_key_index_entry_matches (const key_index_entry_t *entry,
+                          uint32_t hash,
+                          const _mongocrypt_buffer_t *id,
+                          const char *alt_name)
+{
+   if (entry->hash != hash) {
+      return false;
+   }
+   if (id) {
+      return entry->id && 0 == _mongocrypt_buffer_cmp (entry->id, id);
+   }
+   return entry->alt_name && 0 == strcmp (entry->alt_name, alt_name);
+}
+
+
+/* Find the entry for @id or @alt_name (only one is set), or the unused entry
+ * where it would be inserted. */
+static key_index_entry_t *
+_key_index_find (_mongocrypt_key_broker_t *kb,
+                 uint32_t hash,
+                 const _mongocrypt_buffer_t *id,
+                 const char *alt_name)
+{
+   uint32_t mask = kb->key_index_size - 1;
+   uint32_t i;
+
+   for (i = hash & mask;; i = (i + 1) & mask) {
+      key_index_entry_t *entry = &kb->key_index[i];
+
+      if (!entry->key_returned ||
+          _key_index_entry_matches (entry, hash, id, alt_name)) {
+         return entry;
+      }
+   }
+}
+
+
+/* Add @key_returned to the index by @id or @alt_name. An earlier key with the
+ * same _id or keyAltName is kept, matching the order lists were searched. */
+static void
+_key_index_add (_mongocrypt_key_broker_t *kb,
+                key_returned_t *key_returned,
+                const _mongocrypt_buffer_t *id,
+                const char *alt_name)
+{
+   key_index_entry_t *entry;
+   uint32_t hash;
+
+   hash = id ? _mongocrypt_cache_hash_bytes (id->data, id->len)
+             : _key_index_hash_alt_name (alt_name);
+   entry = _key_index_find (kb, hash, id, alt_name);
+   if (entry->key_returned) {
+      return;
+   }
+   entry->hash = hash;
+   entry->id = id;
+   entry->alt_name = alt_name;
+   entry->key_returned = key_returned;
+}
+
+
+static void
+_key_index_build (_mongocrypt_key_broker_t *kb)
+{
+   key_returned_t *lists[2];
    key_returned_t *key_returned;
+   _mongocrypt_key_alt_name_t *alt_name;
+   uint32_t count = 0;
+   uint32_t size;
+   int i;
+
+   /* Keys returned from the driver take precedence over keys from the cache.
+    */
+   lists[0] = kb->keys_returned;
+   lists[1] = kb->keys_cached;
+
+   for (i = 0; i < 2; i++) {
+      for (key_returned = lists[i]; key_returned;
+           key_returned = key_returned->next) {
+         count++;
+         for (alt_name = key_returned->doc->key_alt_names; alt_name;
+              alt_name = alt_name->next) {
+            count++;
+         }
+      }
+   }
+
+   /* Keep the load factor at most one half. */
+   size = 8;
+   while (size < 2 * count) {
+      size *= 2;
+   }
+   kb->key_index = bson_malloc0 (size * sizeof (key_index_entry_t));
+   BSON_ASSERT (kb->key_index);
+   kb->key_index_size = size;
+
+   for (i = 0; i < 2; i++) {
+      for (key_returned = lists[i]; key_returned;
+           key_returned = key_returned->next) {
+         _key_index_add (
+            kb, key_returned, &key_returned->doc->id, NULL /* alt name */);
+         for (alt_name = key_returned->doc->key_alt_names; alt_name;
+              alt_name = alt_name->next) {
+            _key_index_add (kb,
+                            key_returned,
+                            NULL /* id */,
+                            _mongocrypt_key_alt_name_get_string (alt_name));
+         }
+      }
+   }
+}
+
+
+static void
+_key_index_destroy (_mongocrypt_key_broker_t *kb)
+{
+   bson_free (kb->key_index);
+   kb->key_index = NULL;
+   kb->key_index_size = 0;
+}
+
+
+/* Only reads @kb once the index is built, and reports errors through @status
+ * rather than failing @kb, so lookups may run concurrently. */
+static bool
+_get_decrypted_key_material (
+   _mongocrypt_key_broker_t *kb,
+   _mongocrypt_buffer_t *key_id,
+   _mongocrypt_key_alt_name_t *key_alt_name,
+   _mongocrypt_buffer_t *out,
+   const _mongocrypt_prepared_key_t **prepared_key_out,
+   _mongocrypt_buffer_t *key_id_out,
+   mongocrypt_status_t *status)
+{
+   key_returned_t *key_returned = NULL;
+   key_index_entry_t *entry;
+   _mongocrypt_cache_key_value_t *value;
 
    _mongocrypt_buffer_init (out);
+   if (prepared_key_out) {
+      *prepared_key_out = NULL;
+   }
    if (key_id_out) {
       _mongocrypt_buffer_init (key_id_out);
    }
-   /* Search both keys_returned and keys_cached. */
 
-   key_returned =
-      _key_returned_find_one (kb->keys_returned, key_id, key_alt_name);
-   if (!key_returned) {
-      /* Try the keys retrieved from the cache. */
-      key_returned =
-         _key_returned_find_one (kb->keys_cached, key_id, key_alt_name);
+   /* Keys are only looked up once the key broker is done. Index both
+    * keys_returned and keys_cached once rather than searching them for each
+    * field. */
+   if (!kb->key_index) {
+      _key_index_build (kb);
+   }
+
+   if (key_id) {
+      entry = _key_index_find (
+         kb,
+         _mongocrypt_cache_hash_bytes (key_id->data, key_id->len),
+         key_id,
+         NULL /* alt name */);
+      key_returned = entry->key_returned;
+   }
+
+   for (; !key_returned && key_alt_name; key_alt_name = key_alt_name->next) {
+      const char *name = _mongocrypt_key_alt_name_get_string (key_alt_name);
+
+      entry = _key_index_find (
+         kb, _key_index_hash_alt_name (name), NULL /* id */, name);
+      key_returned = entry->key_returned;
    }
 
    if (!key_returned) {
-      return _key_broker_fail_w_msg (kb, "could not find key");
+      CLIENT_ERR ("could not find key");
+      return false;
    }
 
    if (!key_returned->decrypted) {
-      return _key_broker_fail_w_msg (kb, "unexpected, key not decrypted");
+      CLIENT_ERR ("unexpected, key not decrypted");
+      return false;
    }
 
-   _mongocrypt_buffer_copy_to (&key_returned->decrypted_key_material, out);
+   _mongocrypt_buffer_set_to (&key_returned->decrypted_key_material, out);
    if (key_id_out) {
-      _mongocrypt_buffer_copy_to (&key_returned->doc->id, key_id_out);
+      _mongocrypt_buffer_set_to (&key_returned->doc->id, key_id_out);
+   }
+   value = key_returned->cache_value ? key_returned->cache_value
+                                     : key_returned->stored_value;
+   if (prepared_key_out && value) {
+      *prepared_key_out =
+         _mongocrypt_cache_key_value_prepared_key (value, kb->crypt->crypto);
    }
    return true;
 }
 
+void
+_mongocrypt_key_broker_prepare_lookups (_mongocrypt_key_broker_t *kb)
+{
+   BSON_ASSERT (kb);
+
+   if (kb->state == KB_DONE && !kb->key_index) {
+      _key_index_build (kb);
+   }
+}
+
 bool
-_mongocrypt_key_broker_decrypted_key_by_id (_mongocrypt_key_broker_t *kb,
-                                            const _mongocrypt_buffer_t *key_id,
-                                            _mongocrypt_buffer_t *out)
+_mongocrypt_key_broker_decrypted_key_by_id (
+   _mongocrypt_key_broker_t *kb,
+   const _mongocrypt_buffer_t *key_id,
+   _mongocrypt_buffer_t *out,
+   const _mongocrypt_prepared_key_t **prepared_key_out,
+   mongocrypt_status_t *status)
 {
    if (kb->state != KB_DONE) {
-      return _key_broker_fail_w_msg (
-         kb, "attempting retrieve decrypted key material, but in wrong state");
+      _mongocrypt_buffer_init (out);
+      if (prepared_key_out) {
+         *prepared_key_out = NULL;
+      }
+      CLIENT_ERR (
+         "attempting retrieve decrypted key material, but in wrong state");
+      return false;
    }
    return _get_decrypted_key_material (kb,
                                        (_mongocrypt_buffer_t *) key_id,
                                        NULL /* key alt name */,
                                        out,
-                                       NULL /* key id out */);
+                                       prepared_key_out,
+                                       NULL /* key id out */,
+                                       status);
 }
 
 bool
@@ -940,18 +1479,29 @@ _mongocrypt_key_broker_decrypted_key_by_name (
    _mongocrypt_key_broker_t *kb,
    const bson_value_t *key_alt_name_value,
    _mongocrypt_buffer_t *out,
-   _mongocrypt_buffer_t *key_id_out)
+   const _mongocrypt_prepared_key_t **prepared_key_out,
+   _mongocrypt_buffer_t *key_id_out,
+   mongocrypt_status_t *status)
 {
    bool ret;
    _mongocrypt_key_alt_name_t *key_alt_name;
 
    if (kb->state != KB_DONE) {
-      return _key_broker_fail_w_msg (
-         kb, "attempting retrieve decrypted key material, but in wrong state");
+      _mongocrypt_buffer_init (out);
+      if (prepared_key_out) {
+         *prepared_key_out = NULL;
+      }
+      if (key_id_out) {
+         _mongocrypt_buffer_init (key_id_out);
+      }
+      CLIENT_ERR (
+         "attempting retrieve decrypted key material, but in wrong state");
+      return false;
    }
 
    key_alt_name = _mongocrypt_key_alt_name_new (key_alt_name_value);
-   ret = _get_decrypted_key_material (kb, NULL, key_alt_name, out, key_id_out);
+   ret = _get_decrypted_key_material (
+      kb, NULL, key_alt_name, out, prepared_key_out, key_id_out, status);
    _mongocrypt_key_alt_name_destroy_all (key_alt_name);
    return ret;
 }
@@ -995,8 +1545,14 @@ _destroy_keys_returned (key_returned_t *head)
    while (head) {
       tmp = head->next;
 
-      _mongocrypt_key_destroy (head->doc);
-      _mongocrypt_buffer_cleanup (&head->decrypted_key_material);
+      if (head->cache_value) {
+         /* doc and decrypted_key_material are borrowed. */
+         _mongocrypt_cache_key_value_destroy (head->cache_value);
+      } else {
+         _mongocrypt_key_destroy (head->doc);
+         _mongocrypt_buffer_cleanse (&head->decrypted_key_material);
+      }
+      _mongocrypt_cache_key_value_destroy (head->stored_value);
       _mongocrypt_kms_ctx_cleanup (&head->kms);
 
       bson_free (head);
@@ -1007,6 +1563,9 @@ _destroy_keys_returned (key_returned_t *head)
 void
 _mongocrypt_key_broker_cleanup (_mongocrypt_key_broker_t *kb)
 {
+   /* Wake waiters if this broker did not finish its fetches. */
+   _key_fetch_release (kb);
+   _mongocrypt_key_broker_release_refresh (kb);
    mongocrypt_status_destroy (kb->status);
    _mongocrypt_buffer_cleanup (&kb->filter);
    /* Delete all linked lists */
@@ -1015,6 +1574,7 @@ _mongocrypt_key_broker_cleanup (_mongocrypt_key_broker_t *kb)
    _destroy_key_requests (kb->key_requests);
    _mongocrypt_kms_ctx_cleanup (&kb->auth_request_azure.kms);
    _mongocrypt_kms_ctx_cleanup (&kb->auth_request_gcp.kms);
+   _key_index_destroy (kb);
 }
 
 void
@@ -1035,6 +1595,8 @@ _mongocrypt_key_broker_add_test_key (_mongocrypt_key_broker_t *kb,
                               MONGOCRYPT_KEY_LEN);
    memset (key_returned->decrypted_key_material.data, 0, MONGOCRYPT_KEY_LEN);
    _mongocrypt_key_destroy (key_doc);
+   /* Rebuild the index to include the new key on the next lookup. */
+   _key_index_destroy (kb);
    /* Hijack state and move directly to DONE. */
    kb->state = KB_DONE;
 }
\ No newline at end of file
@@ -51,6 +51,12 @@ struct _mongocrypt_kms_ctx_t {
    _mongocrypt_buffer_t result;
    char *endpoint;
    _mongocrypt_log_t *log;
+   /* Whether the request asked the server to keep the connection open. */
+   bool keep_alive;
+   /* The number of identifiers in a KMIP Get. If more than one, the SecretData
+    * of each is stored in batch_results instead of result. */
+   uint32_t batch_count;
+   _mongocrypt_buffer_t *batch_results;
 };
 
 
@@ -59,7 +65,8 @@ _mongocrypt_kms_ctx_init_aws_decrypt (mongocrypt_kms_ctx_t *kms,
                                       _mongocrypt_opts_t *crypt_opts,
                                       _mongocrypt_key_doc_t *key,
                                       _mongocrypt_log_t *log,
-                                      _mongocrypt_crypto_t *crypto)
+                                      _mongocrypt_crypto_t *crypto,
+                                      _mongocrypt_cache_t *cache_signing_key)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
@@ -70,7 +77,8 @@ _mongocrypt_kms_ctx_init_aws_encrypt (
    struct __mongocrypt_ctx_opts_t *ctx_opts,
    _mongocrypt_buffer_t *decrypted_key_material,
    _mongocrypt_log_t *log,
-   _mongocrypt_crypto_t *crypto) MONGOCRYPT_WARN_UNUSED_RESULT;
+   _mongocrypt_crypto_t *crypto,
+   _mongocrypt_cache_t *cache_signing_key) MONGOCRYPT_WARN_UNUSED_RESULT;
 
 bool
 _mongocrypt_kms_ctx_result (mongocrypt_kms_ctx_t *kms,
@@ -150,4 +158,22 @@ _mongocrypt_kms_ctx_init_kmip_get (mongocrypt_kms_ctx_t *kms,
                                    _mongocrypt_log_t *log)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Get the @count KMIP objects @unique_identifiers from one endpoint in a single
+ * request. Read the result of each with _mongocrypt_kms_ctx_batch_result. */
+bool
+_mongocrypt_kms_ctx_init_kmip_get_batch (
+   mongocrypt_kms_ctx_t *kms,
+   const _mongocrypt_endpoint_t *endpoint,
+   const char *const *unique_identifiers,
+   uint32_t count,
+   _mongocrypt_log_t *log) MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Like _mongocrypt_kms_ctx_result, for the identifier at @index of a context
+ * initialized with _mongocrypt_kms_ctx_init_kmip_get_batch. */
+bool
+_mongocrypt_kms_ctx_batch_result (mongocrypt_kms_ctx_t *kms,
+                                  uint32_t index,
+                                  _mongocrypt_buffer_t *out)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 #endif /* MONGOCRYPT_KMX_CTX_PRIVATE_H */
@@ -18,6 +18,7 @@
 #include "mongocrypt-private.h"
 #include "mongocrypt-binary-private.h"
 #include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-signing-key-private.h"
 #include "mongocrypt-ctx-private.h"
 #include "mongocrypt-kms-ctx-private.h"
 #include "mongocrypt-opts-private.h"
@@ -108,6 +109,33 @@ _set_kms_crypto_hooks (_mongocrypt_crypto_t *crypto,
    }
 }
 
+/* Ask the KMS server to close the connection after responding, or, if
+ * enabled, to keep it open for the next request to the same endpoint. */
+static void
+_set_connection_opt (mongocrypt_kms_ctx_t *kms,
+                     _mongocrypt_opts_t *crypt_opts,
+                     kms_request_opt_t *opt)
+{
+   kms->keep_alive = crypt_opts->kms_keep_alive;
+   if (kms->keep_alive) {
+      kms_request_opt_set_connection_keep_alive (opt, true);
+   } else {
+      kms_request_opt_set_connection_close (opt, true);
+   }
+}
+
+/* The server may close the connection even if asked to keep it open. */
+static void
+_update_keep_alive (mongocrypt_kms_ctx_t *kms, kms_response_t *response)
+{
+   const char *connection;
+
+   connection = kms_response_get_header (response, "Connection");
+   if (connection && 0 == bson_strcasecmp (connection, "close")) {
+      kms->keep_alive = false;
+   }
+}
+
 static bool
 is_kms (_kms_request_type_t kms_type)
 {
@@ -129,15 +157,103 @@ _init_common (mongocrypt_kms_ctx_t *kms,
    kms->log = log;
    kms->status = mongocrypt_status_new ();
    kms->req_type = kms_type;
+   kms->keep_alive = false;
    _mongocrypt_buffer_init (&kms->result);
 }
 
+/* Set the date of the AWS request @kms->req to now, and its signing key from
+ * @cache_signing_key. On a miss the key is derived and added to the cache. It
+ * only changes once per UTC day for a credential, region and service. */
+static bool
+_set_aws_signing_key (mongocrypt_kms_ctx_t *kms,
+                      _mongocrypt_opts_t *crypt_opts,
+                      const char *region,
+                      _mongocrypt_cache_t *cache_signing_key)
+{
+   mongocrypt_status_t *status = kms->status;
+   _mongocrypt_buffer_t attr;
+   _mongocrypt_buffer_t *cached = NULL;
+   _mongocrypt_buffer_t signing_key;
+   unsigned char key[MONGOCRYPT_SIGNING_KEY_LEN];
+   char date[sizeof "YYYYmmDD"];
+   struct tm tm;
+   time_t t;
+   bool ret = false;
+
+   _mongocrypt_buffer_init (&attr);
+   _mongocrypt_buffer_init (&signing_key);
+
+   /* Set the date explicitly, so the signing key is derived from the same day
+    * as the attribute. */
+   time (&t);
+#ifdef _WIN32
+   gmtime_s (&tm, &t);
+#else
+   gmtime_r (&t, &tm);
+#endif
+   if (0 == strftime (date, sizeof date, "%Y%m%d", &tm) ||
+       !kms_request_set_date (kms->req, &tm)) {
+      CLIENT_ERR ("failed to set date");
+      goto done;
+   }
+
+   if (!_mongocrypt_cache_signing_key_attr (
+          crypt_opts->kms_provider_aws.access_key_id,
+          &crypt_opts->kms_provider_aws.secret_access_key_digest,
+          date,
+          region,
+          "kms",
+          &attr)) {
+      CLIENT_ERR ("could not create signing key cache attribute");
+      goto done;
+   }
+
+   if (!_mongocrypt_cache_get (cache_signing_key, &attr, (void **) &cached)) {
+      CLIENT_ERR ("failed to read signing key cache");
+      goto done;
+   }
+
+   if (cached) {
+      BSON_ASSERT (cached->len == MONGOCRYPT_SIGNING_KEY_LEN);
+      if (!kms_request_set_signing_key (kms->req, cached->data)) {
+         CLIENT_ERR ("failed to set signing key");
+         goto done;
+      }
+      ret = true;
+      goto done;
+   }
+
+   if (!kms_request_get_signing_key (kms->req, key) ||
+       !kms_request_set_signing_key (kms->req, key)) {
+      CLIENT_ERR ("failed to create signing key");
+      goto done;
+   }
+
+   signing_key.data = key;
+   signing_key.len = MONGOCRYPT_SIGNING_KEY_LEN;
+   if (!_mongocrypt_cache_add_copy (
+          cache_signing_key, &attr, &signing_key, status)) {
+      goto done;
+   }
+
+   ret = true;
+done:
+   if (cached) {
+      _mongocrypt_buffer_cleanse (cached);
+      bson_free (cached);
+   }
+   _mongocrypt_memzero (key, sizeof (key));
+   _mongocrypt_buffer_cleanse (&attr);
+   return ret;
+}
+
 bool
 _mongocrypt_kms_ctx_init_aws_decrypt (mongocrypt_kms_ctx_t *kms,
                                       _mongocrypt_opts_t *crypt_opts,
                                       _mongocrypt_key_doc_t *key,
                                       _mongocrypt_log_t *log,
-                                      _mongocrypt_crypto_t *crypto)
+                                      _mongocrypt_crypto_t *crypto,
+                                      _mongocrypt_cache_t *cache_signing_key)
 {
    kms_request_opt_t *opt;
    mongocrypt_status_t *status;
@@ -184,7 +300,7 @@ _mongocrypt_kms_ctx_init_aws_decrypt (mongocrypt_kms_ctx_t *kms,
    BSON_ASSERT (opt);
 
    _set_kms_crypto_hooks (crypto, &ctx_with_status, opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
 
    kms->req = kms_decrypt_request_new (
       key->key_material.data, key->key_material.len, opt);
@@ -235,6 +351,14 @@ _mongocrypt_kms_ctx_init_aws_decrypt (mongocrypt_kms_ctx_t *kms,
       goto done;
    }
 
+   if (!_set_aws_signing_key (kms,
+                              crypt_opts,
+                              key->kek.provider.aws.region,
+                              cache_signing_key)) {
+      _mongocrypt_status_append (status, ctx_with_status.status);
+      goto done;
+   }
+
    _mongocrypt_buffer_init (&kms->msg);
    kms->msg.data = (uint8_t *) kms_request_get_signed (kms->req);
    if (!kms->msg.data) {
@@ -270,7 +394,8 @@ _mongocrypt_kms_ctx_init_aws_encrypt (
    _mongocrypt_ctx_opts_t *ctx_opts,
    _mongocrypt_buffer_t *plaintext_key_material,
    _mongocrypt_log_t *log,
-   _mongocrypt_crypto_t *crypto)
+   _mongocrypt_crypto_t *crypto,
+   _mongocrypt_cache_t *cache_signing_key)
 {
    kms_request_opt_t *opt;
    mongocrypt_status_t *status;
@@ -318,7 +443,7 @@ _mongocrypt_kms_ctx_init_aws_encrypt (
 
 
    _set_kms_crypto_hooks (crypto, &ctx_with_status, opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
 
    kms->req = kms_encrypt_request_new (plaintext_key_material->data,
                                        plaintext_key_material->len,
@@ -371,6 +496,14 @@ _mongocrypt_kms_ctx_init_aws_encrypt (
       goto done;
    }
 
+   if (!_set_aws_signing_key (kms,
+                              crypt_opts,
+                              ctx_opts->kek.provider.aws.region,
+                              cache_signing_key)) {
+      _mongocrypt_status_append (status, ctx_with_status.status);
+      goto done;
+   }
+
    _mongocrypt_buffer_init (&kms->msg);
    kms->msg.data = (uint8_t *) kms_request_get_signed (kms->req);
    if (!kms->msg.data) {
@@ -436,6 +569,7 @@ _ctx_done_aws (mongocrypt_kms_ctx_t *kms, const char *json_field)
    /* Parse out the {en|de}crypted result. */
    http_status = kms_response_parser_status (kms->parser);
    response = kms_response_parser_get_response (kms->parser);
+   _update_keep_alive (kms, response);
    body = kms_response_get_body (response, &body_len);
 
    if (http_status != 200) {
@@ -529,6 +663,7 @@ _ctx_done_oauth (mongocrypt_kms_ctx_t *kms)
    /* Parse out the oauth token result (or error). */
    http_status = kms_response_parser_status (kms->parser);
    response = kms_response_parser_get_response (kms->parser);
+   _update_keep_alive (kms, response);
    body = kms_response_get_body (response, &body_len);
 
    if (body_len == 0) {
@@ -611,6 +746,7 @@ _ctx_done_azure_wrapkey_unwrapkey (mongocrypt_kms_ctx_t *kms)
    /* Parse out the oauth token result (or error). */
    http_status = kms_response_parser_status (kms->parser);
    response = kms_response_parser_get_response (kms->parser);
+   _update_keep_alive (kms, response);
    body = kms_response_get_body (response, &body_len);
 
    if (body_len == 0) {
@@ -690,6 +826,7 @@ _ctx_done_gcp (mongocrypt_kms_ctx_t *kms, const char *json_field)
    /* Parse out the {en|de}crypted result. */
    http_status = kms_response_parser_status (kms->parser);
    response = kms_response_parser_get_response (kms->parser);
+   _update_keep_alive (kms, response);
    body = kms_response_get_body (response, &body_len);
 
    if (http_status != 200) {
@@ -816,32 +953,58 @@ _ctx_done_kmip_activate (mongocrypt_kms_ctx_t *kms_ctx)
 }
 
 static bool
-_ctx_done_kmip_get (mongocrypt_kms_ctx_t *kms_ctx)
+_store_kmip_secretdata (mongocrypt_kms_ctx_t *kms_ctx,
+                        kms_response_t *res,
+                        uint32_t index,
+                        _mongocrypt_buffer_t *out)
 {
-   kms_response_t *res = NULL;
    mongocrypt_status_t *status = kms_ctx->status;
-   bool ret = false;
    uint8_t *secretdata;
    size_t secretdata_len;
 
-   res = kms_response_parser_get_response (kms_ctx->parser);
-   if (!res) {
-      CLIENT_ERR ("Error getting KMIP response: %s",
-                  kms_response_parser_error (kms_ctx->parser));
-      goto done;
-   }
-
-   secretdata = kms_kmip_response_get_secretdata (res, &secretdata_len);
+   secretdata =
+      kms_kmip_response_get_secretdata_at (res, index, &secretdata_len);
    if (!secretdata) {
       CLIENT_ERR ("Error getting SecretData from KMIP Get response: %s",
                   kms_response_get_error (res));
-      goto done;
+      return false;
    }
 
    if (!_mongocrypt_buffer_steal_from_data_and_size (
-          &kms_ctx->result, secretdata, secretdata_len)) {
+          out, secretdata, secretdata_len)) {
       CLIENT_ERR ("Error storing KMS SecretData result");
       bson_free (secretdata);
+      return false;
+   }
+   return true;
+}
+
+static bool
+_ctx_done_kmip_get (mongocrypt_kms_ctx_t *kms_ctx)
+{
+   kms_response_t *res = NULL;
+   mongocrypt_status_t *status = kms_ctx->status;
+   bool ret = false;
+   uint32_t i;
+
+   res = kms_response_parser_get_response (kms_ctx->parser);
+   if (!res) {
+      CLIENT_ERR ("Error getting KMIP response: %s",
+                  kms_response_parser_error (kms_ctx->parser));
+      goto done;
+   }
+
+   if (kms_ctx->batch_count > 1) {
+      kms_ctx->batch_results =
+         bson_malloc0 (kms_ctx->batch_count * sizeof (_mongocrypt_buffer_t));
+      BSON_ASSERT (kms_ctx->batch_results);
+      for (i = 0; i < kms_ctx->batch_count; i++) {
+         if (!_store_kmip_secretdata (
+                kms_ctx, res, i, &kms_ctx->batch_results[i])) {
+            goto done;
+         }
+      }
+   } else if (!_store_kmip_secretdata (kms_ctx, res, 0, &kms_ctx->result)) {
       goto done;
    }
 
@@ -963,6 +1126,28 @@ _mongocrypt_kms_ctx_result (mongocrypt_kms_ctx_t *kms,
 }
 
 
+bool
+_mongocrypt_kms_ctx_batch_result (mongocrypt_kms_ctx_t *kms,
+                                  uint32_t index,
+                                  _mongocrypt_buffer_t *out)
+{
+   if (!_mongocrypt_kms_ctx_result (kms, out)) {
+      return false;
+   }
+
+   if (kms->batch_count <= 1) {
+      BSON_ASSERT (index == 0);
+      return true;
+   }
+
+   BSON_ASSERT (kms->batch_results);
+   BSON_ASSERT (index < kms->batch_count);
+   out->data = kms->batch_results[index].data;
+   out->len = kms->batch_results[index].len;
+   return true;
+}
+
+
 bool
 mongocrypt_kms_ctx_status (mongocrypt_kms_ctx_t *kms,
                            mongocrypt_status_t *status_out)
@@ -996,6 +1181,14 @@ _mongocrypt_kms_ctx_cleanup (mongocrypt_kms_ctx_t *kms)
    mongocrypt_status_destroy (kms->status);
    _mongocrypt_buffer_cleanup (&kms->msg);
    _mongocrypt_buffer_cleanup (&kms->result);
+   if (kms->batch_results) {
+      uint32_t i;
+
+      for (i = 0; i < kms->batch_count; i++) {
+         _mongocrypt_buffer_cleanup (&kms->batch_results[i]);
+      }
+      bson_free (kms->batch_results);
+   }
    bson_free (kms->endpoint);
 }
 
@@ -1033,6 +1226,16 @@ mongocrypt_kms_ctx_endpoint (mongocrypt_kms_ctx_t *kms, const char **endpoint)
    return true;
 }
 
+bool
+mongocrypt_kms_ctx_keep_alive (mongocrypt_kms_ctx_t *kms)
+{
+   if (!kms) {
+      return false;
+   }
+   /* after an error, the state of the connection is unknown. */
+   return kms->keep_alive && mongocrypt_status_ok (kms->status);
+}
+
 bool
 _mongocrypt_kms_ctx_init_azure_auth (mongocrypt_kms_ctx_t *kms,
                                      _mongocrypt_log_t *log,
@@ -1073,7 +1276,7 @@ _mongocrypt_kms_ctx_init_azure_auth (mongocrypt_kms_ctx_t *kms,
 
    opt = kms_request_opt_new ();
    BSON_ASSERT (opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
    kms_request_opt_set_provider (opt, KMS_REQUEST_PROVIDER_AZURE);
    kms->req =
       kms_azure_request_oauth_new (hostname,
@@ -1134,7 +1337,7 @@ _mongocrypt_kms_ctx_init_azure_wrapkey (
 
    opt = kms_request_opt_new ();
    BSON_ASSERT (opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
    kms_request_opt_set_provider (opt, KMS_REQUEST_PROVIDER_AZURE);
    kms->req =
       kms_azure_request_wrapkey_new (host,
@@ -1197,7 +1400,7 @@ _mongocrypt_kms_ctx_init_azure_unwrapkey (mongocrypt_kms_ctx_t *kms,
 
    opt = kms_request_opt_new ();
    BSON_ASSERT (opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
    kms_request_opt_set_provider (opt, KMS_REQUEST_PROVIDER_AZURE);
    kms->req =
       kms_azure_request_unwrapkey_new (host,
@@ -1312,7 +1515,7 @@ _mongocrypt_kms_ctx_init_gcp_auth (mongocrypt_kms_ctx_t *kms,
 
    opt = kms_request_opt_new ();
    BSON_ASSERT (opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
    kms_request_opt_set_provider (opt, KMS_REQUEST_PROVIDER_GCP);
    if (crypt_opts->sign_rsaes_pkcs1_v1_5) {
       kms_request_opt_set_crypto_hook_sign_rsaes_pkcs1_v1_5 (
@@ -1387,7 +1590,7 @@ _mongocrypt_kms_ctx_init_gcp_encrypt (
 
    opt = kms_request_opt_new ();
    BSON_ASSERT (opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
    kms_request_opt_set_provider (opt, KMS_REQUEST_PROVIDER_GCP);
    kms->req =
       kms_gcp_request_encrypt_new (hostname,
@@ -1458,7 +1661,7 @@ _mongocrypt_kms_ctx_init_gcp_decrypt (mongocrypt_kms_ctx_t *kms,
 
    opt = kms_request_opt_new ();
    BSON_ASSERT (opt);
-   kms_request_opt_set_connection_close (opt, true);
+   _set_connection_opt (kms, crypt_opts, opt);
    kms_request_opt_set_provider (opt, KMS_REQUEST_PROVIDER_GCP);
    kms->req = kms_gcp_request_decrypt_new (hostname,
                                            access_token,
@@ -1576,6 +1779,18 @@ _mongocrypt_kms_ctx_init_kmip_get (mongocrypt_kms_ctx_t *kms_ctx,
                                    const _mongocrypt_endpoint_t *endpoint,
                                    const char *unique_identifier,
                                    _mongocrypt_log_t *log)
+{
+   return _mongocrypt_kms_ctx_init_kmip_get_batch (
+      kms_ctx, endpoint, &unique_identifier, 1, log);
+}
+
+bool
+_mongocrypt_kms_ctx_init_kmip_get_batch (
+   mongocrypt_kms_ctx_t *kms_ctx,
+   const _mongocrypt_endpoint_t *endpoint,
+   const char *const *unique_identifiers,
+   uint32_t count,
+   _mongocrypt_log_t *log)
 {
    mongocrypt_status_t *status;
    bool ret = false;
@@ -1584,13 +1799,14 @@ _mongocrypt_kms_ctx_init_kmip_get (mongocrypt_kms_ctx_t *kms_ctx,
 
    _init_common (kms_ctx, log, MONGOCRYPT_KMS_KMIP_GET);
    status = kms_ctx->status;
+   kms_ctx->batch_count = count;
 
    kms_ctx->endpoint = bson_strdup (endpoint->host_and_port);
    _mongocrypt_apply_default_port (&kms_ctx->endpoint, DEFAULT_KMIP_PORT);
-   kms_ctx->req =
-      kms_kmip_request_get_new (NULL /* reserved */, unique_identifier);
+   kms_ctx->req = kms_kmip_request_get_batch_new (
+      NULL /* reserved */, unique_identifiers, count);
 
-   if (!kms_ctx->req) {
+   if (kms_request_get_error (kms_ctx->req)) {
       CLIENT_ERR ("Error creating KMIP get request: %s",
                   kms_request_get_error (kms_ctx->req));
       goto done;
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_LOCAL_MARKING_PRIVATE_H
+#define MONGOCRYPT_LOCAL_MARKING_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+
+/* Mark @cmd for the JSON schema @schema in process, and set @reply to the
+ * reply mongocryptd would give. Only insert commands and schemas made of
+ * "properties" and "encrypt" nodes are supported. Returns false, leaving
+ * @reply empty, if @cmd or @schema uses anything else. The command must then
+ * be sent to mongocryptd, which also reports any errors. */
+bool
+_mongocrypt_local_marking (const _mongocrypt_buffer_t *schema,
+                           const _mongocrypt_buffer_t *cmd,
+                           _mongocrypt_buffer_t *reply)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+#endif /* MONGOCRYPT_LOCAL_MARKING_PRIVATE_H */
@@ -0,0 +1,446 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-local-marking-private.h"
+#include "mongocrypt-private.h"
+
+#define ALGORITHM_DETERMINISTIC "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic"
+#define ALGORITHM_RANDOM "AEAD_AES_256_CBC_HMAC_SHA_512-Random"
+
+/* The local marking engine handles the subset of JSON schemas where each node
+ * is either an object with "properties", or a field with "encrypt" giving the
+ * key id, algorithm and BSON type. Anything else, like encryptMetadata, JSON
+ * pointer key ids, or pattern properties, is left to mongocryptd. */
+
+typedef struct {
+   int32_t algorithm;
+   bson_iter_t key_id; /* a UUID binary. */
+   const char *bson_type;
+} _encrypt_spec_t;
+
+
+/* The $jsonSchema alias of @type, or NULL if it has none. */
+static const char *
+_bson_type_alias (bson_type_t type)
+{
+   switch (type) {
+   case BSON_TYPE_DOUBLE:
+      return "double";
+   case BSON_TYPE_UTF8:
+      return "string";
+   case BSON_TYPE_DOCUMENT:
+      return "object";
+   case BSON_TYPE_ARRAY:
+      return "array";
+   case BSON_TYPE_BINARY:
+      return "binData";
+   case BSON_TYPE_OID:
+      return "objectId";
+   case BSON_TYPE_BOOL:
+      return "bool";
+   case BSON_TYPE_DATE_TIME:
+      return "date";
+   case BSON_TYPE_REGEX:
+      return "regex";
+   case BSON_TYPE_DBPOINTER:
+      return "dbPointer";
+   case BSON_TYPE_CODE:
+      return "javascript";
+   case BSON_TYPE_SYMBOL:
+      return "symbol";
+   case BSON_TYPE_CODEWSCOPE:
+      return "javascriptWithScope";
+   case BSON_TYPE_INT32:
+      return "int";
+   case BSON_TYPE_TIMESTAMP:
+      return "timestamp";
+   case BSON_TYPE_INT64:
+      return "long";
+   case BSON_TYPE_DECIMAL128:
+      return "decimal";
+   default:
+      return NULL;
+   }
+}
+
+
+static bool
+_is_utf8_equal (const bson_iter_t *iter, const char *str)
+{
+   return BSON_ITER_HOLDS_UTF8 (iter) &&
+          0 == strcmp (bson_iter_utf8 (iter, NULL), str);
+}
+
+
+static bool
+_parse_encrypt (bson_iter_t *iter, _encrypt_spec_t *spec)
+{
+   bson_iter_t key_ids;
+   bool has_key_id = false;
+
+   memset (spec, 0, sizeof (*spec));
+   while (bson_iter_next (iter)) {
+      const char *key = bson_iter_key (iter);
+
+      if (0 == strcmp (key, "keyId")) {
+         bson_subtype_t subtype;
+         uint32_t len;
+         const uint8_t *data;
+
+         /* Exactly one UUID. A JSON pointer is not supported. */
+         if (!BSON_ITER_HOLDS_ARRAY (iter) ||
+             !bson_iter_recurse (iter, &key_ids) ||
+             !bson_iter_next (&key_ids) || !BSON_ITER_HOLDS_BINARY (&key_ids)) {
+            return false;
+         }
+         bson_iter_binary (&key_ids, &subtype, &len, &data);
+         if (subtype != BSON_SUBTYPE_UUID || len != 16) {
+            return false;
+         }
+         memcpy (&spec->key_id, &key_ids, sizeof (bson_iter_t));
+         if (bson_iter_next (&key_ids)) {
+            return false;
+         }
+         has_key_id = true;
+      } else if (0 == strcmp (key, "algorithm")) {
+         if (_is_utf8_equal (iter, ALGORITHM_DETERMINISTIC)) {
+            spec->algorithm = MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC;
+         } else if (_is_utf8_equal (iter, ALGORITHM_RANDOM)) {
+            spec->algorithm = MONGOCRYPT_ENCRYPTION_ALGORITHM_RANDOM;
+         } else {
+            return false;
+         }
+      } else if (0 == strcmp (key, "bsonType")) {
+         if (!BSON_ITER_HOLDS_UTF8 (iter)) {
+            return false;
+         }
+         spec->bson_type = bson_iter_utf8 (iter, NULL);
+      } else {
+         return false;
+      }
+   }
+
+   /* Deterministic encryption requires a single BSON type. */
+   return has_key_id && spec->algorithm != 0 &&
+          (spec->bson_type ||
+           spec->algorithm == MONGOCRYPT_ENCRYPTION_ALGORITHM_RANDOM);
+}
+
+
+/* Check that the schema node at @iter is supported. Sets @properties to its
+ * properties, if any, and @encrypt to its encrypt spec, if any. */
+static bool
+_parse_node (bson_iter_t *iter,
+             bson_iter_t *properties,
+             bool *has_properties,
+             _encrypt_spec_t *encrypt,
+             bool *has_encrypt)
+{
+   *has_properties = false;
+   *has_encrypt = false;
+   while (bson_iter_next (iter)) {
+      const char *key = bson_iter_key (iter);
+
+      if (0 == strcmp (key, "properties")) {
+         if (!BSON_ITER_HOLDS_DOCUMENT (iter) ||
+             !bson_iter_recurse (iter, properties)) {
+            return false;
+         }
+         *has_properties = true;
+      } else if (0 == strcmp (key, "encrypt")) {
+         bson_iter_t child;
+
+         if (!BSON_ITER_HOLDS_DOCUMENT (iter) ||
+             !bson_iter_recurse (iter, &child) ||
+             !_parse_encrypt (&child, encrypt)) {
+            return false;
+         }
+         *has_encrypt = true;
+      } else if (0 == strcmp (key, "bsonType") || 0 == strcmp (key, "type")) {
+         if (!_is_utf8_equal (iter, "object")) {
+            return false;
+         }
+      } else if (0 != strcmp (key, "title") &&
+                 0 != strcmp (key, "description")) {
+         return false;
+      }
+   }
+   return !(*has_properties && *has_encrypt);
+}
+
+
+/* Check that every node of the schema is supported, and find if any field is
+ * encrypted. */
+static bool
+_check_schema (bson_iter_t *iter, bool *requires_encryption)
+{
+   bson_iter_t properties;
+   _encrypt_spec_t encrypt;
+   bool has_properties, has_encrypt;
+
+   if (!_parse_node (
+          iter, &properties, &has_properties, &encrypt, &has_encrypt)) {
+      return false;
+   }
+   if (has_encrypt) {
+      *requires_encryption = true;
+   }
+   if (!has_properties) {
+      return true;
+   }
+   while (bson_iter_next (&properties)) {
+      bson_iter_t child;
+
+      if (!BSON_ITER_HOLDS_DOCUMENT (&properties) ||
+          !bson_iter_recurse (&properties, &child) ||
+          !_check_schema (&child, requires_encryption)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+/* Returns true if mongocryptd would mark @iter for @spec. Otherwise
+ * mongocryptd reports an error, or the value is already encrypted. */
+static bool
+_can_mark (const bson_iter_t *iter, const _encrypt_spec_t *spec)
+{
+   bson_type_t type = bson_iter_type (iter);
+   const char *alias = _bson_type_alias (type);
+
+   if (!alias) {
+      return false;
+   }
+   if (spec->bson_type && 0 != strcmp (spec->bson_type, alias)) {
+      return false;
+   }
+   if (type == BSON_TYPE_BINARY) {
+      bson_subtype_t subtype;
+      uint32_t len;
+      const uint8_t *data;
+
+      bson_iter_binary (iter, &subtype, &len, &data);
+      if (subtype == BSON_SUBTYPE_ENCRYPTED) {
+         return false;
+      }
+   }
+   if (spec->algorithm == MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC) {
+      switch (type) {
+      case BSON_TYPE_DOUBLE:
+      case BSON_TYPE_DECIMAL128:
+      case BSON_TYPE_DOCUMENT:
+      case BSON_TYPE_ARRAY:
+      case BSON_TYPE_BOOL:
+      case BSON_TYPE_CODEWSCOPE:
+         return false;
+      default:
+         break;
+      }
+   }
+   return true;
+}
+
+
+/* Append a marking for the value at @iter, as mongocryptd formats it. */
+static void
+_append_marking (bson_t *out,
+                 const char *key,
+                 const bson_iter_t *iter,
+                 const _encrypt_spec_t *spec)
+{
+   bson_t marking = BSON_INITIALIZER;
+   uint8_t *data;
+
+   bson_append_int32 (&marking, "a", 1, spec->algorithm);
+   bson_append_iter (&marking, "ki", 2, &spec->key_id);
+   bson_append_iter (&marking, "v", 1, iter);
+
+   data = bson_malloc (marking.len + 1);
+   BSON_ASSERT (data);
+   data[0] = 0; /* the intent-to-encrypt marking type. */
+   memcpy (data + 1, bson_get_data (&marking), marking.len);
+   bson_append_binary (
+      out, key, -1, BSON_SUBTYPE_ENCRYPTED, data, marking.len + 1);
+   bson_free (data);
+   bson_destroy (&marking);
+}
+
+
+/* Copy the document at @doc to @out, marking the fields encrypted by the
+ * schema node @schema. */
+static bool
+_mark_document (bson_iter_t *schema,
+                bson_iter_t *doc,
+                bson_t *out,
+                bool *marked)
+{
+   bson_iter_t properties;
+   _encrypt_spec_t encrypt;
+   bool has_properties, has_encrypt;
+
+   if (!_parse_node (
+          schema, &properties, &has_properties, &encrypt, &has_encrypt) ||
+       has_encrypt) {
+      return false;
+   }
+
+   while (bson_iter_next (doc)) {
+      const char *key = bson_iter_key (doc);
+      bson_iter_t prop, node, node_child, node_properties, doc_child;
+      _encrypt_spec_t spec;
+      bool node_has_properties, node_has_encrypt;
+      bson_t out_child;
+      bool ok;
+
+      /* mongocryptd interprets these keys as paths or operators. */
+      if (key[0] == '$' || strchr (key, '.')) {
+         return false;
+      }
+
+      memcpy (&prop, &properties, sizeof (bson_iter_t));
+      if (!has_properties || !bson_iter_find (&prop, key)) {
+         bson_append_iter (out, key, -1, doc);
+         continue;
+      }
+
+      if (!bson_iter_recurse (&prop, &node)) {
+         return false;
+      }
+      memcpy (&node_child, &node, sizeof (bson_iter_t));
+      if (!_parse_node (&node_child,
+                        &node_properties,
+                        &node_has_properties,
+                        &spec,
+                        &node_has_encrypt)) {
+         return false;
+      }
+
+      if (node_has_encrypt) {
+         if (!_can_mark (doc, &spec)) {
+            return false;
+         }
+         _append_marking (out, key, doc, &spec);
+         *marked = true;
+      } else if (node_has_properties) {
+         /* mongocryptd reports an error if the value is not an object. */
+         if (!BSON_ITER_HOLDS_DOCUMENT (doc) ||
+             !bson_iter_recurse (doc, &doc_child)) {
+            return false;
+         }
+         bson_append_document_begin (out, key, -1, &out_child);
+         ok = _mark_document (&node, &doc_child, &out_child, marked);
+         bson_append_document_end (out, &out_child);
+         if (!ok) {
+            return false;
+         }
+      } else {
+         bson_append_iter (out, key, -1, doc);
+      }
+   }
+   return true;
+}
+
+
+/* Copy the insert command at @cmd to @out, marking each document. */
+static bool
+_mark_insert (bson_iter_t *schema, bson_iter_t *cmd, bson_t *out, bool *marked)
+{
+   while (bson_iter_next (cmd)) {
+      const char *key = bson_iter_key (cmd);
+      bson_iter_t docs, doc, schema_copy;
+      bson_t out_docs, out_doc;
+      bool ok = true;
+
+      if (0 != strcmp (key, "documents")) {
+         bson_append_iter (out, key, -1, cmd);
+         continue;
+      }
+
+      if (!BSON_ITER_HOLDS_ARRAY (cmd) || !bson_iter_recurse (cmd, &docs)) {
+         return false;
+      }
+      bson_append_array_begin (out, key, -1, &out_docs);
+      while (ok && bson_iter_next (&docs)) {
+         if (!BSON_ITER_HOLDS_DOCUMENT (&docs) ||
+             !bson_iter_recurse (&docs, &doc)) {
+            ok = false;
+            break;
+         }
+         memcpy (&schema_copy, schema, sizeof (bson_iter_t));
+         bson_append_document_begin (
+            &out_docs, bson_iter_key (&docs), -1, &out_doc);
+         ok = _mark_document (&schema_copy, &doc, &out_doc, marked);
+         bson_append_document_end (&out_docs, &out_doc);
+      }
+      bson_append_array_end (out, &out_docs);
+      if (!ok) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+bool
+_mongocrypt_local_marking (const _mongocrypt_buffer_t *schema,
+                           const _mongocrypt_buffer_t *cmd,
+                           _mongocrypt_buffer_t *reply)
+{
+   bson_t schema_bson, cmd_bson, result, reply_bson;
+   bson_iter_t schema_iter, cmd_iter;
+   bool requires_encryption = false, marked = false;
+
+   _mongocrypt_buffer_init (reply);
+
+   if (_mongocrypt_buffer_empty (schema)) {
+      bson_init (&schema_bson);
+   } else if (!_mongocrypt_buffer_to_bson (schema, &schema_bson)) {
+      return false;
+   }
+   if (!_mongocrypt_buffer_to_bson (cmd, &cmd_bson) ||
+       !bson_iter_init (&schema_iter, &schema_bson) ||
+       !bson_iter_init (&cmd_iter, &cmd_bson)) {
+      bson_destroy (&schema_bson);
+      return false;
+   }
+
+   if (!_check_schema (&schema_iter, &requires_encryption) ||
+       !bson_iter_next (&cmd_iter) ||
+       0 != strcmp (bson_iter_key (&cmd_iter), "insert")) {
+      bson_destroy (&schema_bson);
+      return false;
+   }
+
+   bson_init (&result);
+   bson_append_iter (&result, NULL, 0, &cmd_iter);
+   if (!bson_iter_init (&schema_iter, &schema_bson) ||
+       !_mark_insert (&schema_iter, &cmd_iter, &result, &marked)) {
+      bson_destroy (&result);
+      bson_destroy (&schema_bson);
+      return false;
+   }
+   bson_destroy (&schema_bson);
+
+   bson_init (&reply_bson);
+   BSON_APPEND_BOOL (
+      &reply_bson, "schemaRequiresEncryption", requires_encryption);
+   BSON_APPEND_BOOL (&reply_bson, "hasEncryptedPlaceholders", marked);
+   BSON_APPEND_DOCUMENT (&reply_bson, "result", &result);
+   bson_destroy (&result);
+   _mongocrypt_buffer_steal_from_bson (reply, &reply_bson);
+   return true;
+}
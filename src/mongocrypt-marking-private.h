@@ -42,6 +42,8 @@ _mongocrypt_marking_parse_unowned (const _mongocrypt_buffer_t *in,
                                    mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* @ctx is the key broker. The buffers of @ciphertext may be drawn from the key
+ * broker's arena, so @ciphertext must not outlive it. */
 bool
 _mongocrypt_marking_to_ciphertext (void *ctx,
                                    _mongocrypt_marking_t *marking,
@@ -15,7 +15,9 @@
  */
 
 #include "mongocrypt.h"
+#include "mongocrypt-atomic-private.h"
 #include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-deterministic-private.h"
 #include "mongocrypt-ciphertext-private.h"
 #include "mongocrypt-crypto-private.h"
 #include "mongocrypt-key-broker-private.h"
@@ -153,6 +155,48 @@ _mongocrypt_marking_cleanup (_mongocrypt_marking_t *marking)
 }
 
 
+/* Look up a previous deterministic encryption with the same attribute. */
+static bool
+_deterministic_cache_get (mongocrypt_t *crypt,
+                          _mongocrypt_buffer_t *attr,
+                          _mongocrypt_buffer_t *out)
+{
+   _mongocrypt_buffer_t *cached = NULL;
+
+   if (!_mongocrypt_cache_get (
+          &crypt->cache_deterministic, attr, (void **) &cached) ||
+       !cached) {
+      _mongocrypt_atomic_int64_add (&crypt->cache_deterministic_misses, 1);
+      return false;
+   }
+
+   _mongocrypt_atomic_int64_add (&crypt->cache_deterministic_hits, 1);
+   _mongocrypt_buffer_steal (out, cached);
+   bson_free (cached);
+   return true;
+}
+
+
+/* Caching is an optimization, so a failure to add a result is only logged. */
+static void
+_deterministic_cache_add (mongocrypt_t *crypt,
+                          _mongocrypt_buffer_t *attr,
+                          _mongocrypt_buffer_t *ciphertext)
+{
+   mongocrypt_status_t *status;
+
+   status = mongocrypt_status_new ();
+   if (!_mongocrypt_cache_add_copy (
+          &crypt->cache_deterministic, attr, ciphertext, status)) {
+      _mongocrypt_log (&crypt->log,
+                       MONGOCRYPT_LOG_LEVEL_WARNING,
+                       "could not cache deterministic ciphertext: %s",
+                       mongocrypt_status_message (status, NULL));
+   }
+   mongocrypt_status_destroy (status);
+}
+
+
 bool
 _mongocrypt_marking_to_ciphertext (void *ctx,
                                    _mongocrypt_marking_t *marking,
@@ -164,7 +208,10 @@ _mongocrypt_marking_to_ciphertext (void *ctx,
    _mongocrypt_key_broker_t *kb;
    _mongocrypt_buffer_t associated_data;
    _mongocrypt_buffer_t key_material;
+   const _mongocrypt_prepared_key_t *prepared_key;
    _mongocrypt_buffer_t key_id;
+   _mongocrypt_buffer_t cache_attr;
+   bool use_cache = false;
    bool ret = false;
    bool key_found;
    uint32_t bytes_written;
@@ -179,83 +226,80 @@ _mongocrypt_marking_to_ciphertext (void *ctx,
    _mongocrypt_buffer_init (&iv);
    _mongocrypt_buffer_init (&key_id);
    _mongocrypt_buffer_init (&key_material);
+   _mongocrypt_buffer_init (&cache_attr);
 
    kb = (_mongocrypt_key_broker_t *) ctx;
 
    /* Get the decrypted key for this marking. */
    if (marking->has_alt_name) {
-      key_found = _mongocrypt_key_broker_decrypted_key_by_name (
-         kb, &marking->key_alt_name, &key_material, &key_id);
+      key_found =
+         _mongocrypt_key_broker_decrypted_key_by_name (kb,
+                                                       &marking->key_alt_name,
+                                                       &key_material,
+                                                       &prepared_key,
+                                                       &key_id,
+                                                       status);
    } else if (!_mongocrypt_buffer_empty (&marking->key_id)) {
       key_found = _mongocrypt_key_broker_decrypted_key_by_id (
-         kb, &marking->key_id, &key_material);
-      _mongocrypt_buffer_copy_to (&marking->key_id, &key_id);
+         kb, &marking->key_id, &key_material, &prepared_key, status);
+      _mongocrypt_buffer_set_to (&marking->key_id, &key_id);
    } else {
       CLIENT_ERR ("marking must have either key_id or key_alt_name");
       goto fail;
    }
 
    if (!key_found) {
-      _mongocrypt_status_copy_to (kb->status, status);
       goto fail;
    }
 
    _mongocrypt_ciphertext_init (ciphertext);
    ciphertext->original_bson_type = (uint8_t) bson_iter_type (&marking->v_iter);
    ciphertext->blob_subtype = marking->algorithm;
-   _mongocrypt_buffer_copy_to (&key_id, &ciphertext->key_id);
-   if (!_mongocrypt_ciphertext_serialize_associated_data (ciphertext,
-                                                          &associated_data)) {
+   _mongocrypt_buffer_resize_in_arena (
+      &ciphertext->key_id, kb->arena, key_id.len);
+   memcpy (ciphertext->key_id.data, key_id.data, key_id.len);
+   ciphertext->key_id.subtype = key_id.subtype;
+   if (!_mongocrypt_ciphertext_serialize_associated_data (
+          ciphertext, kb->arena, &associated_data)) {
       CLIENT_ERR ("could not serialize associated data");
       goto fail;
    }
 
    _mongocrypt_buffer_from_iter (&plaintext, &marking->v_iter);
-   ciphertext->data.len = _mongocrypt_calculate_ciphertext_len (plaintext.len);
-   ciphertext->data.data = bson_malloc (ciphertext->data.len);
-   BSON_ASSERT (ciphertext->data.data);
-
-   ciphertext->data.owned = true;
+   _mongocrypt_buffer_resize_in_arena (&iv, kb->arena, MONGOCRYPT_IV_LEN);
 
    switch (marking->algorithm) {
    case MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC:
       /* Use deterministic encryption. */
-      _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
-      ret = _mongocrypt_calculate_deterministic_iv (kb->crypt->crypto,
-                                                    &key_material,
-                                                    &plaintext,
-                                                    &associated_data,
-                                                    &iv,
-                                                    status);
-      if (!ret) {
+      if (!_mongocrypt_calculate_deterministic_iv (kb->crypt->crypto,
+                                                   &key_material,
+                                                   prepared_key,
+                                                   &plaintext,
+                                                   &associated_data,
+                                                   &iv,
+                                                   status)) {
          goto fail;
       }
 
-      ret = _mongocrypt_do_encryption (kb->crypt->crypto,
-                                       &iv,
-                                       &associated_data,
-                                       &key_material,
-                                       &plaintext,
-                                       &ciphertext->data,
-                                       &bytes_written,
-                                       status);
+      /* The IV is a keyed digest of the associated data and plaintext, so
+       * with the associated data it determines the result. The cache never
+       * sees the plaintext. */
+      use_cache = kb->crypt->opts.deterministic_cache_max_entries > 0 &&
+                  _mongocrypt_cache_deterministic_attr (
+                     &associated_data, &iv, &cache_attr);
+      if (use_cache && _deterministic_cache_get (
+                          kb->crypt, &cache_attr, &ciphertext->data)) {
+         ret = true;
+         goto fail;
+      }
       break;
    case MONGOCRYPT_ENCRYPTION_ALGORITHM_RANDOM:
       /* Use randomized encryption.
        * In this case, we must generate a new, random iv. */
-      _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
       if (!_mongocrypt_random (
              kb->crypt->crypto, &iv, MONGOCRYPT_IV_LEN, status)) {
          goto fail;
       }
-      ret = _mongocrypt_do_encryption (kb->crypt->crypto,
-                                       &iv,
-                                       &associated_data,
-                                       &key_material,
-                                       &plaintext,
-                                       &ciphertext->data,
-                                       &bytes_written,
-                                       status);
       break;
    default:
       /* Error. */
@@ -263,15 +307,33 @@ _mongocrypt_marking_to_ciphertext (void *ctx,
       goto fail;
    }
 
+   _mongocrypt_buffer_resize_in_arena (
+      &ciphertext->data,
+      kb->arena,
+      _mongocrypt_calculate_ciphertext_len (plaintext.len));
+   ret = _mongocrypt_do_encryption (kb->crypt->crypto,
+                                    &iv,
+                                    &associated_data,
+                                    &key_material,
+                                    prepared_key,
+                                    &plaintext,
+                                    &ciphertext->data,
+                                    &bytes_written,
+                                    status);
    if (!ret) {
       goto fail;
    }
 
    BSON_ASSERT (bytes_written == ciphertext->data.len);
 
+   if (use_cache) {
+      _deterministic_cache_add (kb->crypt, &cache_attr, &ciphertext->data);
+   }
+
    ret = true;
 
 fail:
+   _mongocrypt_buffer_cleanup (&cache_attr);
    _mongocrypt_buffer_cleanup (&iv);
    _mongocrypt_buffer_cleanup (&key_id);
    _mongocrypt_buffer_cleanup (&plaintext);
@@ -40,6 +40,9 @@ typedef struct {
 
 typedef struct {
    char *secret_access_key;
+   /* A digest of secret_access_key, set by mongocrypt_init. Identifies the
+    * secret in the signing key cache. */
+   _mongocrypt_buffer_t secret_access_key_digest;
    char *access_key_id;
    char *session_token;
 } _mongocrypt_opts_kms_provider_aws_t;
@@ -65,6 +68,31 @@ typedef struct {
    _mongocrypt_opts_kms_provider_kmip_t kms_provider_kmip;
    mongocrypt_hmac_fn sign_rsaes_pkcs1_v1_5;
    void *sign_ctx;
+
+   /* Cache limits. 0 means unlimited. */
+   uint32_t key_cache_max_entries;
+   uint64_t key_cache_max_bytes;
+   uint32_t collinfo_cache_max_entries;
+   uint64_t collinfo_cache_max_bytes;
+   /* Key cache expiration. 0 means the default, CACHE_EXPIRATION_MS. */
+   uint64_t key_cache_expiration_ms;
+   uint64_t key_cache_refresh_ahead_ms;
+   /* Maximum time to wait for another context fetching the same key. 0
+    * disables key fetch coalescing. */
+   uint32_t key_fetch_max_wait_ms;
+   /* Deterministic encryption cache limits. 0 entries disables the cache. */
+   uint32_t deterministic_cache_max_entries;
+   uint64_t deterministic_cache_max_bytes;
+   /* mongocryptd marking cache limits. 0 entries disables the cache. */
+   uint32_t marking_cache_max_entries;
+   uint64_t marking_cache_max_bytes;
+   /* Mark supported commands in process instead of with mongocryptd. */
+   bool local_markings;
+   /* Ask HTTP KMS servers to keep connections open for reuse. */
+   bool kms_keep_alive;
+   /* Runs field encryption and decryption in finalize. NULL means serial. */
+   mongocrypt_parallel_for_fn parallel_for;
+   void *executor_ctx;
 } _mongocrypt_opts_t;
 
 
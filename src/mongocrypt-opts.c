@@ -52,6 +52,8 @@ void
 _mongocrypt_opts_cleanup (_mongocrypt_opts_t *opts)
 {
    bson_free (opts->kms_provider_aws.secret_access_key);
+   _mongocrypt_buffer_cleanse (
+      &opts->kms_provider_aws.secret_access_key_digest);
    bson_free (opts->kms_provider_aws.access_key_id);
    bson_free (opts->kms_provider_aws.session_token);
    _mongocrypt_buffer_cleanup (&opts->kms_provider_local.key);
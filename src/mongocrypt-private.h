@@ -29,6 +29,7 @@
 #include "mongocrypt-opts-private.h"
 #include "mongocrypt-crypto-private.h"
 #include "mongocrypt-cache-oauth-private.h"
+#include "mongocrypt-schema-map-private.h"
 
 
 #define MONGOCRYPT_GENERIC_ERROR_CODE 1
@@ -70,6 +71,8 @@ _mongocrypt_set_error (mongocrypt_status_t *status,
                        ...);
 
 
+struct _key_fetch_t;
+
 struct _mongocrypt_t {
    bool initialized;
    _mongocrypt_opts_t opts;
@@ -77,6 +80,17 @@ struct _mongocrypt_t {
    /* The collinfo and key cache are protected with an internal mutex. */
    _mongocrypt_cache_t cache_collinfo;
    _mongocrypt_cache_t cache_key;
+   /* Deterministic encryption results. Only used if
+    * opts.deterministic_cache_max_entries is non-zero. The counters are
+    * updated atomically. */
+   _mongocrypt_cache_t cache_deterministic;
+   volatile int64_t cache_deterministic_hits;
+   volatile int64_t cache_deterministic_misses;
+   /* mongocryptd replies by command shape. Only used if
+    * opts.marking_cache_max_entries is non-zero. */
+   _mongocrypt_cache_t cache_marking;
+   /* AWS SigV4 signing keys, which change once per UTC day. */
+   _mongocrypt_cache_t cache_signing_key;
    _mongocrypt_log_t log;
    mongocrypt_status_t *status;
    _mongocrypt_crypto_t *crypto;
@@ -84,6 +98,11 @@ struct _mongocrypt_t {
    uint32_t ctx_counter;
    _mongocrypt_cache_oauth_t *cache_oauth_azure;
    _mongocrypt_cache_oauth_t *cache_oauth_gcp;
+   /* Key ids currently being fetched by key brokers, protected by mutex.
+    * Only used when key fetch coalescing is enabled. */
+   struct _key_fetch_t *key_fetches;
+   /* Built by mongocrypt_init from opts.schema_map. */
+   _mongocrypt_schema_map_t schema_map_index;
 };
 
 typedef enum {
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_SCHEMA_MAP_PRIVATE_H
+#define MONGOCRYPT_SCHEMA_MAP_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+
+typedef struct {
+   uint32_t hash;
+   const char *ns; /* key in the schema map, or NULL for an unused entry. */
+   /* A view of the schema in the schema map, or empty if the value is not a
+    * document. */
+   _mongocrypt_buffer_t schema;
+} _mongocrypt_schema_map_entry_t;
+
+/* An index of the schema map by namespace. It is built once by
+ * mongocrypt_init and is not modified after, so it may be read by contexts on
+ * any thread. The entries are views of the schema map, which must outlive the
+ * index. */
+typedef struct {
+   _mongocrypt_schema_map_entry_t *entries;
+   uint32_t size; /* a power of two, or zero if there is no schema map. */
+} _mongocrypt_schema_map_t;
+
+
+/* Index the namespaces of @schema_map. If a namespace is repeated, the first
+ * is kept. @schema_map must be valid BSON. */
+void
+_mongocrypt_schema_map_build (_mongocrypt_schema_map_t *map,
+                              const _mongocrypt_buffer_t *schema_map);
+
+
+/* Returns the entry for @ns, or NULL if @ns is not in the schema map. */
+const _mongocrypt_schema_map_entry_t *
+_mongocrypt_schema_map_find (const _mongocrypt_schema_map_t *map,
+                             const char *ns);
+
+
+void
+_mongocrypt_schema_map_cleanup (_mongocrypt_schema_map_t *map);
+
+#endif /* MONGOCRYPT_SCHEMA_MAP_PRIVATE_H */
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2019-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-schema-map-private.h"
+#include "mongocrypt-cache-private.h"
+
+
+static uint32_t
+_hash_ns (const char *ns)
+{
+   return _mongocrypt_cache_hash_bytes ((const uint8_t *) ns,
+                                        (uint32_t) strlen (ns));
+}
+
+
+/* Find the entry for @ns, or the unused entry where it would be inserted. */
+static _mongocrypt_schema_map_entry_t *
+_find (const _mongocrypt_schema_map_t *map, uint32_t hash, const char *ns)
+{
+   uint32_t mask = map->size - 1;
+   uint32_t i;
+
+   for (i = hash & mask;; i = (i + 1) & mask) {
+      _mongocrypt_schema_map_entry_t *entry = &map->entries[i];
+
+      if (!entry->ns || (entry->hash == hash && 0 == strcmp (entry->ns, ns))) {
+         return entry;
+      }
+   }
+}
+
+
+void
+_mongocrypt_schema_map_build (_mongocrypt_schema_map_t *map,
+                              const _mongocrypt_buffer_t *schema_map)
+{
+   bson_t bson;
+   bson_iter_t iter;
+   uint32_t count;
+   uint32_t size;
+
+   BSON_ASSERT (map);
+   BSON_ASSERT (schema_map);
+
+   memset (map, 0, sizeof (*map));
+   if (_mongocrypt_buffer_empty (schema_map) ||
+       !_mongocrypt_buffer_to_bson (schema_map, &bson)) {
+      return;
+   }
+
+   count = bson_count_keys (&bson);
+   /* Keep the load factor at most one half. */
+   size = 8;
+   while (size < 2 * count) {
+      size *= 2;
+   }
+   map->entries = bson_malloc0 (size * sizeof (_mongocrypt_schema_map_entry_t));
+   BSON_ASSERT (map->entries);
+   map->size = size;
+
+   if (!bson_iter_init (&iter, &bson)) {
+      return;
+   }
+   while (bson_iter_next (&iter)) {
+      const char *ns = bson_iter_key (&iter);
+      _mongocrypt_schema_map_entry_t *entry;
+      uint32_t hash;
+
+      hash = _hash_ns (ns);
+      entry = _find (map, hash, ns);
+      if (entry->ns) {
+         continue;
+      }
+      entry->hash = hash;
+      entry->ns = ns;
+      /* A value that is not a document leaves the schema empty. It is
+       * reported as an error when its namespace is used. */
+      if (!_mongocrypt_buffer_from_document_iter (&entry->schema, &iter)) {
+         continue;
+      }
+   }
+}
+
+
+const _mongocrypt_schema_map_entry_t *
+_mongocrypt_schema_map_find (const _mongocrypt_schema_map_t *map,
+                             const char *ns)
+{
+   const _mongocrypt_schema_map_entry_t *entry;
+
+   BSON_ASSERT (map);
+   BSON_ASSERT (ns);
+
+   if (!map->size) {
+      return NULL;
+   }
+
+   entry = _find (map, _hash_ns (ns), ns);
+   return entry->ns ? entry : NULL;
+}
+
+
+void
+_mongocrypt_schema_map_cleanup (_mongocrypt_schema_map_t *map)
+{
+   if (!map) {
+      return;
+   }
+
+   bson_free (map->entries);
+   map->entries = NULL;
+   map->size = 0;
+}
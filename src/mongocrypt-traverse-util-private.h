@@ -36,6 +36,36 @@ typedef bool (*_mongocrypt_transform_callback_t) (void *ctx,
                                                   mongocrypt_status_t *status);
 
 
+/* The location of a matched binary element, or of a document or array
+ * enclosing one, as a byte range within the traversed document. For a matched
+ * element, the range spans the whole element, including its type byte and key.
+ * For a document or array, the range spans its length prefix to its trailing
+ * NULL byte. */
+typedef struct {
+   uint32_t offset;
+   uint32_t len;
+   uint32_t key_len; /* only set for a matched element. */
+   bool is_container;
+} _mongocrypt_traverse_loc_t;
+
+
+/* Locations in document order. A document or array precedes the locations
+ * within it. */
+typedef struct {
+   _mongocrypt_traverse_loc_t *locs;
+   uint32_t len;
+   uint32_t allocated;
+} _mongocrypt_traverse_locs_t;
+
+
+void
+_mongocrypt_traverse_locs_init (_mongocrypt_traverse_locs_t *locs);
+
+
+void
+_mongocrypt_traverse_locs_cleanup (_mongocrypt_traverse_locs_t *locs);
+
+
 bool
 _mongocrypt_traverse_binary_in_bson (_mongocrypt_traverse_callback_t cb,
                                      void *ctx,
@@ -55,4 +85,26 @@ _mongocrypt_transform_binary_in_bson (_mongocrypt_transform_callback_t cb,
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
+bool
+_mongocrypt_locate_binary_in_bson (_mongocrypt_traverse_callback_t cb,
+                                   void *ctx,
+                                   traversal_match_t match,
+                                   bson_iter_t *iter,
+                                   _mongocrypt_traverse_locs_t *locs,
+                                   mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+
+bool
+_mongocrypt_splice_binary_in_bson (_mongocrypt_transform_callback_t cb,
+                                   void *ctx,
+                                   const _mongocrypt_buffer_t *doc,
+                                   const _mongocrypt_traverse_locs_t *locs,
+                                   mongocrypt_parallel_for_fn parallel_for,
+                                   void *executor_ctx,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+
 #endif /* MONGOCRYPT_TRAVERSE_UTIL_H */
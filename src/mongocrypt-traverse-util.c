@@ -31,9 +31,79 @@ typedef struct {
    _mongocrypt_transform_callback_t transform_cb;
    mongocrypt_status_t *status;
    traversal_match_t match;
+   const uint8_t *base;                /* start of the traversed document. */
+   _mongocrypt_traverse_locs_t *locs; /* implies locations are recorded. */
    bson_t child;
 } _recurse_state_t;
 
+
+void
+_mongocrypt_traverse_locs_init (_mongocrypt_traverse_locs_t *locs)
+{
+   memset (locs, 0, sizeof (*locs));
+}
+
+
+void
+_mongocrypt_traverse_locs_cleanup (_mongocrypt_traverse_locs_t *locs)
+{
+   if (!locs) {
+      return;
+   }
+   bson_free (locs->locs);
+   _mongocrypt_traverse_locs_init (locs);
+}
+
+
+static void
+_locs_append (_mongocrypt_traverse_locs_t *locs,
+              uint32_t offset,
+              uint32_t len,
+              uint32_t key_len,
+              bool is_container)
+{
+   _mongocrypt_traverse_loc_t *loc;
+
+   if (locs->len == locs->allocated) {
+      locs->allocated = locs->allocated ? locs->allocated * 2 : 8;
+      locs->locs =
+         bson_realloc (locs->locs, locs->allocated * sizeof (*locs->locs));
+   }
+   loc = &locs->locs[locs->len++];
+   loc->offset = offset;
+   loc->len = len;
+   loc->key_len = key_len;
+   loc->is_container = is_container;
+}
+
+
+/* Record the document or array being iterated by @child. Returns the index
+ * to pass to _locs_end_container. */
+static uint32_t
+_locs_begin_container (_recurse_state_t *state, bson_iter_t *child)
+{
+   if (!state->locs) {
+      return 0;
+   }
+   _locs_append (state->locs,
+                 (uint32_t) (child->raw - state->base),
+                 child->len,
+                 0 /* key_len */,
+                 true /* is_container */);
+   return state->locs->len - 1;
+}
+
+
+/* Drop the document or array recorded at @index if nothing was matched in it,
+ * so only the containers whose length changes are kept. */
+static void
+_locs_end_container (_recurse_state_t *state, uint32_t index)
+{
+   if (state->locs && state->locs->len == index + 1) {
+      state->locs->len--;
+   }
+}
+
 static bool
 _check_first_byte (uint8_t byte, traversal_match_t match)
 {
@@ -66,6 +136,18 @@ _recurse (_recurse_state_t *state)
          if (value.subtype == 6 && value.len > 0 &&
              _check_first_byte (value.data[0], state->match)) {
             bool ret;
+
+            if (state->locs) {
+               const uint8_t *element;
+
+               element = state->iter.raw + bson_iter_offset (&state->iter);
+               _locs_append (state->locs,
+                             (uint32_t) (element - state->base),
+                             (uint32_t) ((value.data + value.len) - element),
+                             bson_iter_key_len (&state->iter),
+                             false /* is_container */);
+            }
+
             /* call the right callback. */
             if (state->copy) {
                bson_value_t value_out;
@@ -92,6 +174,7 @@ _recurse (_recurse_state_t *state)
 
       if (BSON_ITER_HOLDS_ARRAY (&state->iter)) {
          _recurse_state_t child_state;
+         uint32_t loc_index;
          bool ret;
 
          memcpy (&child_state, state, sizeof (_recurse_state_t));
@@ -99,6 +182,7 @@ _recurse (_recurse_state_t *state)
             CLIENT_ERR ("error recursing into array");
             return false;
          }
+         loc_index = _locs_begin_container (state, &child_state.iter);
 
          if (state->copy) {
             bson_append_array_begin (state->copy,
@@ -108,6 +192,7 @@ _recurse (_recurse_state_t *state)
             child_state.copy = &state->child;
          }
          ret = _recurse (&child_state);
+         _locs_end_container (state, loc_index);
 
          if (state->copy) {
             bson_append_array_end (state->copy, &state->child);
@@ -120,6 +205,7 @@ _recurse (_recurse_state_t *state)
 
       if (BSON_ITER_HOLDS_DOCUMENT (&state->iter)) {
          _recurse_state_t child_state;
+         uint32_t loc_index;
          bool ret;
 
          memcpy (&child_state, state, sizeof (_recurse_state_t));
@@ -127,6 +213,7 @@ _recurse (_recurse_state_t *state)
             CLIENT_ERR ("error recursing into document");
             return false;
          }
+         loc_index = _locs_begin_container (state, &child_state.iter);
          /* TODO: check for errors everywhere. */
          if (state->copy) {
             bson_append_document_begin (state->copy,
@@ -137,6 +224,7 @@ _recurse (_recurse_state_t *state)
          }
 
          ret = _recurse (&child_state);
+         _locs_end_container (state, loc_index);
 
          if (state->copy) {
             if (!bson_append_document_end (state->copy, &state->child)) {
@@ -177,6 +265,8 @@ _mongocrypt_transform_binary_in_bson (_mongocrypt_transform_callback_t cb,
                                       cb,
                                       status,
                                       match,
+                                      NULL /* base */,
+                                      NULL /* locs */,
                                       {0}};
 
    return _recurse (&starting_state);
@@ -210,7 +300,317 @@ _mongocrypt_traverse_binary_in_bson (_mongocrypt_traverse_callback_t cb,
                                       NULL /* transform callback */,
                                       status,
                                       match,
+                                      NULL /* base */,
+                                      NULL /* locs */,
                                       {0}};
 
    return _recurse (&starting_state);
 }
+
+
+/*-----------------------------------------------------------------------------
+ *
+ * _mongocrypt_locate_binary_in_bson
+ *
+ *    Traverse like _mongocrypt_traverse_binary_in_bson, and also append the
+ *    locations of the matched values, and the documents and arrays enclosing
+ *    them, to locs. iter must be iterating a top-level document, and the
+ *    locations are offsets from its start.
+ *
+ * Return:
+ *    True on success. Returns false on failure and sets error.
+ *
+ *-----------------------------------------------------------------------------
+ */
+bool
+_mongocrypt_locate_binary_in_bson (_mongocrypt_traverse_callback_t cb,
+                                   void *ctx,
+                                   traversal_match_t match,
+                                   bson_iter_t *iter,
+                                   _mongocrypt_traverse_locs_t *locs,
+                                   mongocrypt_status_t *status)
+{
+   _recurse_state_t starting_state = {ctx,
+                                      *iter,
+                                      NULL /* copy */,
+                                      NULL /* path */,
+                                      cb,
+                                      NULL /* transform callback */,
+                                      status,
+                                      match,
+                                      iter->raw /* base */,
+                                      locs,
+                                      {0}};
+
+   return _recurse (&starting_state);
+}
+
+
+static void
+_write_len (uint8_t *dst, uint32_t len)
+{
+   uint32_t len_le = BSON_UINT32_TO_LE (len);
+
+   memcpy (dst, &len_le, sizeof (len_le));
+}
+
+
+/* Transforms located values for _mongocrypt_splice_binary_in_bson. */
+typedef struct {
+   _mongocrypt_transform_callback_t cb;
+   void *ctx;
+   const _mongocrypt_buffer_t *doc;
+   const _mongocrypt_traverse_locs_t *locs;
+   /* Indexed like locs. values[i] is set if results[i] is _SPLICE_OK. */
+   bson_value_t *values;
+   mongocrypt_status_t **statuses;
+   uint8_t *results;
+} _splice_task_t;
+
+enum { _SPLICE_NOT_RUN = 0, _SPLICE_OK, _SPLICE_FAILED };
+
+
+static bool
+_splice_transform_loc (_splice_task_t *task,
+                       uint32_t index,
+                       mongocrypt_status_t *status)
+{
+   const _mongocrypt_traverse_loc_t *loc = &task->locs->locs[index];
+   /* type byte, key, NULL byte, binary length, and subtype. */
+   const uint32_t header_len = 1 + loc->key_len + 1 + 4 + 1;
+   _mongocrypt_buffer_t value;
+
+   _mongocrypt_buffer_init (&value);
+   value.data = task->doc->data + loc->offset + header_len;
+   value.len = loc->len - header_len;
+   value.subtype = BSON_SUBTYPE_ENCRYPTED;
+   return task->cb (task->ctx, &value, &task->values[index], status);
+}
+
+
+/* Called by the executor, possibly concurrently, once per location. Each call
+ * only writes to its own index, and reports errors through its own status. */
+static void
+_splice_run_task (void *task_ctx, uint32_t index)
+{
+   _splice_task_t *task = (_splice_task_t *) task_ctx;
+   mongocrypt_status_t *status;
+
+   if (index >= task->locs->len || task->locs->locs[index].is_container) {
+      return;
+   }
+
+   status = mongocrypt_status_new ();
+   if (_splice_transform_loc (task, index, status)) {
+      task->results[index] = _SPLICE_OK;
+      mongocrypt_status_destroy (status);
+   } else {
+      task->statuses[index] = status;
+      task->results[index] = _SPLICE_FAILED;
+   }
+}
+
+
+/* Transform the located values with parallel_for, then check every location
+ * completed. */
+static bool
+_splice_transform_parallel (_splice_task_t *task,
+                            mongocrypt_parallel_for_fn parallel_for,
+                            void *executor_ctx,
+                            mongocrypt_status_t *status)
+{
+   const _mongocrypt_traverse_locs_t *locs = task->locs;
+   uint32_t i;
+
+   task->statuses = bson_malloc0 (locs->len * sizeof (mongocrypt_status_t *));
+   BSON_ASSERT (task->statuses);
+   task->results = bson_malloc0 (locs->len);
+   BSON_ASSERT (task->results);
+
+   if (!parallel_for (executor_ctx, _splice_run_task, task, locs->len)) {
+      CLIENT_ERR ("parallel executor failed");
+      return false;
+   }
+
+   for (i = 0; i < locs->len; i++) {
+      if (locs->locs[i].is_container) {
+         continue;
+      }
+      if (task->results[i] == _SPLICE_FAILED) {
+         _mongocrypt_status_copy_to (task->statuses[i], status);
+         return false;
+      }
+      if (task->results[i] != _SPLICE_OK) {
+         CLIENT_ERR ("parallel executor did not run every task");
+         return false;
+      }
+   }
+   return true;
+}
+
+
+/*-----------------------------------------------------------------------------
+ *
+ * _mongocrypt_splice_binary_in_bson
+ *
+ *    Produce a copy of doc where each value located by
+ *    _mongocrypt_locate_binary_in_bson is replaced by the result of cb. The
+ *    bytes between located values are copied in bulk, and the lengths of the
+ *    enclosing documents and arrays are adjusted, instead of rebuilding the
+ *    document element by element as _mongocrypt_transform_binary_in_bson
+ *    does.
+ *
+ *    If parallel_for is not NULL and there is more than one located value, cb
+ *    is called through parallel_for and must be safe to call concurrently.
+ *
+ * Return:
+ *    True on success. Returns false on failure and sets error.
+ *
+ *-----------------------------------------------------------------------------
+ */
+bool
+_mongocrypt_splice_binary_in_bson (_mongocrypt_transform_callback_t cb,
+                                   void *ctx,
+                                   const _mongocrypt_buffer_t *doc,
+                                   const _mongocrypt_traverse_locs_t *locs,
+                                   mongocrypt_parallel_for_fn parallel_for,
+                                   void *executor_ctx,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   bson_t replacements;
+   const uint8_t *replacement;
+   uint32_t *replacement_lens;
+   _splice_task_t task;
+   uint32_t value_count = 0;
+   int64_t out_len;
+   uint32_t written;
+   uint32_t cursor;
+   uint32_t i, j;
+   bool ret = false;
+
+   BSON_ASSERT (doc);
+   BSON_ASSERT (locs);
+   BSON_ASSERT (out);
+
+   bson_init (&replacements);
+   replacement_lens = bson_malloc0 ((locs->len + 1) * sizeof (uint32_t));
+   BSON_ASSERT (replacement_lens);
+
+   memset (&task, 0, sizeof (task));
+   task.cb = cb;
+   task.ctx = ctx;
+   task.doc = doc;
+   task.locs = locs;
+   task.values = bson_malloc0 ((locs->len + 1) * sizeof (bson_value_t));
+   BSON_ASSERT (task.values);
+
+   for (i = 0; i < locs->len; i++) {
+      if (!locs->locs[i].is_container) {
+         value_count++;
+      }
+   }
+
+   /* Transform each located value. */
+   if (parallel_for && value_count > 1) {
+      if (!_splice_transform_parallel (
+             &task, parallel_for, executor_ctx, status)) {
+         goto fail;
+      }
+   } else {
+      for (i = 0; i < locs->len; i++) {
+         if (!locs->locs[i].is_container &&
+             !_splice_transform_loc (&task, i, status)) {
+            goto fail;
+         }
+      }
+   }
+
+   /* Append each transformed value as a new element with the same key. */
+   out_len = doc->len;
+   for (i = 0; i < locs->len; i++) {
+      const _mongocrypt_traverse_loc_t *loc = &locs->locs[i];
+      uint32_t start;
+
+      if (loc->is_container) {
+         continue;
+      }
+
+      start = replacements.len;
+      if (!bson_append_value (&replacements,
+                              (const char *) doc->data + loc->offset + 1,
+                              (int) loc->key_len,
+                              &task.values[i])) {
+         CLIENT_ERR ("error appending value");
+         goto fail;
+      }
+      replacement_lens[i] = replacements.len - start;
+      out_len += (int64_t) replacement_lens[i] - (int64_t) loc->len;
+   }
+
+   if (out_len > INT32_MAX) {
+      CLIENT_ERR ("transformed document too large");
+      goto fail;
+   }
+
+   _mongocrypt_buffer_init (out);
+   out->data = bson_malloc ((size_t) out_len);
+   BSON_ASSERT (out->data);
+   out->len = (uint32_t) out_len;
+   out->owned = true;
+
+   /* Skip the length of the replacements document to get to its elements. */
+   replacement = bson_get_data (&replacements) + 4;
+
+   _write_len (out->data, out->len);
+   written = 4;
+   cursor = 4;
+   for (i = 0; i < locs->len; i++) {
+      const _mongocrypt_traverse_loc_t *loc = &locs->locs[i];
+
+      /* Copy everything up to this location unchanged. */
+      memcpy (out->data + written, doc->data + cursor, loc->offset - cursor);
+      written += loc->offset - cursor;
+      cursor = loc->offset;
+
+      if (loc->is_container) {
+         int64_t container_len = loc->len;
+
+         for (j = i + 1; j < locs->len &&
+                         locs->locs[j].offset < loc->offset + loc->len;
+              j++) {
+            if (!locs->locs[j].is_container) {
+               container_len += (int64_t) replacement_lens[j] -
+                                (int64_t) locs->locs[j].len;
+            }
+         }
+         _write_len (out->data + written, (uint32_t) container_len);
+         written += 4;
+         cursor += 4;
+      } else {
+         memcpy (out->data + written, replacement, replacement_lens[i]);
+         replacement += replacement_lens[i];
+         written += replacement_lens[i];
+         cursor += loc->len;
+      }
+   }
+   memcpy (out->data + written, doc->data + cursor, doc->len - cursor);
+   written += doc->len - cursor;
+   BSON_ASSERT (written == out->len);
+
+   ret = true;
+fail:
+   for (i = 0; i < locs->len; i++) {
+      /* Values not transformed are zeroed, which is safe to destroy. */
+      bson_value_destroy (&task.values[i]);
+      if (task.statuses) {
+         mongocrypt_status_destroy (task.statuses[i]);
+      }
+   }
+   bson_free (task.values);
+   bson_free (task.statuses);
+   bson_free (task.results);
+   bson_free (replacement_lens);
+   bson_destroy (&replacements);
+   return ret;
+}
@@ -26,4 +26,9 @@
 bool
 size_to_uint32 (size_t in, uint32_t *out);
 
+/* Set @len bytes at @data to zero, even if they are not read afterwards. For
+ * memory that held secrets, before it is freed or reused. */
+void
+_mongocrypt_memzero (void *data, size_t len);
+
 #endif /* MONGOCRYPT_UTIL_PRIVATE_H */
@@ -24,3 +24,15 @@ bool size_to_uint32 (size_t in, uint32_t *out)
    *out = (uint32_t) in;
    return true;
 }
+
+void
+_mongocrypt_memzero (void *data, size_t len)
+{
+   /* Write through a volatile pointer so the stores are not optimized away. */
+   volatile uint8_t *bytes = (volatile uint8_t *) data;
+   size_t i;
+
+   for (i = 0; i < len; i++) {
+      bytes[i] = 0;
+   }
+}
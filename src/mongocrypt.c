@@ -18,8 +18,12 @@
 #include <bson/bson.h>
 
 #include "mongocrypt-private.h"
+#include "mongocrypt-atomic-private.h"
 #include "mongocrypt-binary-private.h"
 #include "mongocrypt-cache-collinfo-private.h"
+#include "mongocrypt-cache-deterministic-private.h"
+#include "mongocrypt-cache-marking-private.h"
+#include "mongocrypt-cache-signing-key-private.h"
 #include "mongocrypt-cache-key-private.h"
 #include "mongocrypt-config.h"
 #include "mongocrypt-crypto-private.h"
@@ -119,6 +123,9 @@ mongocrypt_new (void)
    _mongocrypt_mutex_init (&crypt->mutex);
    _mongocrypt_cache_collinfo_init (&crypt->cache_collinfo);
    _mongocrypt_cache_key_init (&crypt->cache_key);
+   _mongocrypt_cache_deterministic_init (&crypt->cache_deterministic);
+   _mongocrypt_cache_marking_init (&crypt->cache_marking);
+   _mongocrypt_cache_signing_key_init (&crypt->cache_signing_key);
    crypt->status = mongocrypt_status_new ();
    _mongocrypt_opts_init (&crypt->opts);
    _mongocrypt_log_init (&crypt->log);
@@ -384,6 +391,27 @@ mongocrypt_init (mongocrypt_t *crypt)
          &crypt->log, crypt->opts.log_fn, crypt->opts.log_ctx);
    }
 
+   _mongocrypt_cache_set_limits (&crypt->cache_key,
+                                 crypt->opts.key_cache_max_entries,
+                                 crypt->opts.key_cache_max_bytes);
+   _mongocrypt_cache_set_limits (&crypt->cache_collinfo,
+                                 crypt->opts.collinfo_cache_max_entries,
+                                 crypt->opts.collinfo_cache_max_bytes);
+   _mongocrypt_cache_set_limits (&crypt->cache_deterministic,
+                                 crypt->opts.deterministic_cache_max_entries,
+                                 crypt->opts.deterministic_cache_max_bytes);
+   _mongocrypt_cache_set_limits (&crypt->cache_marking,
+                                 crypt->opts.marking_cache_max_entries,
+                                 crypt->opts.marking_cache_max_bytes);
+   if (crypt->opts.key_cache_expiration_ms) {
+      _mongocrypt_cache_set_expiration (&crypt->cache_key,
+                                        crypt->opts.key_cache_expiration_ms);
+   }
+   _mongocrypt_cache_set_refresh_ahead (&crypt->cache_key,
+                                        crypt->opts.key_cache_refresh_ahead_ms);
+   _mongocrypt_schema_map_build (&crypt->schema_map_index,
+                                 &crypt->opts.schema_map);
+
    if (!crypt->crypto) {
 #ifndef MONGOCRYPT_ENABLE_CRYPTO
       CLIENT_ERR ("libmongocrypt built with native crypto disabled. crypto "
@@ -396,6 +424,16 @@ mongocrypt_init (mongocrypt_t *crypt)
 
 #endif
    }
+
+   /* Hash the AWS secret once, rather than for every KMS request. */
+   if (crypt->opts.kms_provider_aws.secret_access_key &&
+       !_mongocrypt_hash_secret (
+          crypt->crypto,
+          crypt->opts.kms_provider_aws.secret_access_key,
+          &crypt->opts.kms_provider_aws.secret_access_key_digest,
+          status)) {
+      return false;
+   }
    return true;
 }
 
@@ -431,6 +469,12 @@ mongocrypt_destroy (mongocrypt_t *crypt)
    _mongocrypt_opts_cleanup (&crypt->opts);
    _mongocrypt_cache_cleanup (&crypt->cache_collinfo);
    _mongocrypt_cache_cleanup (&crypt->cache_key);
+   _mongocrypt_cache_cleanup (&crypt->cache_deterministic);
+   _mongocrypt_cache_cleanup (&crypt->cache_marking);
+   _mongocrypt_cache_cleanup (&crypt->cache_signing_key);
+   _mongocrypt_schema_map_cleanup (&crypt->schema_map_index);
+   /* All contexts must be destroyed first, so no key fetches remain. */
+   BSON_ASSERT (!crypt->key_fetches);
    _mongocrypt_mutex_cleanup (&crypt->mutex);
    _mongocrypt_log_cleanup (&crypt->log);
    mongocrypt_status_destroy (crypt->status);
@@ -466,6 +510,17 @@ _mongocrypt_validate_and_copy_string (const char *in,
 }
 
 
+bool
+mongocrypt_is_crypto_available (void)
+{
+#ifdef MONGOCRYPT_ENABLE_CRYPTO
+   return true;
+#else
+   return false;
+#endif
+}
+
+
 bool
 mongocrypt_setopt_crypto_hooks (mongocrypt_t *crypt,
                                 mongocrypt_crypto_fn aes_256_cbc_encrypt,
@@ -568,6 +623,218 @@ mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5 (
    return true;
 }
 
+bool
+mongocrypt_setopt_key_cache_limits (mongocrypt_t *crypt,
+                                    uint32_t max_entries,
+                                    uint64_t max_bytes)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.key_cache_max_entries = max_entries;
+   crypt->opts.key_cache_max_bytes = max_bytes;
+   return true;
+}
+
+bool
+mongocrypt_setopt_collinfo_cache_limits (mongocrypt_t *crypt,
+                                         uint32_t max_entries,
+                                         uint64_t max_bytes)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.collinfo_cache_max_entries = max_entries;
+   crypt->opts.collinfo_cache_max_bytes = max_bytes;
+   return true;
+}
+
+bool
+mongocrypt_setopt_key_cache_expiration (mongocrypt_t *crypt,
+                                        uint64_t expiration_ms,
+                                        uint64_t refresh_ahead_ms)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   if (expiration_ms == 0) {
+      CLIENT_ERR ("key cache expiration must be greater than zero");
+      return false;
+   }
+
+   if (expiration_ms > CACHE_MAX_EXPIRATION_MS) {
+      CLIENT_ERR ("key cache expiration must be at most one year");
+      return false;
+   }
+
+   if (refresh_ahead_ms >= expiration_ms) {
+      CLIENT_ERR ("key cache refresh-ahead must be less than the expiration");
+      return false;
+   }
+
+   crypt->opts.key_cache_expiration_ms = expiration_ms;
+   crypt->opts.key_cache_refresh_ahead_ms = refresh_ahead_ms;
+   return true;
+}
+
+bool
+mongocrypt_setopt_key_fetch_coalescing (mongocrypt_t *crypt,
+                                        uint32_t max_wait_ms)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.key_fetch_max_wait_ms = max_wait_ms;
+   return true;
+}
+
+bool
+mongocrypt_setopt_deterministic_cache_limits (mongocrypt_t *crypt,
+                                              uint32_t max_entries,
+                                              uint64_t max_bytes)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.deterministic_cache_max_entries = max_entries;
+   crypt->opts.deterministic_cache_max_bytes = max_bytes;
+   return true;
+}
+
+bool
+mongocrypt_deterministic_cache_stats (mongocrypt_t *crypt,
+                                      uint64_t *hits,
+                                      uint64_t *misses)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (!hits || !misses) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("arguments 'hits' and 'misses' are required");
+      return false;
+   }
+   *hits = (uint64_t) _mongocrypt_atomic_int64_add (
+      &crypt->cache_deterministic_hits, 0);
+   *misses = (uint64_t) _mongocrypt_atomic_int64_add (
+      &crypt->cache_deterministic_misses, 0);
+   return true;
+}
+
+bool
+mongocrypt_setopt_marking_cache_limits (mongocrypt_t *crypt,
+                                        uint32_t max_entries,
+                                        uint64_t max_bytes)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.marking_cache_max_entries = max_entries;
+   crypt->opts.marking_cache_max_bytes = max_bytes;
+   return true;
+}
+
+bool
+mongocrypt_setopt_local_markings (mongocrypt_t *crypt, bool enabled)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.local_markings = enabled;
+   return true;
+}
+
+bool
+mongocrypt_setopt_kms_keep_alive (mongocrypt_t *crypt, bool enabled)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.kms_keep_alive = enabled;
+   return true;
+}
+
+void
+mongocrypt_marking_cache_clear (mongocrypt_t *crypt)
+{
+   if (!crypt) {
+      return;
+   }
+   _mongocrypt_cache_clear (&crypt->cache_marking);
+}
+
+bool
+mongocrypt_setopt_parallel_executor (mongocrypt_t *crypt,
+                                     mongocrypt_parallel_for_fn parallel_for,
+                                     void *executor_ctx)
+{
+   if (!crypt) {
+      return false;
+   }
+
+   if (crypt->initialized) {
+      mongocrypt_status_t *status = crypt->status;
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+   crypt->opts.parallel_for = parallel_for;
+   crypt->opts.executor_ctx = executor_ctx;
+   return true;
+}
+
 bool
 mongocrypt_setopt_kms_providers (mongocrypt_t *crypt,
                                  mongocrypt_binary_t *kms_providers)
@@ -198,6 +198,61 @@ _test_mongocrypt_buffer_steal_from_string (_mongocrypt_tester_t *tester)
    _mongocrypt_buffer_cleanup (&buf);
 }
 
+static void
+_test_mongocrypt_buffer_resize_in_arena (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_arena_t arena;
+   _mongocrypt_buffer_t a;
+   _mongocrypt_buffer_t b;
+   _mongocrypt_buffer_t large;
+   _mongocrypt_buffer_t heap;
+
+   _mongocrypt_arena_init (&arena);
+   _mongocrypt_buffer_init (&a);
+   _mongocrypt_buffer_init (&b);
+   _mongocrypt_buffer_init (&large);
+   _mongocrypt_buffer_init (&heap);
+
+   /* Small buffers are drawn from the arena, and do not overlap. */
+   _mongocrypt_buffer_resize_in_arena (&a, &arena, 5);
+   _mongocrypt_buffer_resize_in_arena (&b, &arena, 16);
+   ASSERT (!a.owned);
+   ASSERT (!b.owned);
+   ASSERT (a.len == 5);
+   ASSERT (b.len == 16);
+   ASSERT (b.data >= a.data + a.len || a.data >= b.data + b.len);
+   memset (a.data, 'a', a.len);
+   memset (b.data, 'b', b.len);
+   ASSERT (a.data[4] == 'a');
+
+   /* An owned buffer is freed before drawing from the arena. */
+   _mongocrypt_buffer_resize (&heap, 8);
+   ASSERT (heap.owned);
+   _mongocrypt_buffer_resize_in_arena (&heap, &arena, 8);
+   ASSERT (!heap.owned);
+
+   /* Large buffers, or a NULL arena, use the heap. */
+   _mongocrypt_buffer_resize_in_arena (&large, &arena, 64 * 1024);
+   ASSERT (large.owned);
+   ASSERT (large.len == 64 * 1024);
+   _mongocrypt_buffer_cleanup (&large);
+   _mongocrypt_buffer_init (&large);
+   _mongocrypt_buffer_resize_in_arena (&large, NULL, 5);
+   ASSERT (large.owned);
+
+   /* Resetting zeroes the memory drawn from the arena. The only chunk is kept,
+    * so it is still safe to read. */
+   _mongocrypt_arena_reset (&arena);
+   ASSERT (a.data[4] == 0);
+   ASSERT (b.data[15] == 0);
+
+   _mongocrypt_buffer_cleanup (&a);
+   _mongocrypt_buffer_cleanup (&b);
+   _mongocrypt_buffer_cleanup (&large);
+   _mongocrypt_buffer_cleanup (&heap);
+   _mongocrypt_arena_cleanup (&arena);
+}
+
 void
 _mongocrypt_tester_install_buffer (_mongocrypt_tester_t *tester)
 {
@@ -205,4 +260,5 @@ _mongocrypt_tester_install_buffer (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_mongocrypt_buffer_copy_from_data_and_size);
    INSTALL_TEST (_test_mongocrypt_buffer_steal_from_data_and_size);
    INSTALL_TEST (_test_mongocrypt_buffer_steal_from_string);
+   INSTALL_TEST (_test_mongocrypt_buffer_resize_in_arena);
 }
@@ -129,6 +129,59 @@ _test_cache_expiration (_mongocrypt_tester_t *tester)
 }
 
 
+/* Entries added later expire later. Eviction removes only the older ones. */
+static void
+_test_cache_expiration_order (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *entry = BCON_NEW ("a", "b");
+   bson_t *tmp = NULL;
+   char ns[32];
+   int i;
+   const int n = 50;
+
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_expiration (&cache, 250);
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "old%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, ns, entry, status),
+                       status);
+   }
+
+   /* Sleep for 500 milliseconds */
+   _usleep (1000 * 500);
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "new%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, ns, entry, status),
+                       status);
+   }
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "old%d", i);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT (!tmp);
+   }
+
+   /* Every old entry was evicted. */
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == (uint32_t) n);
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "new%d", i);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      bson_destroy (tmp);
+   }
+
+   _mongocrypt_cache_cleanup (&cache);
+   mongocrypt_status_destroy (status);
+   bson_destroy (entry);
+}
+
 static void
 _test_cache_duplicates (_mongocrypt_tester_t *tester)
 {
@@ -255,10 +308,428 @@ _test_cache_duplicates (_mongocrypt_tester_t *tester)
    mongocrypt_status_destroy (status);
    _mongocrypt_cache_cleanup (&cache);
 }
+
+
+/* Key cache values are shared by reference instead of copied. */
+static void
+_test_cache_key_value_shared (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   _mongocrypt_key_doc_t *placeholder_keydoc;
+   _mongocrypt_cache_key_value_t *value, *tmp1, *tmp2;
+   _mongocrypt_cache_key_attr_t *attr;
+   _mongocrypt_key_alt_name_t *alt_names;
+   _mongocrypt_buffer_t buf;
+
+   status = mongocrypt_status_new ();
+   _mongocrypt_buffer_init (&buf);
+   _mongocrypt_buffer_resize (&buf, MONGOCRYPT_KEY_LEN);
+   buf.data[0] = 1;
+   placeholder_keydoc = _mongocrypt_key_new ();
+   value = _mongocrypt_cache_key_value_new (placeholder_keydoc, &buf);
+   alt_names = _MONGOCRYPT_KEY_ALT_NAME_CREATE ("a");
+   attr = _mongocrypt_cache_key_attr_new (NULL /* id */, alt_names);
+
+   _mongocrypt_cache_key_init (&cache);
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, attr, value, status),
+                    status);
+   BSON_ASSERT (value->refcount == 2);
+
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp1));
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp2));
+   BSON_ASSERT (tmp1 == value);
+   BSON_ASSERT (tmp2 == value);
+   BSON_ASSERT (value->refcount == 4);
+   _mongocrypt_cache_key_value_destroy (tmp1);
+   _mongocrypt_cache_key_value_destroy (tmp2);
+
+   /* The value outlives the cache while a reference is held. */
+   _mongocrypt_cache_cleanup (&cache);
+   BSON_ASSERT (value->refcount == 1);
+   BSON_ASSERT (value->decrypted_key_material.data[0] == 1);
+   _mongocrypt_cache_key_value_destroy (value);
+
+   _mongocrypt_cache_key_attr_destroy (attr);
+   _mongocrypt_key_alt_name_destroy_all (alt_names);
+   _mongocrypt_key_destroy (placeholder_keydoc);
+   _mongocrypt_buffer_cleanup (&buf);
+   mongocrypt_status_destroy (status);
+}
+
+/* Add enough entries to spread across all shards and grow the buckets. */
+static void
+_test_cache_many_entries (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *tmp = NULL;
+   char ns[32];
+   int i;
+   const int n = 1000;
+
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_cache_collinfo_init (&cache);
+
+   for (i = 0; i < n; i++) {
+      bson_t *entry = BCON_NEW ("i", BCON_INT32 (i));
+
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      ASSERT_OR_PRINT (
+         _mongocrypt_cache_add_stolen (&cache, ns, entry, status), status);
+   }
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == (uint32_t) n);
+
+   for (i = 0; i < n; i++) {
+      bson_iter_t iter;
+
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      BSON_ASSERT (bson_iter_init_find (&iter, tmp, "i"));
+      BSON_ASSERT (bson_iter_int32 (&iter) == i);
+      bson_destroy (tmp);
+   }
+
+   /* Overwriting an entry does not add a new one. */
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (
+                       &cache, "db.coll0", BCON_NEW ("i", "x"), status),
+                    status);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == (uint32_t) n);
+
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "db.missing", (void **) &tmp));
+   BSON_ASSERT (!tmp);
+
+   _mongocrypt_cache_cleanup (&cache);
+   mongocrypt_status_destroy (status);
+}
+
+
+/* Keys looked up by _id use the hash index. Keys looked up by keyAltName must
+ * still be found regardless of the shard their _id maps to. */
+static void
+_test_cache_key_by_id_and_alt_name (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   _mongocrypt_key_doc_t *placeholder_keydoc;
+   _mongocrypt_cache_key_value_t *value, *tmp;
+   _mongocrypt_cache_key_attr_t *attr;
+   _mongocrypt_buffer_t id, material;
+   _mongocrypt_key_alt_name_t *alt_name;
+   char name[32];
+   int i;
+   const int n = 100;
+
+   status = mongocrypt_status_new ();
+   placeholder_keydoc = _mongocrypt_key_new ();
+   _mongocrypt_buffer_init (&material);
+   _mongocrypt_buffer_resize (&material, MONGOCRYPT_KEY_LEN);
+   _mongocrypt_buffer_init (&id);
+   _mongocrypt_buffer_resize (&id, 16);
+   id.subtype = BSON_SUBTYPE_UUID;
+   memset (id.data, 0, id.len);
+
+   _mongocrypt_cache_key_init (&cache);
+
+   for (i = 0; i < n; i++) {
+      id.data[0] = (uint8_t) i;
+      material.data[0] = (uint8_t) i;
+      bson_snprintf (name, sizeof (name), "name%d", i);
+      alt_name = _MONGOCRYPT_KEY_ALT_NAME_CREATE (name);
+
+      attr = _mongocrypt_cache_key_attr_new (&id, alt_name);
+      value = _mongocrypt_cache_key_value_new (placeholder_keydoc, &material);
+      ASSERT_OR_PRINT (
+         _mongocrypt_cache_add_stolen (&cache, attr, value, status), status);
+      _mongocrypt_cache_key_attr_destroy (attr);
+      _mongocrypt_key_alt_name_destroy_all (alt_name);
+   }
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == (uint32_t) n);
+
+   for (i = 0; i < n; i++) {
+      /* Look up by _id. */
+      id.data[0] = (uint8_t) i;
+      attr = _mongocrypt_cache_key_attr_new (&id, NULL);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      BSON_ASSERT (tmp->decrypted_key_material.data[0] == (uint8_t) i);
+      _mongocrypt_cache_key_value_destroy (tmp);
+      _mongocrypt_cache_key_attr_destroy (attr);
+
+      /* Look up by keyAltName. */
+      bson_snprintf (name, sizeof (name), "name%d", i);
+      alt_name = _MONGOCRYPT_KEY_ALT_NAME_CREATE (name);
+      attr = _mongocrypt_cache_key_attr_new (NULL, alt_name);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      BSON_ASSERT (tmp->decrypted_key_material.data[0] == (uint8_t) i);
+      _mongocrypt_cache_key_value_destroy (tmp);
+      _mongocrypt_cache_key_attr_destroy (attr);
+      _mongocrypt_key_alt_name_destroy_all (alt_name);
+   }
+
+   /* A missing _id is not found. */
+   id.data[0] = (uint8_t) n;
+   attr = _mongocrypt_cache_key_attr_new (&id, NULL);
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp));
+   BSON_ASSERT (!tmp);
+   _mongocrypt_cache_key_attr_destroy (attr);
+
+   _mongocrypt_cache_cleanup (&cache);
+   _mongocrypt_buffer_cleanup (&id);
+   _mongocrypt_buffer_cleanup (&material);
+   _mongocrypt_key_destroy (placeholder_keydoc);
+   mongocrypt_status_destroy (status);
+}
+
+static void
+_test_cache_lru (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *tmp = NULL;
+   char ns[32];
+   int i;
+   const int n = 1000;
+
+   status = mongocrypt_status_new ();
+
+   /* Limit by entry count. */
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_limits (&cache, CACHE_NUM_SHARDS * 2, 0);
+   ASSERT_OR_PRINT (
+      _mongocrypt_cache_add_stolen (
+         &cache, "db.hot", BCON_NEW ("i", BCON_INT32 (-1)), status),
+      status);
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (
+                          &cache, ns, BCON_NEW ("i", BCON_INT32 (i)), status),
+                       status);
+      /* Keep the hot entry recently used. */
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, "db.hot", (void **) &tmp));
+      BSON_ASSERT (tmp);
+      bson_destroy (tmp);
+   }
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == CACHE_NUM_SHARDS * 2);
+   /* The most recently added entry is always kept. */
+   bson_snprintf (ns, sizeof (ns), "db.coll%d", n - 1);
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+   BSON_ASSERT (tmp);
+   bson_destroy (tmp);
+   /* The first entry has been evicted. */
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "db.coll0", (void **) &tmp));
+   BSON_ASSERT (!tmp);
+   _mongocrypt_cache_cleanup (&cache);
+
+   /* Limit by bytes. The cache holds three documents per shard. */
+   tmp = BCON_NEW ("i", BCON_INT32 (0));
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_limits (&cache, 0, CACHE_NUM_SHARDS * 3 * tmp->len);
+   bson_destroy (tmp);
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (
+                          &cache, ns, BCON_NEW ("i", BCON_INT32 (i)), status),
+                       status);
+   }
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == CACHE_NUM_SHARDS * 3);
+   _mongocrypt_cache_cleanup (&cache);
+
+   /* A limit below the number of shards applies to the whole cache. */
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_limits (&cache, 2, 0);
+   for (i = 0; i < 5; i++) {
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (
+                          &cache, ns, BCON_NEW ("i", BCON_INT32 (i)), status),
+                       status);
+      BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) ==
+                   (uint32_t) BSON_MIN (i + 1, 2));
+   }
+   /* Only the two most recently used entries remain. */
+   for (i = 0; i < 5; i++) {
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT ((tmp != NULL) == (i >= 3));
+      bson_destroy (tmp);
+      tmp = NULL;
+   }
+   _mongocrypt_cache_cleanup (&cache);
+
+   /* Entries are not evicted before the limit is reached, however they are
+    * spread over the shards. */
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_limits (&cache, 20, 0);
+   for (i = 0; i < 20; i++) {
+      bson_snprintf (ns, sizeof (ns), "db.coll%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (
+                          &cache, ns, BCON_NEW ("i", BCON_INT32 (i)), status),
+                       status);
+   }
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == 20);
+   _mongocrypt_cache_cleanup (&cache);
+
+   mongocrypt_status_destroy (status);
+}
+
+
+/* Expired pairs in shards that were not accessed are evicted before live
+ * pairs, even if the expired pairs were used more recently. */
+static void
+_test_cache_lru_evicts_expired_first (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *entry = BCON_NEW ("a", "b");
+   bson_t *tmp = NULL;
+   char ns[32];
+   int i;
+   const int n = 10;
+
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_expiration (&cache, 500);
+   _mongocrypt_cache_set_limits (&cache, 2 * n, 0);
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "old%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, ns, entry, status),
+                       status);
+   }
+
+   _usleep (1000 * 300);
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "live%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, ns, entry, status),
+                       status);
+   }
+   /* Use the old entries after the live ones. */
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "old%d", i);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      bson_destroy (tmp);
+   }
+
+   /* The old entries expire, the live ones do not. */
+   _usleep (1000 * 300);
+
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "new%d", i);
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, ns, entry, status),
+                       status);
+   }
+
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == (uint32_t) (2 * n));
+   for (i = 0; i < n; i++) {
+      bson_snprintf (ns, sizeof (ns), "live%d", i);
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      bson_destroy (tmp);
+   }
+
+   _mongocrypt_cache_cleanup (&cache);
+   mongocrypt_status_destroy (status);
+   bson_destroy (entry);
+}
+
+
+static void
+_test_cache_limits_setopt (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_key_cache_limits (crypt, 100, 1024 * 1024),
+              crypt);
+   ASSERT_OK (mongocrypt_setopt_collinfo_cache_limits (crypt, 10, 0), crypt);
+   ASSERT_OK (mongocrypt_setopt_deterministic_cache_limits (crypt, 5, 0),
+              crypt);
+   ASSERT_OK (mongocrypt_setopt_marking_cache_limits (crypt, 7, 0), crypt);
+   ASSERT_OK (mongocrypt_setopt_kms_provider_aws (
+                 crypt, "example", -1, "example", -1),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   BSON_ASSERT (crypt->cache_key.max_entries == 100);
+   BSON_ASSERT (crypt->cache_key.max_bytes == 1024 * 1024);
+   BSON_ASSERT (crypt->cache_collinfo.max_entries == 10);
+   BSON_ASSERT (crypt->cache_collinfo.max_bytes == 0);
+   BSON_ASSERT (crypt->cache_deterministic.max_entries == 5);
+   BSON_ASSERT (crypt->cache_marking.max_entries == 7);
+   ASSERT_FAILS (mongocrypt_setopt_key_cache_limits (crypt, 1, 1),
+                 crypt,
+                 "options cannot be set after initialization");
+   mongocrypt_destroy (crypt);
+}
+
+
+static void
+_test_cache_expiration_setopt (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   ASSERT_FAILS (mongocrypt_setopt_key_cache_expiration (crypt, 0, 0),
+                 crypt,
+                 "expiration must be greater than zero");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_FAILS (mongocrypt_setopt_key_cache_expiration (crypt, 1000, 1000),
+                 crypt,
+                 "refresh-ahead must be less than the expiration");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_FAILS (mongocrypt_setopt_key_cache_expiration (
+                    crypt, CACHE_MAX_EXPIRATION_MS + 1, 0),
+                 crypt,
+                 "expiration must be at most one year");
+   ASSERT_FAILS (
+      mongocrypt_setopt_key_cache_expiration (crypt, UINT64_MAX, 1000),
+      crypt,
+      "expiration must be at most one year");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_key_cache_expiration (
+                 crypt, CACHE_MAX_EXPIRATION_MS, 1000),
+              crypt);
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_key_cache_expiration (crypt, 30000, 5000),
+              crypt);
+   ASSERT_OK (mongocrypt_setopt_kms_provider_aws (
+                 crypt, "example", -1, "example", -1),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   BSON_ASSERT (crypt->cache_key.expiration == 30000);
+   BSON_ASSERT (crypt->cache_key.refresh_ahead == 5000);
+   /* The collinfo cache keeps the default. */
+   BSON_ASSERT (crypt->cache_collinfo.expiration == CACHE_EXPIRATION_MS);
+   BSON_ASSERT (crypt->cache_collinfo.refresh_ahead == 0);
+   mongocrypt_destroy (crypt);
+}
+
+
 void
 _mongocrypt_tester_install_cache (_mongocrypt_tester_t *tester)
 {
    INSTALL_TEST (_test_cache);
    INSTALL_TEST (_test_cache_expiration);
+   INSTALL_TEST (_test_cache_expiration_order);
    INSTALL_TEST (_test_cache_duplicates);
+   INSTALL_TEST (_test_cache_key_value_shared);
+   INSTALL_TEST (_test_cache_many_entries);
+   INSTALL_TEST (_test_cache_key_by_id_and_alt_name);
+   INSTALL_TEST (_test_cache_lru);
+   INSTALL_TEST (_test_cache_lru_evicts_expired_first);
+   INSTALL_TEST (_test_cache_limits_setopt);
+   INSTALL_TEST (_test_cache_expiration_setopt);
 }
\ No newline at end of file
@@ -239,8 +239,8 @@ _test_ciphertext_serialize_associated_data (_mongocrypt_tester_t *tester)
    ciphertext.original_bson_type = BSON_TYPE_UTF8;
    ciphertext.blob_subtype = MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC;
 
-   BSON_ASSERT (_mongocrypt_ciphertext_serialize_associated_data (&ciphertext,
-                                                                  &serialized));
+   BSON_ASSERT (_mongocrypt_ciphertext_serialize_associated_data (
+      &ciphertext, NULL /* arena */, &serialized));
    BSON_ASSERT (serialized.len == 18);
    BSON_ASSERT (0 == memcmp (serialized.data, expected, strlen (expected)));
 
@@ -314,6 +314,7 @@ _test_crypto_hooks_encryption_helper (_mongocrypt_tester_t *tester,
                                     &iv,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &plaintext,
                                     &ciphertext,
                                     &bytes_written,
@@ -398,6 +399,7 @@ _test_crypto_hooks_decryption_helper (_mongocrypt_tester_t *tester,
    ret = _mongocrypt_do_decryption (crypt->crypto,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &ciphertext,
                                     &plaintext,
                                     &bytes_written,
@@ -460,8 +462,13 @@ _test_crypto_hooks_iv_gen_helper (_mongocrypt_tester_t *tester, char *error_on)
 
    call_history = bson_string_new (NULL);
 
-   ret = _mongocrypt_calculate_deterministic_iv (
-      crypt->crypto, &key, &plaintext, &associated_data, &iv, status);
+   ret = _mongocrypt_calculate_deterministic_iv (crypt->crypto,
+                                                 &key,
+                                                 NULL /* prepared key */,
+                                                 &plaintext,
+                                                 &associated_data,
+                                                 &iv,
+                                                 status);
 
    if (0 == strcmp (error_on, "error_on:none")) {
       ASSERT_OK_STATUS (ret, status);
@@ -599,6 +606,24 @@ _test_crypto_hooks_unset (_mongocrypt_tester_t *tester)
 }
 
 
+static void
+_test_crypto_available (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1);
+#ifdef MONGOCRYPT_ENABLE_CRYPTO
+   BSON_ASSERT (mongocrypt_is_crypto_available ());
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+#else
+   BSON_ASSERT (!mongocrypt_is_crypto_available ());
+   ASSERT_FAILS (mongocrypt_init (crypt), crypt, "crypto hooks required");
+#endif
+   mongocrypt_destroy (crypt);
+}
+
+
 /* test a bug fix, that an error on explicit encryption in the crypto hooks sets
  * the context state */
 static void
@@ -729,6 +754,7 @@ _mongocrypt_tester_install_crypto_hooks (_mongocrypt_tester_t *tester)
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_random, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_kms_request, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_unset, CRYPTO_PROHIBITED);
+   INSTALL_TEST_CRYPTO (_test_crypto_available, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_explicit_err, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_explicit_sha256_err,
                         CRYPTO_OPTIONAL);
@@ -58,6 +58,7 @@ _test_roundtrip (_mongocrypt_tester_t *tester)
                                     &iv,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &plaintext,
                                     &ciphertext,
                                     &bytes_written,
@@ -69,6 +70,7 @@ _test_roundtrip (_mongocrypt_tester_t *tester)
    ret = _mongocrypt_do_decryption (crypt->crypto,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &ciphertext,
                                     &decrypted,
                                     &bytes_written,
@@ -93,6 +95,7 @@ _test_roundtrip (_mongocrypt_tester_t *tester)
    ret = _mongocrypt_do_decryption (crypt->crypto,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &ciphertext,
                                     &decrypted,
                                     &bytes_written,
@@ -107,6 +110,7 @@ _test_roundtrip (_mongocrypt_tester_t *tester)
    ret = _mongocrypt_do_decryption (crypt->crypto,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &ciphertext,
                                     &decrypted,
                                     &bytes_written,
@@ -118,6 +122,7 @@ _test_roundtrip (_mongocrypt_tester_t *tester)
    ret = _mongocrypt_do_decryption (crypt->crypto,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &ciphertext,
                                     &decrypted,
                                     &bytes_written,
@@ -134,6 +139,7 @@ _test_roundtrip (_mongocrypt_tester_t *tester)
    ret = _mongocrypt_do_decryption (crypt->crypto,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &ciphertext,
                                     &decrypted,
                                     &bytes_written,
@@ -205,6 +211,7 @@ _test_mcgrew (_mongocrypt_tester_t *tester)
                                     &iv,
                                     &associated_data,
                                     &key,
+                                    NULL /* prepared key */,
                                     &plaintext,
                                     &ciphertext_actual,
                                     &bytes_written,
@@ -225,9 +232,244 @@ _test_mcgrew (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+/* Crypto backends may keep per-key state between calls. Interleave more keys
+ * than they are likely to keep, with and without prepared keys, and check
+ * each result. */
+static void
+_test_roundtrip_interleaved_keys (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_status_t *status;
+   _mongocrypt_buffer_t keys[6];
+   _mongocrypt_prepared_key_t *prepared_keys[6];
+   _mongocrypt_buffer_t iv = {0}, associated_data = {0}, plaintext = {0},
+                        ciphertexts[6], prepared_ciphertext = {0},
+                        decrypted = {0}, prepared_iv = {0};
+   uint32_t bytes_written;
+   int i, j;
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_buffer_resize (&plaintext, 20);
+   memset (plaintext.data, 'p', plaintext.len);
+   _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
+   _mongocrypt_buffer_resize (&prepared_iv, MONGOCRYPT_IV_LEN);
+   _mongocrypt_buffer_resize (&decrypted,
+                              _mongocrypt_calculate_plaintext_len (
+                                 _mongocrypt_calculate_ciphertext_len (20)));
+   _mongocrypt_buffer_resize (&prepared_ciphertext,
+                              _mongocrypt_calculate_ciphertext_len (20));
+
+   for (i = 0; i < 6; i++) {
+      _mongocrypt_buffer_init (&keys[i]);
+      _mongocrypt_buffer_resize (&keys[i], MONGOCRYPT_KEY_LEN);
+      memset (keys[i].data, 'a' + i, keys[i].len);
+      _mongocrypt_buffer_init (&ciphertexts[i]);
+      _mongocrypt_buffer_resize (&ciphertexts[i],
+                                 _mongocrypt_calculate_ciphertext_len (20));
+      /* NULL if the backend does not prepare keys. */
+      prepared_keys[i] = _mongocrypt_prepare_key (crypt->crypto, &keys[i]);
+#ifdef MONGOCRYPT_ENABLE_CRYPTO_LIBCRYPTO
+      BSON_ASSERT (prepared_keys[i]);
+#endif
+   }
+
+   for (j = 0; j < 3; j++) {
+      for (i = 0; i < 6; i++) {
+         ASSERT_OR_PRINT (
+            _mongocrypt_calculate_deterministic_iv (crypt->crypto,
+                                                    &keys[i],
+                                                    NULL /* prepared key */,
+                                                    &plaintext,
+                                                    &associated_data,
+                                                    &iv,
+                                                    status),
+            status);
+         ASSERT_OR_PRINT (
+            _mongocrypt_calculate_deterministic_iv (crypt->crypto,
+                                                    &keys[i],
+                                                    prepared_keys[i],
+                                                    &plaintext,
+                                                    &associated_data,
+                                                    &prepared_iv,
+                                                    status),
+            status);
+         BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&iv, &prepared_iv));
+
+         ASSERT_OR_PRINT (_mongocrypt_do_encryption (crypt->crypto,
+                                                     &iv,
+                                                     &associated_data,
+                                                     &keys[i],
+                                                     NULL /* prepared key */,
+                                                     &plaintext,
+                                                     &ciphertexts[i],
+                                                     &bytes_written,
+                                                     status),
+                          status);
+         ASSERT_OR_PRINT (_mongocrypt_do_encryption (crypt->crypto,
+                                                     &iv,
+                                                     &associated_data,
+                                                     &keys[i],
+                                                     prepared_keys[i],
+                                                     &plaintext,
+                                                     &prepared_ciphertext,
+                                                     &bytes_written,
+                                                     status),
+                          status);
+         BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&ciphertexts[i],
+                                                   &prepared_ciphertext));
+      }
+      /* Same plaintext under different keys must differ. */
+      BSON_ASSERT (0 != _mongocrypt_buffer_cmp (&ciphertexts[0],
+                                                &ciphertexts[1]));
+      for (i = 5; i >= 0; i--) {
+         ASSERT_OR_PRINT (_mongocrypt_do_decryption (crypt->crypto,
+                                                     &associated_data,
+                                                     &keys[i],
+                                                     prepared_keys[i],
+                                                     &ciphertexts[i],
+                                                     &decrypted,
+                                                     &bytes_written,
+                                                     status),
+                          status);
+         BSON_ASSERT (bytes_written == plaintext.len);
+         BSON_ASSERT (
+            0 == memcmp (decrypted.data, plaintext.data, plaintext.len));
+      }
+   }
+
+   /* Decrypting with the wrong key fails the HMAC check. */
+   BSON_ASSERT (!_mongocrypt_do_decryption (crypt->crypto,
+                                            &associated_data,
+                                            &keys[1],
+                                            prepared_keys[1],
+                                            &ciphertexts[0],
+                                            &decrypted,
+                                            &bytes_written,
+                                            status));
+
+   for (i = 0; i < 6; i++) {
+      _mongocrypt_prepared_key_destroy (prepared_keys[i]);
+      _mongocrypt_buffer_cleanup (&keys[i]);
+      _mongocrypt_buffer_cleanup (&ciphertexts[i]);
+   }
+   _mongocrypt_buffer_cleanup (&iv);
+   _mongocrypt_buffer_cleanup (&prepared_iv);
+   _mongocrypt_buffer_cleanup (&plaintext);
+   _mongocrypt_buffer_cleanup (&prepared_ciphertext);
+   _mongocrypt_buffer_cleanup (&decrypted);
+   mongocrypt_status_destroy (status);
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Encrypt and decrypt @n small fields, and print the time per field. */
+static void
+_field_overhead_run (mongocrypt_t *crypt, const char *label, int n)
+{
+   mongocrypt_status_t *status;
+   _mongocrypt_buffer_t key = {0}, iv = {0}, associated_data = {0},
+                        plaintext = {0}, ciphertext = {0}, decrypted = {0};
+   uint32_t bytes_written;
+   int64_t start;
+   int64_t encrypt_us;
+   int64_t decrypt_us;
+   int i;
+
+   status = mongocrypt_status_new ();
+
+   /* A small field, like an int32 or short string. */
+   _mongocrypt_buffer_resize (&plaintext, 8);
+   memset (plaintext.data, 'p', plaintext.len);
+   _mongocrypt_buffer_resize (&ciphertext,
+                              _mongocrypt_calculate_ciphertext_len (8));
+   _mongocrypt_buffer_resize (
+      &decrypted, _mongocrypt_calculate_plaintext_len (ciphertext.len));
+   _mongocrypt_buffer_resize (&key, MONGOCRYPT_KEY_LEN);
+   memset (key.data, 'k', key.len);
+   _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
+   memset (iv.data, 'i', iv.len);
+
+   start = bson_get_monotonic_time ();
+   for (i = 0; i < n; i++) {
+      ASSERT_OR_PRINT (_mongocrypt_do_encryption (crypt->crypto,
+                                                  &iv,
+                                                  &associated_data,
+                                                  &key,
+                                                  NULL /* prepared key */,
+                                                  &plaintext,
+                                                  &ciphertext,
+                                                  &bytes_written,
+                                                  status),
+                       status);
+   }
+   encrypt_us = bson_get_monotonic_time () - start;
+
+   start = bson_get_monotonic_time ();
+   for (i = 0; i < n; i++) {
+      ASSERT_OR_PRINT (_mongocrypt_do_decryption (crypt->crypto,
+                                                  &associated_data,
+                                                  &key,
+                                                  NULL /* prepared key */,
+                                                  &ciphertext,
+                                                  &decrypted,
+                                                  &bytes_written,
+                                                  status),
+                       status);
+   }
+   decrypt_us = bson_get_monotonic_time () - start;
+   BSON_ASSERT (bytes_written == plaintext.len);
+   BSON_ASSERT (0 == memcmp (decrypted.data, plaintext.data, plaintext.len));
+
+   printf ("%s: encrypt: %.3f us/field, decrypt: %.3f us/field\n",
+           label,
+           (double) encrypt_us / n,
+           (double) decrypt_us / n);
+
+   _mongocrypt_buffer_cleanup (&key);
+   _mongocrypt_buffer_cleanup (&iv);
+   _mongocrypt_buffer_cleanup (&plaintext);
+   _mongocrypt_buffer_cleanup (&ciphertext);
+   _mongocrypt_buffer_cleanup (&decrypted);
+   mongocrypt_status_destroy (status);
+}
+
+
+/* Measure the per-field cost of encrypting and decrypting small values, where
+ * context setup rather than the cipher dominates. With libcrypto, this
+ * compares creating contexts per operation with reusing them on the thread.
+ * Only runs when the MONGOCRYPT_BENCHMARK environment variable is set, e.g.
+ * "MONGOCRYPT_BENCHMARK=1 test-mongocrypt _test_field_overhead_benchmark". */
+static void
+_test_field_overhead_benchmark (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   const int n = 10000;
+
+   if (!getenv ("MONGOCRYPT_BENCHMARK")) {
+      printf ("  - skipping: set MONGOCRYPT_BENCHMARK to run\n");
+      return;
+   }
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+#ifdef MONGOCRYPT_ENABLE_CRYPTO_LIBCRYPTO
+   _native_crypto_reuse_contexts = false;
+   _field_overhead_run (crypt, "per-operation contexts", n);
+   _native_crypto_reuse_contexts = true;
+   _field_overhead_run (crypt, "reused contexts", n);
+#else
+   _field_overhead_run (crypt, "native crypto", n);
+#endif
+   mongocrypt_destroy (crypt);
+}
+
+
 void
 _mongocrypt_tester_install_crypto (_mongocrypt_tester_t *tester)
 {
    INSTALL_TEST (_test_mcgrew);
    INSTALL_TEST (_test_roundtrip);
+   INSTALL_TEST (_test_roundtrip_interleaved_keys);
+   INSTALL_TEST (_test_field_overhead_benchmark);
 }
\ No newline at end of file
@@ -105,6 +105,134 @@ _test_decrypt_need_keys (_mongocrypt_tester_t *tester)
 }
 
 
+/* Returns true if the attribute of any pair in @cache contains @str. */
+static bool
+_cache_attr_contains (_mongocrypt_cache_t *cache, const char *str)
+{
+   _mongocrypt_cache_pair_t *pair;
+   _mongocrypt_buffer_t *attr;
+   size_t len = strlen (str);
+   uint32_t i, j;
+   size_t k;
+
+   for (i = 0; i < CACHE_NUM_SHARDS; i++) {
+      for (j = 0; j < cache->shards[i].num_buckets; j++) {
+         for (pair = cache->shards[i].buckets[j]; pair; pair = pair->next) {
+            attr = (_mongocrypt_buffer_t *) pair->attr;
+            for (k = 0; k + len <= attr->len; k++) {
+               if (0 == memcmp (attr->data + k, str, len)) {
+                  return true;
+               }
+            }
+         }
+      }
+   }
+   return false;
+}
+
+
+/* AWS requests for the same credentials, day and region share a signing key.
+ */
+static void
+_test_decrypt_signing_key_cache (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *encrypted;
+   int i;
+
+   encrypted = _mongocrypt_tester_encrypted_doc (tester);
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_kms_provider_aws (
+                 crypt, "example", -1, "example-secret", -1),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   /* The secret is hashed once, by init. */
+   BSON_ASSERT (!_mongocrypt_buffer_empty (
+      &crypt->opts.kms_provider_aws.secret_access_key_digest));
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_signing_key) ==
+                0);
+
+   for (i = 0; i < 2; i++) {
+      ctx = mongocrypt_ctx_new (crypt);
+      ASSERT_OK (mongocrypt_ctx_decrypt_init (ctx, encrypted), ctx);
+      _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_KMS);
+      BSON_ASSERT (mongocrypt_ctx_next_kms_ctx (ctx));
+      BSON_ASSERT (
+         _mongocrypt_cache_num_entries (&crypt->cache_signing_key) == 1);
+      mongocrypt_ctx_destroy (ctx);
+   }
+
+   /* Entries are keyed on a digest of the secret key, not the key itself. */
+   BSON_ASSERT (_cache_attr_contains (&crypt->cache_signing_key, "example"));
+   BSON_ASSERT (
+      !_cache_attr_contains (&crypt->cache_signing_key, "example-secret"));
+
+   mongocrypt_destroy (crypt);
+   mongocrypt_binary_destroy (encrypted);
+}
+
+
+static void
+_test_decrypt_kms_keep_alive (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_kms_ctx_t *kms;
+   mongocrypt_binary_t *encrypted;
+   mongocrypt_binary_t *msg;
+   int i;
+
+   encrypted = _mongocrypt_tester_encrypted_doc (tester);
+   /* 0: keep-alive disabled, 1: enabled, 2: enabled but the server closes the
+    * connection. */
+   for (i = 0; i < 3; i++) {
+      bool keep_alive = i >= 1;
+
+      crypt = mongocrypt_new ();
+      ASSERT_OK (mongocrypt_setopt_kms_provider_aws (
+                    crypt, "example", -1, "example", -1),
+                 crypt);
+      if (keep_alive) {
+         ASSERT_OK (mongocrypt_setopt_kms_keep_alive (crypt, true), crypt);
+      }
+      ASSERT_OK (mongocrypt_init (crypt), crypt);
+      ASSERT_FAILS (mongocrypt_setopt_kms_keep_alive (crypt, true),
+                    crypt,
+                    "options cannot be set after initialization");
+
+      ctx = mongocrypt_ctx_new (crypt);
+      ASSERT_OK (mongocrypt_ctx_decrypt_init (ctx, encrypted), ctx);
+      _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_KMS);
+      kms = mongocrypt_ctx_next_kms_ctx (ctx);
+      BSON_ASSERT (kms);
+      msg = mongocrypt_binary_new ();
+      ASSERT_OK (mongocrypt_kms_ctx_message (kms, msg), kms);
+      if (keep_alive) {
+         BSON_ASSERT (strstr ((char *) msg->data, "Connection:keep-alive"));
+      } else {
+         BSON_ASSERT (strstr ((char *) msg->data, "Connection:close"));
+      }
+      mongocrypt_binary_destroy (msg);
+
+      BSON_ASSERT (mongocrypt_kms_ctx_keep_alive (kms) == keep_alive);
+      if (i == 2) {
+         msg = TEST_FILE ("./test/example/kms-decrypt-reply-close.txt");
+         ASSERT_OK (mongocrypt_kms_ctx_feed (kms, msg), kms);
+         BSON_ASSERT (0 == mongocrypt_kms_ctx_bytes_needed (kms));
+         BSON_ASSERT (!mongocrypt_kms_ctx_keep_alive (kms));
+      } else {
+         _mongocrypt_tester_satisfy_kms (tester, kms);
+         BSON_ASSERT (mongocrypt_kms_ctx_keep_alive (kms) == keep_alive);
+      }
+
+      mongocrypt_ctx_destroy (ctx);
+      mongocrypt_destroy (crypt);
+   }
+   mongocrypt_binary_destroy (encrypted);
+}
+
+
 static void
 _test_decrypt_ready (_mongocrypt_tester_t *tester)
 {
@@ -201,6 +329,118 @@ _test_decrypt_empty_binary (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+static void
+_test_decrypt_batch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *decrypted;
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   decrypted = mongocrypt_binary_new ();
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_decrypt_batch_init (
+         ctx,
+         TEST_BSON (
+            "{'v': [{'ssn': {'$binary': {'subType': '06', 'base64': "
+            "'AWFhYWFhYWFhYWFhYWFhYWECRTOW9yZzNDn5dGwuqsrJQNLtgMEKaujhs9aRWRp+"
+            "7Yo3JK8N8jC8P0Xjll6C1CwLsE/"
+            "iP5wjOMhVv1KMMyOCSCrHorXRsb2IKPtzl2lKTqQ='}}}, {'x': 1}, {'ssn': "
+            "{'$binary': {'subType': '06', 'base64': "
+            "'AWFhYWFhYWFhYWFhYWFhYWECRTOW9yZzNDn5dGwuqsrJQNLtgMEKaujhs9aRWRp+"
+            "7Yo3JK8N8jC8P0Xjll6C1CwLsE/"
+            "iP5wjOMhVv1KMMyOCSCrHorXRsb2IKPtzl2lKTqQ='}}}]}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, decrypted), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (
+      TEST_BSON ("{'v': [{'ssn': '457-55-5462'}, {'x': 1}, {'ssn': "
+                 "'457-55-5462'}]}"),
+      decrypted);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (
+      mongocrypt_ctx_decrypt_batch_init (ctx, TEST_BSON ("{'v': [{}, 1]}")),
+      ctx,
+      "invalid docs, 'v' must contain only documents");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (
+      mongocrypt_ctx_decrypt_batch_init (ctx, TEST_BSON ("{'x': []}")),
+      ctx,
+      "invalid docs, must contain array 'v'");
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_binary_destroy (decrypted);
+   mongocrypt_destroy (crypt);
+}
+
+/* Runs tasks in reverse on the calling thread. */
+static bool
+_reverse_parallel_for (void *executor_ctx,
+                       mongocrypt_task_fn task,
+                       void *task_ctx,
+                       uint32_t count)
+{
+   int *calls = (int *) executor_ctx;
+
+   *calls += 1;
+   while (count > 0) {
+      count--;
+      task (task_ctx, count);
+   }
+   return true;
+}
+
+
+static void
+_test_decrypt_parallel_executor (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *decrypted;
+   int calls = 0;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_parallel_executor (
+                 crypt, _reverse_parallel_for, &calls),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   decrypted = mongocrypt_binary_new ();
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_decrypt_init (
+         ctx,
+         TEST_BSON (
+            "{'a': {'$binary': {'subType': '06', 'base64': "
+            "'AWFhYWFhYWFhYWFhYWFhYWECRTOW9yZzNDn5dGwuqsrJQNLtgMEKaujhs9aRWRp+"
+            "7Yo3JK8N8jC8P0Xjll6C1CwLsE/"
+            "iP5wjOMhVv1KMMyOCSCrHorXRsb2IKPtzl2lKTqQ='}}, 'x': 1, 'b': "
+            "{'$binary': {'subType': '06', 'base64': "
+            "'AWFhYWFhYWFhYWFhYWFhYWECRTOW9yZzNDn5dGwuqsrJQNLtgMEKaujhs9aRWRp+"
+            "7Yo3JK8N8jC8P0Xjll6C1CwLsE/"
+            "iP5wjOMhVv1KMMyOCSCrHorXRsb2IKPtzl2lKTqQ='}}}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, decrypted), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (
+      TEST_BSON ("{'a': '457-55-5462', 'x': 1, 'b': '457-55-5462'}"),
+      decrypted);
+   BSON_ASSERT (calls == 1);
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_binary_destroy (decrypted);
+   mongocrypt_destroy (crypt);
+}
+
 void
 _mongocrypt_tester_install_ctx_decrypt (_mongocrypt_tester_t *tester)
 {
@@ -208,6 +448,10 @@ _mongocrypt_tester_install_ctx_decrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_decrypt_init);
    INSTALL_TEST (_test_decrypt_need_keys);
    INSTALL_TEST (_test_decrypt_ready);
+   INSTALL_TEST (_test_decrypt_signing_key_cache);
+   INSTALL_TEST (_test_decrypt_kms_keep_alive);
    INSTALL_TEST (_test_decrypt_empty_aws);
    INSTALL_TEST (_test_decrypt_empty_binary);
+   INSTALL_TEST (_test_decrypt_batch);
+   INSTALL_TEST (_test_decrypt_parallel_executor);
 }
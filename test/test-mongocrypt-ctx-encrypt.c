@@ -14,8 +14,13 @@
  * limitations under the License.
  */
 
+#include <mongocrypt-cache-deterministic-private.h>
 #include <mongocrypt-marking-private.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 #include "test-mongocrypt.h"
 
 
@@ -867,6 +872,57 @@ _test_local_schema (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+
+static void
+_test_local_schema_index (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   _mongocrypt_ctx_encrypt_t *ectx;
+   const uint8_t *map_data;
+   bson_t schema;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_schema_map (
+                 crypt,
+                 TEST_BSON ("{'test.other': {'bsonType': 'object'},"
+                            " 'test.test': {'properties': {}},"
+                            " 'test.test': {'bsonType': 'object'},"
+                            " 'test.bad': 1}")),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   map_data = crypt->opts.schema_map.data;
+
+   /* The first schema for a repeated namespace is used, and is not copied. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_BSON ("{'find': 'test'}")),
+              ctx);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) ==
+                MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   BSON_ASSERT (!ectx->schema.owned);
+   BSON_ASSERT (ectx->schema.data > map_data);
+   BSON_ASSERT (ectx->schema.data < map_data + crypt->opts.schema_map.len);
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->schema, &schema));
+   BSON_ASSERT (bson_has_field (&schema, "properties"));
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A namespace mapped to a value that is not a document is an error. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_encrypt_init (
+                    ctx, "test", -1, TEST_BSON ("{'find': 'bad'}")),
+                 ctx,
+                 "malformed schema map");
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_destroy (crypt);
+}
+
+
 static void
 _test_encrypt_caches_collinfo (_mongocrypt_tester_t *tester)
 {
@@ -1362,6 +1418,219 @@ _test_explicit_encryption (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+static void
+_test_explicit_encryption_bulk (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *bin, *key_id;
+   bson_t as_bson;
+   bson_iter_t iter;
+   _mongocrypt_buffer_t first, second, third, single;
+   char *deterministic = "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic";
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   key_id = mongocrypt_binary_new_from_data (
+      MONGOCRYPT_DATA_AND_LEN ("aaaaaaaaaaaaaaaa"));
+   bin = mongocrypt_binary_new ();
+
+   /* Encrypt one value for comparison. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_OK (
+      mongocrypt_ctx_explicit_encrypt_init (ctx, TEST_BSON ("{'v': 123}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (&single, bin);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Encrypting in bulk matches encrypting values one at a time. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_OK (mongocrypt_ctx_explicit_encrypt_bulk_init (
+                 ctx, TEST_BSON ("{'v': [123, 'abc', 123]}")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (bin, &as_bson));
+   BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "v.0", &iter));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&first, &iter));
+   BSON_ASSERT (bson_iter_next (&iter));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&second, &iter));
+   BSON_ASSERT (bson_iter_next (&iter));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&third, &iter));
+   BSON_ASSERT (!bson_iter_next (&iter));
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&first, &third));
+   BSON_ASSERT (0 != _mongocrypt_buffer_cmp (&first, &second));
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&single, &as_bson));
+   BSON_ASSERT (bson_iter_init_find (&iter, &as_bson, "v"));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&second, &iter));
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&first, &second));
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_FAILS (mongocrypt_ctx_explicit_encrypt_bulk_init (
+                    ctx, TEST_BSON ("{'v': 123}")),
+                 ctx,
+                 "invalid msg, 'v' must be an array");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_FAILS (mongocrypt_ctx_explicit_encrypt_bulk_init (
+                    ctx, TEST_BSON ("{'v': [123, null]}")),
+                 ctx,
+                 "BSON type invalid for encryption");
+   mongocrypt_ctx_destroy (ctx);
+
+   _mongocrypt_buffer_cleanup (&single);
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_binary_destroy (key_id);
+   mongocrypt_destroy (crypt);
+}
+
+/* Explicitly encrypt {'v': 123}, returning a copy of the result. */
+static void
+_explicit_encrypt_123 (_mongocrypt_tester_t *tester,
+                       mongocrypt_t *crypt,
+                       const char *algorithm,
+                       _mongocrypt_buffer_t *out)
+{
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *bin;
+
+   bin = mongocrypt_binary_new ();
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, algorithm, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_alt_name (
+                 ctx, TEST_BSON ("{'keyAltName': 'keyDocumentName'}")),
+              ctx);
+   ASSERT_OK (
+      mongocrypt_ctx_explicit_encrypt_init (ctx, TEST_BSON ("{'v': 123}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (out, bin);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_binary_destroy (bin);
+}
+
+
+static void
+_test_encrypt_deterministic_cache (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t first, second, random;
+   uint64_t hits, misses;
+   char *deterministic = "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic";
+   char *randomized = "AEAD_AES_256_CBC_HMAC_SHA_512-Random";
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_deterministic_cache_limits (crypt, 10, 0),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+
+   _explicit_encrypt_123 (tester, crypt, deterministic, &first);
+   ASSERT_OK (mongocrypt_deterministic_cache_stats (crypt, &hits, &misses),
+              crypt);
+   BSON_ASSERT (hits == 0);
+   BSON_ASSERT (misses == 1);
+   /* The entry counts the ciphertext of the int32 and its fixed size lookup
+    * digest. */
+   BSON_ASSERT (crypt->cache_deterministic.num_bytes ==
+                _mongocrypt_calculate_ciphertext_len (4) +
+                   MONGOCRYPT_CACHE_DETERMINISTIC_ATTR_LEN);
+
+   /* The second encryption is served from the cache, with the same result. */
+   _explicit_encrypt_123 (tester, crypt, deterministic, &second);
+   ASSERT_OK (mongocrypt_deterministic_cache_stats (crypt, &hits, &misses),
+              crypt);
+   BSON_ASSERT (hits == 1);
+   BSON_ASSERT (misses == 1);
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&first, &second));
+
+   /* Random encryption does not use the cache. */
+   _explicit_encrypt_123 (tester, crypt, randomized, &random);
+   ASSERT_OK (mongocrypt_deterministic_cache_stats (crypt, &hits, &misses),
+              crypt);
+   BSON_ASSERT (hits == 1);
+   BSON_ASSERT (misses == 1);
+   BSON_ASSERT (0 != _mongocrypt_buffer_cmp (&first, &random));
+
+   _mongocrypt_buffer_cleanup (&first);
+   _mongocrypt_buffer_cleanup (&second);
+   _mongocrypt_buffer_cleanup (&random);
+   mongocrypt_destroy (crypt);
+}
+
+static void
+_test_ctx_reset (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *bin;
+   mongocrypt_status_t *status;
+   _mongocrypt_buffer_t expected, actual;
+   char *deterministic = "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic";
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   _explicit_encrypt_123 (tester, crypt, deterministic, &expected);
+
+   /* Reset a context partway through an operation. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_alt_name (
+                 ctx, TEST_BSON ("{'keyAltName': 'keyDocumentName'}")),
+              ctx);
+   ASSERT_OK (
+      mongocrypt_ctx_explicit_encrypt_init (ctx, TEST_BSON ("{'v': 123}")),
+      ctx);
+   mongocrypt_ctx_reset (ctx);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_DONE);
+
+   /* Options set before the reset are cleared. */
+   ASSERT_FAILS (
+      mongocrypt_ctx_explicit_encrypt_init (ctx, TEST_BSON ("{'v': 123}")),
+      ctx,
+      "either key id or key alt name required");
+
+   /* A reset clears the error, and the context can be used again. */
+   mongocrypt_ctx_reset (ctx);
+   status = mongocrypt_status_new ();
+   BSON_ASSERT (mongocrypt_ctx_status (ctx, status));
+   mongocrypt_status_destroy (status);
+
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_alt_name (
+                 ctx, TEST_BSON ("{'keyAltName': 'keyDocumentName'}")),
+              ctx);
+   ASSERT_OK (
+      mongocrypt_ctx_explicit_encrypt_init (ctx, TEST_BSON ("{'v': 123}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_from_binary (&actual, bin);
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&expected, &actual));
+   mongocrypt_binary_destroy (bin);
+
+   /* A context may be reset after finishing, and then destroyed. */
+   mongocrypt_ctx_reset (ctx);
+   mongocrypt_ctx_destroy (ctx);
+   _mongocrypt_buffer_cleanup (&expected);
+   mongocrypt_destroy (crypt);
+}
+
 /* Test with empty AWS credentials. */
 void
 _test_encrypt_empty_aws (_mongocrypt_tester_t *tester)
@@ -1523,6 +1792,603 @@ _test_encrypt_caches_collinfo_without_jsonschema (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+#define ENCRYPTED_SSN                                                         \
+   "{'$binary': {'subType': '06', 'base64': "                                 \
+   "'AWFhYWFhYWFhYWFhYWFhYWECRTOW9yZzNDn5dGwuqsrJQNLtgMEKaujhs9aRWRp+7Yo3JK8N" \
+   "8jC8P0Xjll6C1CwLsE/iP5wjOMhVv1KMMyOCSCrHorXRsb2IKPtzl2lKTqQ='}}"
+
+static void
+_test_encrypt_batch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *encrypted;
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   encrypted = mongocrypt_binary_new ();
+
+   /* Commands are marked one at a time, then share one key request. Bypassed
+    * commands are returned unchanged in their position. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_batch_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'v': [{'find': 'test', 'filter': {'ssn': "
+                            "'457-55-5462'}}, {'ping': 1}, {'find': 'test', "
+                            "'filter': {'ssn': '457-55-5462'}}]}")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, encrypted), ctx);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_DONE);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (
+      TEST_BSON ("{'v': [{'filter': {'ssn': " ENCRYPTED_SSN "}, 'find': "
+                 "'test'}, {'ping': 1}, {'filter': {'ssn': " ENCRYPTED_SSN
+                 "}, 'find': 'test'}]}"),
+      encrypted);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A batch of only bypassed commands needs nothing. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_batch_init (
+                 ctx, "test", -1, TEST_BSON ("{'v': [{'ping': 1}]}")),
+              ctx);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, encrypted), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_BSON ("{'v': [{'ping': 1}]}"),
+                                        encrypted);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_encrypt_batch_init (
+                    ctx,
+                    "test",
+                    -1,
+                    TEST_BSON ("{'v': [{'find': 'a'}, {'find': 'b'}]}")),
+                 ctx,
+                 "all commands in a batch must target the same collection");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_encrypt_batch_init (
+                    ctx, "test", -1, TEST_BSON ("{'v': {'find': 'a'}}")),
+                 ctx,
+                 "invalid commands, must contain array 'v'");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_encrypt_batch_init (
+                    ctx, "test", -1, TEST_BSON ("{'v': [1]}")),
+                 ctx,
+                 "invalid commands, 'v' must contain only documents");
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_binary_destroy (encrypted);
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Runs tasks in reverse on the calling thread. */
+static bool
+_reverse_parallel_for (void *executor_ctx,
+                       mongocrypt_task_fn task,
+                       void *task_ctx,
+                       uint32_t count)
+{
+   int *calls = (int *) executor_ctx;
+
+   *calls += 1;
+   while (count > 0) {
+      count--;
+      task (task_ctx, count);
+   }
+   return true;
+}
+
+
+#define SSN_MARKING                                                            \
+   "{'$binary': {'subType': '06', 'base64': "                                 \
+   "'ADgAAAAQYQABAAAABWtpABAAAAAEYWFhYWFhYWFhYWFhYWFhYQJ2AAwAAAA0NTctNTUtNTQ2" \
+   "MgAA'}}"
+
+/* Encrypt a command with two markings, returning a copy of the result. */
+static void
+_encrypt_two_markings (_mongocrypt_tester_t *tester,
+                       mongocrypt_t *crypt,
+                       _mongocrypt_buffer_t *out)
+{
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *bin;
+
+   bin = mongocrypt_binary_new ();
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_encrypt_init (
+         ctx,
+         "test",
+         -1,
+         TEST_BSON ("{'find': 'test', 'filter': {'a': '457-55-5462', 'b': "
+                    "'457-55-5462'}}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (
+      tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ASSERT_OK (mongocrypt_ctx_mongo_feed (
+                 ctx,
+                 TEST_BSON ("{'schemaRequiresEncryption': true, "
+                            "'hasEncryptedPlaceholders': true, 'result': "
+                            "{'find': 'test', 'filter': {'a': " SSN_MARKING
+                            ", 'b': " SSN_MARKING "}}, 'ok': 1}")),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (out, bin);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_binary_destroy (bin);
+}
+
+
+/* Returns an initialized mongocrypt_t with @parallel_for as its executor. */
+static mongocrypt_t *
+_mongocrypt_with_executor (mongocrypt_parallel_for_fn parallel_for,
+                           void *executor_ctx)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_parallel_executor (crypt, parallel_for, executor_ctx),
+      crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   return crypt;
+}
+
+
+static void
+_test_encrypt_parallel_executor (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t serial, parallel;
+   int calls = 0;
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   _encrypt_two_markings (tester, crypt, &serial);
+   mongocrypt_destroy (crypt);
+
+   crypt = _mongocrypt_with_executor (_reverse_parallel_for, &calls);
+   _encrypt_two_markings (tester, crypt, &parallel);
+
+   /* Deterministic encryption gives the same bytes either way. */
+   BSON_ASSERT (calls == 1);
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&serial, &parallel));
+
+   /* The executor cannot change once the handle is initialized. */
+   ASSERT_FAILS (mongocrypt_setopt_parallel_executor (crypt, NULL, NULL),
+                 crypt,
+                 "options cannot be set after initialization");
+   mongocrypt_destroy (crypt);
+
+   _mongocrypt_buffer_cleanup (&serial);
+   _mongocrypt_buffer_cleanup (&parallel);
+}
+
+
+#ifndef _WIN32
+typedef struct {
+   mongocrypt_task_fn task;
+   void *task_ctx;
+   uint32_t index;
+} _thread_task_t;
+
+
+static void *
+_thread_task_run (void *arg)
+{
+   _thread_task_t *thread_task = (_thread_task_t *) arg;
+
+   thread_task->task (thread_task->task_ctx, thread_task->index);
+   return NULL;
+}
+
+
+/* An executor that runs each task on its own thread. */
+static bool
+_thread_parallel_for (void *executor_ctx,
+                      mongocrypt_task_fn task,
+                      void *task_ctx,
+                      uint32_t count)
+{
+   int *calls = (int *) executor_ctx;
+   pthread_t *threads;
+   _thread_task_t *thread_tasks;
+   uint32_t started;
+   uint32_t i;
+   bool ret = true;
+
+   *calls += 1;
+   threads = bson_malloc0 (count * sizeof (pthread_t));
+   thread_tasks = bson_malloc0 (count * sizeof (_thread_task_t));
+   for (started = 0; started < count; started++) {
+      thread_tasks[started].task = task;
+      thread_tasks[started].task_ctx = task_ctx;
+      thread_tasks[started].index = started;
+      if (0 != pthread_create (&threads[started],
+                               NULL,
+                               _thread_task_run,
+                               &thread_tasks[started])) {
+         ret = false;
+         break;
+      }
+   }
+   /* Only return once every started task has returned. */
+   for (i = 0; i < started; i++) {
+      BSON_ASSERT (0 == pthread_join (threads[i], NULL));
+   }
+   bson_free (thread_tasks);
+   bson_free (threads);
+   return ret;
+}
+
+
+/* Encrypt on real threads, with the fields of each document running
+ * concurrently. */
+static void
+_test_encrypt_parallel_executor_threads (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t serial, parallel;
+   int calls = 0;
+   int i;
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   _encrypt_two_markings (tester, crypt, &serial);
+   mongocrypt_destroy (crypt);
+
+   crypt = _mongocrypt_with_executor (_thread_parallel_for, &calls);
+   for (i = 0; i < 10; i++) {
+      _encrypt_two_markings (tester, crypt, &parallel);
+      BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&serial, &parallel));
+      _mongocrypt_buffer_cleanup (&parallel);
+   }
+   BSON_ASSERT (calls == 10);
+   mongocrypt_destroy (crypt);
+
+   _mongocrypt_buffer_cleanup (&serial);
+}
+#endif /* _WIN32 */
+
+
+/* Assert that the marking at @path in the marked command of @ctx is for
+ * @expected. */
+static void
+_assert_marked (mongocrypt_ctx_t *ctx, const char *path, const char *expected)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_marking_t marking;
+   _mongocrypt_buffer_t buf;
+   bson_t as_bson;
+   bson_iter_t iter;
+   mongocrypt_status_t *status;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   status = mongocrypt_status_new ();
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &as_bson));
+   BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, path, &iter));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&buf, &iter));
+   ASSERT_OR_PRINT (_mongocrypt_marking_parse_unowned (&buf, &marking, status),
+                    status);
+   BSON_ASSERT (0 == strcmp (bson_iter_utf8 (&marking.v_iter, NULL), expected));
+   _mongocrypt_marking_cleanup (&marking);
+   mongocrypt_status_destroy (status);
+}
+
+
+static void
+_test_encrypt_marking_cache (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_marking_cache_limits (crypt, 10, 0), crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (
+      tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
+   mongocrypt_ctx_destroy (ctx);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_marking) == 1);
+
+   /* A command of the same shape is marked without mongocryptd. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': '123'}}")),
+              ctx);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) !=
+                MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   _assert_marked (ctx, "filter.ssn", "123");
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A command of another shape needs mongocryptd. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_encrypt_init (
+         ctx,
+         "test",
+         -1,
+         TEST_BSON ("{'find': 'test', 'filter': {'ssn': '123'}, 'limit': 1}")),
+      ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Clearing the cache sends commands to mongocryptd again. */
+   mongocrypt_marking_cache_clear (crypt);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Mark an insert of {ssn: '457-55-5462', name: 'abc'}, with a schema that
+ * encrypts 'ssn' with the JSON @key_id, and a mongocryptd reply that has the
+ * marking @marking for 'ssn'. Returns the crypt, whose marking cache is
+ * enabled. */
+static mongocrypt_t *
+_insert_with_marking_cache (_mongocrypt_tester_t *tester,
+                            const char *key_id,
+                            mongocrypt_binary_t *marking)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *reply_bin;
+   bson_t reply, result, docs, doc;
+   uint8_t *data;
+   uint32_t len;
+
+   len = mongocrypt_binary_len (marking);
+   data = bson_malloc (len + 1);
+   BSON_ASSERT (data);
+   data[0] = 0; /* the intent-to-encrypt marking type. */
+   memcpy (data + 1, mongocrypt_binary_data (marking), len);
+
+   bson_init (&reply);
+   BSON_APPEND_BOOL (&reply, "schemaRequiresEncryption", true);
+   BSON_APPEND_INT32 (&reply, "ok", 1);
+   BSON_APPEND_DOCUMENT_BEGIN (&reply, "result", &result);
+   BSON_APPEND_UTF8 (&result, "insert", "test");
+   BSON_APPEND_ARRAY_BEGIN (&result, "documents", &docs);
+   BSON_APPEND_DOCUMENT_BEGIN (&docs, "0", &doc);
+   BSON_ASSERT (bson_append_binary (
+      &doc, "ssn", -1, BSON_SUBTYPE_ENCRYPTED, data, len + 1));
+   BSON_APPEND_UTF8 (&doc, "name", "abc");
+   bson_append_document_end (&docs, &doc);
+   bson_append_array_end (&result, &docs);
+   bson_append_document_end (&reply, &result);
+   BSON_APPEND_BOOL (&reply, "hasEncryptedPlaceholders", true);
+   bson_free (data);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_schema_map (
+                 crypt,
+                 TEST_BSON ("{'test.test': {'bsonType': 'object', "
+                            "'properties': {'ssn': {'encrypt': {'keyId': %s, "
+                            "'bsonType': 'string', 'algorithm': "
+                            "'AEAD_AES_256_CBC_HMAC_SHA_512-Random'}}}}}",
+                            key_id)),
+              crypt);
+   ASSERT_OK (mongocrypt_setopt_marking_cache_limits (crypt, 10, 0), crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'insert': 'test', 'documents': [{'ssn': "
+                            "'457-55-5462', 'name': 'abc'}]}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   reply_bin = mongocrypt_binary_new_from_data (
+      (uint8_t *) bson_get_data (&reply), reply.len);
+   ASSERT_OK (mongocrypt_ctx_mongo_feed (ctx, reply_bin), ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_binary_destroy (reply_bin);
+   bson_destroy (&reply);
+   mongocrypt_ctx_destroy (ctx);
+   return crypt;
+}
+
+
+#define KEY_ID \
+   "{'$binary': {'base64': 'YWFhYWFhYWFhYWFhYWFhYQ==', 'subType': '04'}}"
+
+static void
+_test_encrypt_marking_cache_insert (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   _mongocrypt_ctx_encrypt_t *ectx;
+   bson_t marked_cmd;
+   bson_iter_t iter;
+   mongocrypt_binary_t *insert;
+
+   insert = TEST_BSON ("{'insert': 'test', 'documents': [{'ssn': "
+                       "'123-45-6789', 'name': 'xyz'}]}");
+
+   /* Markings with a key id are reused for other insert documents. The values
+    * that are not marked are taken from the new command. */
+   crypt = _insert_with_marking_cache (
+      tester,
+      "[" KEY_ID "]",
+      TEST_BSON ("{'a': 1, 'ki': " KEY_ID ", 'v': '457-55-5462'}"));
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_marking) == 1);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (ctx, "test", -1, insert), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _assert_marked (ctx, "documents.0.ssn", "123-45-6789");
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &marked_cmd));
+   BSON_ASSERT (bson_iter_init (&iter, &marked_cmd));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "documents.0.name", &iter));
+   BSON_ASSERT (0 == strcmp (bson_iter_utf8 (&iter, NULL), "xyz"));
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   /* A key alt name may come from another value of the document, here 'name'
+    * through the JSON pointer keyId, so the reply is not cached. */
+   crypt = _insert_with_marking_cache (
+      tester,
+      "'/name'",
+      TEST_BSON ("{'a': 1, 'ka': 'abc', 'v': '457-55-5462'}"));
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_marking) == 0);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (ctx, "test", -1, insert), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Returns a mongocrypt_t that marks commands locally with the JSON schema
+ * @schema for "test.test". */
+static mongocrypt_t *
+_local_markings_crypt (_mongocrypt_tester_t *tester, const char *schema)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_schema_map (
+                 crypt, TEST_BSON ("{'test.test': %s}", schema)),
+              crypt);
+   ASSERT_OK (mongocrypt_setopt_local_markings (crypt, true), crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   return crypt;
+}
+
+
+/* Assert that encrypting @cmd with @crypt falls back to mongocryptd. */
+static void
+_assert_needs_mongocryptd (_mongocrypt_tester_t *tester,
+                           mongocrypt_t *crypt,
+                           mongocrypt_binary_t *cmd)
+{
+   mongocrypt_ctx_t *ctx;
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (ctx, "test", -1, cmd), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+}
+
+
+static void
+_test_encrypt_local_markings (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   _mongocrypt_ctx_encrypt_t *ectx;
+   bson_t reply, marked_cmd, expected, docs, doc;
+   bson_iter_t marking;
+   const char *insert = "{'insert': 'test', 'documents': [{'ssn': "
+                        "'457-55-5462', 'name': 'abc'}]}";
+
+   crypt = _local_markings_crypt (
+      tester,
+      "{'bsonType': 'object', 'properties': {'ssn': {'encrypt': {'keyId': "
+      "[{'$binary': {'base64': 'YWFhYWFhYWFhYWFhYWFhYQ==', 'subType': "
+      "'04'}}], 'bsonType': 'string', 'algorithm': "
+      "'AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic'}}}}");
+
+   /* An insert is marked without mongocryptd. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_encrypt_init (ctx, "test", -1, TEST_BSON ("%s", insert)),
+      ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+
+   /* The marking is byte for byte the one mongocryptd gives for the same
+    * value, key, and algorithm. */
+   BSON_ASSERT (_mongocrypt_binary_to_bson (
+      TEST_FILE ("./test/example/mongocryptd-reply.json"), &reply));
+   BSON_ASSERT (bson_iter_init (&marking, &reply));
+   BSON_ASSERT (
+      bson_iter_find_descendant (&marking, "result.filter.ssn", &marking));
+   bson_init (&expected);
+   BSON_APPEND_UTF8 (&expected, "insert", "test");
+   BSON_APPEND_ARRAY_BEGIN (&expected, "documents", &docs);
+   BSON_APPEND_DOCUMENT_BEGIN (&docs, "0", &doc);
+   BSON_ASSERT (bson_append_iter (&doc, "ssn", -1, &marking));
+   BSON_APPEND_UTF8 (&doc, "name", "abc");
+   bson_append_document_end (&docs, &doc);
+   bson_append_array_end (&expected, &docs);
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &marked_cmd));
+   BSON_ASSERT (bson_equal (&expected, &marked_cmd));
+   bson_destroy (&expected);
+
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Other commands are sent to mongocryptd. */
+   _assert_needs_mongocryptd (
+      tester, crypt, TEST_FILE ("./test/example/cmd.json"));
+   mongocrypt_destroy (crypt);
+
+   /* So are schemas with keywords the local engine does not know. */
+   crypt = _local_markings_crypt (
+      tester,
+      "{'bsonType': 'object', 'patternProperties': {'^s': {'encrypt': {"
+      "'keyId': [{'$binary': {'base64': 'YWFhYWFhYWFhYWFhYWFhYQ==', "
+      "'subType': '04'}}], 'bsonType': 'string', 'algorithm': "
+      "'AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic'}}}}");
+   _assert_needs_mongocryptd (tester, crypt, TEST_BSON ("%s", insert));
+   mongocrypt_destroy (crypt);
+
+   /* And key ids given by a JSON pointer into the document. */
+   crypt = _local_markings_crypt (
+      tester,
+      "{'bsonType': 'object', 'properties': {'ssn': {'encrypt': {'keyId': "
+      "'/name', 'algorithm': 'AEAD_AES_256_CBC_HMAC_SHA_512-Random'}}}}");
+   _assert_needs_mongocryptd (tester, crypt, TEST_BSON ("%s", insert));
+   mongocrypt_destroy (crypt);
+}
+
+
 void
 _mongocrypt_tester_install_ctx_encrypt (_mongocrypt_tester_t *tester)
 {
@@ -1535,6 +2401,7 @@ _mongocrypt_tester_install_ctx_encrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_key_missing_region);
    INSTALL_TEST (_test_view);
    INSTALL_TEST (_test_local_schema);
+   INSTALL_TEST (_test_local_schema_index);
    INSTALL_TEST (_test_encrypt_caches_collinfo);
    INSTALL_TEST (_test_encrypt_caches_keys);
    INSTALL_TEST (_test_encrypt_caches_keys_by_alt_name);
@@ -1545,9 +2412,20 @@ _mongocrypt_tester_install_ctx_encrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_encrypt_dupe_jsonschema);
    INSTALL_TEST (_test_encrypting_with_explicit_encryption);
    INSTALL_TEST (_test_explicit_encryption);
+   INSTALL_TEST (_test_explicit_encryption_bulk);
+   INSTALL_TEST (_test_encrypt_deterministic_cache);
+   INSTALL_TEST (_test_ctx_reset);
    INSTALL_TEST (_test_encrypt_empty_aws);
    INSTALL_TEST (_test_encrypt_custom_endpoint);
    INSTALL_TEST (_test_encrypt_with_aws_session_token);
    INSTALL_TEST (_test_encrypt_caches_empty_collinfo);
    INSTALL_TEST (_test_encrypt_caches_collinfo_without_jsonschema);
+   INSTALL_TEST (_test_encrypt_batch);
+   INSTALL_TEST (_test_encrypt_parallel_executor);
+#ifndef _WIN32
+   INSTALL_TEST (_test_encrypt_parallel_executor_threads);
+#endif
+   INSTALL_TEST (_test_encrypt_marking_cache);
+   INSTALL_TEST (_test_encrypt_marking_cache_insert);
+   INSTALL_TEST (_test_encrypt_local_markings);
 }
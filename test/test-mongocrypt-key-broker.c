@@ -619,6 +619,119 @@ _test_key_broker_multi_match (_mongocrypt_tester_t *tester)
 }
 
 
+static void
+_test_key_broker_lookup (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_key_broker_t key_broker;
+   _mongocrypt_key_broker_t key_broker_cached;
+   _mongocrypt_buffer_t key_id1, key_id2, key_doc1, key_doc2, unknown_id;
+   _mongocrypt_buffer_t material1, material2, key_id_out;
+   const _mongocrypt_prepared_key_t *prepared1, *prepared2;
+   mongocrypt_kms_ctx_t *kms;
+   bson_value_t alt_name;
+   mongocrypt_status_t *status;
+
+   _gen_uuid_and_key_and_altname (tester, "alt1", 1, &key_id1, &key_doc1);
+   _gen_uuid_and_key_and_altname (tester, "alt2", 2, &key_id2, &key_doc2);
+   _gen_uuid (3, &unknown_id);
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   _mongocrypt_key_broker_init (&key_broker, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&key_broker, &key_id1),
+              &key_broker);
+   _key_broker_add_name (&key_broker, "alt2");
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&key_broker), &key_broker);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&key_broker, &key_doc1),
+              &key_broker);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&key_broker, &key_doc2),
+              &key_broker);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&key_broker), &key_broker);
+   while ((kms = _mongocrypt_key_broker_next_kms (&key_broker))) {
+      _mongocrypt_tester_satisfy_kms (tester, kms);
+   }
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (&key_broker), &key_broker);
+
+   /* Key material is borrowed from the key broker, not copied. */
+   status = mongocrypt_status_new ();
+   ASSERT_OK_STATUS (_mongocrypt_key_broker_decrypted_key_by_id (
+                        &key_broker, &key_id1, &material1, &prepared1, status),
+                     status);
+   BSON_ASSERT (!material1.owned);
+   BSON_ASSERT (material1.len == MONGOCRYPT_KEY_LEN);
+#ifdef MONGOCRYPT_ENABLE_CRYPTO_LIBCRYPTO
+   /* The key is prepared once, on the value stored to the key cache. */
+   BSON_ASSERT (prepared1);
+#endif
+
+   /* Look up each key by _id and by keyAltName. */
+   _bson_value_from_string ("alt1", &alt_name);
+   ASSERT_OK_STATUS (
+      _mongocrypt_key_broker_decrypted_key_by_name (&key_broker,
+                                                    &alt_name,
+                                                    &material2,
+                                                    &prepared2,
+                                                    &key_id_out,
+                                                    status),
+      status);
+   BSON_ASSERT (material2.data == material1.data);
+   BSON_ASSERT (prepared2 == prepared1);
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&key_id_out, &key_id1));
+   bson_value_destroy (&alt_name);
+
+   _bson_value_from_string ("alt2", &alt_name);
+   ASSERT_OK_STATUS (
+      _mongocrypt_key_broker_decrypted_key_by_name (&key_broker,
+                                                    &alt_name,
+                                                    &material2,
+                                                    NULL /* prepared key */,
+                                                    &key_id_out,
+                                                    status),
+      status);
+   BSON_ASSERT (material2.data != material1.data);
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp (&key_id_out, &key_id2));
+   ASSERT_OK_STATUS (
+      _mongocrypt_key_broker_decrypted_key_by_id (
+         &key_broker, &key_id2, &material1, NULL /* prepared key */, status),
+      status);
+   BSON_ASSERT (material2.data == material1.data);
+   bson_value_destroy (&alt_name);
+
+   ASSERT_FAILS_STATUS (
+      _mongocrypt_key_broker_decrypted_key_by_id (
+         &key_broker, &unknown_id, &material1, NULL /* prepared key */, status),
+      status,
+      "could not find key");
+   /* A failed lookup does not fail the key broker. */
+   BSON_ASSERT (key_broker.state == KB_DONE);
+   ASSERT_OK_STATUS (true, key_broker.status);
+
+   /* A later key broker gets the key from the cache, and shares the key
+    * prepared by the first. */
+   _mongocrypt_key_broker_init (&key_broker_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&key_broker_cached, &key_id1),
+              &key_broker_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&key_broker_cached),
+              &key_broker_cached);
+   BSON_ASSERT (key_broker_cached.state == KB_DONE);
+   ASSERT_OK_STATUS (
+      _mongocrypt_key_broker_decrypted_key_by_id (
+         &key_broker_cached, &key_id1, &material2, &prepared2, status),
+      status);
+   BSON_ASSERT (prepared2 == prepared1);
+   _mongocrypt_key_broker_cleanup (&key_broker_cached);
+   mongocrypt_status_destroy (status);
+
+   _mongocrypt_buffer_cleanup (&key_id1);
+   _mongocrypt_buffer_cleanup (&key_doc1);
+   _mongocrypt_buffer_cleanup (&key_id2);
+   _mongocrypt_buffer_cleanup (&key_doc2);
+   _mongocrypt_buffer_cleanup (&unknown_id);
+   _mongocrypt_key_broker_cleanup (&key_broker);
+   mongocrypt_destroy (crypt);
+}
+
+
 /*
 <RequestMessage tag="0x420078" type="Structure">
  <RequestHeader tag="0x420077" type="Structure">
@@ -768,8 +881,8 @@ _test_key_broker_kmip (_mongocrypt_tester_t *tester)
               kms);
    ASSERT_OK (_mongocrypt_key_broker_kms_done (&kb), &kb);
 
-   BSON_ASSERT (
-      _mongocrypt_key_broker_decrypted_key_by_id (&kb, &id, &secretdata));
+   BSON_ASSERT (_mongocrypt_key_broker_decrypted_key_by_id (
+      &kb, &id, &secretdata, NULL /* prepared key */, kb.status));
    ASSERT_CMPBYTES (secretdata.data,
                     secretdata.len,
                     EXPECTED_SECRETDATA,
@@ -785,6 +898,96 @@ _test_key_broker_kmip (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+/* Keys wrapped by the same KMIP key on the same endpoint share one request. */
+static void
+_test_key_broker_kmip_batch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_key_broker_t kb;
+   bson_t keydoc_bson;
+   bson_t other_keydoc_bson = BSON_INITIALIZER;
+   bson_iter_t iter;
+   _mongocrypt_buffer_t id;
+   _mongocrypt_buffer_t other_id;
+   _mongocrypt_buffer_t keydoc;
+   _mongocrypt_buffer_t other_keydoc;
+   mongocrypt_kms_ctx_t *kms;
+   mongocrypt_binary_t *msg;
+   _mongocrypt_buffer_t secretdata;
+   const uint8_t other_id_data[16] = {1, 2, 3, 4, 5, 6, 7, 8,
+                                      9, 10, 11, 12, 13, 14, 15, 16};
+
+   crypt = _mongocrypt_tester_mongocrypt ();
+   _mongocrypt_key_broker_init (&kb, crypt);
+   _load_json_as_bson ("./test/data/key-document-kmip.json", &keydoc_bson);
+   ASSERT_OR_PRINT_MSG (bson_iter_init_find (&iter, &keydoc_bson, "_id"),
+                        "could not find _id in key-document-kmip.json");
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&id, &iter));
+
+   /* A second key with the same key material and KMIP keyId. */
+   bson_copy_to_excluding_noinit (
+      &keydoc_bson, &other_keydoc_bson, "_id", "keyAltNames", NULL);
+   BSON_ASSERT (BSON_APPEND_BINARY (&other_keydoc_bson,
+                                    "_id",
+                                    BSON_SUBTYPE_UUID,
+                                    other_id_data,
+                                    sizeof (other_id_data)));
+   _mongocrypt_buffer_init (&other_id);
+   other_id.data = (uint8_t *) other_id_data;
+   other_id.len = sizeof (other_id_data);
+   other_id.subtype = BSON_SUBTYPE_UUID;
+
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb, &id), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb, &other_id), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   _mongocrypt_buffer_from_bson (&keydoc, &keydoc_bson);
+   _mongocrypt_buffer_from_bson (&other_keydoc, &other_keydoc_bson);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&kb, &keydoc), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&kb, &other_keydoc), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb), &kb);
+
+   /* There should be exactly one KMS request, for the one KMIP keyId. */
+   kms = _mongocrypt_key_broker_next_kms (&kb);
+   ASSERT_OR_PRINT_MSG (kms, "expected KMS context returned, got none");
+   BSON_ASSERT (!_mongocrypt_key_broker_next_kms (&kb));
+
+   msg = mongocrypt_binary_new ();
+   mongocrypt_kms_ctx_message (kms, msg);
+   ASSERT_CMPBYTES (EXPECTED_GET_REQUEST,
+                    sizeof (EXPECTED_GET_REQUEST),
+                    mongocrypt_binary_data (msg),
+                    mongocrypt_binary_len (msg));
+
+   ASSERT_OK (kms_ctx_feed_all (
+                 kms, SUCCESS_GET_RESPONSE, sizeof (SUCCESS_GET_RESPONSE)),
+              kms);
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (&kb), &kb);
+
+   BSON_ASSERT (_mongocrypt_key_broker_decrypted_key_by_id (
+      &kb, &id, &secretdata, NULL /* prepared key */, kb.status));
+   ASSERT_CMPBYTES (secretdata.data,
+                    secretdata.len,
+                    EXPECTED_SECRETDATA,
+                    sizeof (EXPECTED_SECRETDATA));
+   _mongocrypt_buffer_cleanup (&secretdata);
+   BSON_ASSERT (_mongocrypt_key_broker_decrypted_key_by_id (
+      &kb, &other_id, &secretdata, NULL /* prepared key */, kb.status));
+   ASSERT_CMPBYTES (secretdata.data,
+                    secretdata.len,
+                    EXPECTED_SECRETDATA,
+                    sizeof (EXPECTED_SECRETDATA));
+   _mongocrypt_buffer_cleanup (&secretdata);
+
+   mongocrypt_binary_destroy (msg);
+   _mongocrypt_buffer_cleanup (&keydoc);
+   _mongocrypt_buffer_cleanup (&other_keydoc);
+   _mongocrypt_buffer_cleanup (&id);
+   bson_destroy (&keydoc_bson);
+   bson_destroy (&other_keydoc_bson);
+   _mongocrypt_key_broker_cleanup (&kb);
+   mongocrypt_destroy (crypt);
+}
+
 /*
 <ResponseMessage tag="0x42007b" type="Structure">
  <ResponseHeader tag="0x42007a" type="Structure">
@@ -875,6 +1078,279 @@ _test_key_broker_kmip_notfound (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+/* Satisfy a key broker waiting on @key_doc. This stores the key to the cache.
+ */
+static void
+_key_broker_fetch (_mongocrypt_tester_t *tester,
+                   _mongocrypt_key_broker_t *kb,
+                   _mongocrypt_buffer_t *key_doc)
+{
+   mongocrypt_kms_ctx_t *kms;
+
+   BSON_ASSERT (kb->state == KB_ADDING_DOCS);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (kb, key_doc), kb);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (kb), kb);
+   kms = _mongocrypt_key_broker_next_kms (kb);
+   BSON_ASSERT (kms);
+   _mongocrypt_tester_satisfy_kms (tester, kms);
+   BSON_ASSERT (!_mongocrypt_key_broker_next_kms (kb));
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (kb), kb);
+   BSON_ASSERT (kb->state == KB_DONE);
+}
+
+
+static void
+_test_key_broker_refresh_ahead (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id, key_doc;
+   _mongocrypt_key_broker_t kb_fill, kb_refresh, kb_cached;
+
+   _gen_uuid_and_key (tester, 1, &key_id, &key_doc);
+   crypt = _mongocrypt_tester_mongocrypt ();
+   /* Every entry is immediately within the refresh-ahead window. */
+   _mongocrypt_cache_set_refresh_ahead (&crypt->cache_key,
+                                        crypt->cache_key.expiration);
+
+   /* Populate the cache. */
+   _mongocrypt_key_broker_init (&kb_fill, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_fill, &key_id), &kb_fill);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_fill), &kb_fill);
+   _key_broker_fetch (tester, &kb_fill, &key_doc);
+   _mongocrypt_key_broker_cleanup (&kb_fill);
+
+   /* The first broker to see the entry is asked to refresh it. */
+   _mongocrypt_key_broker_init (&kb_refresh, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_refresh, &key_id),
+              &kb_refresh);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_refresh), &kb_refresh);
+   BSON_ASSERT (_key_broker_num_satisfied (&kb_refresh) == 0);
+
+   /* Others are served the cached entry while the refresh is in flight. */
+   _mongocrypt_key_broker_init (&kb_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_cached, &key_id),
+              &kb_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_cached), &kb_cached);
+   BSON_ASSERT (kb_cached.state == KB_DONE);
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+
+   /* Completing the refresh replaces the entry. */
+   _key_broker_fetch (tester, &kb_refresh, &key_doc);
+   _mongocrypt_key_broker_cleanup (&kb_refresh);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_key) == 1);
+
+   /* With refresh-ahead disabled, the entry is always served. */
+   _mongocrypt_cache_set_refresh_ahead (&crypt->cache_key, 0);
+   _mongocrypt_key_broker_init (&kb_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_cached, &key_id),
+              &kb_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_cached), &kb_cached);
+   BSON_ASSERT (kb_cached.state == KB_DONE);
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+
+   _mongocrypt_buffer_cleanup (&key_id);
+   _mongocrypt_buffer_cleanup (&key_doc);
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Start a key broker requesting @key_id and return whether it was asked to
+ * refresh the cached key rather than served from the cache. */
+static bool
+_key_broker_asked_to_refresh (_mongocrypt_key_broker_t *kb,
+                              mongocrypt_t *crypt,
+                              _mongocrypt_buffer_t *key_id)
+{
+   _mongocrypt_key_broker_init (kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (kb, key_id), kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (kb), kb);
+   return _key_broker_num_satisfied (kb) == 0;
+}
+
+
+static void
+_test_key_broker_refresh_ahead_released (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id, key_doc, other_id, other_doc;
+   _mongocrypt_key_broker_t kb_fill, kb_refresh, kb_cached;
+
+   _gen_uuid_and_key (tester, 1, &key_id, &key_doc);
+   _gen_uuid_and_key (tester, 2, &other_id, &other_doc);
+   crypt = _mongocrypt_tester_mongocrypt ();
+   /* Every entry is immediately within the refresh-ahead window. */
+   _mongocrypt_cache_set_refresh_ahead (&crypt->cache_key,
+                                        crypt->cache_key.expiration);
+
+   /* Populate the cache. */
+   _mongocrypt_key_broker_init (&kb_fill, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_fill, &key_id), &kb_fill);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_fill), &kb_fill);
+   _key_broker_fetch (tester, &kb_fill, &key_doc);
+   _mongocrypt_key_broker_cleanup (&kb_fill);
+
+   /* A broker destroyed before fetching releases its claim. */
+   BSON_ASSERT (_key_broker_asked_to_refresh (&kb_refresh, crypt, &key_id));
+   BSON_ASSERT (!_key_broker_asked_to_refresh (&kb_cached, crypt, &key_id));
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+   _mongocrypt_key_broker_cleanup (&kb_refresh);
+
+   /* A broker that fails releases its claim, before it is destroyed. */
+   BSON_ASSERT (_key_broker_asked_to_refresh (&kb_refresh, crypt, &key_id));
+   ASSERT_FAILS (_mongocrypt_key_broker_add_doc (&kb_refresh, &other_doc),
+                 &kb_refresh,
+                 "unexpected key returned");
+   BSON_ASSERT (_key_broker_asked_to_refresh (&kb_cached, crypt, &key_id));
+   _mongocrypt_key_broker_cleanup (&kb_refresh);
+
+   /* Completing the refresh replaces the entry. */
+   _key_broker_fetch (tester, &kb_cached, &key_doc);
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_key) == 1);
+
+   _mongocrypt_buffer_cleanup (&other_id);
+   _mongocrypt_buffer_cleanup (&other_doc);
+   _mongocrypt_buffer_cleanup (&key_id);
+   _mongocrypt_buffer_cleanup (&key_doc);
+   mongocrypt_destroy (crypt);
+}
+
+static void
+_test_key_broker_coalesce_fetches (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id, key_doc;
+   _mongocrypt_key_broker_t kb_owner, kb_waiter, kb_cached;
+   mongocrypt_binary_t *filter;
+   int i;
+
+   _gen_uuid_and_key (tester, 1, &key_id, &key_doc);
+   crypt = _mongocrypt_tester_mongocrypt ();
+   crypt->opts.key_fetch_max_wait_ms = 60000;
+
+   /* The first broker to miss the cache registers the fetch. */
+   _mongocrypt_key_broker_init (&kb_owner, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_owner, &key_id),
+              &kb_owner);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_owner), &kb_owner);
+   BSON_ASSERT (kb_owner.state == KB_ADDING_DOCS);
+   BSON_ASSERT (kb_owner.owns_fetches);
+   BSON_ASSERT (crypt->key_fetches);
+
+   BSON_ASSERT (0 == _mongocrypt_key_broker_wait_ms (&kb_owner));
+
+   /* A second broker defers the key. With nothing else to fetch, it waits
+    * instead of fetching. */
+   _mongocrypt_key_broker_init (&kb_waiter, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_waiter, &key_id),
+              &kb_waiter);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.state == KB_ADDING_DOCS);
+   BSON_ASSERT (!kb_waiter.owns_fetches);
+   BSON_ASSERT (kb_waiter.key_requests->deferred);
+   BSON_ASSERT (KEY_FETCH_WAIT_MIN_MS ==
+                _mongocrypt_key_broker_wait_ms (&kb_waiter));
+
+   /* While the owner is fetching, the waiter backs off. */
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.state == KB_ADDING_DOCS);
+   BSON_ASSERT (kb_waiter.key_requests->deferred);
+   BSON_ASSERT (2 * KEY_FETCH_WAIT_MIN_MS ==
+                _mongocrypt_key_broker_wait_ms (&kb_waiter));
+   for (i = 0; i < 10; i++) {
+      ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb_waiter), &kb_waiter);
+   }
+   BSON_ASSERT (KEY_FETCH_WAIT_MAX_MS ==
+                _mongocrypt_key_broker_wait_ms (&kb_waiter));
+
+   /* A waiting broker has no filter. */
+   _mongocrypt_key_broker_init (&kb_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_cached, &key_id),
+              &kb_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_cached), &kb_cached);
+   filter = mongocrypt_binary_new ();
+   ASSERT_FAILS (_mongocrypt_key_broker_filter (&kb_cached, filter),
+                 &kb_cached,
+                 "waiting on other fetches");
+   mongocrypt_binary_destroy (filter);
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+
+   /* Completing the fetch releases it. */
+   _key_broker_fetch (tester, &kb_owner, &key_doc);
+   BSON_ASSERT (!kb_owner.owns_fetches);
+   BSON_ASSERT (!crypt->key_fetches);
+   _mongocrypt_key_broker_cleanup (&kb_owner);
+
+   /* The waiter is then served from the cache. */
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.state == KB_DONE);
+   BSON_ASSERT (_key_broker_num_satisfied (&kb_waiter) == 1);
+   BSON_ASSERT (0 == _mongocrypt_key_broker_wait_ms (&kb_waiter));
+   _mongocrypt_key_broker_cleanup (&kb_waiter);
+
+   /* Later brokers are served from the cache without deferring. */
+   _mongocrypt_key_broker_init (&kb_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_cached, &key_id),
+              &kb_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_cached), &kb_cached);
+   BSON_ASSERT (kb_cached.state == KB_DONE);
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+
+   /* An abandoned fetch is released on cleanup, and the waiter fetches the
+    * key itself. */
+   _mongocrypt_cache_clear (&crypt->cache_key);
+   _mongocrypt_key_broker_init (&kb_owner, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_owner, &key_id),
+              &kb_owner);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_owner), &kb_owner);
+   _mongocrypt_key_broker_init (&kb_waiter, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_waiter, &key_id),
+              &kb_waiter);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.key_requests->deferred);
+   BSON_ASSERT (crypt->key_fetches);
+   _mongocrypt_key_broker_cleanup (&kb_owner);
+   BSON_ASSERT (!crypt->key_fetches);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.state == KB_ADDING_DOCS);
+   BSON_ASSERT (!kb_waiter.key_requests->deferred);
+   BSON_ASSERT (kb_waiter.owns_fetches);
+   BSON_ASSERT (0 == _mongocrypt_key_broker_wait_ms (&kb_waiter));
+   _key_broker_fetch (tester, &kb_waiter, &key_doc);
+   BSON_ASSERT (!crypt->key_fetches);
+   _mongocrypt_key_broker_cleanup (&kb_waiter);
+
+   /* Once the wait expires, the waiter fetches the key itself without
+    * taking over the owner's fetch. */
+   _mongocrypt_cache_clear (&crypt->cache_key);
+   _mongocrypt_key_broker_init (&kb_owner, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_owner, &key_id),
+              &kb_owner);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_owner), &kb_owner);
+   _mongocrypt_key_broker_init (&kb_waiter, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_waiter, &key_id),
+              &kb_waiter);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.key_requests->deferred);
+   kb_waiter.fetch_deadline = 0;
+   /* The waiter still waits once before polling. */
+   BSON_ASSERT (1 == _mongocrypt_key_broker_wait_ms (&kb_waiter));
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb_waiter), &kb_waiter);
+   BSON_ASSERT (kb_waiter.state == KB_ADDING_DOCS);
+   BSON_ASSERT (!kb_waiter.key_requests->deferred);
+   BSON_ASSERT (!kb_waiter.owns_fetches);
+   _key_broker_fetch (tester, &kb_waiter, &key_doc);
+   _mongocrypt_key_broker_cleanup (&kb_waiter);
+   BSON_ASSERT (kb_owner.owns_fetches);
+   _mongocrypt_key_broker_cleanup (&kb_owner);
+   BSON_ASSERT (!crypt->key_fetches);
+
+   _mongocrypt_buffer_cleanup (&key_id);
+   _mongocrypt_buffer_cleanup (&key_doc);
+   mongocrypt_destroy (crypt);
+}
+
+
 void
 _mongocrypt_tester_install_key_broker (_mongocrypt_tester_t *tester)
 {
@@ -883,6 +1359,11 @@ _mongocrypt_tester_install_key_broker (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_key_broker_add_decrypted_key);
    INSTALL_TEST (_test_key_broker_wrong_subtype);
    INSTALL_TEST (_test_key_broker_multi_match);
+   INSTALL_TEST (_test_key_broker_lookup);
    INSTALL_TEST (_test_key_broker_kmip);
+   INSTALL_TEST (_test_key_broker_kmip_batch);
    INSTALL_TEST (_test_key_broker_kmip_notfound);
+   INSTALL_TEST (_test_key_broker_refresh_ahead);
+   INSTALL_TEST (_test_key_broker_refresh_ahead_released);
+   INSTALL_TEST (_test_key_broker_coalesce_fetches);
 }
@@ -289,22 +289,27 @@ _match_cache_entry (_mongocrypt_tester_t *tester,
                     mongocrypt_ctx_t *ctx,
                     bson_t *expected_entry)
 {
+   _mongocrypt_cache_t *cache;
    _mongocrypt_cache_pair_t *pair;
    bool matched = false;
-
-   pair = ctx->crypt->cache_key.pair;
-
-   while (pair) {
-      if (_match_one_cache_entry (pair, expected_entry)) {
-         if (matched) {
-            printf ("double matched entry: %s\n",
-                    bson_as_json (expected_entry, NULL));
-            BSON_ASSERT (false);
+   uint32_t i;
+   int j;
+
+   cache = &ctx->crypt->cache_key;
+
+   for (j = 0; j < CACHE_NUM_SHARDS; j++) {
+      for (i = 0; i < cache->shards[j].num_buckets; i++) {
+         for (pair = cache->shards[j].buckets[i]; pair; pair = pair->next) {
+            if (_match_one_cache_entry (pair, expected_entry)) {
+               if (matched) {
+                  printf ("double matched entry: %s\n",
+                          bson_as_json (expected_entry, NULL));
+                  BSON_ASSERT (false);
+               }
+               matched = true;
+            }
          }
-         matched = true;
       }
-
-      pair = pair->next;
    }
 
    if (!matched) {
@@ -400,6 +400,20 @@ test_transform_cb (void *ctx,
    return true;
 }
 
+/* Runs tasks in reverse on the calling thread. */
+static bool
+_reverse_parallel_for (void *executor_ctx,
+                       mongocrypt_task_fn task,
+                       void *task_ctx,
+                       uint32_t count)
+{
+   while (count > 0) {
+      count--;
+      task (task_ctx, count);
+   }
+   return true;
+}
+
 static void
 test_transform (int num_markings,
                 int num_deterministic,
@@ -414,6 +428,9 @@ test_transform (int num_markings,
    bson_iter_t iter;
    bson_t *bson;
    bson_t out = BSON_INITIALIZER;
+   _mongocrypt_traverse_locs_t locs;
+   _mongocrypt_buffer_t doc;
+   _mongocrypt_buffer_t spliced;
    int matches = 0;
 
    status = mongocrypt_status_new ();
@@ -453,6 +470,47 @@ test_transform (int num_markings,
 
    BSON_ASSERT (matches == num_matches);
 
+   /* Splicing at the recorded locations produces the same document. */
+   _mongocrypt_traverse_locs_init (&locs);
+   matches = 0;
+   BSON_ASSERT (bson_iter_init (&iter, bson));
+   BSON_ASSERT (_mongocrypt_locate_binary_in_bson (
+      test_traverse_cb, &matches, match, &iter, &locs, status));
+   BSON_ASSERT (matches == num_matches);
+
+   matches = 0;
+   _mongocrypt_buffer_from_bson (&doc, bson);
+   _mongocrypt_buffer_init (&spliced);
+   BSON_ASSERT (_mongocrypt_splice_binary_in_bson (test_transform_cb,
+                                                   &matches,
+                                                   &doc,
+                                                   &locs,
+                                                   NULL /* parallel_for */,
+                                                   NULL /* executor_ctx */,
+                                                   &spliced,
+                                                   status));
+   BSON_ASSERT (matches == num_matches);
+   BSON_ASSERT (spliced.len == out.len);
+   BSON_ASSERT (0 == memcmp (spliced.data, bson_get_data (&out), out.len));
+   _mongocrypt_buffer_cleanup (&spliced);
+
+   /* The output does not depend on the order an executor runs tasks in. */
+   matches = 0;
+   _mongocrypt_buffer_init (&spliced);
+   BSON_ASSERT (_mongocrypt_splice_binary_in_bson (test_transform_cb,
+                                                   &matches,
+                                                   &doc,
+                                                   &locs,
+                                                   _reverse_parallel_for,
+                                                   NULL /* executor_ctx */,
+                                                   &spliced,
+                                                   status));
+   BSON_ASSERT (matches == num_matches);
+   BSON_ASSERT (spliced.len == out.len);
+   BSON_ASSERT (0 == memcmp (spliced.data, bson_get_data (&out), out.len));
+
+   _mongocrypt_buffer_cleanup (&spliced);
+   _mongocrypt_traverse_locs_cleanup (&locs);
    bson_destroy (bson);
    bson_destroy (&out);
    mongocrypt_status_destroy (status);